@@ -0,0 +1,308 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Reports the speed and the ratio of the formats, filters and levels supported
+// by CompressorArchiveLibarchive, so the right setting can be chosen for a
+// kind of data. The archives are created with the host libarchive, set up the
+// same way as CompressorArchiveLibarchive::SetFormatAndFilter and
+// CompressorArchiveLibarchive::SetCompressionLevel do.
+//
+// The corpus is generated, so the results are comparable between runs and
+// machines: text, incompressible binary data and sparse records. Files and
+// directories passed as arguments are added as another corpus.
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "archive.h"
+#include "archive_entry.h"
+
+namespace {
+
+// The size of every generated corpus.
+const size_t kGeneratedCorpusSize = 8 * 1024 * 1024;  // 8 MB.
+
+// The size of the files of the generated corpora.
+const size_t kGeneratedFileSize = 256 * 1024;  // 256 KB.
+
+// Same as compressor_archive_constants::kMaximumDataChunkSize.
+const size_t kMaximumDataChunkSize = 512 * 1024;
+
+// A file of a corpus.
+struct File {
+  std::string name;
+  std::string data;
+};
+
+// A named set of files.
+struct Corpus {
+  std::string name;
+  std::vector<File> files;
+};
+
+// How an archive is created. Mirrors request::PackFormat and
+// request::PackFilter.
+struct Setting {
+  const char* name;
+  bool zip;
+  // The ZIP compression or the TAR filter, see SetFormatAndFilter.
+  const char* compression;
+  // -1 for the default level.
+  int level;
+};
+
+const Setting kSettings[] = {
+    {"zip store", true, "store", -1},
+    {"zip deflate 1", true, "deflate", 1},
+    {"zip deflate 6", true, "deflate", 6},
+    {"zip deflate 9", true, "deflate", 9},
+    {"tar", false, "none", -1},
+    {"tar.gz 1", false, "gzip", 1},
+    {"tar.gz 6", false, "gzip", 6},
+    {"tar.gz 9", false, "gzip", 9},
+    {"tar.zst 1", false, "zstd", 1},
+    {"tar.zst 3", false, "zstd", 3},
+    {"tar.zst 9", false, "zstd", 9},
+    {"tar.zst 19", false, "zstd", 19},
+    {"tar.xz 0", false, "xz", 0},
+    {"tar.xz 6", false, "xz", 6},
+    {"tar.xz 9", false, "xz", 9},
+    {"tar.lz4 1", false, "lz4", 1},
+    {"tar.lz4 9", false, "lz4", 9},
+};
+
+// A xorshift generator, so the corpora are the same everywhere. Its period is
+// long enough for the binary corpus not to repeat.
+class Random {
+ public:
+  explicit Random(uint32_t seed) : state_(seed) {}
+
+  uint32_t Next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return state_;
+  }
+
+ private:
+  uint32_t state_;
+};
+
+// Splits data into files of kGeneratedFileSize named after the corpus.
+Corpus SplitCorpus(const std::string& name, const std::string& data) {
+  Corpus corpus;
+  corpus.name = name;
+  for (size_t offset = 0; offset < data.size(); offset += kGeneratedFileSize) {
+    File file;
+    std::stringstream file_name;
+    file_name << name << "/" << offset / kGeneratedFileSize;
+    file.name = file_name.str();
+    file.data = data.substr(offset, kGeneratedFileSize);
+    corpus.files.push_back(file);
+  }
+  return corpus;
+}
+
+// Words from a small vocabulary with a skewed distribution, like prose or
+// source code.
+Corpus GenerateText() {
+  const char* const kWords[] = {
+      "the", "archive", "of", "file", "and", "to", "a", "volume", "in",
+      "request", "is", "data", "for", "entry", "with", "chunk", "size",
+      "offset", "return", "const", "int64_t", "std::string", "if", "else",
+      "while", "JavaScript", "NaCl", "compressor", "header", "metadata"};
+  const size_t kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+  Random random(1);
+  std::string data;
+  while (data.size() < kGeneratedCorpusSize) {
+    // Squaring skews the distribution towards the first words.
+    uint32_t value = random.Next() % 1024;
+    data += kWords[value * value / (1024 * 1024 / kWordCount + 1) % kWordCount];
+    data += random.Next() % 12 == 0 ? "\n" : " ";
+  }
+  data.resize(kGeneratedCorpusSize);
+  return SplitCorpus("text", data);
+}
+
+// Random bytes, like already compressed media.
+Corpus GenerateBinary() {
+  Random random(2);
+  std::string data(kGeneratedCorpusSize, '\0');
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<char>(random.Next());
+  return SplitCorpus("binary", data);
+}
+
+// Fixed size records that are mostly zeros, like databases or disk images.
+Corpus GenerateSparse() {
+  Random random(3);
+  std::string data(kGeneratedCorpusSize, '\0');
+  for (size_t offset = 0; offset < data.size(); offset += 64) {
+    for (size_t i = 0; i < 8; ++i)
+      data[offset + i] = static_cast<char>(random.Next() % 16);
+  }
+  return SplitCorpus("sparse", data);
+}
+
+// Adds the file or the files in the directory at path to corpus.
+void AddPath(const std::string& path, Corpus* corpus) {
+  struct stat path_stat;
+  if (stat(path.c_str(), &path_stat) != 0)
+    return;
+
+  if (S_ISDIR(path_stat.st_mode)) {
+    DIR* directory = opendir(path.c_str());
+    if (!directory)
+      return;
+    while (struct dirent* entry = readdir(directory)) {
+      std::string name = entry->d_name;
+      if (name != "." && name != "..")
+        AddPath(path + "/" + name, corpus);
+    }
+    closedir(directory);
+  } else if (S_ISREG(path_stat.st_mode)) {
+    std::ifstream stream(path.c_str(), std::ios::binary);
+    std::stringstream data;
+    data << stream.rdbuf();
+    File file;
+    file.name = path;
+    file.data = data.str();
+    corpus->files.push_back(file);
+  }
+}
+
+// Counts the bytes written to an archive instead of keeping them.
+ssize_t CountingWrite(archive* archive_object,
+                      void* client_data,
+                      const void* buffer,
+                      size_t length) {
+  *static_cast<int64_t*>(client_data) += length;
+  return length;
+}
+
+// Same as CompressorArchiveLibarchive::SetFormatAndFilter and
+// CompressorArchiveLibarchive::SetCompressionLevel.
+bool SetUp(archive* archive_object, const Setting& setting) {
+  std::stringstream level;
+  level << setting.level;
+  if (setting.zip) {
+    if (archive_write_set_format_zip(archive_object) != ARCHIVE_OK ||
+        archive_write_set_format_option(archive_object, "zip", "compression",
+                                        setting.compression) != ARCHIVE_OK) {
+      return false;
+    }
+    return setting.level < 0 ||
+           archive_write_set_format_option(
+               archive_object, "zip", "compression-level",
+               level.str().c_str()) == ARCHIVE_OK;
+  }
+
+  if (archive_write_set_format_pax_restricted(archive_object) != ARCHIVE_OK)
+    return false;
+  if (!strcmp(setting.compression, "none"))
+    return archive_write_add_filter_none(archive_object) == ARCHIVE_OK;
+  if (archive_write_add_filter_by_name(archive_object, setting.compression) !=
+      ARCHIVE_OK) {
+    return false;
+  }
+  return setting.level < 0 ||
+         archive_write_set_filter_option(archive_object, NULL,
+                                         "compression-level",
+                                         level.str().c_str()) == ARCHIVE_OK;
+}
+
+// Archives corpus with setting. Returns false in case of failure, otherwise
+// sets *output_size and *seconds.
+bool Run(const Corpus& corpus,
+         const Setting& setting,
+         int64_t* output_size,
+         double* seconds) {
+  *output_size = 0;
+  archive* archive_object = archive_write_new();
+  if (!SetUp(archive_object, setting)) {
+    archive_write_free(archive_object);
+    return false;
+  }
+  archive_write_set_bytes_in_last_block(archive_object, 1);
+  archive_write_set_bytes_per_block(archive_object, kMaximumDataChunkSize);
+
+  timeval start;
+  gettimeofday(&start, NULL);
+  archive_write_open(archive_object, output_size, NULL, CountingWrite, NULL);
+  bool success = true;
+  for (size_t i = 0; i < corpus.files.size() && success; ++i) {
+    const File& file = corpus.files[i];
+    archive_entry* entry = archive_entry_new();
+    archive_entry_set_pathname(entry, file.name.c_str());
+    archive_entry_set_size(entry, file.data.size());
+    archive_entry_set_filetype(entry, AE_IFREG);
+    archive_entry_set_perm(entry, 0640);
+    success = archive_write_header(archive_object, entry) == ARCHIVE_OK;
+    for (size_t offset = 0; success && offset < file.data.size();
+         offset += kMaximumDataChunkSize) {
+      size_t length =
+          std::min(kMaximumDataChunkSize, file.data.size() - offset);
+      success = archive_write_data(archive_object, file.data.data() + offset,
+                                   length) == static_cast<ssize_t>(length);
+    }
+    archive_entry_free(entry);
+  }
+  success = archive_write_close(archive_object) == ARCHIVE_OK && success;
+  archive_write_free(archive_object);
+
+  timeval end;
+  gettimeofday(&end, NULL);
+  *seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  return success;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<Corpus> corpora;
+  corpora.push_back(GenerateText());
+  corpora.push_back(GenerateBinary());
+  corpora.push_back(GenerateSparse());
+  if (argc > 1) {
+    Corpus corpus;
+    corpus.name = "files";
+    for (int i = 1; i < argc; ++i)
+      AddPath(argv[i], &corpus);
+    corpora.push_back(corpus);
+  }
+
+  printf("%-8s %-14s %10s %10s %8s %10s\n", "corpus", "setting", "input MB",
+         "output MB", "ratio", "MB/s");
+  for (size_t i = 0; i < corpora.size(); ++i) {
+    int64_t input_size = 0;
+    for (size_t j = 0; j < corpora[i].files.size(); ++j)
+      input_size += corpora[i].files[j].data.size();
+    double input_mb = input_size / (1024.0 * 1024.0);
+
+    for (size_t j = 0; j < sizeof(kSettings) / sizeof(kSettings[0]); ++j) {
+      int64_t output_size = 0;
+      double seconds = 0;
+      if (!Run(corpora[i], kSettings[j], &output_size, &seconds)) {
+        printf("%-8s %-14s %s\n", corpora[i].name.c_str(), kSettings[j].name,
+               "not supported");
+        continue;
+      }
+      printf("%-8s %-14s %10.2f %10.2f %8.3f %10.1f\n",
+             corpora[i].name.c_str(), kSettings[j].name, input_mb,
+             output_size / (1024.0 * 1024.0),
+             input_size > 0 ? static_cast<double>(output_size) / input_size : 0,
+             seconds > 0 ? input_mb / seconds : 0);
+    }
+  }
+  return 0;
+}
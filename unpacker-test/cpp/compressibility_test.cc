@@ -0,0 +1,87 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "compressibility.h"
+
+#include <cstdlib>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Returns incompressible data of the given size.
+std::string GetRandomData(size_t size) {
+  unsigned int seed = 1;
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; ++i)
+    data[i] = static_cast<char>(rand_r(&seed));
+  return data;
+}
+
+// Returns compressible data of the given size.
+std::string GetTextData(size_t size) {
+  std::string data;
+  while (data.size() < size)
+    data += "The quick brown fox jumps over the lazy dog. ";
+  data.resize(size);
+  return data;
+}
+
+}  // namespace
+
+TEST(CompressibilityTest, HasCompressedExtension) {
+  EXPECT_TRUE(compressibility::HasCompressedExtension("photo.jpg"));
+  EXPECT_TRUE(compressibility::HasCompressedExtension("dir/Movie.MP4"));
+  EXPECT_TRUE(compressibility::HasCompressedExtension("archive.tar.gz"));
+  EXPECT_FALSE(compressibility::HasCompressedExtension("notes.txt"));
+  EXPECT_FALSE(compressibility::HasCompressedExtension("jpg"));
+  EXPECT_FALSE(compressibility::HasCompressedExtension("photos.jpg/readme"));
+  EXPECT_FALSE(compressibility::HasCompressedExtension("file."));
+}
+
+TEST(CompressibilityTest, HasCompressedSignature) {
+  const char kPng[] = "\x89PNG\r\n\x1a\n and the rest";
+  EXPECT_TRUE(compressibility::HasCompressedSignature(kPng, sizeof(kPng) - 1));
+  const char kWebp[] = "RIFF\x10\x00\x00\x00WEBPVP8 ";
+  EXPECT_TRUE(
+      compressibility::HasCompressedSignature(kWebp, sizeof(kWebp) - 1));
+
+  // The signature must fit in the data.
+  EXPECT_FALSE(compressibility::HasCompressedSignature(kPng, 4));
+  const char kText[] = "Plain text.";
+  EXPECT_FALSE(
+      compressibility::HasCompressedSignature(kText, sizeof(kText) - 1));
+}
+
+TEST(CompressibilityTest, EstimateRatio) {
+  std::string random = GetRandomData(compressibility_constants::kSampleSize);
+  EXPECT_GE(compressibility::EstimateRatio(random.data(), random.size()),
+            compressibility_constants::kDefaultStoreRatio);
+
+  // Only the sample is deflated.
+  std::string text = GetTextData(compressibility_constants::kSampleSize) +
+                     GetRandomData(compressibility_constants::kSampleSize);
+  EXPECT_LT(compressibility::EstimateRatio(text.data(), text.size()), 0.1);
+
+  EXPECT_EQ(1, compressibility::EstimateRatio("", 0));
+}
+
+TEST(CompressibilityTest, ShouldStore) {
+  std::string random = GetRandomData(1000);
+  std::string text = GetTextData(1000);
+  const double kRatio = compressibility_constants::kDefaultStoreRatio;
+
+  EXPECT_TRUE(compressibility::ShouldStore("random", random.data(),
+                                           random.size(), kRatio));
+  EXPECT_TRUE(compressibility::ShouldStore("text.zip", text.data(),
+                                           text.size(), kRatio));
+  EXPECT_TRUE(compressibility::ShouldStore("text", "PK\x03\x04", 4, kRatio));
+  EXPECT_FALSE(
+      compressibility::ShouldStore("text", text.data(), text.size(), kRatio));
+
+  // A ratio of 0 disables the detection.
+  EXPECT_FALSE(compressibility::ShouldStore("random.jpg", random.data(),
+                                            random.size(), 0));
+}
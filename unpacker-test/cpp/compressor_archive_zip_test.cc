@@ -0,0 +1,608 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "compressor_archive_zip.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "ppapi/utility/threading/simple_thread.h"
+#include "ppapi_simple/ps_main.h"
+#include "zlib.h"
+
+#include "compressibility.h"
+#include "compressor_io_javascript_stream.h"
+
+namespace {
+
+// The size of a file made of several chunks.
+const int64_t kLargeFileSize =
+    compressor_archive_constants::kMaximumDataChunkSize * 5 / 2;
+
+// A fixed modification time, 2017-01-01 00:00:00 UTC.
+const time_t kModificationTime = 1483228800;
+
+// How long PendingWritesCompressorStream takes to write a chunk.
+const useconds_t kWriteDelayUs = 20000;  // 20 ms.
+
+// A stream that serves the files from memory and keeps the archive.
+class FakeCompressorStream : public CompressorStream {
+ public:
+  FakeCompressorStream() : fail_reads_(false) {}
+
+  // Queues data to be read by the next Read() calls. Empty files are not
+  // read.
+  void AddFile(const std::string& data) {
+    if (!data.empty())
+      files_.push_back(data);
+  }
+
+  virtual pp::VarArrayBuffer GetWriteBuffer() {
+    return pp::VarArrayBuffer(
+        compressor_archive_constants::kMaximumDataChunkSize);
+  }
+
+  virtual int64_t Write(int64_t bytes_to_write,
+                        const pp::VarArrayBuffer& buffer) {
+    pp::VarArrayBuffer array_buffer(buffer);
+    archive_.append(static_cast<const char*>(array_buffer.Map()),
+                    bytes_to_write);
+    array_buffer.Unmap();
+    return bytes_to_write;
+  }
+
+  virtual void WriteChunkDone(int64_t write_bytes) {}
+
+  virtual bool Flush() { return true; }
+
+  virtual void StartEntry(int entry_id, int64_t file_size) {}
+
+  virtual void StartEntryWithContents(int entry_id,
+                                      const pp::VarArrayBuffer& contents) {}
+
+  virtual int64_t Read(int64_t bytes_to_read, pp::VarArrayBuffer* buffer) {
+    if (fail_reads_ || files_.empty() ||
+        files_.front().size() < static_cast<size_t>(bytes_to_read)) {
+      return -1;
+    }
+    *buffer = pp::VarArrayBuffer(bytes_to_read);
+    memcpy(buffer->Map(), files_.front().data(), bytes_to_read);
+    buffer->Unmap();
+    files_.front().erase(0, bytes_to_read);
+    if (files_.front().empty())
+      files_.pop_front();
+    return bytes_to_read;
+  }
+
+  virtual void ReadFileChunkDone(int64_t read_bytes,
+                                 pp::VarArrayBuffer* buffer) {}
+
+  virtual void Abort() {}
+
+  void set_fail_reads(bool fail_reads) { fail_reads_ = fail_reads; }
+
+  const std::string& archive() const { return archive_; }
+
+ private:
+  std::deque<std::string> files_;
+  std::string archive_;
+  bool fail_reads_;
+};
+
+// A stream that writes through CompressorIOJavaScriptStream, with the chunks
+// written late by another thread like JavaScript does, so Write() waits with
+// the maximum number of chunks pending.
+class PendingWritesCompressorStream
+    : public FakeCompressorStream,
+      public JavaScriptCompressorRequestorInterface {
+ public:
+  explicit PendingWritesCompressorStream(pp::InstanceHandle instance_handle)
+      : io_stream_(this),
+        worker_(instance_handle),
+        callback_factory_(this),
+        pending_writes_(0),
+        max_pending_writes_(0),
+        write_waited_(false) {
+    pthread_mutex_init(&lock_, NULL);
+    pthread_cond_init(&pending_writes_cond_, NULL);
+  }
+
+  virtual ~PendingWritesCompressorStream() {
+    worker_.Join();
+    pthread_cond_destroy(&pending_writes_cond_);
+    pthread_mutex_destroy(&lock_);
+  }
+
+  bool Init() { return worker_.Start(); }
+
+  virtual pp::VarArrayBuffer GetWriteBuffer() {
+    return io_stream_.GetWriteBuffer();
+  }
+
+  virtual int64_t Write(int64_t bytes_to_write,
+                        const pp::VarArrayBuffer& buffer) {
+    pthread_mutex_lock(&lock_);
+    if (pending_writes_ >= compressor_stream_constants::kMaximumPendingWrites) {
+      write_waited_ = true;
+      pthread_cond_broadcast(&pending_writes_cond_);
+    }
+    pthread_mutex_unlock(&lock_);
+    return io_stream_.Write(bytes_to_write, buffer);
+  }
+
+  virtual bool Flush() { return io_stream_.Flush(); }
+
+  virtual void WriteChunkRequest(int64_t length,
+                                 const pp::VarArrayBuffer& buffer) {
+    // The buffer is reused once written, so keep its contents now.
+    FakeCompressorStream::Write(length, buffer);
+    pthread_mutex_lock(&lock_);
+    ++pending_writes_;
+    max_pending_writes_ = std::max(max_pending_writes_, pending_writes_);
+    pthread_mutex_unlock(&lock_);
+    worker_.message_loop().PostWork(callback_factory_.NewCallback(
+        &PendingWritesCompressorStream::WriteChunkDoneCallback, length));
+  }
+
+  virtual void ReadFileChunkRequest(int entry_id, int64_t length) {}
+
+  // Blocks until Write() is called with the maximum number of chunks
+  // pending, so that it waits for them to be written.
+  void WaitForWaitingWrite() {
+    pthread_mutex_lock(&lock_);
+    while (!write_waited_)
+      pthread_cond_wait(&pending_writes_cond_, &lock_);
+    pthread_mutex_unlock(&lock_);
+  }
+
+  // The maximum number of chunks that were pending at the same time.
+  size_t max_pending_writes() const { return max_pending_writes_; }
+
+ private:
+  void WriteChunkDoneCallback(int32_t /*result*/, int64_t length) {
+    usleep(kWriteDelayUs);
+    pthread_mutex_lock(&lock_);
+    --pending_writes_;
+    pthread_mutex_unlock(&lock_);
+    io_stream_.WriteChunkDone(length);
+  }
+
+  CompressorIOJavaScriptStream io_stream_;
+
+  // Writes the chunks on a different thread than Write() and Flush().
+  pp::SimpleThread worker_;
+  pp::CompletionCallbackFactory<PendingWritesCompressorStream>
+      callback_factory_;
+
+  pthread_mutex_t lock_;
+  pthread_cond_t pending_writes_cond_;
+  size_t pending_writes_;
+  size_t max_pending_writes_;
+  bool write_waited_;
+};
+
+// The jobs that add a file to an archive and close it, run on the pool like
+// the jobs of Compressor.
+struct ArchiveJobs {
+  CompressorArchiveZip* compressor_archive;
+  std::string contents;
+};
+
+void RunAddToArchiveJob(void* jobs_data, int32_t /*result*/) {
+  ArchiveJobs* jobs = static_cast<ArchiveJobs*>(jobs_data);
+  jobs->compressor_archive->AddToArchive(
+      "file", jobs->contents.size(), kModificationTime, false /* directory */,
+      0 /* compression_level */);
+}
+
+void RunCloseArchiveJob(void* jobs_data, int32_t /*result*/) {
+  ArchiveJobs* jobs = static_cast<ArchiveJobs*>(jobs_data);
+  jobs->compressor_archive->CloseArchive(false /* has_error */);
+}
+
+// An entry read back from an archive.
+struct ZipEntry {
+  std::string filename;
+  uint16_t method;
+  uint32_t external_attributes;
+  std::string data;
+};
+
+uint32_t GetUint32(const std::string& data, size_t offset) {
+  const unsigned char* bytes =
+      reinterpret_cast<const unsigned char*>(data.data() + offset);
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+         (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+uint16_t GetUint16(const std::string& data, size_t offset) {
+  const unsigned char* bytes =
+      reinterpret_cast<const unsigned char*>(data.data() + offset);
+  return bytes[0] | (bytes[1] << 8);
+}
+
+// Inflates raw deflate data of the given size.
+std::string Inflate(const std::string& data, size_t size) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  EXPECT_EQ(Z_OK, inflateInit2(&stream, -MAX_WBITS));
+  std::string output(size, '\0');
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = data.size();
+  stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+  stream.avail_out = output.size();
+  EXPECT_EQ(Z_STREAM_END, inflate(&stream, Z_FINISH));
+  EXPECT_EQ(0u, stream.avail_in);
+  output.resize(stream.total_out);
+  inflateEnd(&stream);
+  return output;
+}
+
+// Reads the entries of a ZIP archive through its central directory, checking
+// the CRC-32 and the sizes of every entry.
+std::vector<ZipEntry> ReadZip(const std::string& archive) {
+  std::vector<ZipEntry> entries;
+  if (archive.size() < 22) {
+    ADD_FAILURE() << "The archive is too short.";
+    return entries;
+  }
+  size_t end = archive.size() - 22;
+  EXPECT_EQ(0x06054b50u, GetUint32(archive, end));
+  size_t count = GetUint16(archive, end + 10);
+  size_t offset = GetUint32(archive, end + 16);
+
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_EQ(0x02014b50u, GetUint32(archive, offset));
+    ZipEntry entry;
+    uint16_t flags = GetUint16(archive, offset + 8);
+    entry.method = GetUint16(archive, offset + 10);
+    uint32_t crc = GetUint32(archive, offset + 16);
+    uint32_t compressed_size = GetUint32(archive, offset + 20);
+    uint32_t size = GetUint32(archive, offset + 24);
+    uint16_t filename_length = GetUint16(archive, offset + 28);
+    uint16_t extra_length = GetUint16(archive, offset + 30);
+    entry.external_attributes = GetUint32(archive, offset + 38);
+    uint32_t header_offset = GetUint32(archive, offset + 42);
+    entry.filename = archive.substr(offset + 46, filename_length);
+    offset += 46 + filename_length + extra_length;
+
+    EXPECT_EQ(0x04034b50u, GetUint32(archive, header_offset));
+    EXPECT_EQ(flags, GetUint16(archive, header_offset + 6));
+    EXPECT_EQ(entry.method, GetUint16(archive, header_offset + 8));
+    size_t data_offset = header_offset + 30 +
+                         GetUint16(archive, header_offset + 26) +
+                         GetUint16(archive, header_offset + 28);
+    std::string data = archive.substr(data_offset, compressed_size);
+    entry.data = entry.method == 8 ? Inflate(data, size) : data;
+    EXPECT_EQ(size, entry.data.size());
+    EXPECT_EQ(crc, crc32(0, reinterpret_cast<const Bytef*>(entry.data.data()),
+                         entry.data.size()));
+
+    // Deflated entries have a data descriptor, stored entries have their
+    // CRC-32 and sizes in their local header.
+    if (entry.method == 0) {
+      EXPECT_EQ(0, flags & 0x08);
+      EXPECT_EQ(crc, GetUint32(archive, header_offset + 14));
+      EXPECT_EQ(compressed_size, GetUint32(archive, header_offset + 18));
+      EXPECT_EQ(size, GetUint32(archive, header_offset + 22));
+    } else {
+      EXPECT_EQ(0x08, flags & 0x08);
+      size_t descriptor_offset = data_offset + compressed_size;
+      EXPECT_EQ(0x08074b50u, GetUint32(archive, descriptor_offset));
+      EXPECT_EQ(crc, GetUint32(archive, descriptor_offset + 4));
+      EXPECT_EQ(compressed_size, GetUint32(archive, descriptor_offset + 8));
+      EXPECT_EQ(size, GetUint32(archive, descriptor_offset + 12));
+    }
+    entries.push_back(entry);
+  }
+  return entries;
+}
+
+// Returns incompressible data of the given size.
+std::string GetRandomContents(int64_t size, unsigned int seed) {
+  std::string contents(size, '\0');
+  for (int64_t i = 0; i < size; ++i)
+    contents[i] = static_cast<char>(rand_r(&seed));
+  return contents;
+}
+
+// Returns compressible data of the given size.
+std::string GetContents(int64_t size, int seed) {
+  std::string contents;
+  for (int64_t i = 0; contents.size() < static_cast<size_t>(size); ++i) {
+    char line[64];
+    snprintf(line, sizeof(line), "line %lld of file %d\n",
+             static_cast<long long>(i), seed);
+    contents += line;
+  }
+  contents.resize(size);
+  return contents;
+}
+
+}  // namespace
+
+// Class used by TEST_F macro to initialize the environment for testing
+// CompressorArchiveZip methods.
+class CompressorArchiveZipTest : public testing::Test {
+ protected:
+  CompressorArchiveZipTest() : worker_pool(NULL), compressor_archive(NULL) {}
+
+  virtual void SetUp() {
+    worker_pool = new WorkerPool(pp::InstanceHandle(PSGetInstanceId()),
+                                 worker_pool_constants::kMaximumThreads);
+    ASSERT_TRUE(worker_pool->Start());
+    compressor_archive = new CompressorArchiveZip(
+        &stream, worker_pool, compressibility_constants::kDefaultStoreRatio);
+  }
+
+  virtual void TearDown() {
+    delete compressor_archive;
+    compressor_archive = NULL;
+    delete worker_pool;
+    worker_pool = NULL;
+  }
+
+  // Adds a file with contents to the archive.
+  void AddFile(const std::string& filename,
+               const std::string& contents,
+               int compression_level) {
+    stream.AddFile(contents);
+    compressor_archive->AddToArchive(filename, contents.size(),
+                                     kModificationTime, false /* directory */,
+                                     compression_level);
+  }
+
+  FakeCompressorStream stream;
+  WorkerPool* worker_pool;
+  CompressorArchiveZip* compressor_archive;
+};
+
+TEST_F(CompressorArchiveZipTest, IsSupported) {
+  EXPECT_TRUE(CompressorArchiveZip::IsSupported(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_DEFAULT, ""));
+  EXPECT_TRUE(CompressorArchiveZip::IsSupported(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_NONE, ""));
+  EXPECT_TRUE(CompressorArchiveZip::IsSupported(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_DEFLATE, ""));
+  EXPECT_FALSE(CompressorArchiveZip::IsSupported(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_ZSTD, ""));
+  EXPECT_FALSE(CompressorArchiveZip::IsSupported(
+      request::PACK_FORMAT_TAR, request::PACK_FILTER_DEFAULT, ""));
+  // libarchive options need libarchive.
+  EXPECT_FALSE(CompressorArchiveZip::IsSupported(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_DEFAULT,
+      "zip:experimental"));
+}
+
+TEST_F(CompressorArchiveZipTest, CreateArchiveWithInvalidLevel) {
+  EXPECT_FALSE(compressor_archive->CreateArchive(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_DEFAULT, 10, ""));
+  EXPECT_FALSE(compressor_archive->CreateArchive(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_DEFAULT, -2, ""));
+}
+
+TEST_F(CompressorArchiveZipTest, WriteEntries) {
+  ASSERT_TRUE(compressor_archive->CreateArchive(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_DEFAULT,
+      compressor_archive_constants::kDefaultCompressionLevel, ""));
+
+  std::vector<std::string> contents;
+  contents.push_back(GetContents(100, 1));
+  contents.push_back(GetContents(kLargeFileSize, 2));
+  contents.push_back(GetContents(1000, 3));
+  compressor_archive->AddToArchive(
+      "dir", 0, kModificationTime, true /* directory */,
+      compressor_archive_constants::kDefaultCompressionLevel);
+  AddFile("dir/small", contents[0],
+          compressor_archive_constants::kDefaultCompressionLevel);
+  AddFile("dir/large", contents[1],
+          compressor_archive_constants::kDefaultCompressionLevel);
+  AddFile("dir/empty", "",
+          compressor_archive_constants::kDefaultCompressionLevel);
+  AddFile("stored", contents[2], 0);
+  compressor_archive->CloseArchive(false /* has_error */);
+
+  std::vector<ZipEntry> entries = ReadZip(stream.archive());
+  ASSERT_EQ(5u, entries.size());
+
+  // The entries are written in order, whichever is deflated first.
+  EXPECT_EQ("dir", entries[0].filename);
+  EXPECT_EQ(0, entries[0].method);
+  EXPECT_EQ(0x10u, entries[0].external_attributes & 0x10);
+
+  EXPECT_EQ("dir/small", entries[1].filename);
+  EXPECT_EQ(8, entries[1].method);
+  EXPECT_EQ(contents[0], entries[1].data);
+
+  EXPECT_EQ("dir/large", entries[2].filename);
+  EXPECT_EQ(8, entries[2].method);
+  EXPECT_EQ(contents[1], entries[2].data);
+
+  // Empty files are stored.
+  EXPECT_EQ("dir/empty", entries[3].filename);
+  EXPECT_EQ(0, entries[3].method);
+  EXPECT_TRUE(entries[3].data.empty());
+
+  EXPECT_EQ("stored", entries[4].filename);
+  EXPECT_EQ(0, entries[4].method);
+  EXPECT_EQ(contents[2], entries[4].data);
+}
+
+TEST_F(CompressorArchiveZipTest, WriteStoredArchive) {
+  ASSERT_TRUE(compressor_archive->CreateArchive(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_NONE,
+      compressor_archive_constants::kDefaultCompressionLevel, ""));
+
+  std::string contents = GetContents(kLargeFileSize, 1);
+  AddFile("stored", contents,
+          compressor_archive_constants::kDefaultCompressionLevel);
+  // The level of an entry overrides the archive's.
+  AddFile("deflated", contents, 1);
+  compressor_archive->CloseArchive(false /* has_error */);
+
+  std::vector<ZipEntry> entries = ReadZip(stream.archive());
+  ASSERT_EQ(2u, entries.size());
+  EXPECT_EQ(0, entries[0].method);
+  EXPECT_EQ(contents, entries[0].data);
+  EXPECT_EQ(8, entries[1].method);
+  EXPECT_EQ(contents, entries[1].data);
+}
+
+TEST_F(CompressorArchiveZipTest, WriteEntryTooBigToStore) {
+  ASSERT_TRUE(compressor_archive->CreateArchive(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_NONE,
+      compressor_archive_constants::kDefaultCompressionLevel, ""));
+
+  // Stored entries are read entirely before being written, so bigger entries
+  // are deflated without compression.
+  std::string contents = GetContents(
+      compressor_archive_constants::kMaximumStoredEntrySize + 1, 1);
+  AddFile("large", contents,
+          compressor_archive_constants::kDefaultCompressionLevel);
+  compressor_archive->CloseArchive(false /* has_error */);
+
+  std::vector<ZipEntry> entries = ReadZip(stream.archive());
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ(8, entries[0].method);
+  EXPECT_EQ(contents, entries[0].data);
+  EXPECT_LT(contents.size(), stream.archive().size());
+}
+
+TEST_F(CompressorArchiveZipTest, WriteLargeEntries) {
+  ASSERT_TRUE(compressor_archive->CreateArchive(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_DEFAULT,
+      compressor_archive_constants::kDefaultCompressionLevel, ""));
+
+  // The chunks of every entry are deflated in parallel, with the streams of
+  // the queues switching between levels.
+  std::vector<std::string> contents;
+  contents.push_back(GetContents(kLargeFileSize * 2, 1));
+  contents.push_back(GetRandomContents(kLargeFileSize, 2));
+  contents.push_back(GetContents(kLargeFileSize, 3));
+  AddFile("default", contents[0],
+          compressor_archive_constants::kDefaultCompressionLevel);
+  AddFile("random", contents[1], 9);
+  AddFile("fast", contents[2], 1);
+  compressor_archive->CloseArchive(false /* has_error */);
+
+  std::vector<ZipEntry> entries = ReadZip(stream.archive());
+  ASSERT_EQ(3u, entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    EXPECT_EQ(8, entries[i].method);
+    EXPECT_EQ(contents[i], entries[i].data);
+  }
+}
+
+TEST_F(CompressorArchiveZipTest, WriteIncompressibleEntries) {
+  ASSERT_TRUE(compressor_archive->CreateArchive(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_DEFAULT,
+      compressor_archive_constants::kDefaultCompressionLevel, ""));
+
+  std::vector<std::string> contents;
+  contents.push_back(GetRandomContents(kLargeFileSize, 1));
+  contents.push_back(GetContents(1000, 2));
+  contents.push_back(GetRandomContents(1000, 3));
+  contents.push_back(GetContents(1000, 4));
+  AddFile("random", contents[0],
+          compressor_archive_constants::kDefaultCompressionLevel);
+  // Compressed formats are recognized by their extension.
+  AddFile("photo.JPG", contents[1],
+          compressor_archive_constants::kDefaultCompressionLevel);
+  // An explicit level is respected.
+  AddFile("random.bin", contents[2], 6);
+  AddFile("text", contents[3],
+          compressor_archive_constants::kDefaultCompressionLevel);
+  compressor_archive->CloseArchive(false /* has_error */);
+
+  std::vector<ZipEntry> entries = ReadZip(stream.archive());
+  ASSERT_EQ(4u, entries.size());
+  EXPECT_EQ(0, entries[0].method);
+  EXPECT_EQ(0, entries[1].method);
+  EXPECT_EQ(8, entries[2].method);
+  EXPECT_EQ(8, entries[3].method);
+  for (size_t i = 0; i < entries.size(); ++i)
+    EXPECT_EQ(contents[i], entries[i].data);
+}
+
+TEST_F(CompressorArchiveZipTest, WriteManyEntries) {
+  ASSERT_TRUE(compressor_archive->CreateArchive(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_DEFAULT, 9, ""));
+
+  // More entries than queues, so that queues are shared by entries.
+  const int kEntries = worker_pool_constants::kMaximumThreads * 4;
+  for (int i = 0; i < kEntries; ++i) {
+    char filename[16];
+    snprintf(filename, sizeof(filename), "%d", i);
+    AddFile(filename, GetContents(10000 * (i + 1), i),
+            compressor_archive_constants::kDefaultCompressionLevel);
+  }
+  compressor_archive->CloseArchive(false /* has_error */);
+
+  std::vector<ZipEntry> entries = ReadZip(stream.archive());
+  ASSERT_EQ(static_cast<size_t>(kEntries), entries.size());
+  for (int i = 0; i < kEntries; ++i)
+    EXPECT_EQ(GetContents(10000 * (i + 1), i), entries[i].data);
+}
+
+TEST_F(CompressorArchiveZipTest, ReadFailure) {
+  ASSERT_TRUE(compressor_archive->CreateArchive(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_DEFAULT,
+      compressor_archive_constants::kDefaultCompressionLevel, ""));
+
+  stream.set_fail_reads(true);
+  AddFile("file", GetContents(kLargeFileSize, 1),
+          compressor_archive_constants::kDefaultCompressionLevel);
+  // Closing with an error doesn't wait for the writer.
+  compressor_archive->CloseArchive(true /* has_error */);
+  // Nothing is written after an error.
+  AddFile("next", GetContents(100, 2),
+          compressor_archive_constants::kDefaultCompressionLevel);
+  EXPECT_EQ(std::string::npos, stream.archive().find("next"));
+}
+
+// Closing an archive waits for the writer, which waits for JavaScript with
+// the maximum number of chunks pending, even with a single thread in the pool.
+TEST(CompressorArchiveZipPendingWritesTest, CloseArchiveWithPendingWrites) {
+  pp::InstanceHandle instance_handle(PSGetInstanceId());
+  WorkerPool worker_pool(instance_handle, 1);
+  ASSERT_TRUE(worker_pool.Start());
+  PendingWritesCompressorStream stream(instance_handle);
+  ASSERT_TRUE(stream.Init());
+  CompressorArchiveZip compressor_archive(
+      &stream, &worker_pool, compressibility_constants::kDefaultStoreRatio);
+  ASSERT_TRUE(compressor_archive.CreateArchive(
+      request::PACK_FORMAT_ZIP, request::PACK_FILTER_NONE,
+      compressor_archive_constants::kDefaultCompressionLevel, ""));
+
+  // Many more chunks than can be pending.
+  ArchiveJobs jobs;
+  jobs.compressor_archive = &compressor_archive;
+  jobs.contents = GetRandomContents(
+      compressor_archive_constants::kMaximumDataChunkSize *
+          compressor_stream_constants::kMaximumPendingWrites * 3,
+      1);
+  stream.AddFile(jobs.contents);
+
+  // The writer is already waiting for JavaScript when the archive is closed.
+  WorkerPool::JobQueue job_queue(&worker_pool);
+  job_queue.PostWork(pp::CompletionCallback(&RunAddToArchiveJob, &jobs));
+  stream.WaitForWaitingWrite();
+  job_queue.PostWork(pp::CompletionCallback(&RunCloseArchiveJob, &jobs));
+  job_queue.Join();
+
+  EXPECT_EQ(compressor_stream_constants::kMaximumPendingWrites,
+            stream.max_pending_writes());
+  std::vector<ZipEntry> entries = ReadZip(stream.archive());
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ(jobs.contents, entries[0].data);
+}
@@ -0,0 +1,226 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "compressor_io_javascript_stream.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "ppapi/cpp/var_array_buffer.h"
+
+#include "compressor_archive.h"
+
+namespace {
+
+const int64_t kChunkSize = compressor_archive_constants::kMaximumDataChunkSize;
+
+// Returns the contents of buffer.
+std::string GetContents(pp::VarArrayBuffer* buffer) {
+  std::string contents(static_cast<char*>(buffer->Map()),
+                       buffer->ByteLength());
+  buffer->Unmap();
+  return contents;
+}
+
+// Fake JavaScriptCompressorRequestor that records the requests. The tests
+// respond to them in order, as JavaScript does.
+class FakeJavaScriptCompressorRequestor
+    : public JavaScriptCompressorRequestorInterface {
+ public:
+  virtual void WriteChunkRequest(int64_t length,
+                                 const pp::VarArrayBuffer& buffer) {
+    write_requests_.push_back(length);
+  }
+
+  virtual void ReadFileChunkRequest(int entry_id, int64_t length) {
+    read_entry_ids_.push_back(entry_id);
+    read_requests_.push_back(length);
+  }
+
+  const std::vector<int64_t>& write_requests() const {
+    return write_requests_;
+  }
+
+  const std::vector<int64_t>& read_requests() const { return read_requests_; }
+
+  const std::vector<int>& read_entry_ids() const { return read_entry_ids_; }
+
+ private:
+  std::vector<int64_t> write_requests_;
+  std::vector<int64_t> read_requests_;
+  std::vector<int> read_entry_ids_;
+};
+
+}  // namespace
+
+// Class used by TEST_F macro to initialize the environment for testing
+// CompressorIOJavaScriptStream methods.
+class CompressorIOJavaScriptStreamTest : public testing::Test {
+ protected:
+  CompressorIOJavaScriptStreamTest()
+      : stream(&requestor), responded_requests(0) {}
+
+  // Responds to the next read file chunk request with a chunk filled with the
+  // index of the request, or with an error if fail is true.
+  void RespondToNextRequest(bool fail) {
+    ASSERT_LT(responded_requests, requestor.read_requests().size());
+    int64_t length = requestor.read_requests()[responded_requests];
+    pp::VarArrayBuffer buffer(length);
+    memset(buffer.Map(), static_cast<int>(responded_requests), length);
+    buffer.Unmap();
+    stream.ReadFileChunkDone(fail ? -1 : length, &buffer);
+    responses.push_back(buffer);
+    ++responded_requests;
+  }
+
+  FakeJavaScriptCompressorRequestor requestor;
+  CompressorIOJavaScriptStream stream;
+  size_t responded_requests;
+  std::vector<pp::VarArrayBuffer> responses;
+};
+
+TEST_F(CompressorIOJavaScriptStreamTest, ReadAhead) {
+  stream.StartEntry(1, kChunkSize * 5 / 2);
+  // The first chunks are requested before they are read.
+  ASSERT_EQ(compressor_stream_constants::kMaximumReadAheadChunks,
+            requestor.read_requests().size());
+  EXPECT_EQ(kChunkSize, requestor.read_requests()[0]);
+  EXPECT_EQ(kChunkSize, requestor.read_requests()[1]);
+  RespondToNextRequest(false);
+  RespondToNextRequest(false);
+
+  // Reading a chunk requests the next one. The chunk is not copied.
+  pp::VarArrayBuffer buffer;
+  EXPECT_EQ(kChunkSize, stream.Read(kChunkSize, &buffer));
+  EXPECT_TRUE(responses[0] == buffer);
+  EXPECT_EQ(std::string(kChunkSize, 0), GetContents(&buffer));
+  ASSERT_EQ(3u, requestor.read_requests().size());
+  EXPECT_EQ(kChunkSize / 2, requestor.read_requests()[2]);
+  RespondToNextRequest(false);
+
+  // Reads don't need to match the chunks.
+  EXPECT_EQ(kChunkSize / 2, stream.Read(kChunkSize / 2, &buffer));
+  EXPECT_EQ(std::string(kChunkSize / 2, 1), GetContents(&buffer));
+  EXPECT_EQ(kChunkSize, stream.Read(kChunkSize, &buffer));
+  EXPECT_EQ(std::string(kChunkSize / 2, 1) + std::string(kChunkSize / 2, 2),
+            GetContents(&buffer));
+
+  // Nothing is requested beyond the entry.
+  EXPECT_EQ(3u, requestor.read_requests().size());
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, ReadError) {
+  stream.StartEntry(1, kChunkSize * 2);
+  RespondToNextRequest(true);
+  RespondToNextRequest(false);
+
+  pp::VarArrayBuffer buffer;
+  EXPECT_EQ(-1, stream.Read(kChunkSize, &buffer));
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, DiscardPreviousEntry) {
+  stream.StartEntry(1, kChunkSize * 3);
+  RespondToNextRequest(false);
+
+  // The chunks of the previous entry are discarded, whether they were
+  // received or not.
+  stream.StartEntry(2, 100);
+  ASSERT_EQ(3u, requestor.read_requests().size());
+  EXPECT_EQ(100, requestor.read_requests()[2]);
+  // The requests tell JavaScript which entry to read.
+  EXPECT_EQ(1, requestor.read_entry_ids()[1]);
+  EXPECT_EQ(2, requestor.read_entry_ids()[2]);
+  RespondToNextRequest(false);
+  RespondToNextRequest(false);
+
+  pp::VarArrayBuffer buffer;
+  EXPECT_EQ(100, stream.Read(100, &buffer));
+  EXPECT_EQ(std::string(100, 2), GetContents(&buffer));
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, StartEntryWithContents) {
+  stream.StartEntry(1, kChunkSize * 2);
+  RespondToNextRequest(false);
+
+  // The contents are read without requesting anything, and the chunks of the
+  // previous entry are discarded.
+  pp::VarArrayBuffer contents(100);
+  memset(contents.Map(), 'a', 100);
+  contents.Unmap();
+  stream.StartEntryWithContents(2, contents);
+  RespondToNextRequest(false);
+
+  pp::VarArrayBuffer buffer;
+  EXPECT_EQ(100, stream.Read(100, &buffer));
+  EXPECT_TRUE(contents == buffer);
+  EXPECT_EQ(std::string(100, 'a'), GetContents(&buffer));
+  EXPECT_EQ(2u, requestor.read_requests().size());
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, WriteBehind) {
+  // The chunks are sent without waiting for the previous ones to be written.
+  pp::VarArrayBuffer buffer(100);
+  for (size_t i = 0; i < compressor_stream_constants::kMaximumPendingWrites;
+       ++i) {
+    EXPECT_EQ(100, stream.Write(100, buffer));
+  }
+  EXPECT_EQ(compressor_stream_constants::kMaximumPendingWrites,
+            requestor.write_requests().size());
+
+  // A chunk can be sent once a previous one is written.
+  stream.WriteChunkDone(100);
+  EXPECT_EQ(100, stream.Write(100, buffer));
+
+  for (size_t i = 0; i < compressor_stream_constants::kMaximumPendingWrites;
+       ++i) {
+    stream.WriteChunkDone(100);
+  }
+  EXPECT_TRUE(stream.Flush());
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, ReuseWriteBuffers) {
+  pp::VarArrayBuffer buffer = stream.GetWriteBuffer();
+  EXPECT_EQ(kChunkSize, buffer.ByteLength());
+  EXPECT_EQ(100, stream.Write(100, buffer));
+  EXPECT_FALSE(buffer == stream.GetWriteBuffer());
+
+  // The buffer is reused once JavaScript wrote it.
+  stream.WriteChunkDone(100);
+  EXPECT_TRUE(buffer == stream.GetWriteBuffer());
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, WriteError) {
+  pp::VarArrayBuffer buffer(100);
+  EXPECT_EQ(100, stream.Write(100, buffer));
+  EXPECT_EQ(100, stream.Write(100, buffer));
+
+  // The error is returned by the next calls.
+  stream.WriteChunkDone(-1);
+  EXPECT_EQ(-1, stream.Write(100, buffer));
+  EXPECT_EQ(2u, requestor.write_requests().size());
+  // Flush doesn't wait for the chunks after the error.
+  EXPECT_FALSE(stream.Flush());
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, Abort) {
+  pp::VarArrayBuffer buffer(100);
+  EXPECT_EQ(100, stream.Write(100, buffer));
+  stream.StartEntry(1, kChunkSize * 3);
+  RespondToNextRequest(false);
+
+  // Nothing waits for JavaScript anymore, even for the chunks already read.
+  stream.Abort();
+  EXPECT_EQ(-1, stream.Read(kChunkSize, &buffer));
+  EXPECT_EQ(-1, stream.Write(100, buffer));
+  EXPECT_FALSE(stream.Flush());
+
+  // The next entries are not requested.
+  stream.StartEntry(2, kChunkSize);
+  EXPECT_EQ(-1, stream.Read(kChunkSize, &buffer));
+  EXPECT_EQ(compressor_stream_constants::kMaximumReadAheadChunks,
+            requestor.read_requests().size());
+  EXPECT_EQ(1u, requestor.write_requests().size());
+}
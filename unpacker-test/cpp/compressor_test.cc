@@ -0,0 +1,238 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "compressor.h"
+
+#include <pthread.h>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "ppapi_simple/ps_main.h"
+
+#include "compressibility.h"
+#include "fake_lib_archive.h"
+#include "request.h"
+
+namespace {
+
+// A compressor id used at the creation of Compressor.
+const int kCompressorId = 1;
+
+// A fake implementation of JavaScriptMessageSender that records the messages
+// of the compressor, which are sent from the jobs of the compressor.
+class FakeJavaScriptMessageSender : public JavaScriptMessageSenderInterface {
+ public:
+  FakeJavaScriptMessageSender()
+      : errors_(0), add_to_archive_done_(0), close_archive_done_(false) {
+    pthread_mutex_init(&lock_, NULL);
+    pthread_cond_init(&message_cond_, NULL);
+  }
+
+  virtual ~FakeJavaScriptMessageSender() {
+    pthread_cond_destroy(&message_cond_);
+    pthread_mutex_destroy(&lock_);
+  }
+
+  virtual void SendFileSystemError(const std::string& file_system_id,
+                                   const std::string& request_id,
+                                   const std::string& message) {}
+
+
+  virtual void SendFileChunkRequest(const std::string& file_system_id,
+                                    const std::string& request_id,
+                                    int64_t offset,
+                                    int64_t bytes_to_read) {}
+
+  virtual void SendPassphraseRequest(const std::string& file_system_id,
+                                     const std::string& request_id) {}
+
+  virtual void SendReadMetadataDone(const std::string& file_system_id,
+                                    const std::string& request_id,
+                                    const pp::Var& metadata,
+                                    const pp::Var& metadata_cache) {}
+
+  virtual void SendReadMetadataProgress(const std::string& file_system_id,
+                                        const std::string& request_id,
+                                        const pp::VarArrayBuffer& metadata) {}
+
+  virtual void SendReadDirectoryDone(const std::string& file_system_id,
+                                     const std::string& request_id,
+                                     const pp::VarArray& entries) {}
+
+  virtual void SendGetMetadataDone(const std::string& file_system_id,
+                                   const std::string& request_id,
+                                   const pp::VarDictionary& metadata) {}
+
+  virtual void SendOpenFileDone(const std::string& file_system_id,
+                                const std::string& request_id) {}
+
+  virtual void SendOpenFileByPathDone(const std::string& file_system_id,
+                                      const std::string& request_id,
+                                      int64_t index,
+                                      int64_t size) {}
+
+  virtual void SendCloseFileDone(const std::string& file_system_id,
+                                 const std::string& request_id,
+                                 const std::string& open_request_id) {}
+
+  virtual void SendReadFileDone(const std::string& file_system_id,
+                                const std::string& request_id,
+                                const pp::VarArrayBuffer& array_buffer,
+                                bool has_more_data) {}
+
+  virtual void SendExtractEntry(const std::string& file_system_id,
+                                const std::string& request_id,
+                                int64_t index,
+                                const std::string& path,
+                                int64_t size) {}
+
+  virtual void SendExtractData(const std::string& file_system_id,
+                               const std::string& request_id,
+                               int64_t index,
+                               const pp::VarArrayBuffer& array_buffer,
+                               bool has_more_data) {}
+
+  virtual void SendExtractDone(const std::string& file_system_id,
+                               const std::string& request_id) {}
+
+  virtual void SendConsoleLog(const std::string& file_system_id,
+                              const std::string& request_id,
+                              const std::string& src_file,
+                              int src_line,
+                              const std::string& src_func,
+                              const std::string& message) {}
+
+  virtual void SendCompressorError(int compressor_id,
+                                   const std::string& message) {
+    pthread_mutex_lock(&lock_);
+    ++errors_;
+    pthread_mutex_unlock(&lock_);
+  }
+
+  virtual void SendCreateArchiveDone(int compressor_id) {}
+
+  virtual void SendReadFileChunk(int compressor_id_,
+                                 int entry_id,
+                                 int64_t file_size) {
+    pthread_mutex_lock(&lock_);
+    read_entry_ids_.push_back(entry_id);
+    pthread_cond_broadcast(&message_cond_);
+    pthread_mutex_unlock(&lock_);
+  }
+
+  virtual void SendWriteChunk(int compressor_id,
+                              const pp::VarArrayBuffer& array_buffer,
+                              int64_t length) {}
+
+  virtual void SendAddToArchiveDone(int compressor_id, int entry_id) {
+    pthread_mutex_lock(&lock_);
+    ++add_to_archive_done_;
+    pthread_mutex_unlock(&lock_);
+  }
+
+  virtual void SendCloseArchiveDone(int compressor_id) {
+    pthread_mutex_lock(&lock_);
+    close_archive_done_ = true;
+    pthread_cond_broadcast(&message_cond_);
+    pthread_mutex_unlock(&lock_);
+  }
+
+  // Blocks until a file chunk is requested.
+  void WaitForReadFileChunk() {
+    pthread_mutex_lock(&lock_);
+    while (read_entry_ids_.empty())
+      pthread_cond_wait(&message_cond_, &lock_);
+    pthread_mutex_unlock(&lock_);
+  }
+
+  // Blocks until CLOSE_ARCHIVE_DONE is sent.
+  void WaitForCloseArchiveDone() {
+    pthread_mutex_lock(&lock_);
+    while (!close_archive_done_)
+      pthread_cond_wait(&message_cond_, &lock_);
+    pthread_mutex_unlock(&lock_);
+  }
+
+  // The getters must be called once the compressor is done.
+  const std::vector<int>& read_entry_ids() const { return read_entry_ids_; }
+  int errors() const { return errors_; }
+  int add_to_archive_done() const { return add_to_archive_done_; }
+
+ private:
+  pthread_mutex_t lock_;
+  pthread_cond_t message_cond_;
+  std::vector<int> read_entry_ids_;
+  int errors_;
+  int add_to_archive_done_;
+  bool close_archive_done_;
+};
+
+// Returns the dictionary of an ADD_TO_ARCHIVE request for a file.
+pp::VarDictionary CreateAddToArchiveRequest(int entry_id) {
+  pp::VarDictionary dictionary;
+  dictionary.Set(request::key::kEntryId, entry_id);
+  dictionary.Set(request::key::kPathname, "file");
+  dictionary.Set(request::key::kFileSize, "1000");
+  dictionary.Set(request::key::kIsDirectory, false);
+  dictionary.Set(request::key::kModificationTime, "01/01/2017 00:00:00");
+  return dictionary;
+}
+
+}  // namespace
+
+// Class used by TEST_F macro to initialize the environment for testing
+// Compressor methods.
+class CompressorTest : public testing::Test {
+ protected:
+  CompressorTest() : message_sender(NULL), worker_pool(NULL),
+                     compressor(NULL) {}
+
+  virtual void SetUp() {
+    fake_lib_archive_config::ResetVariables();
+    message_sender = new FakeJavaScriptMessageSender();
+    worker_pool = new WorkerPool(pp::InstanceHandle(PSGetInstanceId()),
+                                 WorkerPool::DefaultMaximumThreads());
+    compressor = new Compressor(worker_pool, kCompressorId, message_sender);
+    ASSERT_TRUE(compressor->Init());
+  }
+
+  virtual void TearDown() {
+    delete compressor;
+    compressor = NULL;
+    delete worker_pool;
+    worker_pool = NULL;
+    delete message_sender;
+    message_sender = NULL;
+  }
+
+  FakeJavaScriptMessageSender* message_sender;
+  WorkerPool* worker_pool;
+  Compressor* compressor;
+};
+
+// JavaScript doesn't respond anymore once it closed the archive with an
+// error, so the entry being added fails and the queued ones are dropped.
+TEST_F(CompressorTest, CloseArchiveWithErrorWhileAdding) {
+  compressor->CreateArchive(
+      request::PACK_FORMAT_TAR, request::PACK_FILTER_NONE,
+      compressor_archive_constants::kDefaultCompressionLevel, "",
+      compressibility_constants::kDefaultStoreRatio);
+  for (int entry_id = 1; entry_id <= 3; ++entry_id)
+    compressor->AddToArchive(CreateAddToArchiveRequest(entry_id));
+  message_sender->WaitForReadFileChunk();
+
+  pp::VarDictionary close_archive;
+  close_archive.Set(request::key::kHasError, true);
+  compressor->CloseArchive(close_archive);
+  message_sender->WaitForCloseArchiveDone();
+
+  // The archive is released once the first entry stopped using it.
+  EXPECT_EQ(1, fake_lib_archive_config::archive_write_header_count);
+  ASSERT_FALSE(message_sender->read_entry_ids().empty());
+  for (size_t i = 0; i < message_sender->read_entry_ids().size(); ++i)
+    EXPECT_EQ(1, message_sender->read_entry_ids()[i]);
+  EXPECT_EQ(0, message_sender->add_to_archive_done());
+  EXPECT_EQ(0, message_sender->errors());
+}
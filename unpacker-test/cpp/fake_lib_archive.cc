@@ -33,6 +33,14 @@ namespace {
 archive test_archive;
 archive_entry test_archive_entry;
 
+// The index in fake_lib_archive_config::archive_entries of the entry returned
+// by the next archive_read_next_header, and of the last one returned.
+size_t next_entry_index = 0;
+size_t current_entry_index = 0;
+
+// True from archive_write_new until archive_write_free.
+bool write_archive_open = false;
+
 }  // namespace
 
 // Initialize the variables from fake_lib_archive_config namespace defined in
@@ -58,7 +66,9 @@ bool fail_archive_set_options = false;
 
 int archive_read_next_header_return_value = ARCHIVE_OK;
 int archive_read_seek_header_return_value = ARCHIVE_OK;
+std::vector<std::string> archive_entries;
 mode_t archive_entry_filetype_return_value = S_IFREG;  // Regular file.
+int archive_write_header_count = 0;
 
 void ResetVariables() {
   archive_data = NULL;
@@ -78,13 +88,18 @@ void ResetVariables() {
   fail_archive_set_options = false;
 
   archive_read_next_header_return_value = ARCHIVE_OK;
+  archive_read_seek_header_return_value = ARCHIVE_OK;
+  archive_entries.clear();
   archive_entry_filetype_return_value = S_IFREG;
+  archive_write_header_count = 0;
 }
 
 }  // namespace fake_lib_archive_config
 
 archive* archive_read_new() {
   test_archive.data_offset = 0;  // Reset data_offset.
+  next_entry_index = 0;
+  current_entry_index = 0;
   return fake_lib_archive_config::fail_archive_read_new ? NULL : &test_archive;
 }
 
@@ -153,14 +168,32 @@ int archive_read_open1(archive* archive_object) {
 
 int archive_read_next_header(archive* archive_object, archive_entry** entry) {
   *entry = &test_archive_entry;
+  if (!fake_lib_archive_config::archive_entries.empty()) {
+    if (next_entry_index >= fake_lib_archive_config::archive_entries.size())
+      return ARCHIVE_EOF;
+    current_entry_index = next_entry_index++;
+  }
   return fake_lib_archive_config::archive_read_next_header_return_value;
 }
 
 int archive_read_seek_header(archive* archive_object, size_t index) {
-  return fake_lib_archive_config::archive_read_seek_header_return_value;
+  if (fake_lib_archive_config::archive_read_seek_header_return_value !=
+      ARCHIVE_OK) {
+    return fake_lib_archive_config::archive_read_seek_header_return_value;
+  }
+  if (!fake_lib_archive_config::archive_entries.empty()) {
+    if (index >= fake_lib_archive_config::archive_entries.size())
+      return ARCHIVE_EOF;
+    next_entry_index = index;
+  }
+  return ARCHIVE_OK;
 }
 
 const char* archive_entry_pathname(archive_entry* entry) {
+  const std::vector<std::string>& entries =
+      fake_lib_archive_config::archive_entries;
+  if (!entries.empty())
+    return entries[current_entry_index].c_str();
   return fake_lib_archive_config::kPathName;
 }
 
@@ -213,3 +246,111 @@ ssize_t archive_read_data(archive* archive_object,
   archive_object->data_offset += read_bytes;
   return read_bytes;
 }
+
+archive* archive_write_new() {
+  write_archive_open = true;
+  return &test_archive;
+}
+
+int archive_write_set_format_zip(archive* archive_object) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_set_format_pax_restricted(archive* archive_object) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_set_format_option(archive* archive_object,
+                                    const char* module,
+                                    const char* option,
+                                    const char* value) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_add_filter_none(archive* archive_object) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_add_filter_gzip(archive* archive_object) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_add_filter_zstd(archive* archive_object) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_add_filter_xz(archive* archive_object) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_add_filter_lz4(archive* archive_object) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_set_filter_option(archive* archive_object,
+                                    const char* module,
+                                    const char* option,
+                                    const char* value) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_set_options(archive* archive_object, const char* options) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_set_bytes_per_block(archive* archive_object,
+                                      int bytes_per_block) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_open(archive* archive_object,
+                       void* client_data,
+                       archive_open_callback* open_callback,
+                       archive_write_callback* write_callback,
+                       archive_close_callback* close_callback) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_header(archive* archive_object, archive_entry* entry) {
+  EXPECT_TRUE(archive_object == &test_archive && write_archive_open);
+  ++fake_lib_archive_config::archive_write_header_count;
+  return ARCHIVE_OK;
+}
+
+ssize_t archive_write_data(archive* archive_object,
+                           const void* buffer,
+                           size_t length) {
+  EXPECT_TRUE(archive_object == &test_archive && write_archive_open);
+  return length;
+}
+
+int archive_write_fail(archive* archive_object) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_free(archive* archive_object) {
+  write_archive_open = false;
+  return ARCHIVE_OK;
+}
+
+int archive_errno(archive* archive_object) {
+  return 0;
+}
+
+archive_entry* archive_entry_new() {
+  return &test_archive_entry;
+}
+
+void archive_entry_free(archive_entry* entry) {}
+
+void archive_entry_set_pathname(archive_entry* entry, const char* pathname) {}
+
+void archive_entry_set_size(archive_entry* entry, int64_t size) {}
+
+void archive_entry_set_mtime(archive_entry* entry,
+                             time_t modification_time,
+                             long nanoseconds) {}
+
+void archive_entry_set_filetype(archive_entry* entry, unsigned int type) {}
+
+void archive_entry_set_perm(archive_entry* entry, mode_t permissions) {}
@@ -9,6 +9,8 @@
 #define FAKE_LIB_ARCHIVE_H_
 
 #include <limits>
+#include <string>
+#include <vector>
 
 #include "archive.h"
 
@@ -62,10 +64,23 @@ extern int archive_read_next_header_return_value;
 // By default it should be set to ARCHIVE_OK.
 extern int archive_read_seek_header_return_value;
 
+// The path names of the entries of the archive, in order. If not empty,
+// archive_read_next_header returns them one by one, archive_read_seek_header
+// moves to the given one and archive_entry_pathname returns the path name of
+// the last one returned, instead of kPathName.
+// By default it is empty.
+extern std::vector<std::string> archive_entries;
+
 // Return value for archive_entry_filetype.
 // By default it should be set to regular file.
 extern mode_t archive_entry_filetype_return_value;
 
+// The number of entries written by archive_write_header. archive_write_header
+// and archive_write_data fail the test if the archive returned by
+// archive_write_new was freed.
+// By default it is set to 0.
+extern int archive_write_header_count;
+
 // Resets all variables to default values.
 void ResetVariables();
 
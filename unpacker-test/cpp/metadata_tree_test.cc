@@ -0,0 +1,517 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "metadata_tree.h"
+
+#include <sys/time.h>
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "ppapi/cpp/var_array.h"
+
+namespace {
+
+// An entry added to the trees in tests.
+struct TestEntry {
+  const char* path;
+  int64_t size;
+  bool is_directory;
+  time_t modification_time;
+};
+
+// Entries in the order an archive may list them, including directories listed
+// after their files, paths that need normalization and a directory listed
+// with a trailing delimiter.
+const TestEntry kEntries[] = {
+    {"dir/file1", 10, false, 100},
+    {"dir/subdir/file2", 20, false, 200},
+    {"dir", 0, true, 300},
+    {"./file3", 30, false, 400},
+    {"/dir//subdir/./file4", 40, false, 500},
+    {"other/", 0, true, 600},
+    {"other/file5", 50, false, 700},
+    {"", 0, false, 800},
+};
+
+const int kEntriesCount = sizeof(kEntries) / sizeof(kEntries[0]);
+
+// The number of entries in the benchmark archive and how many entries share
+// a directory.
+const int kBenchmarkEntries = 200000;
+const int kBenchmarkEntriesPerDirectory = 50;
+
+// A copy of the recursive pp::VarDictionary based builder that MetadataTree
+// replaced. Used as a reference for the output format and for benchmarking.
+std::string ReferenceNormpath(const std::string& path) {
+  std::string ret = path;
+  size_t i;
+  do {
+    i = ret.length();
+    if (ret[0] == '/')
+      ret.erase(0, 1);
+    if (ret.compare(0, 2, "./") == 0)
+      ret.erase(0, 2);
+    if (ret.compare(0, 3, "../") == 0)
+      ret.erase(0, 3);
+  } while (i != ret.length());
+
+  i = 0;
+  while (i < ret.length()) {
+    if (ret.compare(i, 2, "//") == 0) {
+      ret.erase(i, 1);
+      continue;
+    }
+    if (ret.compare(i, 3, "/./") == 0) {
+      ret.erase(i, 2);
+      continue;
+    }
+    ++i;
+  }
+  return ret;
+}
+
+pp::VarDictionary ReferenceCreateEntry(int64_t index,
+                                       const std::string& name,
+                                       bool is_directory,
+                                       int64_t size,
+                                       time_t modification_time) {
+  pp::VarDictionary entry_metadata;
+  std::stringstream ss_index;
+  ss_index << index;
+  entry_metadata.Set("index", ss_index.str());
+  entry_metadata.Set("isDirectory", is_directory);
+  entry_metadata.Set("name", name);
+  std::stringstream ss_size;
+  ss_size << size;
+  entry_metadata.Set("size", ss_size.str());
+  std::stringstream ss_modification_time;
+  ss_modification_time << modification_time;
+  entry_metadata.Set("modificationTime", ss_modification_time.str());
+  if (is_directory)
+    entry_metadata.Set("entries", pp::VarDictionary());
+  return entry_metadata;
+}
+
+void ReferenceConstructMetadata(int64_t index,
+                                const std::string& entry_complete_path,
+                                int64_t size,
+                                bool is_directory,
+                                time_t modification_time,
+                                pp::VarDictionary* parent_metadata) {
+  std::string entry_path = ReferenceNormpath(entry_complete_path);
+  if (entry_path.empty())
+    return;
+
+  pp::VarDictionary parent_entries =
+      pp::VarDictionary(parent_metadata->Get("entries"));
+
+  size_t position = entry_path.find("/");
+  pp::VarDictionary entry_metadata;
+  std::string entry_name;
+
+  if (position == std::string::npos) {
+    entry_name = entry_path;
+    entry_metadata = ReferenceCreateEntry(
+        index, entry_name, is_directory, size, modification_time);
+    pp::Var old_entry_metadata_var = parent_entries.Get(entry_name);
+    if (!old_entry_metadata_var.is_undefined()) {
+      pp::VarDictionary old_entry_metadata =
+          pp::VarDictionary(old_entry_metadata_var);
+      entry_metadata.Set("entries", old_entry_metadata.Get("entries"));
+    }
+  } else {
+    entry_name = entry_path.substr(0, position);
+    pp::Var entry_metadata_var = parent_entries.Get(entry_name);
+    if (entry_metadata_var.is_undefined()) {
+      entry_metadata =
+          ReferenceCreateEntry(-1, entry_name, true, 0, modification_time);
+    } else {
+      entry_metadata = pp::VarDictionary(entry_metadata_var);
+    }
+    ReferenceConstructMetadata(index, entry_path.substr(position + 1), size,
+                               is_directory, modification_time,
+                               &entry_metadata);
+  }
+
+  parent_entries.Set(entry_name, entry_metadata);
+  parent_metadata->Set("entries", parent_entries);
+}
+
+// Compares two metadata dictionaries by value.
+void ExpectEqualMetadata(const pp::VarDictionary& expected,
+                         const pp::VarDictionary& actual) {
+  pp::VarArray expected_keys = expected.GetKeys();
+  ASSERT_EQ(expected_keys.GetLength(), actual.GetKeys().GetLength());
+
+  for (uint32_t i = 0; i < expected_keys.GetLength(); ++i) {
+    pp::Var key = expected_keys.Get(i);
+    pp::Var expected_value = expected.Get(key);
+    pp::Var actual_value = actual.Get(key);
+    ASSERT_FALSE(actual_value.is_undefined()) << key.AsString();
+    if (expected_value.is_dictionary()) {
+      ASSERT_TRUE(actual_value.is_dictionary()) << key.AsString();
+      ExpectEqualMetadata(pp::VarDictionary(expected_value),
+                          pp::VarDictionary(actual_value));
+    } else {
+      EXPECT_EQ(expected_value, actual_value) << key.AsString();
+    }
+  }
+}
+
+// Returns the path of the index-th entry of the benchmark archive.
+std::string BenchmarkPath(int index) {
+  std::stringstream path;
+  int directory = index / kBenchmarkEntriesPerDirectory;
+  path << "root/level" << directory % 10 << "/dir" << directory << "/file"
+       << index;
+  return path.str();
+}
+
+uint32_t ReadUint32(const uint8_t* source) {
+  uint32_t value = 0;
+  for (int i = 3; i >= 0; --i)
+    value = value << 8 | source[i];
+  return value;
+}
+
+double ReadFloat64(const uint8_t* source) {
+  uint64_t bits = 0;
+  for (int i = 7; i >= 0; --i)
+    bits = bits << 8 | source[i];
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+double NowInMilliseconds() {
+  timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec * 1000.0 + now.tv_usec / 1000.0;
+}
+
+}  // namespace
+
+TEST(MetadataTreeTest, EmptyTree) {
+  MetadataTree metadata_tree;
+  EXPECT_EQ(1, metadata_tree.node_count());
+
+  pp::VarDictionary root = metadata_tree.ToVarDictionary();
+  EXPECT_EQ("-1", root.Get("index").AsString());
+  EXPECT_EQ("", root.Get("name").AsString());
+  EXPECT_TRUE(root.Get("isDirectory").AsBool());
+  ASSERT_TRUE(root.Get("entries").is_dictionary());
+  EXPECT_EQ(0, pp::VarDictionary(root.Get("entries")).GetKeys().GetLength());
+}
+
+TEST(MetadataTreeTest, SameOutputAsRecursiveBuilder) {
+  MetadataTree metadata_tree;
+  pp::VarDictionary expected =
+      ReferenceCreateEntry(-1, "" /* name */, true, 0, 0);
+
+  for (int i = 0; i < kEntriesCount; ++i) {
+    metadata_tree.AddEntry(i, kEntries[i].path, kEntries[i].size,
+                           kEntries[i].is_directory,
+                           kEntries[i].modification_time);
+    ReferenceConstructMetadata(i, kEntries[i].path, kEntries[i].size,
+                               kEntries[i].is_directory,
+                               kEntries[i].modification_time, &expected);
+  }
+
+  ExpectEqualMetadata(expected, metadata_tree.ToVarDictionary());
+}
+
+TEST(MetadataTreeTest, DirectoryListedAfterItsFiles) {
+  MetadataTree metadata_tree;
+  metadata_tree.AddEntry(0, "dir/file", 10, false, 100);
+  metadata_tree.AddEntry(1, "dir", 0, true, 200);
+  // Root, "dir" and "dir/file".
+  EXPECT_EQ(3, metadata_tree.node_count());
+
+  pp::VarDictionary root_entries(
+      metadata_tree.ToVarDictionary().Get("entries"));
+  pp::VarDictionary dir(root_entries.Get("dir"));
+  EXPECT_EQ("1", dir.Get("index").AsString());
+  EXPECT_EQ("200", dir.Get("modificationTime").AsString());
+
+  pp::VarDictionary file(pp::VarDictionary(dir.Get("entries")).Get("file"));
+  EXPECT_EQ("0", file.Get("index").AsString());
+  EXPECT_EQ("10", file.Get("size").AsString());
+  EXPECT_FALSE(file.Get("isDirectory").AsBool());
+  EXPECT_TRUE(file.Get("entries").is_undefined());
+}
+
+TEST(MetadataTreeTest, ImplicitDirectories) {
+  MetadataTree metadata_tree;
+  metadata_tree.AddEntry(0, "a/b/c", 10, false, 100);
+
+  pp::VarDictionary a(
+      pp::VarDictionary(metadata_tree.ToVarDictionary().Get("entries"))
+          .Get("a"));
+  EXPECT_EQ("-1", a.Get("index").AsString());
+  EXPECT_TRUE(a.Get("isDirectory").AsBool());
+  EXPECT_EQ("0", a.Get("size").AsString());
+  EXPECT_EQ("100", a.Get("modificationTime").AsString());
+}
+
+TEST(MetadataTreeTest, BinaryFormat) {
+  using namespace metadata_tree_constants;
+
+  MetadataTree metadata_tree;
+  metadata_tree.AddEntry(0, "dir/file", 10, false, 100);
+  metadata_tree.AddEntry(1, "dir", 0, true, 200);
+  metadata_tree.AddEntry(2, "file", 30, false, 300);
+
+  pp::VarArrayBuffer array_buffer = metadata_tree.ToVarArrayBuffer();
+  const uint8_t* data = static_cast<const uint8_t*>(array_buffer.Map());
+
+  // Root, "dir", "dir/file" and "file".
+  const uint32_t kRecords = 4;
+  EXPECT_EQ(kBinaryFormatVersion, ReadUint32(data));
+  EXPECT_EQ(kRecords, ReadUint32(data + 4));
+  uint32_t string_table_offset = ReadUint32(data + 8);
+  uint32_t string_table_size = ReadUint32(data + 12);
+  EXPECT_EQ(kBinaryHeaderSize + kRecords * kBinaryRecordSize,
+            string_table_offset);
+  EXPECT_EQ(0, ReadUint32(data + 16));  // The first record.
+  // "", "dir" and "file", as names are stored only once.
+  EXPECT_EQ(7, string_table_size);
+  ASSERT_EQ(string_table_offset + string_table_size,
+            array_buffer.ByteLength());
+
+  const struct {
+    uint32_t parent;
+    const char* name;
+    bool is_directory;
+    double index;
+    double size;
+    double modification_time;
+  } kExpected[] = {
+      {kBinaryNoParent, "", true, -1, 0, 0},
+      {0, "dir", true, 1, 0, 200},
+      {1, "file", false, 0, 10, 100},
+      {0, "file", false, 2, 30, 300},
+  };
+
+  for (uint32_t i = 0; i < kRecords; ++i) {
+    const uint8_t* record = data + kBinaryHeaderSize + i * kBinaryRecordSize;
+    EXPECT_EQ(kExpected[i].parent, ReadUint32(record));
+    uint32_t name_offset = ReadUint32(record + 4);
+    uint32_t name_length = ReadUint32(record + 8);
+    ASSERT_LE(name_offset + name_length, string_table_size);
+    EXPECT_EQ(kExpected[i].name,
+              std::string(reinterpret_cast<const char*>(
+                              data + string_table_offset + name_offset),
+                          name_length));
+    EXPECT_EQ(kExpected[i].is_directory ? kBinaryDirectoryFlag : 0,
+              ReadUint32(record + 12));
+    EXPECT_EQ(kExpected[i].index, ReadFloat64(record + 16));
+    EXPECT_EQ(kExpected[i].size, ReadFloat64(record + 24));
+    EXPECT_EQ(kExpected[i].modification_time, ReadFloat64(record + 32));
+  }
+
+  array_buffer.Unmap();
+}
+
+TEST(MetadataTreeTest, BinaryFormatFromNode) {
+  using namespace metadata_tree_constants;
+
+  MetadataTree metadata_tree;
+  metadata_tree.AddEntry(0, "dir/file", 10, false, 100);
+  size_t first_node = metadata_tree.node_count();
+  metadata_tree.AddEntry(1, "dir/other", 20, false, 200);
+
+  pp::VarArrayBuffer array_buffer = metadata_tree.ToVarArrayBuffer(first_node);
+  const uint8_t* data = static_cast<const uint8_t*>(array_buffer.Map());
+
+  EXPECT_EQ(1, ReadUint32(data + 4));  // Only "dir/other".
+  uint32_t string_table_offset = ReadUint32(data + 8);
+  EXPECT_EQ(5, ReadUint32(data + 12));  // Only "other".
+  EXPECT_EQ(first_node, ReadUint32(data + 16));
+
+  // The parent is "dir", sent before.
+  const uint8_t* record = data + kBinaryHeaderSize;
+  EXPECT_EQ(1, ReadUint32(record));
+  EXPECT_EQ("other", std::string(reinterpret_cast<const char*>(
+                                     data + string_table_offset +
+                                     ReadUint32(record + 4)),
+                                 ReadUint32(record + 8)));
+  EXPECT_EQ(1, ReadFloat64(record + 16));
+
+  array_buffer.Unmap();
+
+  // Nothing was added since.
+  pp::VarArrayBuffer empty =
+      metadata_tree.ToVarArrayBuffer(metadata_tree.node_count());
+  EXPECT_EQ(kBinaryHeaderSize, empty.ByteLength());
+}
+
+TEST(MetadataTreeTest, GetEntryMetadata) {
+  MetadataTree metadata_tree;
+  metadata_tree.AddEntry(0, "dir/file", 10, false, 100);
+
+  pp::VarDictionary entry_metadata;
+  EXPECT_EQ(MetadataTree::RESULT_SUCCESS,
+            metadata_tree.GetEntryMetadata("/dir/file", &entry_metadata));
+  EXPECT_EQ("file", entry_metadata.Get("name").AsString());
+  EXPECT_EQ("0", entry_metadata.Get("index").AsString());
+  EXPECT_EQ("10", entry_metadata.Get("size").AsString());
+  EXPECT_FALSE(entry_metadata.Get("isDirectory").AsBool());
+
+  // Directories are returned without their children.
+  EXPECT_EQ(MetadataTree::RESULT_SUCCESS,
+            metadata_tree.GetEntryMetadata("/dir/", &entry_metadata));
+  EXPECT_EQ("dir", entry_metadata.Get("name").AsString());
+  EXPECT_TRUE(entry_metadata.Get("isDirectory").AsBool());
+  EXPECT_TRUE(entry_metadata.Get("entries").is_undefined());
+
+  EXPECT_EQ(MetadataTree::RESULT_SUCCESS,
+            metadata_tree.GetEntryMetadata("/", &entry_metadata));
+  EXPECT_EQ("-1", entry_metadata.Get("index").AsString());
+
+  EXPECT_EQ(MetadataTree::RESULT_NOT_FOUND,
+            metadata_tree.GetEntryMetadata("/dir/other", &entry_metadata));
+  EXPECT_EQ(MetadataTree::RESULT_NOT_FOUND,
+            metadata_tree.GetEntryMetadata("/file", &entry_metadata));
+}
+
+TEST(MetadataTreeTest, ReadDirectory) {
+  MetadataTree metadata_tree;
+  for (int i = 0; i < kEntriesCount; ++i) {
+    metadata_tree.AddEntry(i, kEntries[i].path, kEntries[i].size,
+                           kEntries[i].is_directory,
+                           kEntries[i].modification_time);
+  }
+
+  pp::VarArray entries;
+  EXPECT_EQ(MetadataTree::RESULT_SUCCESS,
+            metadata_tree.ReadDirectory("/", &entries));
+  // "dir", "file3" and "other".
+  ASSERT_EQ(3, entries.GetLength());
+  EXPECT_EQ("dir", pp::VarDictionary(entries.Get(0)).Get("name").AsString());
+  EXPECT_EQ("file3", pp::VarDictionary(entries.Get(1)).Get("name").AsString());
+  EXPECT_EQ("other", pp::VarDictionary(entries.Get(2)).Get("name").AsString());
+
+  // Has "file1", "subdir" and "file4" in it.
+  pp::VarArray dir_entries;
+  EXPECT_EQ(MetadataTree::RESULT_SUCCESS,
+            metadata_tree.ReadDirectory("/dir", &dir_entries));
+  EXPECT_EQ(2, dir_entries.GetLength());
+
+  pp::VarArray subdir_entries;
+  EXPECT_EQ(MetadataTree::RESULT_SUCCESS,
+            metadata_tree.ReadDirectory("/dir/subdir/", &subdir_entries));
+  EXPECT_EQ(2, subdir_entries.GetLength());
+
+  pp::VarArray no_entries;
+  EXPECT_EQ(MetadataTree::RESULT_NOT_A_DIRECTORY,
+            metadata_tree.ReadDirectory("/file3", &no_entries));
+  EXPECT_EQ(MetadataTree::RESULT_NOT_FOUND,
+            metadata_tree.ReadDirectory("/missing", &no_entries));
+}
+
+TEST(MetadataTreeTest, FindEntry) {
+  MetadataTree metadata_tree;
+  metadata_tree.AddEntry(3, "dir/file", 10, false, 100);
+
+  int64_t index = 0;
+  int64_t size = 0;
+  bool is_directory = true;
+  EXPECT_EQ(MetadataTree::RESULT_SUCCESS,
+            metadata_tree.FindEntry("/dir/file", &index, &size,
+                                    &is_directory));
+  EXPECT_EQ(3, index);
+  EXPECT_EQ(10, size);
+  EXPECT_FALSE(is_directory);
+
+  EXPECT_EQ(MetadataTree::RESULT_SUCCESS,
+            metadata_tree.FindEntry("/dir", &index, &size, &is_directory));
+  EXPECT_EQ(-1, index);
+  EXPECT_TRUE(is_directory);
+
+  EXPECT_EQ(MetadataTree::RESULT_NOT_FOUND,
+            metadata_tree.FindEntry("/file", &index, &size, &is_directory));
+}
+
+TEST(MetadataTreeTest, NormalizePath) {
+  EXPECT_EQ("dir/file", MetadataTree::NormalizePath("/dir/file"));
+  EXPECT_EQ("dir/file", MetadataTree::NormalizePath("./dir//file"));
+  EXPECT_EQ("dir", MetadataTree::NormalizePath("../dir/"));
+  EXPECT_EQ("", MetadataTree::NormalizePath("/"));
+}
+
+TEST(MetadataTreeTest, FromBinary) {
+  MetadataTree metadata_tree;
+  for (int i = 0; i < kEntriesCount; ++i) {
+    metadata_tree.AddEntry(i, kEntries[i].path, kEntries[i].size,
+                           kEntries[i].is_directory,
+                           kEntries[i].modification_time);
+  }
+
+  pp::VarArrayBuffer array_buffer = metadata_tree.ToVarArrayBuffer();
+  const uint8_t* data = static_cast<const uint8_t*>(array_buffer.Map());
+  MetadataTree* restored_tree =
+      MetadataTree::FromBinary(data, array_buffer.ByteLength());
+  ASSERT_TRUE(restored_tree != NULL);
+  EXPECT_EQ(metadata_tree.node_count(), restored_tree->node_count());
+  ExpectEqualMetadata(metadata_tree.ToVarDictionary(),
+                      restored_tree->ToVarDictionary());
+
+  // Entries can be looked up by path in the restored tree.
+  pp::VarDictionary entry_metadata;
+  EXPECT_EQ(MetadataTree::RESULT_SUCCESS,
+            restored_tree->GetEntryMetadata("/dir/subdir/file4",
+                                            &entry_metadata));
+  EXPECT_EQ("40", entry_metadata.Get("size").AsString());
+  delete restored_tree;
+
+  // Truncated data.
+  EXPECT_TRUE(MetadataTree::FromBinary(data, array_buffer.ByteLength() - 1) ==
+              NULL);
+
+  // Only a part of a tree.
+  metadata_tree.AddEntry(kEntriesCount, "new", 1, false, 1);
+  pp::VarArrayBuffer part =
+      metadata_tree.ToVarArrayBuffer(metadata_tree.node_count() - 1);
+  EXPECT_TRUE(MetadataTree::FromBinary(
+                  static_cast<const uint8_t*>(part.Map()),
+                  part.ByteLength()) == NULL);
+
+  part.Unmap();
+  array_buffer.Unmap();
+}
+
+// Compares MetadataTree with the recursive builder on a big archive. Run with
+// --gtest_also_run_disabled_tests.
+TEST(MetadataTreeTest, DISABLED_BenchmarkAgainstRecursiveBuilder) {
+  std::vector<std::string> paths;
+  for (int i = 0; i < kBenchmarkEntries; ++i)
+    paths.push_back(BenchmarkPath(i));
+
+  double start = NowInMilliseconds();
+  pp::VarDictionary expected =
+      ReferenceCreateEntry(-1, "" /* name */, true, 0, 0);
+  for (int i = 0; i < kBenchmarkEntries; ++i)
+    ReferenceConstructMetadata(i, paths[i], i, false, i, &expected);
+  double recursive_time = NowInMilliseconds() - start;
+
+  start = NowInMilliseconds();
+  MetadataTree metadata_tree;
+  for (int i = 0; i < kBenchmarkEntries; ++i)
+    metadata_tree.AddEntry(i, paths[i], i, false, i);
+  double build_time = NowInMilliseconds() - start;
+  pp::VarDictionary actual = metadata_tree.ToVarDictionary();
+  double tree_time = NowInMilliseconds() - start;
+
+  printf("%d entries: recursive builder %.1f ms, MetadataTree %.1f ms "
+         "(%.1f ms building, %.1f ms converting to pp::Var)\n",
+         kBenchmarkEntries, recursive_time, tree_time, build_time,
+         tree_time - build_time);
+
+  ExpectEqualMetadata(expected, actual);
+}
@@ -41,6 +41,84 @@ TEST(request, CreateReadMetadataDoneResponse) {
             pp::VarDictionary(metadata_done.Get(request::key::kMetadata)));
 }
 
+TEST(request, CreateReadMetadataDoneResponseWithCache) {
+  pp::VarArrayBuffer metadata(10);
+  pp::VarArrayBuffer metadata_cache(20);
+
+  pp::VarDictionary metadata_done = request::CreateReadMetadataDoneResponse(
+      kFileSystemId, kRequestId, metadata, metadata_cache);
+  EXPECT_EQ(request::READ_METADATA_DONE,
+            metadata_done.Get(request::key::kOperation).AsInt());
+  EXPECT_EQ(metadata, metadata_done.Get(request::key::kMetadata));
+  EXPECT_EQ(metadata_cache, metadata_done.Get(request::key::kMetadataCache));
+
+  // No cache record.
+  metadata_done = request::CreateReadMetadataDoneResponse(
+      kFileSystemId, kRequestId, metadata, pp::Var());
+  EXPECT_TRUE(metadata_done.Get(request::key::kMetadataCache).is_undefined());
+}
+
+TEST(request, CreateReadMetadataProgressResponse) {
+  pp::VarArrayBuffer metadata(10);
+
+  pp::VarDictionary metadata_progress =
+      request::CreateReadMetadataProgressResponse(kFileSystemId, kRequestId,
+                                                  metadata);
+
+  EXPECT_TRUE(metadata_progress.Get(request::key::kOperation).is_int());
+  EXPECT_EQ(request::READ_METADATA_PROGRESS,
+            metadata_progress.Get(request::key::kOperation).AsInt());
+
+  EXPECT_TRUE(metadata_progress.Get(request::key::kFileSystemId).is_string());
+  EXPECT_EQ(kFileSystemId,
+            metadata_progress.Get(request::key::kFileSystemId).AsString());
+
+  EXPECT_TRUE(metadata_progress.Get(request::key::kRequestId).is_string());
+  EXPECT_EQ(kRequestId,
+            metadata_progress.Get(request::key::kRequestId).AsString());
+
+  EXPECT_TRUE(metadata_progress.Get(request::key::kMetadata).is_array_buffer());
+  EXPECT_EQ(metadata, metadata_progress.Get(request::key::kMetadata));
+
+  EXPECT_FALSE(request::IsPackRequest(request::READ_METADATA_PROGRESS));
+}
+
+TEST(request, CreateReadDirectoryDoneResponse) {
+  pp::VarArray entries;
+  entries.Set(0, pp::VarDictionary());
+
+  pp::VarDictionary read_directory_done =
+      request::CreateReadDirectoryDoneResponse(kFileSystemId, kRequestId,
+                                               entries);
+
+  EXPECT_EQ(request::READ_DIRECTORY_DONE,
+            read_directory_done.Get(request::key::kOperation).AsInt());
+  EXPECT_EQ(kFileSystemId,
+            read_directory_done.Get(request::key::kFileSystemId).AsString());
+  EXPECT_EQ(kRequestId,
+            read_directory_done.Get(request::key::kRequestId).AsString());
+  EXPECT_TRUE(read_directory_done.Get(request::key::kEntries).is_array());
+  EXPECT_EQ(entries, read_directory_done.Get(request::key::kEntries));
+}
+
+TEST(request, CreateGetMetadataDoneResponse) {
+  pp::VarDictionary metadata;
+  metadata.Set("name", "file");
+
+  pp::VarDictionary get_metadata_done =
+      request::CreateGetMetadataDoneResponse(kFileSystemId, kRequestId,
+                                             metadata);
+
+  EXPECT_EQ(request::GET_METADATA_DONE,
+            get_metadata_done.Get(request::key::kOperation).AsInt());
+  EXPECT_EQ(kFileSystemId,
+            get_metadata_done.Get(request::key::kFileSystemId).AsString());
+  EXPECT_EQ(kRequestId,
+            get_metadata_done.Get(request::key::kRequestId).AsString());
+  EXPECT_TRUE(get_metadata_done.Get(request::key::kMetadata).is_dictionary());
+  EXPECT_EQ(metadata, get_metadata_done.Get(request::key::kMetadata));
+}
+
 TEST(request, CreateReadChunkRequest) {
   int64_t expected_offset = std::numeric_limits<int64_t>::max();
   pp::VarDictionary read_chunk = request::CreateReadChunkRequest(
@@ -87,6 +165,66 @@ TEST(request, CreateOpenFileDoneResponse) {
             open_file_done.Get(request::key::kRequestId).AsString());
 }
 
+TEST(request, CreateOpenFileByPathDoneResponse) {
+  int64_t expected_size = std::numeric_limits<int64_t>::max();
+  pp::VarDictionary open_file_by_path_done =
+      request::CreateOpenFileByPathDoneResponse(
+          kFileSystemId, kRequestId, 5, expected_size);
+
+  EXPECT_TRUE(open_file_by_path_done.Get(request::key::kOperation).is_int());
+  EXPECT_EQ(request::OPEN_FILE_BY_PATH_DONE,
+            open_file_by_path_done.Get(request::key::kOperation).AsInt());
+
+  EXPECT_TRUE(
+      open_file_by_path_done.Get(request::key::kFileSystemId).is_string());
+  EXPECT_EQ(kFileSystemId,
+            open_file_by_path_done.Get(request::key::kFileSystemId).AsString());
+
+  EXPECT_TRUE(open_file_by_path_done.Get(request::key::kRequestId).is_string());
+  EXPECT_EQ(kRequestId,
+            open_file_by_path_done.Get(request::key::kRequestId).AsString());
+
+  EXPECT_TRUE(open_file_by_path_done.Get(request::key::kIndex).is_string());
+  EXPECT_EQ("5", open_file_by_path_done.Get(request::key::kIndex).AsString());
+
+  EXPECT_TRUE(open_file_by_path_done.Get(request::key::kSize).is_string());
+  std::stringstream ss_size(
+      open_file_by_path_done.Get(request::key::kSize).AsString());
+  int64_t size;
+  ss_size >> size;
+  EXPECT_EQ(expected_size, size);
+}
+
+TEST(request, CreateExtractResponses) {
+  pp::VarDictionary extract_entry = request::CreateExtractEntryResponse(
+      kFileSystemId, kRequestId, 5, "dir/file", 100);
+  EXPECT_EQ(request::EXTRACT_ENTRY,
+            extract_entry.Get(request::key::kOperation).AsInt());
+  EXPECT_EQ(kRequestId, extract_entry.Get(request::key::kRequestId).AsString());
+  EXPECT_EQ("5", extract_entry.Get(request::key::kIndex).AsString());
+  EXPECT_EQ("dir/file", extract_entry.Get(request::key::kPath).AsString());
+  EXPECT_EQ("100", extract_entry.Get(request::key::kSize).AsString());
+
+  pp::VarArrayBuffer array_buffer(10);
+  pp::VarDictionary extract_data = request::CreateExtractDataResponse(
+      kFileSystemId, kRequestId, 5, array_buffer, false);
+  EXPECT_EQ(request::EXTRACT_DATA,
+            extract_data.Get(request::key::kOperation).AsInt());
+  EXPECT_EQ("5", extract_data.Get(request::key::kIndex).AsString());
+  EXPECT_TRUE(extract_data.Get(request::key::kReadFileData).is_array_buffer());
+  EXPECT_EQ(10, pp::VarArrayBuffer(
+                    extract_data.Get(request::key::kReadFileData))
+                    .ByteLength());
+  EXPECT_FALSE(extract_data.Get(request::key::kHasMoreData).AsBool());
+
+  pp::VarDictionary extract_done =
+      request::CreateExtractDoneResponse(kFileSystemId, kRequestId);
+  EXPECT_EQ(request::EXTRACT_DONE,
+            extract_done.Get(request::key::kOperation).AsInt());
+  EXPECT_EQ(kFileSystemId,
+            extract_done.Get(request::key::kFileSystemId).AsString());
+}
+
 TEST(request, CreateCloseFileDoneResponse) {
   std::string open_request_id = "1";
   pp::VarDictionary close_file_done = request::CreateCloseFileDoneResponse(
@@ -156,3 +294,27 @@ TEST(request, CreateFileSystemError) {
   EXPECT_TRUE(error.Get(request::key::kError).is_string());
   EXPECT_EQ(kError, error.Get(request::key::kError).AsString());
 }
+
+TEST(request, CreatePackRequestsWithEntryId) {
+  const int kCompressorId = 3;
+  const int kEntryId = 5;
+
+  pp::VarDictionary read_file_chunk =
+      request::CreateReadFileChunkRequest(kCompressorId, kEntryId, 100);
+  EXPECT_EQ(request::READ_FILE_CHUNK,
+            read_file_chunk.Get(request::key::kOperation).AsInt());
+  EXPECT_EQ(kCompressorId,
+            read_file_chunk.Get(request::key::kCompressorId).AsInt());
+  EXPECT_TRUE(read_file_chunk.Get(request::key::kEntryId).is_int());
+  EXPECT_EQ(kEntryId, read_file_chunk.Get(request::key::kEntryId).AsInt());
+  EXPECT_EQ("100", read_file_chunk.Get(request::key::kLength).AsString());
+
+  pp::VarDictionary add_to_archive_done =
+      request::CreateAddToArchiveDoneResponse(kCompressorId, kEntryId);
+  EXPECT_EQ(request::ADD_TO_ARCHIVE_DONE,
+            add_to_archive_done.Get(request::key::kOperation).AsInt());
+  EXPECT_EQ(kCompressorId,
+            add_to_archive_done.Get(request::key::kCompressorId).AsInt());
+  EXPECT_TRUE(add_to_archive_done.Get(request::key::kEntryId).is_int());
+  EXPECT_EQ(kEntryId, add_to_archive_done.Get(request::key::kEntryId).AsInt());
+}
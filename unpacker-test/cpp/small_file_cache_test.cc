@@ -0,0 +1,94 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "small_file_cache.h"
+
+#include <cstring>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// The maximum size of a cached file in tests.
+const int64_t kMaximumFileSize = 10;
+
+// The capacity of the caches in tests.
+const int64_t kCapacity = 25;
+
+// Fake contents of the cached files.
+const char kContents[] = "0123456789abcdef";
+
+// Returns the contents of the file at index in cache as a string, or an empty
+// string if it is not cached.
+std::string GetContents(SmallFileCache* cache, int64_t index) {
+  pp::VarArrayBuffer contents;
+  if (!cache->Get(index, &contents))
+    return std::string();
+  std::string result(static_cast<const char*>(contents.Map()),
+                     contents.ByteLength());
+  contents.Unmap();
+  return result;
+}
+
+}  // namespace
+
+TEST(SmallFileCacheTest, PutAndGet) {
+  SmallFileCache cache(kMaximumFileSize, kCapacity);
+  pp::VarArrayBuffer contents;
+  EXPECT_FALSE(cache.Get(1, &contents));
+  EXPECT_FALSE(cache.Contains(1));
+
+  EXPECT_TRUE(cache.Put(1, kContents, 5));
+  EXPECT_TRUE(cache.Contains(1));
+  EXPECT_EQ(std::string(kContents, 5), GetContents(&cache, 1));
+  EXPECT_EQ(5, cache.size());
+
+  // Empty files are cached too.
+  EXPECT_TRUE(cache.Put(2, kContents, 0));
+  ASSERT_TRUE(cache.Get(2, &contents));
+  EXPECT_EQ(0u, contents.ByteLength());
+}
+
+TEST(SmallFileCacheTest, PutTooBig) {
+  SmallFileCache cache(kMaximumFileSize, kCapacity);
+  EXPECT_TRUE(cache.CanCache(kMaximumFileSize));
+  EXPECT_FALSE(cache.CanCache(kMaximumFileSize + 1));
+  EXPECT_FALSE(cache.Put(1, kContents, kMaximumFileSize + 1));
+  EXPECT_FALSE(cache.Contains(1));
+  EXPECT_EQ(0, cache.size());
+}
+
+TEST(SmallFileCacheTest, PutReplaces) {
+  SmallFileCache cache(kMaximumFileSize, kCapacity);
+  EXPECT_TRUE(cache.Put(1, kContents, 5));
+  EXPECT_TRUE(cache.Put(1, kContents + 5, 3));
+  EXPECT_EQ(std::string(kContents + 5, 3), GetContents(&cache, 1));
+  EXPECT_EQ(3, cache.size());
+}
+
+TEST(SmallFileCacheTest, ReleasesLeastRecentlyUsed) {
+  SmallFileCache cache(kMaximumFileSize, kCapacity);
+  EXPECT_TRUE(cache.Put(1, kContents, 10));
+  EXPECT_TRUE(cache.Put(2, kContents, 10));
+
+  // Using the first file makes the second one the least recently used.
+  EXPECT_FALSE(GetContents(&cache, 1).empty());
+  EXPECT_TRUE(cache.Put(3, kContents, 10));
+  EXPECT_TRUE(cache.Contains(1));
+  EXPECT_FALSE(cache.Contains(2));
+  EXPECT_TRUE(cache.Contains(3));
+  EXPECT_EQ(20, cache.size());
+}
+
+TEST(SmallFileCacheTest, ContentsOutliveCache) {
+  pp::VarArrayBuffer contents;
+  {
+    SmallFileCache cache(kMaximumFileSize, kCapacity);
+    EXPECT_TRUE(cache.Put(1, kContents, 5));
+    ASSERT_TRUE(cache.Get(1, &contents));
+  }
+  EXPECT_EQ(0, memcmp(contents.Map(), kContents, 5));
+  contents.Unmap();
+}
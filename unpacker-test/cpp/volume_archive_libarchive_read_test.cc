@@ -210,6 +210,67 @@ TEST_F(VolumeArchiveLibarchiveReadTest, ReadSuccessForLargeLength) {
   delete expected_buffer;
 }
 
+// Test that the data at the beginning of the file can be read again, as it is
+// kept by VolumeArchiveLibarchive.
+TEST_F(VolumeArchiveLibarchiveReadTest, ReadSuccessForDataReadAgain) {
+  fake_lib_archive_config::archive_data = kArchiveData;
+  fake_lib_archive_config::archive_data_size = sizeof(kArchiveData);
+  int64_t archive_data_size = fake_lib_archive_config::archive_data_size;
+  EXPECT_TRUE(volume_archive->CanReadDataAgain());
+
+  int64_t length = archive_data_size / 2;
+  {
+    const char* buffer = NULL;
+    int64_t read_bytes = volume_archive->ReadData(0, length, &buffer);
+    EXPECT_EQ(length, read_bytes);
+    EXPECT_EQ(0, memcmp(buffer, kArchiveData, read_bytes));
+  }
+  EXPECT_TRUE(volume_archive->CanReadDataAgain());
+
+  // Read the same data again and continue with the rest of the data.
+  {
+    const char* buffer = NULL;
+    int64_t read_bytes = volume_archive->ReadData(0, length, &buffer);
+    EXPECT_EQ(length, read_bytes);
+    EXPECT_EQ(0, memcmp(buffer, kArchiveData, read_bytes));
+  }
+  {
+    int64_t offset = length;
+    const char* buffer = NULL;
+    int64_t read_bytes = volume_archive->ReadData(
+        offset, archive_data_size - offset, &buffer);
+    EXPECT_LT(0, read_bytes);
+    EXPECT_EQ(0, memcmp(buffer, kArchiveData + offset, read_bytes));
+  }
+}
+
+// Test that skipping data which was already decompressed ahead doesn't skip
+// any more data.
+TEST_F(VolumeArchiveLibarchiveReadTest, ReadSuccessAfterSkipWithConsume) {
+  fake_lib_archive_config::archive_data = kArchiveData;
+  fake_lib_archive_config::archive_data_size = sizeof(kArchiveData);
+  int64_t archive_data_size = fake_lib_archive_config::archive_data_size;
+
+  int64_t length = archive_data_size / 4;
+  {
+    const char* buffer = NULL;
+    int64_t read_bytes = volume_archive->ReadData(0, length, &buffer);
+    EXPECT_EQ(length, read_bytes);
+    volume_archive->MaybeDecompressAhead();
+  }
+
+  {
+    int64_t offset = length * 2;
+    const char* buffer = NULL;
+    int64_t read_bytes = volume_archive->ReadData(offset, length, &buffer);
+    EXPECT_LT(0, read_bytes);
+    EXPECT_EQ(0, memcmp(buffer, kArchiveData + offset, read_bytes));
+  }
+
+  // The skipped data isn't kept.
+  EXPECT_FALSE(volume_archive->CanReadDataAgain());
+}
+
 TEST_F(VolumeArchiveLibarchiveReadTest, ReadFailureForOffsetEqualToZero) {
   fake_lib_archive_config::archive_data = NULL;
   const char* buffer;
@@ -260,3 +321,46 @@ TEST_F(VolumeArchiveLibarchiveReadTest, ReadFailureAfterSucessfulRead) {
     EXPECT_EQ(read_data_error, volume_archive->error_message());
   }
 }
+
+// Test that the headers after an entry reached with SeekHeader are read in
+// order, so that Volume can read on from an archive parked after a seek. The
+// entries are in the order of an ISO9660 image with subdirectories, where
+// the entries of a directory come after all the directories.
+TEST_F(VolumeArchiveLibarchiveReadTest, GetNextHeaderAfterSeekHeader) {
+  fake_lib_archive_config::archive_entries.push_back("dir/");
+  fake_lib_archive_config::archive_entries.push_back("dir/sub/");
+  fake_lib_archive_config::archive_entries.push_back("file1");
+  fake_lib_archive_config::archive_entries.push_back("dir/file2");
+  fake_lib_archive_config::archive_entries.push_back("dir/sub/file3");
+
+  const char* path_name = NULL;
+  int64_t size = 0;
+  bool is_directory = false;
+  time_t modification_time = 0;
+
+  // Seek into the middle of the image and read on.
+  ASSERT_TRUE(volume_archive->SeekHeader(1));
+  EXPECT_EQ(1, volume_archive->curr_index);
+  ASSERT_EQ(VolumeArchive::RESULT_SUCCESS,
+            volume_archive->GetNextHeader(
+                &path_name, &size, &is_directory, &modification_time));
+  EXPECT_STREQ("dir/sub/", path_name);
+  ASSERT_EQ(VolumeArchive::RESULT_SUCCESS,
+            volume_archive->GetNextHeader(
+                &path_name, &size, &is_directory, &modification_time));
+  EXPECT_STREQ("file1", path_name);
+  EXPECT_EQ(3, volume_archive->curr_index);
+
+  // Seeking back to the first directory reads every entry once more.
+  ASSERT_TRUE(volume_archive->SeekHeader(0));
+  for (size_t i = 0; i < fake_lib_archive_config::archive_entries.size();
+       ++i) {
+    ASSERT_EQ(VolumeArchive::RESULT_SUCCESS,
+              volume_archive->GetNextHeader(
+                  &path_name, &size, &is_directory, &modification_time));
+    EXPECT_EQ(fake_lib_archive_config::archive_entries[i], path_name);
+  }
+  EXPECT_EQ(VolumeArchive::RESULT_EOF,
+            volume_archive->GetNextHeader(
+                &path_name, &size, &is_directory, &modification_time));
+}
@@ -22,7 +22,8 @@ class FakeJavaScriptRequestor : public JavaScriptRequestorInterface {
         array_buffer_(50),
         worker_(instance_handle),
         callback_factory_(this),
-        force_failure_(false) {
+        force_failure_(false),
+        requests_to_answer_(-1) {
     void* data = array_buffer_.Map();
     memset(data, 1, array_buffer_.ByteLength());
     array_buffer_.Unmap();
@@ -35,6 +36,10 @@ class FakeJavaScriptRequestor : public JavaScriptRequestorInterface {
   void RequestFileChunk(const std::string& request_id,
                         int64_t offset,
                         int64_t bytes_to_read) {
+    if (requests_to_answer_ == 0)
+      return;  // Dropped, like a chunk for an outdated request id.
+    if (requests_to_answer_ > 0)
+      --requests_to_answer_;
     worker_.message_loop().PostWork(callback_factory_.NewCallback(
         &FakeJavaScriptRequestor::RequestFileChunkCallback,
         offset,
@@ -52,6 +57,12 @@ class FakeJavaScriptRequestor : public JavaScriptRequestorInterface {
 
   void set_force_failure(bool force_failure) { force_failure_ = force_failure; }
 
+  // Only the next requests_to_answer chunk requests are answered. Negative
+  // values answer all of them.
+  void set_requests_to_answer(int requests_to_answer) {
+    requests_to_answer_ = requests_to_answer;
+  }
+
   pp::VarArrayBuffer array_buffer() const { return array_buffer_; }
 
  private:
@@ -104,6 +115,7 @@ class FakeJavaScriptRequestor : public JavaScriptRequestorInterface {
   pp::CompletionCallbackFactory<FakeJavaScriptRequestor> callback_factory_;
 
   bool force_failure_;
+  int requests_to_answer_;
 };
 
 // Class used by TEST_F macro to initialize the environment for testing
@@ -325,3 +337,27 @@ TEST_F(VolumeReaderJavaScriptStreamTest, InvalidRead) {
   const void* buffer = NULL;
   EXPECT_EQ(ARCHIVE_FATAL, volume_reader->Read(bytes_to_read, &buffer));
 }
+
+TEST_F(VolumeReaderJavaScriptStreamTest, ReadAfterSetRequestId) {
+  // The read ahead of the first read is never answered, as if it was
+  // requested for a request which finished meanwhile.
+  fake_javascript_requestor->set_requests_to_answer(1);
+  volume_reader->SetRequestId("1");
+  int64_t bytes_to_read =
+      fake_javascript_requestor->array_buffer().ByteLength() / 2;
+  const void* buffer = NULL;
+  int64_t read_bytes_1 = volume_reader->Read(bytes_to_read, &buffer);
+  ASSERT_GT(read_bytes_1, 0);
+
+  // Reading for another request must request the chunk again.
+  fake_javascript_requestor->set_requests_to_answer(-1);
+  volume_reader->SetRequestId("2");
+  int64_t read_bytes_2 = volume_reader->Read(bytes_to_read, &buffer);
+  ASSERT_GT(read_bytes_2, 0);
+
+  const void* expected_buffer =
+      static_cast<char*>(fake_javascript_requestor->array_buffer().Map()) +
+      read_bytes_1;
+  EXPECT_EQ(0, memcmp(buffer, expected_buffer, read_bytes_2));
+  fake_javascript_requestor->array_buffer().Unmap();
+}
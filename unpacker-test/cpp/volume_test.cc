@@ -34,11 +34,29 @@ class FakeJavaScriptMessageSender : public JavaScriptMessageSenderInterface {
 
   virtual void SendReadMetadataDone(const std::string& file_system_id,
                                     const std::string& request_id,
-                                    const pp::VarDictionary& metadata) {}
+                                    const pp::Var& metadata,
+                                    const pp::Var& metadata_cache) {}
+
+  virtual void SendReadMetadataProgress(const std::string& file_system_id,
+                                        const std::string& request_id,
+                                        const pp::VarArrayBuffer& metadata) {}
+
+  virtual void SendReadDirectoryDone(const std::string& file_system_id,
+                                     const std::string& request_id,
+                                     const pp::VarArray& entries) {}
+
+  virtual void SendGetMetadataDone(const std::string& file_system_id,
+                                   const std::string& request_id,
+                                   const pp::VarDictionary& metadata) {}
 
   virtual void SendOpenFileDone(const std::string& file_system_id,
                                 const std::string& request_id) {}
 
+  virtual void SendOpenFileByPathDone(const std::string& file_system_id,
+                                      const std::string& request_id,
+                                      int64_t index,
+                                      int64_t size) {}
+
   virtual void SendCloseFileDone(const std::string& file_system_id,
                                  const std::string& request_id,
                                  const std::string& open_request_id) {}
@@ -48,6 +66,21 @@ class FakeJavaScriptMessageSender : public JavaScriptMessageSenderInterface {
                                 const pp::VarArrayBuffer& array_buffer,
                                 bool has_more_data) {}
 
+  virtual void SendExtractEntry(const std::string& file_system_id,
+                                const std::string& request_id,
+                                int64_t index,
+                                const std::string& path,
+                                int64_t size) {}
+
+  virtual void SendExtractData(const std::string& file_system_id,
+                               const std::string& request_id,
+                               int64_t index,
+                               const pp::VarArrayBuffer& array_buffer,
+                               bool has_more_data) {}
+
+  virtual void SendExtractDone(const std::string& file_system_id,
+                               const std::string& request_id) {}
+
   virtual void SendConsoleLog(const std::string& file_system_id,
                               const std::string& request_id,
                               const std::string& src_file,
@@ -58,13 +91,14 @@ class FakeJavaScriptMessageSender : public JavaScriptMessageSenderInterface {
   virtual void SendCreateArchiveDone(int compressor_id) {};
 
   virtual void SendReadFileChunk(int compressor_id_,
+                                 int entry_id,
                                  int64_t file_size) {};
 
   virtual void SendWriteChunk(int compressor_id,
                               const pp::VarArrayBuffer& array_buffer,
                               int64_t length) {};
 
-  virtual void SendAddToArchiveDone(int compressor_id) {};
+  virtual void SendAddToArchiveDone(int compressor_id, int entry_id) {};
 
   virtual void SendCloseArchiveDone(int compressor_id) {};
 };
@@ -75,14 +109,15 @@ class FakeJavaScriptMessageSender : public JavaScriptMessageSenderInterface {
 // Volume methods.
 class VolumeTest : public testing::Test {
  protected:
-  VolumeTest() : message_sender(NULL), volume(NULL) {}
+  VolumeTest() : message_sender(NULL), worker_pool(NULL), volume(NULL) {}
 
   virtual void SetUp() {
     message_sender = new FakeJavaScriptMessageSender();
+    worker_pool = new WorkerPool(pp::InstanceHandle(PSGetInstanceId()),
+                                 WorkerPool::DefaultMaximumThreads());
     // TODO(cmihail): Use the constructor with custom factories for
     // VolumeArchive and VolumeReader.
-    volume = new Volume(
-        pp::InstanceHandle(PSGetInstanceId()), kFileSystemId, message_sender);
+    volume = new Volume(worker_pool, kFileSystemId, message_sender);
   }
 
   virtual void TearDown() {
@@ -90,9 +125,12 @@ class VolumeTest : public testing::Test {
     message_sender = NULL;
     delete volume;
     volume = NULL;
+    delete worker_pool;
+    worker_pool = NULL;
   }
 
   FakeJavaScriptMessageSender* message_sender;
+  WorkerPool* worker_pool;
   Volume* volume;
 };
 
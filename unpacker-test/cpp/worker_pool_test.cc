@@ -0,0 +1,375 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "worker_pool.h"
+
+#include <sys/time.h>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "ppapi/utility/threading/lock.h"
+#include "ppapi_simple/ps_main.h"
+
+namespace {
+
+// The number of jobs submitted to every queue.
+const int kJobsPerQueue = 100;
+
+// The number of queues used by tests with multiple queues.
+const int kQueues = 10;
+
+// How long a job blocked without WorkerPool::WaitForSignal waits to be
+// signaled.
+const int kBlockTimeoutMs = 100;
+
+// Records the order in which the jobs of a queue were run.
+class JobRecorder {
+ public:
+  JobRecorder() : running_(false), overlapped_(false) {}
+
+  // Returns a callback that records index when run.
+  pp::CompletionCallback NewJob(int index) {
+    return pp::CompletionCallback(&JobRecorder::RunJob, new Job(this, index));
+  }
+
+  const std::vector<int>& recorded_indexes() const {
+    return recorded_indexes_;
+  }
+
+  // True if two jobs of the queue were run at the same time.
+  bool overlapped() const { return overlapped_; }
+
+ private:
+  // The data bound to a callback returned by NewJob.
+  struct Job {
+    Job(JobRecorder* recorder, int index) : recorder(recorder), index(index) {}
+    JobRecorder* const recorder;
+    const int index;
+  };
+
+  static void RunJob(void* job_data, int32_t result) {
+    EXPECT_EQ(PP_OK, result);
+    Job* job = static_cast<Job*>(job_data);
+    job->recorder->Record(job->index);
+    delete job;
+  }
+
+  void Record(int index) {
+    lock_.Acquire();
+    if (running_)
+      overlapped_ = true;
+    running_ = true;
+    lock_.Release();
+
+    // Jobs of a queue don't run in parallel, so no lock is needed here.
+    recorded_indexes_.push_back(index);
+
+    lock_.Acquire();
+    running_ = false;
+    lock_.Release();
+  }
+
+  pp::Lock lock_;
+  std::vector<int> recorded_indexes_;
+  bool running_;
+  bool overlapped_;
+};
+
+// A job that waits with WorkerPool::WaitForSignal until another job signals
+// it.
+class WaitingJob {
+ public:
+  WaitingJob()
+      : signaled_(false),
+        finished_(false),
+        waited_for_finish_(false),
+        signaled_while_blocked_(false) {
+    pthread_mutex_init(&lock_, NULL);
+    pthread_cond_init(&signaled_cond_, NULL);
+    pthread_cond_init(&finished_cond_, NULL);
+  }
+
+  ~WaitingJob() {
+    pthread_cond_destroy(&signaled_cond_);
+    pthread_cond_destroy(&finished_cond_);
+    pthread_mutex_destroy(&lock_);
+  }
+
+  pp::CompletionCallback NewWaitJob() {
+    return pp::CompletionCallback(&WaitingJob::Wait, this);
+  }
+
+  pp::CompletionCallback NewSignalJob() {
+    return pp::CompletionCallback(&WaitingJob::Signal, this);
+  }
+
+  // Returns a job that waits with WorkerPool::WaitForSignal until the job
+  // returned by NewWaitJob finished.
+  pp::CompletionCallback NewWaitForFinishJob() {
+    return pp::CompletionCallback(&WaitingJob::WaitForFinish, this);
+  }
+
+  // Returns a job that blocks its thread without WorkerPool::WaitForSignal
+  // until the job returned by NewSignalJob runs, for up to kBlockTimeoutMs.
+  pp::CompletionCallback NewBlockJob() {
+    return pp::CompletionCallback(&WaitingJob::Block, this);
+  }
+
+  bool finished() const { return finished_; }
+
+  bool waited_for_finish() const { return waited_for_finish_; }
+
+  // True if the job returned by NewBlockJob was signaled before it timed out,
+  // which needs another thread to run jobs.
+  bool signaled_while_blocked() const { return signaled_while_blocked_; }
+
+ private:
+  static void Wait(void* waiting_job, int32_t /* result */) {
+    WaitingJob* job = static_cast<WaitingJob*>(waiting_job);
+    pthread_mutex_lock(&job->lock_);
+    while (!job->signaled_)
+      WorkerPool::WaitForSignal(&job->signaled_cond_, &job->lock_);
+    job->finished_ = true;
+    pthread_cond_broadcast(&job->finished_cond_);
+    pthread_mutex_unlock(&job->lock_);
+  }
+
+  static void WaitForFinish(void* waiting_job, int32_t /* result */) {
+    WaitingJob* job = static_cast<WaitingJob*>(waiting_job);
+    pthread_mutex_lock(&job->lock_);
+    while (!job->finished_)
+      WorkerPool::WaitForSignal(&job->finished_cond_, &job->lock_);
+    job->waited_for_finish_ = true;
+    pthread_mutex_unlock(&job->lock_);
+  }
+
+  static void Block(void* waiting_job, int32_t /* result */) {
+    WaitingJob* job = static_cast<WaitingJob*>(waiting_job);
+    timeval now;
+    gettimeofday(&now, NULL);
+    timespec deadline;
+    deadline.tv_sec = now.tv_sec + kBlockTimeoutMs / 1000;
+    deadline.tv_nsec = (now.tv_usec + kBlockTimeoutMs % 1000 * 1000) * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+      ++deadline.tv_sec;
+      deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&job->lock_);
+    int result = 0;
+    while (!job->signaled_ && result == 0) {
+      result = pthread_cond_timedwait(&job->signaled_cond_, &job->lock_,
+                                      &deadline);
+    }
+    job->signaled_while_blocked_ = job->signaled_;
+    job->finished_ = true;
+    pthread_mutex_unlock(&job->lock_);
+  }
+
+  static void Signal(void* waiting_job, int32_t /* result */) {
+    WaitingJob* job = static_cast<WaitingJob*>(waiting_job);
+    pthread_mutex_lock(&job->lock_);
+    job->signaled_ = true;
+    pthread_cond_signal(&job->signaled_cond_);
+    pthread_mutex_unlock(&job->lock_);
+  }
+
+  pthread_mutex_t lock_;
+  pthread_cond_t signaled_cond_;
+  pthread_cond_t finished_cond_;
+  bool signaled_;
+  bool finished_;
+  bool waited_for_finish_;
+  bool signaled_while_blocked_;
+};
+
+void ExpectInOrder(const JobRecorder& recorder) {
+  EXPECT_FALSE(recorder.overlapped());
+  ASSERT_EQ(kJobsPerQueue, recorder.recorded_indexes().size());
+  for (int i = 0; i < kJobsPerQueue; ++i)
+    EXPECT_EQ(i, recorder.recorded_indexes()[i]);
+}
+
+}  // namespace
+
+// Class used by TEST_F macro to initialize the environment for testing
+// WorkerPool methods.
+class WorkerPoolTest : public testing::Test {
+ protected:
+  WorkerPoolTest() : worker_pool(NULL) {}
+
+  virtual void SetUp() {
+    worker_pool = new WorkerPool(pp::InstanceHandle(PSGetInstanceId()),
+                                 worker_pool_constants::kMaximumThreads);
+    ASSERT_TRUE(worker_pool->Start());
+  }
+
+  virtual void TearDown() {
+    delete worker_pool;
+    worker_pool = NULL;
+  }
+
+  WorkerPool* worker_pool;
+};
+
+TEST_F(WorkerPoolTest, DefaultMaximumThreads) {
+  EXPECT_LE(worker_pool_constants::kMinimumThreads,
+            WorkerPool::DefaultMaximumThreads());
+  EXPECT_GE(worker_pool_constants::kMaximumThreads,
+            WorkerPool::DefaultMaximumThreads());
+}
+
+TEST_F(WorkerPoolTest, SingleQueueRunsInOrder) {
+  JobRecorder recorder;
+  WorkerPool::JobQueue job_queue(worker_pool);
+  for (int i = 0; i < kJobsPerQueue; ++i)
+    job_queue.PostWork(recorder.NewJob(i));
+  job_queue.Join();
+
+  ExpectInOrder(recorder);
+}
+
+TEST_F(WorkerPoolTest, MultipleQueuesRunInOrder) {
+  JobRecorder recorders[kQueues];
+  std::vector<WorkerPool::JobQueue*> job_queues;
+  for (int i = 0; i < kQueues; ++i)
+    job_queues.push_back(new WorkerPool::JobQueue(worker_pool));
+
+  // Interleave the jobs so all the queues are busy at the same time.
+  for (int i = 0; i < kJobsPerQueue; ++i) {
+    for (int j = 0; j < kQueues; ++j)
+      job_queues[j]->PostWork(recorders[j].NewJob(i));
+  }
+
+  for (int i = 0; i < kQueues; ++i) {
+    job_queues[i]->Join();
+    ExpectInOrder(recorders[i]);
+    delete job_queues[i];
+  }
+}
+
+TEST_F(WorkerPoolTest, JoinWithoutJobs) {
+  WorkerPool::JobQueue job_queue(worker_pool);
+  job_queue.Join();
+}
+
+TEST_F(WorkerPoolTest, QueueIsReusedAfterJoin) {
+  JobRecorder recorder;
+  WorkerPool::JobQueue job_queue(worker_pool);
+  for (int i = 0; i < kJobsPerQueue / 2; ++i)
+    job_queue.PostWork(recorder.NewJob(i));
+  job_queue.Join();
+  for (int i = kJobsPerQueue / 2; i < kJobsPerQueue; ++i)
+    job_queue.PostWork(recorder.NewJob(i));
+  job_queue.Join();
+
+  ExpectInOrder(recorder);
+}
+
+// A job waiting for another job of the same pool must not block the pool,
+// even if the pool has a single thread.
+TEST(WorkerPoolSingleThreadTest, WaitingJobRunsOtherQueues) {
+  WorkerPool worker_pool(pp::InstanceHandle(PSGetInstanceId()), 1);
+  ASSERT_TRUE(worker_pool.Start());
+
+  WaitingJob waiting_job;
+  JobRecorder recorder;
+  WorkerPool::JobQueue waiting_queue(&worker_pool);
+  WorkerPool::JobQueue other_queue(&worker_pool);
+
+  waiting_queue.PostWork(waiting_job.NewWaitJob());
+  for (int i = 0; i < kJobsPerQueue; ++i)
+    other_queue.PostWork(recorder.NewJob(i));
+  other_queue.PostWork(waiting_job.NewSignalJob());
+
+  waiting_queue.Join();
+  other_queue.Join();
+
+  EXPECT_TRUE(waiting_job.finished());
+  ExpectInOrder(recorder);
+}
+
+// Jobs posted to the queue of a waiting job are not run before it finishes.
+TEST(WorkerPoolSingleThreadTest, WaitingJobKeepsQueueOrder) {
+  WorkerPool worker_pool(pp::InstanceHandle(PSGetInstanceId()), 1);
+  ASSERT_TRUE(worker_pool.Start());
+
+  WaitingJob waiting_job;
+  JobRecorder recorder;
+  WorkerPool::JobQueue waiting_queue(&worker_pool);
+  WorkerPool::JobQueue other_queue(&worker_pool);
+
+  waiting_queue.PostWork(recorder.NewJob(0));
+  waiting_queue.PostWork(waiting_job.NewWaitJob());
+  for (int i = 1; i < kJobsPerQueue; ++i)
+    waiting_queue.PostWork(recorder.NewJob(i));
+  other_queue.PostWork(waiting_job.NewSignalJob());
+
+  waiting_queue.Join();
+  other_queue.Join();
+
+  EXPECT_TRUE(waiting_job.finished());
+  ExpectInOrder(recorder);
+}
+
+// A job of another queue waiting for a waiting job must not keep it from
+// finishing, e.g. a compressor closing an archive while its writer waits.
+TEST(WorkerPoolSingleThreadTest, WaitingJobIsWaitedForByOtherQueue) {
+  WorkerPool worker_pool(pp::InstanceHandle(PSGetInstanceId()), 1);
+  ASSERT_TRUE(worker_pool.Start());
+
+  WaitingJob waiting_job;
+  WorkerPool::JobQueue waiting_queue(&worker_pool);
+  WorkerPool::JobQueue waiting_for_finish_queue(&worker_pool);
+  WorkerPool::JobQueue signal_queue(&worker_pool);
+
+  waiting_queue.PostWork(waiting_job.NewWaitJob());
+  waiting_for_finish_queue.PostWork(waiting_job.NewWaitForFinishJob());
+  signal_queue.PostWork(waiting_job.NewSignalJob());
+
+  waiting_queue.Join();
+  waiting_for_finish_queue.Join();
+  signal_queue.Join();
+
+  EXPECT_TRUE(waiting_job.finished());
+  EXPECT_TRUE(waiting_job.waited_for_finish());
+}
+
+// The threads started while jobs wait exit once the jobs stopped waiting, so
+// a single thread runs jobs again and a blocked job blocks the other queues.
+TEST(WorkerPoolSingleThreadTest, ExtraThreadsExitAfterWaiting) {
+  WorkerPool worker_pool(pp::InstanceHandle(PSGetInstanceId()), 1);
+  ASSERT_TRUE(worker_pool.Start());
+
+  // Every waiting job gets a thread of its own.
+  std::vector<WaitingJob*> waiting_jobs;
+  std::vector<WorkerPool::JobQueue*> waiting_queues;
+  WorkerPool::JobQueue signal_queue(&worker_pool);
+  for (int i = 0; i < kQueues; ++i) {
+    waiting_jobs.push_back(new WaitingJob);
+    waiting_queues.push_back(new WorkerPool::JobQueue(&worker_pool));
+    waiting_queues[i]->PostWork(waiting_jobs[i]->NewWaitJob());
+  }
+  for (int i = 0; i < kQueues; ++i)
+    signal_queue.PostWork(waiting_jobs[i]->NewSignalJob());
+  for (int i = 0; i < kQueues; ++i) {
+    waiting_queues[i]->Join();
+    EXPECT_TRUE(waiting_jobs[i]->finished());
+  }
+  signal_queue.Join();
+
+  WaitingJob blocking_job;
+  waiting_queues[0]->PostWork(blocking_job.NewBlockJob());
+  signal_queue.PostWork(blocking_job.NewSignalJob());
+  waiting_queues[0]->Join();
+  signal_queue.Join();
+  EXPECT_TRUE(blocking_job.finished());
+  EXPECT_FALSE(blocking_job.signaled_while_blocked());
+
+  for (int i = 0; i < kQueues; ++i) {
+    delete waiting_queues[i];
+    delete waiting_jobs[i];
+  }
+}
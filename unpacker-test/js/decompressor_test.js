@@ -123,6 +123,10 @@ describe('Decompressor', function() {
         expect(onSuccessSpy.calledOnce).to.be.true;
       });
 
+      it('should call onSuccess without a cache record', function() {
+        expect(onSuccessSpy.firstCall.args[1]).to.be.undefined;
+      });
+
       it('should not call onError', function() {
         expect(onErrorSpy.called).to.be.false;
       });
@@ -205,6 +209,324 @@ describe('Decompressor', function() {
     });
   });  // Test readMetadata.
 
+  // Test readMetadata with a metadata cache.
+  describe('that reads metadata with a metadata cache', function() {
+    var record = new ArrayBuffer(8);
+    beforeEach(function() {
+      decompressor.readMetadata(
+          METADATA_REQUEST_ID, ENCODING, onSuccessSpy, onErrorSpy,
+          unpacker.request.MetadataFormat.BINARY, undefined, record);
+    });
+
+    it('should call naclModule.postMessage with the record', function() {
+      var readMetadataRequest = unpacker.request.createReadMetadataRequest(
+          FILE_SYSTEM_ID, METADATA_REQUEST_ID, ENCODING, BLOB.size,
+          unpacker.request.MetadataFormat.BINARY, false, record);
+      expect(naclModule.postMessage.calledWith(readMetadataRequest))
+          .to.be.true;
+    });
+
+    it('should pass a new record to onSuccess', function() {
+      var data = {};
+      data[unpacker.request.Key.METADATA] = new ArrayBuffer(20);
+      data[unpacker.request.Key.METADATA_CACHE] = new ArrayBuffer(28);
+      decompressor.processMessage(
+          data, unpacker.request.Operation.READ_METADATA_DONE,
+          METADATA_REQUEST_ID);
+      expect(onSuccessSpy.firstCall.args[1])
+          .to.equal(data[unpacker.request.Key.METADATA_CACHE]);
+    });
+  });  // Test readMetadata with a metadata cache.
+
+  // Test readMetadata with progress.
+  describe('that reads metadata with progress', function() {
+    var onProgressSpy;
+
+    beforeEach(function() {
+      onProgressSpy = sinon.spy();
+      decompressor.readMetadata(
+          METADATA_REQUEST_ID, ENCODING, onSuccessSpy, onErrorSpy,
+          unpacker.request.MetadataFormat.BINARY, onProgressSpy);
+    });
+
+    it('should call naclModule.postMessage with a progress request',
+       function() {
+         var readMetadataRequest = unpacker.request.createReadMetadataRequest(
+             FILE_SYSTEM_ID, METADATA_REQUEST_ID, ENCODING, BLOB.size,
+             unpacker.request.MetadataFormat.BINARY, true);
+         expect(naclModule.postMessage.calledWith(readMetadataRequest))
+             .to.be.true;
+       });
+
+    describe('and receives a processMessage with READ_METADATA_PROGRESS',
+             function() {
+      var data = {};
+      beforeEach(function() {
+        data[unpacker.request.Key.METADATA] = new ArrayBuffer(20);
+        decompressor.processMessage(
+            data, unpacker.request.Operation.READ_METADATA_PROGRESS,
+            METADATA_REQUEST_ID);
+      });
+
+      it('should call onProgress with the metadata', function() {
+        expect(onProgressSpy.calledOnce).to.be.true;
+        expect(onProgressSpy.calledWith(data[unpacker.request.Key.METADATA]))
+            .to.be.true;
+      });
+
+      it('should not call onSuccess', function() {
+        expect(onSuccessSpy.called).to.be.false;
+      });
+
+      it('should keep the request in progress', function() {
+        expect(decompressor.requestsInProgress[METADATA_REQUEST_ID])
+            .to.not.be.undefined;
+      });
+    });
+  });  // Test readMetadata with progress.
+
+  // Test readDirectory.
+  describe('that reads a directory', function() {
+    beforeEach(function() {
+      decompressor.readDirectory(METADATA_REQUEST_ID, '/dir', onSuccessSpy,
+                                 onErrorSpy);
+    });
+
+    it('should call naclModule.postMessage with read directory request',
+       function() {
+         var readDirectoryRequest = unpacker.request.createReadDirectoryRequest(
+             FILE_SYSTEM_ID, METADATA_REQUEST_ID, '/dir');
+         expect(naclModule.postMessage.calledWith(readDirectoryRequest))
+             .to.be.true;
+       });
+
+    describe('and receives a processMessage with READ_DIRECTORY_DONE',
+             function() {
+      var data = {};
+      beforeEach(function() {
+        data[unpacker.request.Key.ENTRIES] = [{name: 'file'}];
+        decompressor.processMessage(
+            data, unpacker.request.Operation.READ_DIRECTORY_DONE,
+            METADATA_REQUEST_ID);
+      });
+
+      it('should call onSuccess with the entries', function() {
+        expect(onSuccessSpy.calledWith(data[unpacker.request.Key.ENTRIES]))
+            .to.be.true;
+      });
+
+      it('should remove the request in progress', function() {
+        expect(decompressor.requestsInProgress[METADATA_REQUEST_ID])
+            .to.be.undefined;
+      });
+    });
+
+    describe('and receives a processMessage with FILE_SYSTEM_ERROR',
+             function() {
+      beforeEach(function() {
+        var data = {};
+        data[unpacker.request.Key.ERROR] = 'NOT_A_DIRECTORY';
+        decompressor.processMessage(
+            data, unpacker.request.Operation.FILE_SYSTEM_ERROR,
+            METADATA_REQUEST_ID);
+      });
+
+      it('should call onError with the lookup error', function() {
+        expect(onErrorSpy.calledWith('NOT_A_DIRECTORY')).to.be.true;
+      });
+    });
+  });  // Test readDirectory.
+
+  // Test getMetadata.
+  describe('that gets the metadata of an entry', function() {
+    beforeEach(function() {
+      decompressor.getMetadata(OPEN_REQUEST_ID, FILE_PATH, onSuccessSpy,
+                               onErrorSpy);
+    });
+
+    it('should call naclModule.postMessage with get metadata request',
+       function() {
+         var getMetadataRequest = unpacker.request.createGetMetadataRequest(
+             FILE_SYSTEM_ID, OPEN_REQUEST_ID, FILE_PATH);
+         expect(naclModule.postMessage.calledWith(getMetadataRequest))
+             .to.be.true;
+       });
+
+    describe('and receives a processMessage with GET_METADATA_DONE',
+             function() {
+      var data = {};
+      beforeEach(function() {
+        data[unpacker.request.Key.METADATA] = {name: 'dummy'};
+        decompressor.processMessage(
+            data, unpacker.request.Operation.GET_METADATA_DONE,
+            OPEN_REQUEST_ID);
+      });
+
+      it('should call onSuccess with the metadata', function() {
+        expect(onSuccessSpy.calledWith(data[unpacker.request.Key.METADATA]))
+            .to.be.true;
+      });
+
+      it('should remove the request in progress', function() {
+        expect(decompressor.requestsInProgress[OPEN_REQUEST_ID])
+            .to.be.undefined;
+      });
+    });
+  });  // Test getMetadata.
+
+  // Test openFiles.
+  describe('that opens many files', function() {
+    var otherOnSuccessSpy;
+    beforeEach(function() {
+      otherOnSuccessSpy = sinon.spy();
+      decompressor.openFiles([
+        {requestId: OPEN_REQUEST_ID, index: 7, onSuccess: onSuccessSpy,
+         onError: onErrorSpy},
+        {requestId: OPEN_REQUEST_ID + 1, index: 3,
+         onSuccess: otherOnSuccessSpy, onError: onErrorSpy}
+      ], ENCODING);
+    });
+
+    it('should call naclModule.postMessage once with open files request',
+       function() {
+         var openFilesRequest = unpacker.request.createOpenFilesRequest(
+             FILE_SYSTEM_ID, [OPEN_REQUEST_ID, OPEN_REQUEST_ID + 1], [7, 3],
+             ENCODING, BLOB.size);
+         expect(naclModule.postMessage.calledOnce).to.be.true;
+         expect(naclModule.postMessage.calledWith(openFilesRequest)).to.be
+             .true;
+       });
+
+    it('should answer every file separately', function() {
+      decompressor.processMessage({}, unpacker.request.Operation.OPEN_FILE_DONE,
+                                  OPEN_REQUEST_ID + 1);
+      expect(otherOnSuccessSpy.calledOnce).to.be.true;
+      expect(onSuccessSpy.called).to.be.false;
+      expect(decompressor.requestsInProgress[OPEN_REQUEST_ID]).to.not.be
+          .undefined;
+    });
+  });  // Test openFiles.
+
+  // Test openFileByPath.
+  describe('that opens a file by path', function() {
+    beforeEach(function() {
+      decompressor.openFileByPath(OPEN_REQUEST_ID, '/dir/file', ENCODING,
+                                  onSuccessSpy, onErrorSpy);
+    });
+
+    it('should call naclModule.postMessage with open file by path request',
+       function() {
+         var openFileByPathRequest =
+             unpacker.request.createOpenFileByPathRequest(
+                 FILE_SYSTEM_ID, OPEN_REQUEST_ID, '/dir/file', ENCODING,
+                 BLOB.size);
+         expect(naclModule.postMessage.calledWith(openFileByPathRequest))
+             .to.be.true;
+       });
+
+    describe('and receives a processMessage with OPEN_FILE_BY_PATH_DONE',
+             function() {
+      beforeEach(function() {
+        var data = {};
+        data[unpacker.request.Key.INDEX] = '3';
+        data[unpacker.request.Key.SIZE] = '100';
+        decompressor.processMessage(
+            data, unpacker.request.Operation.OPEN_FILE_BY_PATH_DONE,
+            OPEN_REQUEST_ID);
+      });
+
+      it('should call onSuccess with the index and the size', function() {
+        expect(onSuccessSpy.calledWith({index: 3, size: 100})).to.be.true;
+      });
+
+      it('should NOT remove the request in progress', function() {
+        expect(decompressor.requestsInProgress[OPEN_REQUEST_ID])
+            .to.not.be.undefined;
+      });
+    });
+
+    describe('and receives a processMessage with FILE_SYSTEM_ERROR',
+             function() {
+      beforeEach(function() {
+        var data = {};
+        data[unpacker.request.Key.ERROR] = 'NOT_A_FILE';
+        decompressor.processMessage(
+            data, unpacker.request.Operation.FILE_SYSTEM_ERROR,
+            OPEN_REQUEST_ID);
+      });
+
+      it('should call onError with the lookup error', function() {
+        expect(onErrorSpy.calledWith('NOT_A_FILE')).to.be.true;
+      });
+
+      it('should remove the request in progress', function() {
+        expect(decompressor.requestsInProgress[OPEN_REQUEST_ID])
+            .to.be.undefined;
+      });
+    });
+  });  // Test openFileByPath.
+
+  // Test extract.
+  describe('that extracts entries', function() {
+    var onDataSpy;
+    beforeEach(function() {
+      onDataSpy = sinon.spy();
+      decompressor.extract(OPEN_REQUEST_ID, [2], ENCODING, onDataSpy,
+                           onSuccessSpy, onErrorSpy);
+    });
+
+    it('should call naclModule.postMessage with extract request', function() {
+      var extractRequest = unpacker.request.createExtractRequest(
+          FILE_SYSTEM_ID, OPEN_REQUEST_ID, [2], ENCODING, BLOB.size);
+      expect(naclModule.postMessage.calledWith(extractRequest)).to.be.true;
+    });
+
+    describe('and receives an entry with its data', function() {
+      var buffer = new ArrayBuffer(5);
+      beforeEach(function() {
+        var entryData = {};
+        entryData[unpacker.request.Key.INDEX] = '2';
+        entryData[unpacker.request.Key.PATH] = 'dir/file';
+        entryData[unpacker.request.Key.SIZE] = '5';
+        decompressor.processMessage(
+            entryData, unpacker.request.Operation.EXTRACT_ENTRY,
+            OPEN_REQUEST_ID);
+
+        var data = {};
+        data[unpacker.request.Key.INDEX] = '2';
+        data[unpacker.request.Key.READ_FILE_DATA] = buffer;
+        data[unpacker.request.Key.HAS_MORE_DATA] = false;
+        decompressor.processMessage(
+            data, unpacker.request.Operation.EXTRACT_DATA, OPEN_REQUEST_ID);
+      });
+
+      it('should call onData with the entry and the data', function() {
+        expect(onDataSpy.calledWith({index: 2, path: 'dir/file', size: 5},
+                                    buffer, false)).to.be.true;
+      });
+
+      it('should not call onSuccess', function() {
+        expect(onSuccessSpy.called).to.be.false;
+      });
+
+      describe('and receives a processMessage with EXTRACT_DONE', function() {
+        beforeEach(function() {
+          decompressor.processMessage(
+              {}, unpacker.request.Operation.EXTRACT_DONE, OPEN_REQUEST_ID);
+        });
+
+        it('should call onSuccess', function() {
+          expect(onSuccessSpy.calledOnce).to.be.true;
+        });
+
+        it('should remove the request in progress', function() {
+          expect(decompressor.requestsInProgress[OPEN_REQUEST_ID])
+              .to.be.undefined;
+        });
+      });
+    });
+  });  // Test extract.
+
   // Test openFile.
   describe('that opens a file', function() {
     beforeEach(function() {
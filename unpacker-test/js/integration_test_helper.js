@@ -178,7 +178,7 @@ var tests_helper = {
       chrome.fileSystemProvider.mount
           .withArgs({fileSystemId: volume.fileSystemId,
                      displayName: volume.entry.name,
-                     openedFilesLimit: 1})
+                     openedFilesLimit: unpacker.app.OPENED_FILES_LIMIT})
           .callsArg(1);
       chrome.fileSystemProvider.unmount
           .withArgs({fileSystemId: volume.fileSystemId})
@@ -278,7 +278,7 @@ var tests_helper = {
           fileSystemId: fileSystemId,
           displayName: archiveData.name,
           writable: false,
-          openedFilesLimit: 1,
+          openedFilesLimit: unpacker.app.OPENED_FILES_LIMIT,
           openedFiles: []
         }
       };
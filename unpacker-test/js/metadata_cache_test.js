@@ -0,0 +1,70 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+'use strict';
+
+describe('MetadataCache', function() {
+  /**
+   * Creates a blob of the given size with the given byte at the given offset.
+   * @param {number} size
+   * @param {number} offset
+   * @param {number} value
+   * @return {!Blob}
+   */
+  var createBlob = function(size, offset, value) {
+    var data = new Uint8Array(size);
+    data[offset] = value;
+    return new Blob([data], {type: 'application/octet-stream'});
+  };
+
+  describe('getFingerprint', function() {
+    var BLOCK_SIZE = unpacker.MetadataCache.FINGERPRINT_BLOCK_SIZE;
+
+    it('should be the same for the same contents', function() {
+      return Promise.all([
+        unpacker.MetadataCache.getFingerprint(createBlob(100, 0, 1)),
+        unpacker.MetadataCache.getFingerprint(createBlob(100, 0, 1))
+      ]).then(function(fingerprints) {
+        expect(fingerprints[0]).to.equal(fingerprints[1]);
+      });
+    });
+
+    it('should start with the size', function() {
+      return unpacker.MetadataCache.getFingerprint(createBlob(100, 0, 1))
+          .then(function(fingerprint) {
+            expect(fingerprint.split(':')[0]).to.equal('100');
+          });
+    });
+
+    it('should differ for different heads', function() {
+      var size = 3 * BLOCK_SIZE;
+      return Promise.all([
+        unpacker.MetadataCache.getFingerprint(createBlob(size, 10, 1)),
+        unpacker.MetadataCache.getFingerprint(createBlob(size, 10, 2))
+      ]).then(function(fingerprints) {
+        expect(fingerprints[0]).to.not.equal(fingerprints[1]);
+      });
+    });
+
+    it('should differ for different tails', function() {
+      var size = 3 * BLOCK_SIZE;
+      return Promise.all([
+        unpacker.MetadataCache.getFingerprint(createBlob(size, size - 1, 1)),
+        unpacker.MetadataCache.getFingerprint(createBlob(size, size - 1, 2))
+      ]).then(function(fingerprints) {
+        expect(fingerprints[0]).to.not.equal(fingerprints[1]);
+      });
+    });
+
+    it('should not read the middle of big archives', function() {
+      var size = 3 * BLOCK_SIZE;
+      return Promise.all([
+        unpacker.MetadataCache.getFingerprint(createBlob(size, BLOCK_SIZE, 1)),
+        unpacker.MetadataCache.getFingerprint(createBlob(size, BLOCK_SIZE, 2))
+      ]).then(function(fingerprints) {
+        expect(fingerprints[0]).to.equal(fingerprints[1]);
+      });
+    });
+  });
+});
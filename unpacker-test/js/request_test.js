@@ -92,6 +92,61 @@ describe('On calling', function() {
       expect(readMetadataRequest[unpacker.request.Key.ARCHIVE_SIZE])
           .to.equal(ARCHIVE_SIZE.toString());
     });
+
+    it('without a metadata format', function() {
+      expect(readMetadataRequest[unpacker.request.Key.METADATA_FORMAT])
+          .to.be.undefined;
+    });
+  });
+
+  describe('request.createReadMetadataRequest with a metadata format',
+           function() {
+    it('should set the metadata format', function() {
+      var readMetadataRequest = unpacker.request.createReadMetadataRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, ENCODING, ARCHIVE_SIZE,
+          unpacker.request.MetadataFormat.BINARY);
+      expect(readMetadataRequest[unpacker.request.Key.METADATA_FORMAT])
+          .to.equal(unpacker.request.MetadataFormat.BINARY);
+    });
+
+    it('should set the metadata progress if requested', function() {
+      var readMetadataRequest = unpacker.request.createReadMetadataRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, ENCODING, ARCHIVE_SIZE,
+          unpacker.request.MetadataFormat.BINARY, true);
+      expect(readMetadataRequest[unpacker.request.Key.METADATA_PROGRESS])
+          .to.be.true;
+    });
+  });
+
+  describe('request.createReadMetadataRequest with a metadata cache',
+           function() {
+    it('should only ask for a new record without a record', function() {
+      var readMetadataRequest = unpacker.request.createReadMetadataRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, ENCODING, ARCHIVE_SIZE, undefined,
+          false, null);
+      expect(readMetadataRequest[unpacker.request.Key.CREATE_METADATA_CACHE])
+          .to.be.true;
+      expect(readMetadataRequest[unpacker.request.Key.METADATA_CACHE])
+          .to.be.undefined;
+    });
+
+    it('should pass the record', function() {
+      var record = new ArrayBuffer(8);
+      var readMetadataRequest = unpacker.request.createReadMetadataRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, ENCODING, ARCHIVE_SIZE, undefined,
+          false, record);
+      expect(readMetadataRequest[unpacker.request.Key.CREATE_METADATA_CACHE])
+          .to.be.true;
+      expect(readMetadataRequest[unpacker.request.Key.METADATA_CACHE])
+          .to.equal(record);
+    });
+
+    it('should not use the cache if not set', function() {
+      var readMetadataRequest = unpacker.request.createReadMetadataRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, ENCODING, ARCHIVE_SIZE);
+      expect(readMetadataRequest[unpacker.request.Key.CREATE_METADATA_CACHE])
+          .to.be.undefined;
+    });
   });
 
   describe('request.createReadChunkDoneResponse should create a response',
@@ -176,6 +231,53 @@ describe('On calling', function() {
     });
   });
 
+  describe('request.createReadDirectoryRequest should create a request',
+           function() {
+    var readDirectoryRequest;
+    beforeEach(function() {
+      readDirectoryRequest = unpacker.request.createReadDirectoryRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, '/dir');
+    });
+
+    it('with READ_DIRECTORY as operation', function() {
+      expect(readDirectoryRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.READ_DIRECTORY);
+    });
+
+    it('with correct request id', function() {
+      expect(readDirectoryRequest[unpacker.request.Key.REQUEST_ID])
+          .to.equal(REQUEST_ID.toString());
+    });
+
+    it('with correct path', function() {
+      expect(readDirectoryRequest[unpacker.request.Key.PATH]).to.equal('/dir');
+    });
+  });
+
+  describe('request.createGetMetadataRequest should create a request',
+           function() {
+    var getMetadataRequest;
+    beforeEach(function() {
+      getMetadataRequest = unpacker.request.createGetMetadataRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, '/dir/file');
+    });
+
+    it('with GET_METADATA as operation', function() {
+      expect(getMetadataRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.GET_METADATA);
+    });
+
+    it('with correct file system id', function() {
+      expect(getMetadataRequest[unpacker.request.Key.FILE_SYSTEM_ID])
+          .to.equal(FILE_SYSTEM_ID);
+    });
+
+    it('with correct path', function() {
+      expect(getMetadataRequest[unpacker.request.Key.PATH])
+          .to.equal('/dir/file');
+    });
+  });
+
   describe('request.createOpenFileRequest should create a request', function() {
     var openFileRequest;
     beforeEach(function() {
@@ -213,6 +315,87 @@ describe('On calling', function() {
     });
   });
 
+  describe('request.createOpenFileByPathRequest should create a request',
+           function() {
+    var openFileByPathRequest;
+    beforeEach(function() {
+      openFileByPathRequest = unpacker.request.createOpenFileByPathRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, '/dir/file', ENCODING, ARCHIVE_SIZE);
+    });
+
+    it('with OPEN_FILE_BY_PATH as operation', function() {
+      expect(openFileByPathRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.OPEN_FILE_BY_PATH);
+    });
+
+    it('with correct request id', function() {
+      expect(openFileByPathRequest[unpacker.request.Key.REQUEST_ID])
+          .to.equal(REQUEST_ID.toString());
+    });
+
+    it('with correct path', function() {
+      expect(openFileByPathRequest[unpacker.request.Key.PATH])
+          .to.equal('/dir/file');
+    });
+
+    it('with correct encoding', function() {
+      expect(openFileByPathRequest[unpacker.request.Key.ENCODING])
+          .to.equal(ENCODING);
+    });
+
+    it('with correct archive size', function() {
+      expect(openFileByPathRequest[unpacker.request.Key.ARCHIVE_SIZE])
+          .to.equal(ARCHIVE_SIZE.toString());
+    });
+  });
+
+  describe('request.createOpenFilesRequest should create a request',
+           function() {
+    var openFilesRequest;
+    beforeEach(function() {
+      openFilesRequest = unpacker.request.createOpenFilesRequest(
+          FILE_SYSTEM_ID, [REQUEST_ID, REQUEST_ID + 1], [7, 3], ENCODING,
+          ARCHIVE_SIZE);
+    });
+
+    it('with OPEN_FILES as operation', function() {
+      expect(openFilesRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.OPEN_FILES);
+    });
+
+    it('with the first open request id as request id', function() {
+      expect(openFilesRequest[unpacker.request.Key.REQUEST_ID])
+          .to.equal(REQUEST_ID.toString());
+    });
+
+    it('with the open request ids and the indices as strings', function() {
+      expect(openFilesRequest[unpacker.request.Key.REQUEST_IDS])
+          .to.deep.equal([REQUEST_ID.toString(), (REQUEST_ID + 1).toString()]);
+      expect(openFilesRequest[unpacker.request.Key.INDICES])
+          .to.deep.equal(['7', '3']);
+    });
+  });
+
+  describe('request.createExtractRequest should create a request', function() {
+    it('with EXTRACT as operation and the indices as strings', function() {
+      var extractRequest = unpacker.request.createExtractRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, [1, 3], ENCODING, ARCHIVE_SIZE);
+      expect(extractRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.EXTRACT);
+      expect(extractRequest[unpacker.request.Key.INDICES])
+          .to.deep.equal(['1', '3']);
+      expect(extractRequest[unpacker.request.Key.ENCODING]).to.equal(ENCODING);
+      expect(extractRequest[unpacker.request.Key.ARCHIVE_SIZE])
+          .to.equal(ARCHIVE_SIZE.toString());
+    });
+
+    it('without indices for all of the entries', function() {
+      var extractRequest = unpacker.request.createExtractRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, null, ENCODING, ARCHIVE_SIZE);
+      expect(extractRequest[unpacker.request.Key.INDICES]).to.be.undefined;
+    });
+  });
+
   describe('request.createCloseFileRequest should create a request',
       function() {
     var closeFileRequest;
@@ -279,4 +462,120 @@ describe('On calling', function() {
           .to.equal(LENGTH.toString());
     });
   });
+
+  describe('request.createCreateArchiveRequest should create a request',
+      function() {
+    it('with CREATE_ARCHIVE as operation and the format and filter',
+        function() {
+      var createArchiveRequest = unpacker.request.createCreateArchiveRequest(
+          1, unpacker.request.PackFormat.TAR,
+          unpacker.request.PackFilter.ZSTD);
+      expect(createArchiveRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.CREATE_ARCHIVE);
+      expect(createArchiveRequest[unpacker.request.Key.COMPRESSOR_ID])
+          .to.equal(1);
+      expect(createArchiveRequest[unpacker.request.Key.PACK_FORMAT])
+          .to.equal(unpacker.request.PackFormat.TAR);
+      expect(createArchiveRequest[unpacker.request.Key.PACK_FILTER])
+          .to.equal(unpacker.request.PackFilter.ZSTD);
+    });
+
+    it('with the level and the libarchive options', function() {
+      var createArchiveRequest = unpacker.request.createCreateArchiveRequest(
+          1, unpacker.request.PackFormat.TAR,
+          unpacker.request.PackFilter.DEFLATE, 9, 'gzip:!timestamp');
+      expect(createArchiveRequest[unpacker.request.Key.PACK_LEVEL])
+          .to.equal(9);
+      expect(createArchiveRequest[unpacker.request.Key.PACK_OPTIONS])
+          .to.equal('gzip:!timestamp');
+    });
+
+    it('with the store ratio', function() {
+      var createArchiveRequest = unpacker.request.createCreateArchiveRequest(
+          1, unpacker.request.PackFormat.ZIP,
+          unpacker.request.PackFilter.DEFAULT, undefined, undefined, 0.9);
+      expect(createArchiveRequest[unpacker.request.Key.PACK_STORE_RATIO])
+          .to.equal(0.9);
+      expect(createArchiveRequest[unpacker.request.Key.PACK_LEVEL])
+          .to.be.undefined;
+    });
+
+    it('without the format and filter for the defaults', function() {
+      var createArchiveRequest =
+          unpacker.request.createCreateArchiveRequest(1);
+      expect(createArchiveRequest[unpacker.request.Key.PACK_FORMAT])
+          .to.be.undefined;
+      expect(createArchiveRequest[unpacker.request.Key.PACK_FILTER])
+          .to.be.undefined;
+      expect(createArchiveRequest[unpacker.request.Key.PACK_LEVEL])
+          .to.be.undefined;
+      expect(createArchiveRequest[unpacker.request.Key.PACK_OPTIONS])
+          .to.be.undefined;
+      expect(createArchiveRequest[unpacker.request.Key.PACK_STORE_RATIO])
+          .to.be.undefined;
+    });
+  });
+
+  describe('request.createAddToArchiveRequest should create a request',
+      function() {
+    it('with the level of the entry if set', function() {
+      var addToArchiveRequest = unpacker.request.createAddToArchiveRequest(
+          1, 2, 'dir/file', 100, '01/01/2017 00:00:00', false, 0);
+      expect(addToArchiveRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.ADD_TO_ARCHIVE);
+      expect(addToArchiveRequest[unpacker.request.Key.PACK_LEVEL]).to.equal(0);
+    });
+
+    it('without the level of the entry if not set', function() {
+      var addToArchiveRequest = unpacker.request.createAddToArchiveRequest(
+          1, 2, 'dir/file', 100, '01/01/2017 00:00:00', false);
+      expect(addToArchiveRequest[unpacker.request.Key.PACK_LEVEL])
+          .to.be.undefined;
+      expect(addToArchiveRequest[unpacker.request.Key.FILE_CONTENTS])
+          .to.be.undefined;
+    });
+
+    it('with the contents of the file if set', function() {
+      var contents = new ArrayBuffer(100);
+      var addToArchiveRequest = unpacker.request.createAddToArchiveRequest(
+          1, 2, 'dir/file', 100, '01/01/2017 00:00:00', false, undefined,
+          contents);
+      expect(addToArchiveRequest[unpacker.request.Key.FILE_CONTENTS])
+          .to.equal(contents);
+      expect(addToArchiveRequest[unpacker.request.Key.PACK_LEVEL])
+          .to.be.undefined;
+    });
+  });
+
+  describe('request.createAddToArchiveBatchRequest should create a request',
+      function() {
+    var entries = [
+      unpacker.request.createAddToArchiveRequest(
+          1, 2, 'dir', 0, '01/01/2017 00:00:00', true),
+      unpacker.request.createAddToArchiveRequest(
+          1, 3, 'dir/file', 3, '01/01/2017 00:00:00', false, undefined,
+          new ArrayBuffer(3))
+    ];
+    var addToArchiveBatchRequest;
+
+    beforeEach(function() {
+      addToArchiveBatchRequest =
+          unpacker.request.createAddToArchiveBatchRequest(1, entries);
+    });
+
+    it('with ADD_TO_ARCHIVE_BATCH as operation', function() {
+      expect(addToArchiveBatchRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.ADD_TO_ARCHIVE_BATCH);
+    });
+
+    it('with correct compressor id', function() {
+      expect(addToArchiveBatchRequest[unpacker.request.Key.COMPRESSOR_ID])
+          .to.equal(1);
+    });
+
+    it('with the entries in order', function() {
+      expect(addToArchiveBatchRequest[unpacker.request.Key.ENTRIES])
+          .to.equal(entries);
+    });
+  });
 });
@@ -84,6 +84,45 @@ describe('Volume', function() {
    */
   var INDEX = 0;
 
+  /**
+   * Encodes records in the format of unpacker.request.MetadataFormat.BINARY.
+   * Every record is [parent, name, isDirectory, index, size, mtime].
+   * @param {!Array<!Array>} records
+   * @param {number=} opt_firstRecord The number of the first record.
+   * @return {!ArrayBuffer}
+   */
+  var encodeBinaryMetadata = function(records, opt_firstRecord) {
+    var names = records.map(function(record) {
+      return new TextEncoder().encode(record[1]);
+    });
+    var stringTableOffset = 20 + records.length * 40;
+    var stringTableSize = names.reduce(function(size, name) {
+      return size + name.length;
+    }, 0);
+    var buffer = new ArrayBuffer(stringTableOffset + stringTableSize);
+    var view = new DataView(buffer);
+    view.setUint32(0, 1, true);
+    view.setUint32(4, records.length, true);
+    view.setUint32(8, stringTableOffset, true);
+    view.setUint32(12, stringTableSize, true);
+    view.setUint32(16, opt_firstRecord || 0, true);
+
+    var nameOffset = 0;
+    records.forEach(function(record, i) {
+      var offset = 20 + i * 40;
+      view.setUint32(offset, record[0], true);
+      view.setUint32(offset + 4, nameOffset, true);
+      view.setUint32(offset + 8, names[i].length, true);
+      view.setUint32(offset + 12, record[2] ? 1 : 0, true);
+      view.setFloat64(offset + 16, record[3], true);
+      view.setFloat64(offset + 24, record[4], true);
+      view.setFloat64(offset + 32, record[5], true);
+      new Uint8Array(buffer, stringTableOffset + nameOffset).set(names[i]);
+      nameOffset += names[i].length;
+    });
+    return buffer;
+  };
+
   var volume;
   var decompressor;
   var onInitializeSuccessSpy;
@@ -93,6 +132,10 @@ describe('Volume', function() {
     volume = null;
     decompressor = {
       readMetadata: sinon.stub(),
+      readDirectory: sinon.stub(),
+      getMetadata: sinon.stub(),
+      getArchiveSize: sinon.stub().returns(1000),
+      getArchive: sinon.stub().returns(new Blob([])),
       openFile: sinon.stub(),
       closeFile: sinon.stub(),
       readFile: sinon.stub()
@@ -132,6 +175,382 @@ describe('Volume', function() {
     });
   });
 
+  // Test opening a file by path before initialize.
+  describe('that opens a file by path before initialize', function() {
+    var options;
+    var onSuccessSpy;
+    var onErrorSpy;
+    beforeEach(function() {
+      decompressor.openFileByPath = sinon.stub();
+      onSuccessSpy = sinon.spy();
+      onErrorSpy = sinon.spy();
+      options = {
+        mode: 'READ',
+        requestId: OPEN_REQUEST_ID,
+        filePath: '/dir/file'
+      };
+    });
+
+    describe('that succeeds', function() {
+      beforeEach(function() {
+        decompressor.openFileByPath.withArgs(
+            options.requestId, options.filePath, volume.encoding)
+            .callsArgWith(3, {index: 2, size: 10});
+        volume.openFileByPath(options, onSuccessSpy, onErrorSpy);
+      });
+
+      it('should call onSuccess', function() {
+        expect(onSuccessSpy.calledOnce).to.be.true;
+        expect(onErrorSpy.called).to.be.false;
+      });
+
+      it('should add open operation options to openedFiles', function() {
+        expect(volume.openedFiles[options.requestId]).to.equal(options);
+      });
+
+      it('should limit reads to the size of the file', function() {
+        var readSuccessSpy = sinon.spy();
+        volume.onReadFileRequested({
+          requestId: READ_REQUEST_ID,
+          openRequestId: OPEN_REQUEST_ID,
+          offset: 10,
+          length: 5
+        }, readSuccessSpy, sinon.spy());
+        expect(readSuccessSpy.calledWith(new ArrayBuffer(0), false)).to.be
+            .true;
+        expect(decompressor.readFile.called).to.be.false;
+      });
+    });
+
+    describe('that fails', function() {
+      beforeEach(function() {
+        decompressor.openFileByPath.callsArgWith(4, 'NOT_FOUND');
+        volume.openFileByPath(options, onSuccessSpy, onErrorSpy);
+      });
+
+      it('should call onError with the error', function() {
+        expect(onErrorSpy.calledWith('NOT_FOUND')).to.be.true;
+      });
+
+      it('should not add the file to openedFiles', function() {
+        expect(volume.openedFiles[options.requestId]).to.be.undefined;
+      });
+    });
+  });
+
+  // Test extracting entries.
+  describe('that extracts entries', function() {
+    beforeEach(function() {
+      decompressor.extract = sinon.stub();
+    });
+
+    it('should pass the request to the decompressor', function() {
+      var onDataSpy = sinon.spy();
+      var onSuccessSpy = sinon.spy();
+      var onErrorSpy = sinon.spy();
+      volume.extract(READ_REQUEST_ID, [1, 2], onDataSpy, onSuccessSpy,
+                     onErrorSpy);
+      expect(decompressor.extract.calledWith(
+          READ_REQUEST_ID, [1, 2], volume.encoding, onDataSpy, onSuccessSpy,
+          onErrorSpy)).to.be.true;
+    });
+
+    it('should not call the decompressor without indices', function() {
+      var onSuccessSpy = sinon.spy();
+      volume.extract(READ_REQUEST_ID, [], sinon.spy(), onSuccessSpy,
+                     sinon.spy());
+      expect(decompressor.extract.called).to.be.false;
+      expect(onSuccessSpy.calledOnce).to.be.true;
+    });
+  });
+
+  // Test volume that receives the metadata in the binary format.
+  describe('that initializes with binary metadata', function() {
+    beforeEach(function() {
+      decompressor.readMetadata.callsArgWith(2, encodeBinaryMetadata([
+        [0xffffffff, '', true, -1, 0, 3000],
+        [0, 'file', false, 0, 50, 20000],
+        [0, 'dir', true, -1, 0, 12000],
+        [2, 'insideFile', false, 1, 45, 200]
+      ]));
+      volume.initialize(onInitializeSuccessSpy, onInitializeErrorSpy);
+    });
+
+    it('should request the binary format', function() {
+      expect(decompressor.readMetadata.firstCall.args[4])
+          .to.equal(unpacker.request.MetadataFormat.BINARY);
+    });
+
+    it('should call onSuccess for volume.initialize', function() {
+      expect(onInitializeSuccessSpy.calledOnce).to.be.true;
+    });
+
+    it('should decode the root directory', function() {
+      expect(volume.metadata.isDirectory).to.be.true;
+      expect(volume.metadata.index).to.equal(-1);
+      expect(Object.keys(volume.metadata.entries)).to.deep.equal(
+          ['file', 'dir']);
+    });
+
+    it('should decode a file entry', function() {
+      var entry = volume.metadata.entries['file'];
+      expect(entry.name).to.equal('file');
+      expect(entry.isDirectory).to.be.false;
+      expect(entry.index).to.equal(0);
+      expect(entry.size).to.equal(50);
+      expect(entry.modificationTime.getTime()).to.equal(20000 * 1000);
+      expect(entry.entries).to.be.undefined;
+    });
+
+    it('should decode a nested entry', function() {
+      var entry = volume.metadata.entries['dir'].entries['insideFile'];
+      expect(entry.name).to.equal('insideFile');
+      expect(entry.index).to.equal(1);
+      expect(entry.size).to.equal(45);
+    });
+  });
+
+  // Test volume with a metadata cache.
+  describe('that initializes with a metadata cache', function() {
+    var RECORD = new ArrayBuffer(8);
+    var NEW_RECORD = new ArrayBuffer(16);
+    var metadataCache;
+    var getFingerprintStub;
+
+    beforeEach(function() {
+      getFingerprintStub =
+          sinon.stub(unpacker.MetadataCache, 'getFingerprint');
+      getFingerprintStub.returns(Promise.resolve('fingerprint'));
+      metadataCache = {get: sinon.stub(), put: sinon.spy()};
+      volume = new unpacker.Volume(decompressor, ENTRY,
+                                   /** @type {!unpacker.MetadataCache} */ (
+                                       metadataCache));
+    });
+
+    afterEach(function() {
+      getFingerprintStub.restore();
+    });
+
+    it('should pass the cached record to NaCl', function(done) {
+      metadataCache.get.returns(Promise.resolve(RECORD));
+      decompressor.readMetadata = function() {
+        var args = Array.prototype.slice.call(arguments);
+        expect(metadataCache.get.calledWith('fingerprint')).to.be.true;
+        expect(args[6]).to.equal(RECORD);
+        args[2](METADATA);
+        expect(metadataCache.put.called).to.be.false;
+        expect(volume.isReady()).to.be.true;
+        done();
+      };
+      volume.initialize(onInitializeSuccessSpy, onInitializeErrorSpy);
+    });
+
+    it('should store a new record', function(done) {
+      metadataCache.get.returns(Promise.resolve(null));
+      decompressor.readMetadata = function() {
+        var args = Array.prototype.slice.call(arguments);
+        expect(args[6]).to.be.null;
+        args[2](METADATA, NEW_RECORD);
+        expect(metadataCache.put.calledWith('fingerprint', NEW_RECORD))
+            .to.be.true;
+        done();
+      };
+      volume.initialize(onInitializeSuccessSpy, onInitializeErrorSpy);
+    });
+
+    it('should read the metadata if fingerprinting fails', function(done) {
+      getFingerprintStub.returns(Promise.reject('FAILED'));
+      decompressor.readMetadata = function() {
+        var args = Array.prototype.slice.call(arguments);
+        expect(args[6]).to.be.undefined;
+        args[2](METADATA, NEW_RECORD);
+        expect(metadataCache.put.called).to.be.false;
+        done();
+      };
+      volume.initialize(onInitializeSuccessSpy, onInitializeErrorSpy);
+    });
+  });
+
+  // Test volume of a big archive, which metadata is kept by NaCl.
+  describe('that initializes with lazy metadata', function() {
+    var onSuccessSpy;
+    var onErrorSpy;
+    beforeEach(function() {
+      decompressor.getArchiveSize.returns(
+          unpacker.Volume.LAZY_METADATA_MINIMUM_ARCHIVE_SIZE);
+      decompressor.readMetadata.callsArgWith(2, {
+        index: '-1',
+        name: '',
+        size: '0',
+        isDirectory: true,
+        modificationTime: '3000'
+      });
+      volume.initialize(onInitializeSuccessSpy, onInitializeErrorSpy);
+      onSuccessSpy = sinon.spy();
+      onErrorSpy = sinon.spy();
+    });
+
+    it('should request the lazy format', function() {
+      expect(decompressor.readMetadata.firstCall.args[4])
+          .to.equal(unpacker.request.MetadataFormat.LAZY);
+    });
+
+    it('should be ready to use', function() {
+      expect(onInitializeSuccessSpy.calledOnce).to.be.true;
+      expect(volume.isReady()).to.be.true;
+      expect(volume.metadata.modificationTime.getTime())
+          .to.equal(3000 * 1000);
+    });
+
+    it('should read directories from NaCl', function() {
+      decompressor.readDirectory.callsArgWith(2, [
+        {index: '0', name: 'file', size: '50', isDirectory: false,
+         modificationTime: '20000'}
+      ]);
+      volume.onReadDirectoryRequested(
+          {requestId: METADATA_REQUEST_ID, directoryPath: '/'}, onSuccessSpy,
+          onErrorSpy);
+      expect(decompressor.readDirectory.firstCall.args[0])
+          .to.equal(METADATA_REQUEST_ID);
+      expect(decompressor.readDirectory.firstCall.args[1]).to.equal('/');
+      expect(onSuccessSpy.calledOnce).to.be.true;
+      var entries = onSuccessSpy.firstCall.args[0];
+      expect(entries[0].size).to.equal(50);
+      expect(entries[0].modificationTime.getTime()).to.equal(20000 * 1000);
+      expect(onSuccessSpy.firstCall.args[1]).to.be.false;
+    });
+
+    it('should get the metadata of entries from NaCl', function() {
+      decompressor.getMetadata.callsArgWith(3, 'NOT_FOUND');
+      volume.onGetMetadataRequested(
+          {requestId: METADATA_REQUEST_ID, entryPath: '/invalid'},
+          onSuccessSpy, onErrorSpy);
+      expect(decompressor.getMetadata.firstCall.args[1]).to.equal('/invalid');
+      expect(onSuccessSpy.called).to.be.false;
+      expect(onErrorSpy.calledWith('NOT_FOUND')).to.be.true;
+    });
+
+    it('should open and read files with the size from NaCl', function() {
+      decompressor.getMetadata.callsArgWith(2, {
+        index: '0', name: 'file', size: '50', isDirectory: false,
+        modificationTime: '20000'
+      });
+      decompressor.openFile.callsArg(3);
+      volume.onOpenFileRequested(
+          {mode: 'READ', requestId: OPEN_REQUEST_ID, filePath: '/file'},
+          onSuccessSpy, onErrorSpy);
+      expect(decompressor.openFile.firstCall.args[1]).to.equal(0);
+      expect(onSuccessSpy.calledOnce).to.be.true;
+
+      var onReadSuccessSpy = sinon.spy();
+      volume.onReadFileRequested(
+          {requestId: READ_REQUEST_ID, openRequestId: OPEN_REQUEST_ID,
+           offset: 50, length: 10},
+          onReadSuccessSpy, onErrorSpy);
+      expect(decompressor.readFile.called).to.be.false;
+      expect(onReadSuccessSpy.calledOnce).to.be.true;
+      expect(onReadSuccessSpy.firstCall.args[1]).to.be.false;
+    });
+  });
+
+  // Test volume that receives the metadata in batches.
+  describe('that receives metadata in batches', function() {
+    var onProgressSpy;
+    var onProgress;
+    var onDone;
+
+    beforeEach(function() {
+      onProgressSpy = sinon.spy();
+      volume.initialize(onInitializeSuccessSpy, onInitializeErrorSpy,
+                        onProgressSpy);
+      onDone = decompressor.readMetadata.firstCall.args[2];
+      onProgress = decompressor.readMetadata.firstCall.args[5];
+      onProgress(encodeBinaryMetadata([
+        [0xffffffff, '', true, -1, 0, 3000],
+        [0, 'dir', true, -1, 0, 12000]
+      ]));
+    });
+
+    it('should be ready to use after the first batch', function() {
+      expect(onProgressSpy.calledOnce).to.be.true;
+      expect(onInitializeSuccessSpy.called).to.be.false;
+      expect(volume.isReady()).to.be.true;
+    });
+
+    it('should link a batch to the entries of previous batches', function() {
+      onProgress(encodeBinaryMetadata([
+        [1, 'insideFile', false, 0, 45, 200]
+      ], 2));
+      expect(volume.metadata.entries['dir'].entries['insideFile'].size)
+          .to.equal(45);
+    });
+
+    it('should send directory entries as they are read', function() {
+      var onSuccessSpy = sinon.spy();
+      var onErrorSpy = sinon.spy();
+      volume.onReadDirectoryRequested(
+          {directoryPath: '/'}, onSuccessSpy, onErrorSpy);
+      expect(onSuccessSpy.calledOnce).to.be.true;
+      expect(onSuccessSpy.firstCall.args[0].length).to.equal(1);
+      expect(onSuccessSpy.firstCall.args[1]).to.be.true;
+
+      onProgress(encodeBinaryMetadata([
+        [0, 'file', false, 0, 50, 20000]
+      ], 2));
+      expect(onSuccessSpy.calledTwice).to.be.true;
+      expect(onSuccessSpy.secondCall.args[0][0].name).to.equal('file');
+      expect(onSuccessSpy.secondCall.args[1]).to.be.true;
+
+      onDone(encodeBinaryMetadata([
+        [0xffffffff, '', true, -1, 0, 3000],
+        [0, 'dir', true, -1, 0, 12000],
+        [0, 'file', false, 0, 50, 20000]
+      ]));
+      expect(onSuccessSpy.calledThrice).to.be.true;
+      expect(onSuccessSpy.thirdCall.args[0].length).to.equal(0);
+      expect(onSuccessSpy.thirdCall.args[1]).to.be.false;
+      expect(onErrorSpy.called).to.be.false;
+    });
+
+    it('should answer requests for entries once they are read', function() {
+      var onSuccessSpy = sinon.spy();
+      var onErrorSpy = sinon.spy();
+      volume.onGetMetadataRequested(
+          {entryPath: '/file'}, onSuccessSpy, onErrorSpy);
+      expect(onSuccessSpy.called).to.be.false;
+
+      onProgress(encodeBinaryMetadata([
+        [0, 'file', false, 0, 50, 20000]
+      ], 2));
+      expect(onSuccessSpy.calledOnce).to.be.true;
+      expect(onSuccessSpy.firstCall.args[0].name).to.equal('file');
+      expect(onErrorSpy.called).to.be.false;
+    });
+
+    it('should not find missing entries once all are read', function() {
+      var onSuccessSpy = sinon.spy();
+      var onErrorSpy = sinon.spy();
+      volume.onGetMetadataRequested(
+          {entryPath: '/missing'}, onSuccessSpy, onErrorSpy);
+      onDone(encodeBinaryMetadata([
+        [0xffffffff, '', true, -1, 0, 3000]
+      ]));
+      expect(onInitializeSuccessSpy.calledOnce).to.be.true;
+      expect(onSuccessSpy.called).to.be.false;
+      expect(onErrorSpy.calledWith('NOT_FOUND')).to.be.true;
+    });
+
+    it('should fail pending requests if reading fails', function() {
+      var onSuccessSpy = sinon.spy();
+      var onErrorSpy = sinon.spy();
+      volume.onGetMetadataRequested(
+          {entryPath: '/missing'}, onSuccessSpy, onErrorSpy);
+      decompressor.readMetadata.firstCall.args[3]('FAILED');
+      expect(onInitializeErrorSpy.calledOnce).to.be.true;
+      expect(onErrorSpy.calledWith('FAILED')).to.be.true;
+    });
+  });
+
   // Test volume that initializes correctly.
   describe('that correctly initializes', function() {
     beforeEach(function() {
@@ -379,6 +798,35 @@ describe('Volume', function() {
         });
       });
 
+      // Files requested while another file is being opened.
+      describe('while another file is being opened', function() {
+        beforeEach(function() {
+          decompressor.openFiles = sinon.stub();
+          [OPEN_REQUEST_ID, OPEN_REQUEST_ID + 10, OPEN_REQUEST_ID + 11]
+              .forEach(function(requestId) {
+                volume.onOpenFileRequested(
+                    {mode: 'READ', requestId: requestId, filePath: '/file'},
+                    onSuccessSpy, onErrorSpy);
+              });
+        });
+
+        it('should open the first file right away', function() {
+          expect(decompressor.openFile.calledOnce).to.be.true;
+          expect(decompressor.openFiles.called).to.be.false;
+        });
+
+        it('should open the other files together once it is opened',
+           function() {
+             decompressor.openFile.firstCall.args[3]();
+             expect(onSuccessSpy.calledOnce).to.be.true;
+             expect(decompressor.openFiles.calledOnce).to.be.true;
+             var files = decompressor.openFiles.firstCall.args[0];
+             expect(files.length).to.equal(2);
+             expect(files[0].requestId).to.equal(OPEN_REQUEST_ID + 10);
+             expect(files[1].index).to.equal(INDEX);
+           });
+      });
+
       // Valid open file options.
       describe('with valid options', function() {
         var options;
@@ -58,6 +58,12 @@ module.exports = function(config) {
         included: true,
         served: true
       },
+      {
+        pattern: 'js/metadata-cache.js',
+        watched: true,
+        included: true,
+        served: true
+      },
       {
         pattern: 'js/passphrase-manager.js',
         watched: true,
@@ -0,0 +1,126 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "compressibility.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "zlib.h"
+
+namespace {
+
+// The extensions of compressed formats, in lower case.
+const char* const kCompressedExtensions[] = {
+    // Images.
+    "jpg", "jpeg", "png", "gif", "webp", "heic", "heif", "avif", "jxl",
+    // Audio and video.
+    "mp3", "aac", "m4a", "ogg", "oga", "opus", "flac", "mp4", "m4v", "mov",
+    "mkv", "webm", "avi", "3gp",
+    // Archives and compressed files.
+    "zip", "gz", "tgz", "bz2", "tbz2", "xz", "txz", "zst", "lz4", "lzma",
+    "7z", "rar", "cab", "jar", "apk", "crx",
+    // Documents that are ZIP archives.
+    "docx", "xlsx", "pptx", "odt", "ods", "odp", "epub"};
+
+// The signature of a compressed format at the given offset.
+struct Signature {
+  size_t offset;
+  size_t size;
+  const char* bytes;
+};
+
+const Signature kCompressedSignatures[] = {
+    {0, 3, "\xff\xd8\xff"},                      // JPEG.
+    {0, 8, "\x89PNG\r\n\x1a\n"},                 // PNG.
+    {0, 4, "GIF8"},                              // GIF.
+    {8, 4, "WEBP"},                              // WebP.
+    {4, 4, "ftyp"},                              // MP4, MOV, HEIC.
+    {0, 4, "\x1a\x45\xdf\xa3"},                  // Matroska, WebM.
+    {0, 4, "OggS"},                              // Ogg.
+    {0, 4, "fLaC"},                              // FLAC.
+    {0, 3, "ID3"},                               // MP3.
+    {0, 4, "PK\x03\x04"},                        // ZIP.
+    {0, 2, "\x1f\x8b"},                          // Gzip.
+    {0, 3, "BZh"},                               // Bzip2.
+    {0, 6, "\xfd\x37\x7a\x58\x5a\x00"},          // XZ.
+    {0, 4, "\x28\xb5\x2f\xfd"},                  // Zstandard.
+    {0, 4, "\x04\x22\x4d\x18"},                  // LZ4.
+    {0, 6, "\x37\x7a\xbc\xaf\x27\x1c"},          // 7z.
+    {0, 4, "Rar!"}};                             // RAR.
+
+}  // namespace
+
+namespace compressibility {
+
+bool HasCompressedExtension(const std::string& filename) {
+  size_t dot = filename.rfind('.');
+  if (dot == std::string::npos || filename.find('/', dot) != std::string::npos)
+    return false;
+
+  std::string extension = filename.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 ::tolower);
+  for (size_t i = 0;
+       i < sizeof(kCompressedExtensions) / sizeof(kCompressedExtensions[0]);
+       ++i) {
+    if (extension == kCompressedExtensions[i])
+      return true;
+  }
+  return false;
+}
+
+bool HasCompressedSignature(const char* data, int64_t size) {
+  for (size_t i = 0;
+       i < sizeof(kCompressedSignatures) / sizeof(kCompressedSignatures[0]);
+       ++i) {
+    const Signature& signature = kCompressedSignatures[i];
+    if (static_cast<size_t>(size) >= signature.offset + signature.size &&
+        memcmp(data + signature.offset, signature.bytes, signature.size) ==
+            0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+double EstimateRatio(const char* data, int64_t size) {
+  uLong sample_size = static_cast<uLong>(
+      std::min(size, compressibility_constants::kSampleSize));
+  if (sample_size == 0)
+    return 1;
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return 1;
+  }
+  std::string output(deflateBound(&stream, sample_size), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream.avail_in = sample_size;
+  stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+  stream.avail_out = output.size();
+  int result = deflate(&stream, Z_FINISH);
+  uLong deflated_size = stream.total_out;
+  deflateEnd(&stream);
+  if (result != Z_STREAM_END)
+    return 1;
+  return static_cast<double>(deflated_size) / sample_size;
+}
+
+bool ShouldStore(const std::string& filename,
+                 const char* data,
+                 int64_t size,
+                 double store_ratio) {
+  if (store_ratio <= 0)
+    return false;
+  // The name and the signature are checked first, as they are cheaper.
+  return HasCompressedExtension(filename) ||
+         HasCompressedSignature(data, size) ||
+         EstimateRatio(data, size) >= store_ratio;
+}
+
+}  // namespace compressibility
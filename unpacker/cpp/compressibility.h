@@ -0,0 +1,49 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef COMPRESSIBILITY_H_
+#define COMPRESSIBILITY_H_
+
+#include <stdint.h>
+
+#include <string>
+
+// A namespace with constants used by compressibility.
+namespace compressibility_constants {
+// The number of bytes at the start of an entry that are deflated by
+// EstimateRatio.
+const int64_t kSampleSize = 64 * 1024;  // 64 KB.
+// Entries whose sample doesn't deflate below this ratio of its size are
+// stored by default, as deflating them would save less than 5%.
+const double kDefaultStoreRatio = 0.95;
+}  // namespace compressibility_constants
+
+// Decides whether an entry is worth deflating from its name and the start of
+// its data, so already compressed files like photos, videos or archives are
+// stored instead of burning CPU for nothing.
+namespace compressibility {
+
+// Returns true if filename has the extension of a compressed format.
+bool HasCompressedExtension(const std::string& filename);
+
+// Returns true if data starts with the signature of a compressed format.
+bool HasCompressedSignature(const char* data, int64_t size);
+
+// Deflates the first kSampleSize bytes of data with the fastest level and
+// returns the ratio of the deflated size to the sampled size, or 1 if there is
+// no data.
+double EstimateRatio(const char* data, int64_t size);
+
+// Returns true if the entry named filename that starts with data should be
+// stored: if its extension or its signature is the one of a compressed
+// format, or if its sample doesn't deflate below store_ratio. Entries are
+// never stored if store_ratio is not positive.
+bool ShouldStore(const std::string& filename,
+                 const char* data,
+                 int64_t size,
+                 double store_ratio);
+
+}  // namespace compressibility
+
+#endif  // COMPRESSIBILITY_H_
@@ -8,9 +8,12 @@
 #include <ctime>
 #include <sstream>
 
+#include "ppapi/cpp/var_array.h"
+
 #include "request.h"
 #include "compressor_io_javascript_stream.h"
 #include "compressor_archive_libarchive.h"
+#include "compressor_archive_zip.h"
 
 namespace {
 
@@ -26,9 +29,9 @@ class JavaScriptCompressorRequestor : public JavaScriptCompressorRequestorInterf
         compressor_->compressor_id(), buffer, length);
   }
 
-  virtual void ReadFileChunkRequest(int64_t length) {
+  virtual void ReadFileChunkRequest(int entry_id, int64_t length) {
     compressor_->message_sender()->SendReadFileChunk(
-        compressor_->compressor_id(), length);
+        compressor_->compressor_id(), entry_id, length);
   }
 
  private:
@@ -37,43 +40,105 @@ class JavaScriptCompressorRequestor : public JavaScriptCompressorRequestorInterf
 
 }  // namespace
 
-Compressor::Compressor(const pp::InstanceHandle& instance_handle,
+Compressor::Compressor(WorkerPool* worker_pool,
                        int compressor_id,
                        JavaScriptMessageSenderInterface* message_sender)
     : compressor_id_(compressor_id),
       message_sender_(message_sender),
-      worker_(instance_handle),
-      callback_factory_(this) {
+      worker_pool_(worker_pool),
+      job_queue_(worker_pool),
+      callback_factory_(this),
+      compressor_archive_(NULL),
+      aborted_(false) {
   requestor_ = new JavaScriptCompressorRequestor(this);
   compressor_stream_ =
       new CompressorIOJavaScriptStream(requestor_);
-  compressor_archive_ =
-      new CompressorArchiveLibarchive(compressor_stream_);
+  pthread_mutex_init(&aborted_lock_, NULL);
 }
 
 Compressor::~Compressor() {
-  worker_.Join();
+  job_queue_.Join();
   delete compressor_archive_;
   delete compressor_stream_;
   delete requestor_;
+  pthread_mutex_destroy(&aborted_lock_);
 }
 
 bool Compressor::Init() {
-  return worker_.Start();
+  return worker_pool_->Start();
 }
 
-void Compressor::CreateArchive() {
-  compressor_archive_->CreateArchive();
+void Compressor::CreateArchive(request::PackFormat format,
+                               request::PackFilter filter,
+                               int compression_level,
+                               const std::string& options,
+                               double store_ratio) {
+  // ZIP archives are written without libarchive when possible, so that the
+  // entries are deflated in parallel.
+  PP_DCHECK(!compressor_archive_);
+  if (CompressorArchiveZip::IsSupported(format, filter, options)) {
+    compressor_archive_ = new CompressorArchiveZip(
+        compressor_stream_, worker_pool_, store_ratio);
+  } else {
+    compressor_archive_ = new CompressorArchiveLibarchive(compressor_stream_);
+  }
+  if (!compressor_archive_->CreateArchive(
+          format, filter, compression_level, options)) {
+    message_sender_->SendCompressorError(
+        compressor_id_, "Unsupported archive format, filter or options.");
+    return;
+  }
   message_sender_->SendCreateArchiveDone(compressor_id_);
 }
 
 void Compressor::AddToArchive(const pp::VarDictionary& dictionary) {
-  worker_.message_loop().PostWork(callback_factory_.NewCallback(
+  job_queue_.PostWork(callback_factory_.NewCallback(
       &Compressor::AddToArchiveCallback, dictionary));
 }
 
+void Compressor::AddToArchiveBatch(const pp::VarDictionary& dictionary) {
+  job_queue_.PostWork(callback_factory_.NewCallback(
+      &Compressor::AddToArchiveBatchCallback, dictionary));
+}
+
 void Compressor::AddToArchiveCallback(int32_t,
                                       const pp::VarDictionary& dictionary) {
+  if (IsAborted())
+    return;
+
+  int entry_id = 0;
+  if (!AddEntry(dictionary, &entry_id)) {
+    SendAddToArchiveError();
+    return;
+  }
+  message_sender_->SendAddToArchiveDone(compressor_id_, entry_id);
+}
+
+void Compressor::AddToArchiveBatchCallback(
+    int32_t,
+    const pp::VarDictionary& dictionary) {
+  PP_DCHECK(dictionary.Get(request::key::kEntries).is_array());
+  pp::VarArray entries(dictionary.Get(request::key::kEntries));
+  int entry_id = 0;
+  for (uint32_t i = 0; i < entries.GetLength(); ++i) {
+    PP_DCHECK(entries.Get(i).is_dictionary());
+    if (IsAborted())
+      return;
+    // The archive is unusable after a failure, so the rest of the batch is
+    // dropped.
+    if (!AddEntry(pp::VarDictionary(entries.Get(i)), &entry_id)) {
+      SendAddToArchiveError();
+      return;
+    }
+  }
+  message_sender_->SendAddToArchiveDone(compressor_id_, entry_id);
+}
+
+bool Compressor::AddEntry(const pp::VarDictionary& dictionary,
+                          int* entry_id) {
+  PP_DCHECK(dictionary.Get(request::key::kEntryId).is_int());
+  *entry_id = dictionary.Get(request::key::kEntryId).AsInt();
+
   PP_DCHECK(dictionary.Get(request::key::kPathname).is_string());
   std::string pathname =
       dictionary.Get(request::key::kPathname).AsString();
@@ -94,9 +159,31 @@ void Compressor::AddToArchiveCallback(int32_t,
   strptime(strtime.c_str(), "%m/%d/%Y %T", &tm);
   time_t modification_time = mktime(&tm);
 
-  compressor_archive_->AddToArchive(
-      pathname, file_size, modification_time, is_directory);
-  message_sender_->SendAddToArchiveDone(compressor_id_);
+  // The level is optional and overrides the level of the archive.
+  int compression_level =
+      compressor_archive_constants::kDefaultCompressionLevel;
+  pp::Var compression_level_var = dictionary.Get(request::key::kPackLevel);
+  if (!compression_level_var.is_undefined()) {
+    PP_DCHECK(compression_level_var.is_int());
+    compression_level = compression_level_var.AsInt();
+  }
+
+  // The first chunks of the file are requested from JavaScript right away, so
+  // that they are read while the entry is set up. Small files are sent along
+  // with the entry instead.
+  if (!is_directory) {
+    pp::Var contents_var = dictionary.Get(request::key::kFileContents);
+    if (!contents_var.is_undefined()) {
+      PP_DCHECK(contents_var.is_array_buffer());
+      pp::VarArrayBuffer contents(contents_var);
+      PP_DCHECK(static_cast<int64_t>(contents.ByteLength()) == file_size);
+      compressor_stream_->StartEntryWithContents(*entry_id, contents);
+    } else {
+      compressor_stream_->StartEntry(*entry_id, file_size);
+    }
+  }
+  return compressor_archive_->AddToArchive(
+      pathname, file_size, modification_time, is_directory, compression_level);
 }
 
 void Compressor::ReadFileChunkDone(const pp::VarDictionary& dictionary) {
@@ -123,18 +210,38 @@ void Compressor::CloseArchive(const pp::VarDictionary& dictionary) {
   bool has_error =
       dictionary.Get(request::key::kHasError).AsBool();
 
-  // If an error has occurred, no more write chunk requests are sent and
-  // CloseArchive() can be safely called in the main thread.
+  // If an error has occurred, JavaScript doesn't respond to the requests of
+  // the entry being added anymore, so it's made to fail, and the entries
+  // queued after it are dropped. The archive is still used by that entry, so
+  // it's closed on job_queue_ as well.
   if (has_error) {
-    compressor_archive_->CloseArchive(has_error);
-    message_sender_->SendCloseArchiveDone(compressor_id_);
-  } else {
-    worker_.message_loop().PostWork(callback_factory_.NewCallback(
-        &Compressor::CloseArchiveCallback, has_error));
+    pthread_mutex_lock(&aborted_lock_);
+    aborted_ = true;
+    pthread_mutex_unlock(&aborted_lock_);
+    compressor_stream_->Abort();
   }
+  job_queue_.PostWork(callback_factory_.NewCallback(
+      &Compressor::CloseArchiveCallback, has_error));
 }
 
 void Compressor::CloseArchiveCallback(int32_t, bool has_error) {
   compressor_archive_->CloseArchive(has_error);
-  message_sender_->SendCloseArchiveDone(compressor_id_);
+  // The last chunks may still be written by JavaScript. If writing any of them
+  // failed, JavaScript already reported the error.
+  if (has_error || compressor_stream_->Flush())
+    message_sender_->SendCloseArchiveDone(compressor_id_);
+}
+
+void Compressor::SendAddToArchiveError() {
+  if (!IsAborted()) {
+    message_sender_->SendCompressorError(
+        compressor_id_, "Failed to add an entry to the archive.");
+  }
+}
+
+bool Compressor::IsAborted() {
+  pthread_mutex_lock(&aborted_lock_);
+  bool aborted = aborted_;
+  pthread_mutex_unlock(&aborted_lock_);
+  return aborted;
 }
@@ -9,22 +9,22 @@
 #include <pthread.h>
 
 #include "archive.h"
-#include "ppapi/cpp/instance_handle.h"
 #include "ppapi/cpp/var_array_buffer.h"
 #include "ppapi/cpp/var_dictionary.h"
 #include "ppapi/utility/completion_callback_factory.h"
-#include "ppapi/utility/threading/simple_thread.h"
 
 #include "compressor_archive.h"
 #include "compressor_stream.h"
 #include "javascript_compressor_requestor_interface.h"
 #include "javascript_message_sender_interface.h"
+#include "request.h"
+#include "worker_pool.h"
 
 // Handles all packing operations like creating archive objects and writing data
 // onto the archive.
 class Compressor {
  public:
-  Compressor(const pp::InstanceHandle& instance_handle /* Used for workers. */,
+  Compressor(WorkerPool* worker_pool /* Used for jobs. */,
              int compressor_id,
              JavaScriptMessageSenderInterface* message_sender);
 
@@ -33,19 +33,34 @@ class Compressor {
   // Initializes the compressor.
   bool Init();
 
-  // Creates an archive object.
-  void CreateArchive();
-
-  // Adds an entry to the archive.
+  // Creates an archive object in the given format, compressed with the given
+  // filter, level and libarchive options, see CompressorArchive::CreateArchive.
+  // Entries of ZIP archives that don't deflate below store_ratio are stored,
+  // see compressibility::ShouldStore. Sends an error to JavaScript if the
+  // combination is not supported.
+  void CreateArchive(request::PackFormat format,
+                     request::PackFilter filter,
+                     int compression_level,
+                     const std::string& options,
+                     double store_ratio);
+
+  // Adds an entry to the archive. JavaScript doesn't wait for an entry to be
+  // added before it sends the next ones, they are queued on job_queue_.
   void AddToArchive(const pp::VarDictionary& dictionary);
 
+  // Adds the entries of an ADD_TO_ARCHIVE_BATCH request to the archive, in
+  // order.
+  void AddToArchiveBatch(const pp::VarDictionary& dictionary);
+
   // Processes a file chunk sent from JavaScript.
   void ReadFileChunkDone(const pp::VarDictionary& dictionary);
 
   // Receives a write chunk response from JavaScript.
   void WriteChunkDone(const pp::VarDictionary& dictionary);
 
-  // Releases all resources obtained by libarchive.
+  // Releases all resources obtained by libarchive, once the entries queued on
+  // job_queue_ are added. After an error, JavaScript doesn't respond anymore,
+  // so the entry being added fails and the queued ones are dropped.
   void CloseArchive(const pp::VarDictionary& dictionary);
 
   // A getter function for the message sender.
@@ -62,32 +77,56 @@ class Compressor {
   // A callback helper for AddToArchive.
   void AddToArchiveCallback(int32_t, const pp::VarDictionary& dictionary);
 
+  // A callback helper for AddToArchiveBatch.
+  void AddToArchiveBatchCallback(int32_t, const pp::VarDictionary& dictionary);
+
+  // Adds the entry described by dictionary, with the keys of an
+  // ADD_TO_ARCHIVE request, to the archive and sets entry_id to its id.
+  // Returns false if the entry could not be added.
+  bool AddEntry(const pp::VarDictionary& dictionary, int* entry_id);
+
   // A callback helper for CloseArchive.
   void CloseArchiveCallback(int32_t, bool has_error);
 
+  // Sends an error for an entry that could not be added, unless the archive
+  // was closed with an error and JavaScript knows already.
+  void SendAddToArchiveError();
+
+  // Returns true if the archive was closed with an error.
+  bool IsAborted();
+
   // The compressor id of this compressor.
   int compressor_id_;
 
   // An object that sends messages to JavaScript.
   JavaScriptMessageSenderInterface* message_sender_;
 
-  // A worker for jobs that require blocking operations or a lot of processing
-  // time. Those shouldn't be done on the main thread. The jobs submitted to
-  // this thread are executed in order, so a new job must wait for the last job
-  // to finish.
-  pp::SimpleThread worker_;
+  // The pool that runs jobs that require blocking operations or a lot of
+  // processing time. Those shouldn't be done on the main thread.
+  WorkerPool* worker_pool_;
+
+  // The queue the jobs of this compressor are submitted to. The jobs are
+  // executed in order, so a new job must wait for the last job to finish.
+  WorkerPool::JobQueue job_queue_;
 
-  // Callback factory used to submit jobs to worker_.
+  // Callback factory used to submit jobs to job_queue_.
   pp::CompletionCallbackFactory<Compressor> callback_factory_;
 
   // A requestor for making calls to JavaScript.
   JavaScriptCompressorRequestorInterface* requestor_;
 
-  // Libarchive wrapper instance per compressor, shared across all operations.
+  // The archive wrapper instance per compressor, shared across all operations.
+  // Created by CreateArchive for the requested format.
   CompressorArchive* compressor_archive_;
 
   // An instance that takes care of all IO operations.
   CompressorStream* compressor_stream_;
+
+  // Guards aborted_, which is set in the main thread and read by the jobs.
+  pthread_mutex_t aborted_lock_;
+
+  // True once the archive was closed with an error.
+  bool aborted_;
 };
 
 #endif  /// COMPRESSOR_H_
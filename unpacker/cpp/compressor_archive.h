@@ -6,6 +6,18 @@
 #define COMPRESSSOR_ARCHIVE_H_
 
 #include "compressor_io_javascript_stream.h"
+#include "request.h"
+
+// A namespace with constants used by CompressorArchive.
+namespace compressor_archive_constants {
+const int64_t kMaximumDataChunkSize = 512 * 1024;
+const int kFilePermission = 0640;
+const int kDirectoryPermission = 0760;
+// Selects the default compression level of the format or of the filter.
+const int kDefaultCompressionLevel = -1;
+// The level zlib deflates with by default.
+const int kZipDefaultCompressionLevel = 6;
+}  // namespace compressor_archive_constants
 
 // Defines a wrapper for packing operations executed on an archive. API is not
 // meant to be thread safe and its methods shouldn't be called in parallel.
@@ -16,9 +28,16 @@ class CompressorArchive {
 
   virtual ~CompressorArchive() {}
 
-  // Creates an archive object. This method does not call CustomArchiveWrite, so
-  // this is synchronous.
-  virtual void CreateArchive() = 0;
+  // Creates an archive object in the given format, compressed with the given
+  // filter at compression_level, or at the default level of the filter if
+  // compression_level is kDefaultCompressionLevel. options are passed to
+  // libarchive as they are, e.g. "gzip:!timestamp", and may be empty. Returns
+  // false if the combination is not supported. This method does not call
+  // CustomArchiveWrite, so this is synchronous.
+  virtual bool CreateArchive(request::PackFormat format,
+                             request::PackFilter filter,
+                             int compression_level,
+                             const std::string& options) = 0;
 
   // Releases all resources obtained by libarchive.
   // This method also writes metadata about the archive itself onto the end of
@@ -32,10 +51,16 @@ class CompressorArchive {
   // JavaScript for file chunks, compresses and writes them onto the archive
   // until all chunks of the entry are written onto the archive. This method
   // calls IO operations, so this function must not be called in the main thread.
-  virtual void AddToArchive(const std::string& filename,
+  // compression_level overrides the level of the archive for this entry, unless
+  // it is kDefaultCompressionLevel. Only ZIP
+  // archives compress the entries on their own, so the level is ignored for
+  // other formats. Returns false if the entry could not be added, then the
+  // next entries are not added either.
+  virtual bool AddToArchive(const std::string& filename,
                             int64_t file_size,
                             time_t modification_time,
-                            bool is_directory) = 0;
+                            bool is_directory,
+                            int compression_level) = 0;
 
   // A getter function for archive_.
   struct archive* archive() const { return archive_; }
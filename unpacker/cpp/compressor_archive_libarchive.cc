@@ -4,8 +4,10 @@
 
 #include "compressor_archive_libarchive.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <cstring>
+#include <sstream>
 
 #include "archive_entry.h"
 #include "ppapi/cpp/logging.h"
@@ -16,72 +18,181 @@ namespace {
     return ARCHIVE_OK;
   }
 
-  // Called when any data chunk must be written on the archive. It copies data
-  // from the given buffer processed by libarchive to an array buffer and passes
-  // it to compressor_stream.
+  // Called when any data must be written on the archive. It copies data from
+  // the given buffer processed by libarchive to the array buffer passed to
+  // compressor_stream once it is full.
   ssize_t CustomArchiveWrite(archive* archive_object, void* client_data,
       const void* buffer, size_t length) {
     CompressorArchiveLibarchive* compressor_libarchive =
         static_cast<CompressorArchiveLibarchive*>(client_data);
 
-    const char* char_buffer = static_cast<const char*>(buffer);
-
-    // Copy the data in buffer to array_buffer.
     PP_DCHECK(length > 0);
-    pp::VarArrayBuffer array_buffer(length);
-    char* array_buffer_data = static_cast<char*>(array_buffer.Map());
-    memcpy(array_buffer_data, char_buffer, length);
-    array_buffer.Unmap();
-
-    ssize_t written_bytes =
-        compressor_libarchive->compressor_stream()->Write(length, array_buffer);
-
-    // Negative written_bytes represents an error.
-    if (written_bytes < 0) {
+    if (!compressor_libarchive->WriteOutput(static_cast<const char*>(buffer),
+                                            length)) {
       // When writing fails, archive_set_error() should be called and -1 should
       // be returned.
       archive_set_error(
           compressor_libarchive->archive(), EIO, "Failed to write a chunk.");
       return -1;
     }
-    return written_bytes;
+    return length;
   }
 
-  // Nothing to do here because JavaScript takes care of file close operations.
+  // Writes the data left in the array buffer. JavaScript takes care of file
+  // close operations.
   int CustomArchiveClose(archive* archive_object, void* client_data) {
-    return ARCHIVE_OK;
+    CompressorArchiveLibarchive* compressor_libarchive =
+        static_cast<CompressorArchiveLibarchive*>(client_data);
+    return compressor_libarchive->FlushOutput() ? ARCHIVE_OK : ARCHIVE_FATAL;
   }
 }
 
 CompressorArchiveLibarchive::CompressorArchiveLibarchive(
     CompressorStream* compressor_stream)
     : CompressorArchive(compressor_stream),
-      compressor_stream_(compressor_stream) {
-  destination_buffer_ =
-      new char[compressor_archive_constants::kMaximumDataChunkSize];
-}
+      format_(request::PACK_FORMAT_ZIP),
+      filter_(request::PACK_FILTER_DEFAULT),
+      compression_level_(
+          compressor_archive_constants::kDefaultCompressionLevel),
+      compressor_stream_(compressor_stream),
+      archive_(NULL),
+      output_data_(NULL),
+      output_length_(0) {}
 
 CompressorArchiveLibarchive::~CompressorArchiveLibarchive() {
-  delete destination_buffer_;
+  if (output_data_)
+    output_buffer_.Unmap();
 }
 
-void CompressorArchiveLibarchive::CreateArchive() {
+bool CompressorArchiveLibarchive::CreateArchive(
+    request::PackFormat format,
+    request::PackFilter filter,
+    int compression_level,
+    const std::string& options) {
+  format_ = format;
+  filter_ = filter;
+  // Stored archives are not compressed, so they have no level.
+  compression_level_ =
+      filter == request::PACK_FILTER_NONE ?
+          compressor_archive_constants::kDefaultCompressionLevel :
+          compression_level;
   archive_ = archive_write_new();
-  archive_write_set_format_zip(archive_);
+  if (!SetFormatAndFilter(format, filter) ||
+      !SetCompressionLevel(compression_level_) ||
+      (!options.empty() &&
+       archive_write_set_options(archive_, options.c_str()) != ARCHIVE_OK)) {
+    archive_write_free(archive_);
+    archive_ = NULL;
+    return false;
+  }
 
-  // Passing 1 as the second argument causes the final chunk not to be padded.
-  archive_write_set_bytes_in_last_block(archive_, 1);
-  archive_write_set_bytes_per_block(
-     archive_, compressor_archive_constants::kMaximumDataChunkSize);
+  // libarchive doesn't buffer the output into blocks, CustomArchiveWrite
+  // copies it into the array buffers sent to JavaScript instead.
+  archive_write_set_bytes_per_block(archive_, 0);
   archive_write_open(archive_, this, CustomArchiveOpen,
                      CustomArchiveWrite, CustomArchiveClose);
+  return true;
+}
+
+bool CompressorArchiveLibarchive::SetFormatAndFilter(
+    request::PackFormat format,
+    request::PackFilter filter) {
+  switch (format) {
+    case request::PACK_FORMAT_ZIP: {
+      // ZIP compresses every file on its own, so no filters are added.
+      if (archive_write_set_format_zip(archive_) != ARCHIVE_OK)
+        return false;
+      const char* compression = NULL;
+      if (filter == request::PACK_FILTER_DEFAULT ||
+          filter == request::PACK_FILTER_DEFLATE) {
+        compression = "deflate";
+      } else if (filter == request::PACK_FILTER_NONE) {
+        compression = "store";
+      } else {
+        return false;
+      }
+      return archive_write_set_format_option(
+          archive_, "zip", "compression", compression) == ARCHIVE_OK;
+    }
+
+    case request::PACK_FORMAT_TAR: {
+      // The pax extensions are used only for what ustar can't store, e.g. long
+      // paths.
+      if (archive_write_set_format_pax_restricted(archive_) != ARCHIVE_OK)
+        return false;
+      int result = ARCHIVE_FATAL;
+      switch (filter) {
+        case request::PACK_FILTER_DEFAULT:
+        case request::PACK_FILTER_NONE:
+          result = archive_write_add_filter_none(archive_);
+          break;
+        case request::PACK_FILTER_DEFLATE:
+          result = archive_write_add_filter_gzip(archive_);
+          break;
+        case request::PACK_FILTER_ZSTD:
+          result = archive_write_add_filter_zstd(archive_);
+          break;
+        case request::PACK_FILTER_XZ:
+          result = archive_write_add_filter_xz(archive_);
+          break;
+        case request::PACK_FILTER_LZ4:
+          result = archive_write_add_filter_lz4(archive_);
+          break;
+      }
+      // ARCHIVE_WARN means an external program would be used, which is not
+      // possible here.
+      return result == ARCHIVE_OK;
+    }
+  }
+  return false;
+}
+
+bool CompressorArchiveLibarchive::SetCompressionLevel(int compression_level) {
+  if (compression_level ==
+          compressor_archive_constants::kDefaultCompressionLevel) {
+    return true;
+  }
+
+  std::stringstream level;
+  level << compression_level;
+  // ZIP reads the level for every entry, where 0 stores the entry and other
+  // levels deflate it.
+  if (format_ == request::PACK_FORMAT_ZIP) {
+    return archive_write_set_format_option(
+        archive_, "zip", "compression-level", level.str().c_str()) ==
+        ARCHIVE_OK;
+  }
+
+  // Uncompressed TAR archives have no level.
+  if (filter_ == request::PACK_FILTER_DEFAULT ||
+      filter_ == request::PACK_FILTER_NONE) {
+    return true;
+  }
+  return archive_write_set_filter_option(
+      archive_, NULL, "compression-level", level.str().c_str()) == ARCHIVE_OK;
 }
 
-void CompressorArchiveLibarchive::AddToArchive(
+bool CompressorArchiveLibarchive::AddToArchive(
     const std::string& filename,
     int64_t file_size,
     time_t modification_time,
-    bool is_directory) {
+    bool is_directory,
+    int compression_level) {
+  // The archive was released when a previous entry failed.
+  if (!archive_)
+    return false;
+
+  // Only ZIP compresses the entries on their own.
+  bool override_level =
+      format_ == request::PACK_FORMAT_ZIP && !is_directory &&
+      compression_level !=
+          compressor_archive_constants::kDefaultCompressionLevel &&
+      compression_level != compression_level_;
+  if (override_level && !SetCompressionLevel(compression_level)) {
+    CloseArchive(true /* hasError */);
+    return false;
+  }
+
   entry = archive_entry_new();
 
   archive_entry_set_pathname(entry, filename.c_str());
@@ -100,10 +211,12 @@ void CompressorArchiveLibarchive::AddToArchive(
   archive_write_header(archive_, entry);
   // If archive_errno() returns 0, the header was written correctly.
   if (archive_errno(archive_) != 0) {
+    archive_entry_free(entry);
     CloseArchive(true /* hasError */);
-    return;
+    return false;
   }
 
+  bool success = true;
   if (!is_directory) {
     int64_t remaining_size = file_size;
     while (remaining_size > 0) {
@@ -111,19 +224,24 @@ void CompressorArchiveLibarchive::AddToArchive(
           compressor_archive_constants::kMaximumDataChunkSize);
       PP_DCHECK(chunk_size > 0);
 
-      int64_t read_bytes =
-          compressor_stream_->Read(chunk_size, destination_buffer_);
+      // The chunk is compressed from the array buffer received from
+      // JavaScript.
+      pp::VarArrayBuffer buffer;
+      int64_t read_bytes = compressor_stream_->Read(chunk_size, &buffer);
       // Negative read_bytes indicates an error occurred when reading chunks.
       if (read_bytes < 0) {
         CloseArchive(true /* hasError */);
+        success = false;
         break;
       }
 
       int64_t written_bytes =
-          archive_write_data(archive_, destination_buffer_, read_bytes);
+          archive_write_data(archive_, buffer.Map(), read_bytes);
+      buffer.Unmap();
       // If archive_errno() returns 0, the buffer was written correctly.
       if (archive_errno(archive_) != 0) {
         CloseArchive(true /* hasError */);
+        success = false;
         break;
       }
       PP_DCHECK(written_bytes > 0);
@@ -133,15 +251,61 @@ void CompressorArchiveLibarchive::AddToArchive(
   }
 
   archive_entry_free(entry);
+
+  // Restore the compression of the archive for the next entries. A level set
+  // for an entry may have switched between storing and deflating.
+  if (override_level && archive_) {
+    if (filter_ == request::PACK_FILTER_NONE) {
+      archive_write_set_format_option(archive_, "zip", "compression", "store");
+    } else {
+      SetCompressionLevel(
+          compression_level_ !=
+                  compressor_archive_constants::kDefaultCompressionLevel ?
+              compression_level_ :
+              compressor_archive_constants::kZipDefaultCompressionLevel);
+    }
+  }
+  return success;
 }
 
 void CompressorArchiveLibarchive::CloseArchive(bool has_error) {
   // If has_error is true, mark the archive object as being unusable and
-  // release resources without writing no more data on the archive.
-  if (has_error)
+  // release resources without writing no more data on the archive. There is
+  // no archive object if creating it failed.
+  if (archive_ && has_error)
     archive_write_fail(archive_);
   if (archive_) {
     archive_write_free(archive_);
     archive_ = NULL;
   }
 }
+
+bool CompressorArchiveLibarchive::WriteOutput(const char* data,
+                                              int64_t length) {
+  while (length > 0) {
+    if (!output_data_) {
+      output_buffer_ = compressor_stream_->GetWriteBuffer();
+      output_data_ = static_cast<char*>(output_buffer_.Map());
+      output_length_ = 0;
+    }
+    int64_t copied_length = std::min(
+        length, static_cast<int64_t>(output_buffer_.ByteLength()) -
+                    output_length_);
+    memcpy(output_data_ + output_length_, data, copied_length);
+    output_length_ += copied_length;
+    data += copied_length;
+    length -= copied_length;
+    if (output_length_ == output_buffer_.ByteLength() && !FlushOutput())
+      return false;
+  }
+  return true;
+}
+
+bool CompressorArchiveLibarchive::FlushOutput() {
+  if (!output_data_)
+    return true;
+  output_buffer_.Unmap();
+  output_data_ = NULL;
+  // Negative written bytes represent an error.
+  return compressor_stream_->Write(output_length_, output_buffer_) >= 0;
+}
@@ -8,17 +8,11 @@
 #include <string>
 
 #include "archive.h"
+#include "ppapi/cpp/var_array_buffer.h"
 
 #include "compressor_archive.h"
 #include "compressor_stream.h"
 
-// A namespace with constants used by CompressorArchiveLibarchive.
-namespace compressor_archive_constants {
-const int64_t kMaximumDataChunkSize = 512 * 1024;
-const int kFilePermission = 640;
-const int kDirectoryPermission = 760;
-}  // namespace compressor_archive_constants
-
 class CompressorArchiveLibarchive : public CompressorArchive {
  public:
   explicit CompressorArchiveLibarchive(CompressorStream* compressor_stream);
@@ -26,16 +20,21 @@ class CompressorArchiveLibarchive : public CompressorArchive {
   virtual ~CompressorArchiveLibarchive();
 
   // Creates an archive object.
-  virtual void CreateArchive();
+  virtual bool CreateArchive(request::PackFormat format,
+                             request::PackFilter filter,
+                             int compression_level,
+                             const std::string& options);
 
   // Releases all resources obtained by libarchive.
   virtual void CloseArchive(bool has_error);
 
-  // Adds an entry to the archive.
-  virtual void AddToArchive(const std::string& filename,
+  // Adds an entry to the archive. The archive is released once an entry
+  // fails, so the next entries fail right away.
+  virtual bool AddToArchive(const std::string& filename,
                             int64_t file_size,
                             time_t modification_time,
-                            bool is_directory);
+                            bool is_directory,
+                            int compression_level);
 
   // A getter function for archive_.
   struct archive* archive() const { return archive_; }
@@ -43,7 +42,32 @@ class CompressorArchiveLibarchive : public CompressorArchive {
   // A getter function for compressor_stream.
   CompressorStream* compressor_stream() const { return compressor_stream_; }
 
+  // Copies the data written by libarchive into output_buffer_, and writes
+  // output_buffer_ onto the archive once it is full. Returns false on failure.
+  bool WriteOutput(const char* data, int64_t length);
+
+  // Writes the data left in output_buffer_. Returns false on failure.
+  bool FlushOutput();
+
  private:
+  // Sets the format and the filters of archive_. Returns false if the
+  // combination is not supported.
+  bool SetFormatAndFilter(request::PackFormat format,
+                          request::PackFilter filter);
+
+  // Sets the compression level of the entries written next. Returns false if
+  // the level is not supported by the format or the filter of archive_.
+  bool SetCompressionLevel(int compression_level);
+
+  // The format of archive_.
+  request::PackFormat format_;
+
+  // The filter of archive_.
+  request::PackFilter filter_;
+
+  // The compression level of archive_.
+  int compression_level_;
+
   // An instance that takes care of all IO operations.
   CompressorStream* compressor_stream_;
 
@@ -54,8 +78,14 @@ class CompressorArchiveLibarchive : public CompressorArchive {
   // processed.
   struct archive_entry* entry;
 
-  // The buffer used to store the data read from JavaScript.
-  char* destination_buffer_;
+  // The buffer of compressor_stream_ libarchive's output is copied into. It is
+  // kept mapped at output_data_ until it is written, or NULL if there is no
+  // output to write.
+  pp::VarArrayBuffer output_buffer_;
+  char* output_data_;
+
+  // The number of bytes of output_buffer_ filled so far.
+  int64_t output_length_;
 };
 
 #endif  // COMPRESSOR_ARCHIVE_LIBARCHIVE_H_
@@ -0,0 +1,654 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "compressor_archive_zip.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+#include "ppapi/cpp/logging.h"
+#include "ppapi/cpp/var_array_buffer.h"
+
+#include "compressibility.h"
+
+namespace {
+
+// The signatures of the ZIP records, see the .ZIP File Format Specification.
+const uint32_t kLocalFileHeaderSignature = 0x04034b50;
+const uint32_t kDataDescriptorSignature = 0x08074b50;
+const uint32_t kCentralDirectoryHeaderSignature = 0x02014b50;
+const uint32_t kZip64EndOfCentralDirectorySignature = 0x06064b50;
+const uint32_t kZip64EndOfCentralDirectoryLocatorSignature = 0x07064b50;
+const uint32_t kEndOfCentralDirectorySignature = 0x06054b50;
+
+// The ids of the extra fields.
+const uint16_t kZip64ExtraFieldId = 0x0001;
+const uint16_t kExtendedTimestampExtraFieldId = 0x5455;
+
+// The general purpose flags. The sizes and the CRC-32 of the entries with data
+// follow their data, so the data can be written while it is deflated.
+const uint16_t kDataDescriptorFlag = 1 << 3;
+const uint16_t kUtf8Flag = 1 << 11;
+
+// The compression methods.
+const uint16_t kMethodStore = 0;
+const uint16_t kMethodDeflate = 8;
+
+// The versions needed to extract the entries.
+const uint16_t kVersionDeflate = 20;
+const uint16_t kVersionZip64 = 45;
+
+// Made on UNIX, so the permissions are stored in the external attributes.
+const uint16_t kVersionMadeByUnix = 3 << 8;
+
+// The MS-DOS attribute of directories.
+const uint32_t kDosDirectoryAttribute = 0x10;
+
+// Sizes and offsets stored in ZIP64 extra fields are set to this value.
+const uint32_t kZip64Marker = 0xffffffff;
+const uint16_t kZip64EntriesMarker = 0xffff;
+
+// The number of bytes the output buffer of a chunk grows by while deflating.
+const size_t kDeflateOutputStep = 64 * 1024;
+
+// The size of the dictionary of a chunk, as big as the window of deflate.
+const size_t kDictionarySize = 1 << MAX_WBITS;
+
+void AppendUint16(std::string* output, uint16_t value) {
+  output->push_back(static_cast<char>(value & 0xff));
+  output->push_back(static_cast<char>(value >> 8));
+}
+
+void AppendUint32(std::string* output, uint32_t value) {
+  AppendUint16(output, static_cast<uint16_t>(value & 0xffff));
+  AppendUint16(output, static_cast<uint16_t>(value >> 16));
+}
+
+void AppendUint64(std::string* output, uint64_t value) {
+  AppendUint32(output, static_cast<uint32_t>(value & 0xffffffff));
+  AppendUint32(output, static_cast<uint32_t>(value >> 32));
+}
+
+// Converts time to the MS-DOS date and time used by ZIP. Times before 1980
+// can't be represented, so they are clamped.
+void GetDosDateAndTime(time_t time, uint16_t* dos_date, uint16_t* dos_time) {
+  tm local_time;
+  if (!localtime_r(&time, &local_time) || local_time.tm_year < 80) {
+    *dos_date = (1 << 5) | 1;  // 1980-01-01.
+    *dos_time = 0;
+    return;
+  }
+  *dos_date = ((local_time.tm_year - 80) << 9) |
+              ((local_time.tm_mon + 1) << 5) | local_time.tm_mday;
+  *dos_time = (local_time.tm_hour << 11) | (local_time.tm_min << 5) |
+              (local_time.tm_sec / 2);
+}
+
+// Appends the extended timestamp extra field, which keeps the modification
+// time in UTC and with a precision of a second.
+void AppendExtendedTimestamp(std::string* output, time_t time) {
+  AppendUint16(output, kExtendedTimestampExtraFieldId);
+  AppendUint16(output, 5);
+  output->push_back(1);  // Only the modification time is present.
+  AppendUint32(output, static_cast<uint32_t>(time));
+}
+
+}  // namespace
+
+CompressorArchiveZip::CompressorArchiveZip(CompressorStream* compressor_stream,
+                                           WorkerPool* worker_pool,
+                                           double store_ratio)
+    : CompressorArchive(compressor_stream),
+      compressor_stream_(compressor_stream),
+      store_ratio_(store_ratio),
+      compression_level_(
+          compressor_archive_constants::kZipDefaultCompressionLevel),
+      store_(false),
+      next_job_queue_(0),
+      writer_queue_(worker_pool),
+      callback_factory_(this),
+      buffered_bytes_(0),
+      write_scheduled_(false),
+      error_(false),
+      output_data_(NULL),
+      output_length_(0),
+      output_offset_(0) {
+  for (int i = 0; i < WorkerPool::DefaultMaximumThreads(); ++i) {
+    job_queues_.push_back(new WorkerPool::JobQueue(worker_pool));
+    Deflater* deflater = new Deflater;
+    deflater->compression_level =
+        compressor_archive_constants::kDefaultCompressionLevel;
+    deflaters_.push_back(deflater);
+  }
+  pthread_mutex_init(&lock_, NULL);
+  pthread_cond_init(&progress_cond_, NULL);
+}
+
+CompressorArchiveZip::~CompressorArchiveZip() {
+  // The jobs use the entries, so they must finish first.
+  writer_queue_.Join();
+  for (size_t i = 0; i < job_queues_.size(); ++i) {
+    delete job_queues_[i];
+    if (deflaters_[i]->compression_level !=
+            compressor_archive_constants::kDefaultCompressionLevel) {
+      deflateEnd(&deflaters_[i]->stream);
+    }
+    delete deflaters_[i];
+  }
+
+  for (size_t i = 0; i < entries_.size(); ++i)
+    DeleteEntry(entries_[i]);
+  for (size_t i = 0; i < written_entries_.size(); ++i)
+    DeleteEntry(written_entries_[i]);
+  if (output_data_)
+    output_buffer_.Unmap();
+
+  pthread_cond_destroy(&progress_cond_);
+  pthread_mutex_destroy(&lock_);
+}
+
+bool CompressorArchiveZip::IsSupported(request::PackFormat format,
+                                       request::PackFilter filter,
+                                       const std::string& options) {
+  return format == request::PACK_FORMAT_ZIP && options.empty() &&
+         (filter == request::PACK_FILTER_DEFAULT ||
+          filter == request::PACK_FILTER_NONE ||
+          filter == request::PACK_FILTER_DEFLATE);
+}
+
+bool CompressorArchiveZip::CreateArchive(request::PackFormat format,
+                                         request::PackFilter filter,
+                                         int compression_level,
+                                         const std::string& options) {
+  if (!IsSupported(format, filter, options) ||
+      compression_level <
+          compressor_archive_constants::kDefaultCompressionLevel ||
+      compression_level > Z_BEST_COMPRESSION) {
+    return false;
+  }
+
+  // Same as libarchive, level 0 stores the entries.
+  store_ = filter == request::PACK_FILTER_NONE || compression_level == 0;
+  if (!store_ &&
+      compression_level !=
+          compressor_archive_constants::kDefaultCompressionLevel) {
+    compression_level_ = compression_level;
+  }
+  return true;
+}
+
+bool CompressorArchiveZip::AddToArchive(const std::string& filename,
+                                        int64_t file_size,
+                                        time_t modification_time,
+                                        bool is_directory,
+                                        int compression_level) {
+  Entry* entry = new Entry;
+  entry->filename = filename;
+  entry->size = is_directory ? 0 : file_size;
+  entry->modification_time = modification_time;
+  entry->is_directory = is_directory;
+  if (compression_level !=
+          compressor_archive_constants::kDefaultCompressionLevel) {
+    entry->compression_level =
+        std::max(0, std::min(compression_level, Z_BEST_COMPRESSION));
+  } else {
+    entry->compression_level = store_ ? 0 : compression_level_;
+  }
+  // Same as libarchive, empty files are stored.
+  if (entry->size == 0)
+    entry->compression_level = 0;
+  entry->stored = entry->compression_level == 0 &&
+      entry->size <= compressor_archive_constants::kMaximumStoredEntrySize;
+  entry->zip64 = entry->size >= compressor_archive_constants::kZip64EntrySize;
+  entry->crc = crc32(0, Z_NULL, 0);
+  entry->read = entry->size == 0;
+  entry->header_written = false;
+  entry->header_offset = 0;
+  entry->compressed_size = 0;
+
+  // Whether an entry is stored is decided from its first chunk, unless its
+  // level is set, so its header is queued with the first chunk.
+  bool detect_store =
+      compression_level ==
+          compressor_archive_constants::kDefaultCompressionLevel &&
+      entry->compression_level > 0;
+  bool queued = false;
+
+  pthread_mutex_lock(&lock_);
+  bool error = error_;
+  if (!error && entry->size == 0) {
+    entries_.push_back(entry);
+    ScheduleWrite();
+    queued = true;
+  }
+  pthread_mutex_unlock(&lock_);
+
+  std::string dictionary;
+  int64_t remaining_size = entry->size;
+  while (!error && remaining_size > 0) {
+    int64_t chunk_size = std::min(remaining_size,
+        compressor_archive_constants::kMaximumDataChunkSize);
+
+    // Let the pool deflate and write chunks while the buffer is full.
+    pthread_mutex_lock(&lock_);
+    while (!error_ && buffered_bytes_ > 0 &&
+           buffered_bytes_ + chunk_size >
+               compressor_archive_constants::kMaximumBufferedBytes) {
+      WorkerPool::WaitForSignal(&progress_cond_, &lock_);
+    }
+    error = error_;
+    pthread_mutex_unlock(&lock_);
+    if (error)
+      break;
+
+    Chunk* chunk = new Chunk;
+    chunk->deflated = false;
+    int64_t read_bytes = compressor_stream_->Read(chunk_size, &chunk->input);
+    // Negative read_bytes indicates an error occurred when reading chunks.
+    if (read_bytes != chunk_size) {
+      delete chunk;
+      pthread_mutex_lock(&lock_);
+      error_ = true;
+      pthread_cond_broadcast(&progress_cond_);
+      pthread_mutex_unlock(&lock_);
+      error = true;
+      break;
+    }
+    const char* input = static_cast<const char*>(chunk->input.Map());
+    if (!queued && detect_store &&
+        compressibility::ShouldStore(filename, input, read_bytes,
+                                     store_ratio_)) {
+      entry->compression_level = 0;
+      entry->stored =
+          entry->size <= compressor_archive_constants::kMaximumStoredEntrySize;
+    }
+    remaining_size -= read_bytes;
+    chunk->size = read_bytes;
+    chunk->last = remaining_size == 0;
+    if (entry->compression_level > 0) {
+      chunk->dictionary.swap(dictionary);
+      if (!chunk->last) {
+        size_t dictionary_size =
+            std::min(kDictionarySize, static_cast<size_t>(read_bytes));
+        dictionary.assign(input + read_bytes - dictionary_size,
+                          dictionary_size);
+      }
+    }
+    chunk->input.Unmap();
+
+    pthread_mutex_lock(&lock_);
+    if (!queued) {
+      entries_.push_back(entry);
+      ScheduleWrite();
+      queued = true;
+    }
+    entry->chunks.push_back(chunk);
+    entry->read = chunk->last;
+    buffered_bytes_ += chunk_size;
+    pthread_mutex_unlock(&lock_);
+
+    job_queues_[next_job_queue_]->PostWork(callback_factory_.NewCallback(
+        &CompressorArchiveZip::DeflateChunkCallback, entry, chunk,
+        deflaters_[next_job_queue_]));
+    next_job_queue_ = (next_job_queue_ + 1) % job_queues_.size();
+  }
+
+  // The entry is released with the archive once queued.
+  if (!queued)
+    DeleteEntry(entry);
+  return !error;
+}
+
+void CompressorArchiveZip::DeflateChunkCallback(int32_t,
+                                                Entry* entry,
+                                                Chunk* chunk,
+                                                Deflater* deflater) {
+  const Bytef* input = static_cast<const Bytef*>(chunk->input.Map());
+  uInt input_size = static_cast<uInt>(chunk->size);
+  chunk->crc = crc32(crc32(0, Z_NULL, 0), input, input_size);
+
+  bool success = true;
+  if (!entry->stored) {
+    z_stream* stream = &deflater->stream;
+    if (deflater->compression_level == entry->compression_level) {
+      success = deflateReset(stream) == Z_OK;
+    } else {
+      if (deflater->compression_level !=
+              compressor_archive_constants::kDefaultCompressionLevel) {
+        deflateEnd(stream);
+      }
+      memset(stream, 0, sizeof(*stream));
+      // Negative window bits produce raw deflate data, without the zlib
+      // header and trailer ZIP doesn't use.
+      success = deflateInit2(stream, entry->compression_level, Z_DEFLATED,
+                             -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+      deflater->compression_level =
+          success ? entry->compression_level :
+                    compressor_archive_constants::kDefaultCompressionLevel;
+    }
+    if (success && !chunk->dictionary.empty()) {
+      success = deflateSetDictionary(
+          stream, reinterpret_cast<const Bytef*>(chunk->dictionary.data()),
+          chunk->dictionary.size()) == Z_OK;
+    }
+
+    std::string output;
+    if (success) {
+      stream->next_in = const_cast<Bytef*>(input);
+      stream->avail_in = input_size;
+      // A sync flush ends the data on a byte boundary without marking the
+      // last block, so the next chunk continues the deflate stream.
+      int flush = chunk->last ? Z_FINISH : Z_SYNC_FLUSH;
+      int result = Z_OK;
+      do {
+        size_t used = output.size();
+        output.resize(used + kDeflateOutputStep);
+        stream->next_out = reinterpret_cast<Bytef*>(&output[used]);
+        stream->avail_out = kDeflateOutputStep;
+        result = deflate(stream, flush);
+        output.resize(output.size() - stream->avail_out);
+      } while (result == Z_OK && stream->avail_out == 0);
+      success = chunk->last ? result == Z_STREAM_END : result == Z_OK;
+    }
+    // The chunk is released by the writer, so the memory used by the data read
+    // from JavaScript is released now.
+    chunk->data.swap(output);
+    std::string().swap(chunk->dictionary);
+  }
+  chunk->input.Unmap();
+  int64_t released_bytes = 0;
+  if (!entry->stored) {
+    chunk->input = pp::VarArrayBuffer();
+    released_bytes = input_size - static_cast<int64_t>(chunk->data.size());
+  }
+
+  pthread_mutex_lock(&lock_);
+  buffered_bytes_ -= released_bytes;
+  chunk->deflated = true;
+  if (!success)
+    error_ = true;
+  ScheduleWrite();
+  pthread_cond_broadcast(&progress_cond_);
+  pthread_mutex_unlock(&lock_);
+}
+
+void CompressorArchiveZip::ScheduleWrite() {
+  if (write_scheduled_)
+    return;
+  write_scheduled_ = true;
+  writer_queue_.PostWork(callback_factory_.NewCallback(
+      &CompressorArchiveZip::WriteEntriesCallback));
+}
+
+void CompressorArchiveZip::WriteEntriesCallback(int32_t) {
+  pthread_mutex_lock(&lock_);
+  while (!error_ && !entries_.empty()) {
+    Entry* entry = entries_.front();
+    bool success = true;
+
+    if (!entry->header_written) {
+      // The CRC-32 of a stored entry is in its header, so it waits for all
+      // the chunks of the entry.
+      bool ready = !entry->stored || entry->read;
+      for (size_t i = 0; ready && i < entry->chunks.size(); ++i)
+        ready = entry->chunks[i]->deflated;
+      if (!ready)
+        break;
+      if (entry->stored) {
+        for (size_t i = 0; i < entry->chunks.size(); ++i) {
+          const Chunk* chunk = entry->chunks[i];
+          entry->crc = crc32_combine(entry->crc, chunk->crc, chunk->size);
+        }
+      }
+      entry->header_written = true;
+      pthread_mutex_unlock(&lock_);
+      success = WriteLocalHeader(entry);
+      pthread_mutex_lock(&lock_);
+    } else if (!entry->chunks.empty() && entry->chunks.front()->deflated) {
+      Chunk* chunk = entry->chunks.front();
+      entry->chunks.pop_front();
+      pthread_mutex_unlock(&lock_);
+      // Stored chunks are written from the array buffer read from JavaScript.
+      int64_t length = chunk->size;
+      if (!entry->stored) {
+        entry->crc = crc32_combine(entry->crc, chunk->crc, chunk->size);
+        length = chunk->data.size();
+        success = WriteOutput(chunk->data.data(), length);
+      } else {
+        success = WriteOutput(static_cast<char*>(chunk->input.Map()), length);
+        chunk->input.Unmap();
+      }
+      entry->compressed_size += length;
+      pthread_mutex_lock(&lock_);
+      buffered_bytes_ -= length;
+      delete chunk;
+      pthread_cond_broadcast(&progress_cond_);
+    } else if (entry->chunks.empty() && entry->read) {
+      entries_.pop_front();
+      pthread_mutex_unlock(&lock_);
+      success = WriteDataDescriptor(entry);
+      written_entries_.push_back(entry);
+      pthread_mutex_lock(&lock_);
+    } else {
+      // The next chunk is not deflated or read yet.
+      break;
+    }
+
+    if (!success)
+      error_ = true;
+  }
+  write_scheduled_ = false;
+  pthread_cond_broadcast(&progress_cond_);
+  pthread_mutex_unlock(&lock_);
+}
+
+bool CompressorArchiveZip::WriteLocalHeader(Entry* entry) {
+  entry->header_offset = output_offset_;
+  uint16_t dos_date = 0;
+  uint16_t dos_time = 0;
+  GetDosDateAndTime(entry->modification_time, &dos_date, &dos_time);
+
+  std::string extra;
+  AppendExtendedTimestamp(&extra, entry->modification_time);
+  if (entry->zip64) {
+    // The sizes are in the data descriptor.
+    AppendUint16(&extra, kZip64ExtraFieldId);
+    AppendUint16(&extra, 16);
+    AppendUint64(&extra, 0);
+    AppendUint64(&extra, 0);
+  }
+
+  std::string header;
+  AppendUint32(&header, kLocalFileHeaderSignature);
+  AppendUint16(&header, entry->zip64 ? kVersionZip64 : kVersionDeflate);
+  AppendUint16(&header,
+               kUtf8Flag | (entry->stored ? 0 : kDataDescriptorFlag));
+  AppendUint16(&header, entry->stored ? kMethodStore : kMethodDeflate);
+  AppendUint16(&header, dos_time);
+  AppendUint16(&header, dos_date);
+  // Stored entries are never big enough for ZIP64 sizes.
+  AppendUint32(&header, entry->stored ? entry->crc : 0);
+  AppendUint32(&header, entry->zip64 ? kZip64Marker :
+                        entry->stored ? entry->size : 0);
+  AppendUint32(&header, entry->zip64 ? kZip64Marker :
+                        entry->stored ? entry->size : 0);
+  AppendUint16(&header, entry->filename.size());
+  AppendUint16(&header, extra.size());
+  header += entry->filename;
+  header += extra;
+  return WriteOutput(header.data(), header.size());
+}
+
+bool CompressorArchiveZip::WriteDataDescriptor(Entry* entry) {
+  if (entry->stored)
+    return true;
+
+  std::string descriptor;
+  AppendUint32(&descriptor, kDataDescriptorSignature);
+  AppendUint32(&descriptor, entry->crc);
+  if (entry->zip64) {
+    AppendUint64(&descriptor, entry->compressed_size);
+    AppendUint64(&descriptor, entry->size);
+  } else {
+    AppendUint32(&descriptor, entry->compressed_size);
+    AppendUint32(&descriptor, entry->size);
+  }
+  return WriteOutput(descriptor.data(), descriptor.size());
+}
+
+bool CompressorArchiveZip::WriteCentralDirectory() {
+  int64_t central_directory_offset = output_offset_;
+  bool zip64 = written_entries_.size() >= kZip64EntriesMarker;
+
+  for (size_t i = 0; i < written_entries_.size(); ++i) {
+    const Entry* entry = written_entries_[i];
+    bool zip64_offset = entry->header_offset >= kZip64Marker;
+    zip64 = zip64 || entry->zip64 || zip64_offset;
+    uint16_t dos_date = 0;
+    uint16_t dos_time = 0;
+    GetDosDateAndTime(entry->modification_time, &dos_date, &dos_time);
+
+    std::string extra;
+    AppendExtendedTimestamp(&extra, entry->modification_time);
+    if (entry->zip64 || zip64_offset) {
+      AppendUint16(&extra, kZip64ExtraFieldId);
+      AppendUint16(&extra, (entry->zip64 ? 16 : 0) + (zip64_offset ? 8 : 0));
+      if (entry->zip64) {
+        AppendUint64(&extra, entry->size);
+        AppendUint64(&extra, entry->compressed_size);
+      }
+      if (zip64_offset)
+        AppendUint64(&extra, entry->header_offset);
+    }
+
+    uint32_t mode = entry->is_directory ?
+        S_IFDIR | compressor_archive_constants::kDirectoryPermission :
+        S_IFREG | compressor_archive_constants::kFilePermission;
+    uint16_t version = entry->zip64 || zip64_offset ? kVersionZip64 :
+                                                      kVersionDeflate;
+
+    std::string header;
+    AppendUint32(&header, kCentralDirectoryHeaderSignature);
+    AppendUint16(&header, kVersionMadeByUnix | version);
+    AppendUint16(&header, version);
+    AppendUint16(&header,
+                 kUtf8Flag | (entry->stored ? 0 : kDataDescriptorFlag));
+    AppendUint16(&header, entry->stored ? kMethodStore : kMethodDeflate);
+    AppendUint16(&header, dos_time);
+    AppendUint16(&header, dos_date);
+    AppendUint32(&header, entry->crc);
+    AppendUint32(&header, entry->zip64 ? kZip64Marker : entry->compressed_size);
+    AppendUint32(&header, entry->zip64 ? kZip64Marker : entry->size);
+    AppendUint16(&header, entry->filename.size());
+    AppendUint16(&header, extra.size());
+    AppendUint16(&header, 0);  // The comment length.
+    AppendUint16(&header, 0);  // The disk number.
+    AppendUint16(&header, 0);  // The internal attributes.
+    AppendUint32(&header, (mode << 16) |
+                          (entry->is_directory ? kDosDirectoryAttribute : 0));
+    AppendUint32(&header, zip64_offset ? kZip64Marker : entry->header_offset);
+    header += entry->filename;
+    header += extra;
+    if (!WriteOutput(header.data(), header.size()))
+      return false;
+  }
+
+  int64_t central_directory_size = output_offset_ - central_directory_offset;
+  zip64 = zip64 || central_directory_offset >= kZip64Marker ||
+          central_directory_size >= kZip64Marker;
+  std::string end;
+  if (zip64) {
+    int64_t zip64_end_offset = output_offset_;
+    AppendUint32(&end, kZip64EndOfCentralDirectorySignature);
+    AppendUint64(&end, 44);  // The size of the rest of the record.
+    AppendUint16(&end, kVersionMadeByUnix | kVersionZip64);
+    AppendUint16(&end, kVersionZip64);
+    AppendUint32(&end, 0);  // The disk number.
+    AppendUint32(&end, 0);  // The disk of the central directory.
+    AppendUint64(&end, written_entries_.size());
+    AppendUint64(&end, written_entries_.size());
+    AppendUint64(&end, central_directory_size);
+    AppendUint64(&end, central_directory_offset);
+
+    AppendUint32(&end, kZip64EndOfCentralDirectoryLocatorSignature);
+    AppendUint32(&end, 0);  // The disk of the ZIP64 end record.
+    AppendUint64(&end, zip64_end_offset);
+    AppendUint32(&end, 1);  // The number of disks.
+  }
+
+  uint16_t entries = static_cast<uint16_t>(
+      std::min<size_t>(written_entries_.size(), kZip64EntriesMarker));
+  AppendUint32(&end, kEndOfCentralDirectorySignature);
+  AppendUint16(&end, 0);  // The disk number.
+  AppendUint16(&end, 0);  // The disk of the central directory.
+  AppendUint16(&end, entries);
+  AppendUint16(&end, entries);
+  AppendUint32(&end, zip64 ? kZip64Marker : central_directory_size);
+  AppendUint32(&end, zip64 ? kZip64Marker : central_directory_offset);
+  AppendUint16(&end, 0);  // The comment length.
+  return WriteOutput(end.data(), end.size()) && FlushOutput();
+}
+
+bool CompressorArchiveZip::WriteOutput(const char* data, int64_t length) {
+  output_offset_ += length;
+  while (length > 0) {
+    if (!output_data_) {
+      output_buffer_ = compressor_stream_->GetWriteBuffer();
+      output_data_ = static_cast<char*>(output_buffer_.Map());
+      output_length_ = 0;
+    }
+    int64_t copied_length = std::min(
+        length, static_cast<int64_t>(output_buffer_.ByteLength()) -
+                    output_length_);
+    memcpy(output_data_ + output_length_, data, copied_length);
+    output_length_ += copied_length;
+    data += copied_length;
+    length -= copied_length;
+    if (output_length_ == output_buffer_.ByteLength() && !FlushOutput())
+      return false;
+  }
+  return true;
+}
+
+bool CompressorArchiveZip::FlushOutput() {
+  if (!output_data_)
+    return true;
+  output_buffer_.Unmap();
+  output_data_ = NULL;
+  // Negative written bytes represent an error.
+  return compressor_stream_->Write(output_length_, output_buffer_) >= 0;
+}
+
+void CompressorArchiveZip::CloseArchive(bool has_error) {
+  pthread_mutex_lock(&lock_);
+  if (has_error) {
+    // AddToArchive and the writer stop at the next chunk.
+    error_ = true;
+    pthread_cond_broadcast(&progress_cond_);
+    pthread_mutex_unlock(&lock_);
+    return;
+  }
+
+  // Let the pool deflate and write the last entries meanwhile.
+  while (!error_ && (write_scheduled_ || !entries_.empty()))
+    WorkerPool::WaitForSignal(&progress_cond_, &lock_);
+  bool error = error_;
+  pthread_mutex_unlock(&lock_);
+
+  // The writer is done, so the central directory can be written from here.
+  if (!error && !WriteCentralDirectory()) {
+    pthread_mutex_lock(&lock_);
+    error_ = true;
+    pthread_mutex_unlock(&lock_);
+  }
+}
+
+void CompressorArchiveZip::DeleteEntry(Entry* entry) {
+  for (size_t i = 0; i < entry->chunks.size(); ++i)
+    delete entry->chunks[i];
+  delete entry;
+}
@@ -0,0 +1,258 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef COMPRESSOR_ARCHIVE_ZIP_H_
+#define COMPRESSOR_ARCHIVE_ZIP_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "ppapi/cpp/var_array_buffer.h"
+#include "ppapi/utility/completion_callback_factory.h"
+#include "zlib.h"
+
+#include "compressor_archive.h"
+#include "compressor_stream.h"
+#include "worker_pool.h"
+
+// A namespace with constants used by CompressorArchiveZip.
+namespace compressor_archive_constants {
+// The maximum number of bytes of the chunks read from JavaScript and not
+// written onto the archive yet. Reading waits for the writer beyond it.
+const int64_t kMaximumBufferedBytes = 16 * 1024 * 1024;  // 16 MB.
+// Stored entries have their CRC-32 in their local header, so they are read
+// entirely before being written. Bigger entries that shouldn't be compressed
+// are deflated at level 0 instead, with a data descriptor.
+const int64_t kMaximumStoredEntrySize = kMaximumBufferedBytes;
+// Entries at least this big are written with ZIP64 sizes. Leaves room for
+// incompressible data that grows when deflated.
+const int64_t kZip64EntrySize = 0xff000000;
+}  // namespace compressor_archive_constants
+
+// Writes ZIP archives with zlib instead of libarchive, so that the entries are
+// deflated on the threads of a WorkerPool while the next entries are read.
+//
+// AddToArchive still reads the files from JavaScript one by one, in chunks of
+// kMaximumDataChunkSize bytes. Like pigz, every chunk is deflated on its own
+// by a job, primed with the end of the previous chunk as dictionary, so the
+// chunks of a single big entry are deflated in parallel as well as the chunks
+// of different entries. The deflate data of every chunk but the last ends
+// with a sync flush, so the chunks of an entry form a single deflate stream,
+// and the CRC-32 of the entry is combined from the CRC-32 of its chunks.
+//
+// A single writer job writes the local headers, the deflated data and the
+// data descriptors of the entries in the order they were added, and
+// CloseArchive writes the central directory once the writer is done. Stored
+// entries have no data descriptor, as many readers can't find the end of
+// their data without sizes in the local header.
+class CompressorArchiveZip : public CompressorArchive {
+ public:
+  // Entries deflated with the level of the archive are stored instead if
+  // compressibility::ShouldStore says so for store_ratio.
+  CompressorArchiveZip(CompressorStream* compressor_stream,
+                       WorkerPool* worker_pool /* Used for jobs. */,
+                       double store_ratio);
+
+  // Waits for the jobs of the archive to finish.
+  virtual ~CompressorArchiveZip();
+
+  // Returns true if archives in the given format, with the given filter and
+  // options can be written by CompressorArchiveZip. Options are libarchive
+  // options, so they are left to CompressorArchiveLibarchive.
+  static bool IsSupported(request::PackFormat format,
+                          request::PackFilter filter,
+                          const std::string& options);
+
+  // Creates an archive object.
+  virtual bool CreateArchive(request::PackFormat format,
+                             request::PackFilter filter,
+                             int compression_level,
+                             const std::string& options);
+
+  // Waits for the entries to be written and writes the central directory. If
+  // has_error is true, stops writing and returns immediately, so it can be
+  // called from the main thread.
+  virtual void CloseArchive(bool has_error);
+
+  // Reads the entry from JavaScript and submits its chunks to be deflated.
+  // Returns before the entry is written onto the archive. Unless
+  // compression_level is set, the entry is stored if its first chunk shows
+  // that it's already compressed.
+  virtual bool AddToArchive(const std::string& filename,
+                            int64_t file_size,
+                            time_t modification_time,
+                            bool is_directory,
+                            int compression_level);
+
+ private:
+  // A part of an entry read from JavaScript.
+  struct Chunk {
+    // The array buffer read from JavaScript, released once deflated. Stored
+    // entries are written from it, so their data is not copied.
+    pp::VarArrayBuffer input;
+
+    // The deflated data.
+    std::string data;
+
+    // The size and the CRC-32 of the data read from JavaScript.
+    int64_t size;
+    uint32_t crc;
+
+    // The end of the previous chunk of the entry, the data is deflated as if
+    // it followed it.
+    std::string dictionary;
+
+    // True if this is the last chunk of the entry.
+    bool last;
+
+    // True if data is deflated and can be written. Guarded by lock_.
+    bool deflated;
+  };
+
+  // An entry of the archive.
+  struct Entry {
+    std::string filename;
+    int64_t size;
+    time_t modification_time;
+    bool is_directory;
+
+    // The level the entry is deflated with, 0 if it is stored or too big to
+    // be stored without compression.
+    int compression_level;
+
+    // True if the entry is stored. Its local header is written once all its
+    // chunks are read, with its CRC-32 and sizes instead of a data descriptor.
+    bool stored;
+
+    // True if the entry is written with ZIP64 sizes.
+    bool zip64;
+
+    // The CRC-32 of the data, combined by the writer.
+    uint32_t crc;
+
+    // The chunks not written yet, in order. Guarded by lock_.
+    std::deque<Chunk*> chunks;
+
+    // True if all the chunks were read. Guarded by lock_.
+    bool read;
+
+    // The state of the entry on the archive, used by the writer.
+    bool header_written;
+    int64_t header_offset;
+    int64_t compressed_size;
+  };
+
+  // A stream reused by the jobs of one of job_queues_.
+  struct Deflater {
+    z_stream stream;
+
+    // The level stream is initialized with, or kDefaultCompressionLevel if it
+    // is not initialized.
+    int compression_level;
+  };
+
+  // Deflates chunk of entry with deflater. Run on the queue of deflater.
+  void DeflateChunkCallback(int32_t,
+                            Entry* entry,
+                            Chunk* chunk,
+                            Deflater* deflater);
+
+  // Writes the entries in order, as long as their chunks are deflated. Run on
+  // writer_queue_.
+  void WriteEntriesCallback(int32_t);
+
+  // Submits WriteEntriesCallback if it's not submitted already. Must be called
+  // with lock_ acquired.
+  void ScheduleWrite();
+
+  // Writes the local header of entry. Returns false on failure.
+  bool WriteLocalHeader(Entry* entry);
+
+  // Writes the data descriptor of entry, if the entry has data. Returns false
+  // on failure.
+  bool WriteDataDescriptor(Entry* entry);
+
+  // Writes the central directory and the end of central directory records.
+  // Returns false on failure.
+  bool WriteCentralDirectory();
+
+  // Writes data onto the archive through output_buffer_, in chunks of
+  // kMaximumDataChunkSize bytes. Returns false on failure.
+  bool WriteOutput(const char* data, int64_t length);
+
+  // Writes the data left in output_buffer_. Returns false on failure.
+  bool FlushOutput();
+
+  // Releases entry and its resources.
+  static void DeleteEntry(Entry* entry);
+
+  // An instance that takes care of all IO operations.
+  CompressorStream* compressor_stream_;
+
+  // The ratio passed to compressibility::ShouldStore.
+  double store_ratio_;
+
+  // The compression level of the archive.
+  int compression_level_;
+
+  // True if the entries are stored by default.
+  bool store_;
+
+  // The queues the chunks are deflated on. The chunks are spread among them,
+  // so that as many chunks as the pool has threads are deflated in parallel.
+  std::vector<WorkerPool::JobQueue*> job_queues_;
+
+  // The streams used by the jobs of job_queues_, by queue.
+  std::vector<Deflater*> deflaters_;
+
+  // The index of the queue in job_queues_ the next chunk is deflated on.
+  size_t next_job_queue_;
+
+  // The queue WriteEntriesCallback is run on.
+  WorkerPool::JobQueue writer_queue_;
+
+  // Callback factory used to submit jobs.
+  pp::CompletionCallbackFactory<CompressorArchiveZip> callback_factory_;
+
+  // A lock guarding the state shared by AddToArchive, the jobs and
+  // CloseArchive.
+  pthread_mutex_t lock_;
+
+  // Broadcasted when chunks are deflated or written, and on errors.
+  pthread_cond_t progress_cond_;
+
+  // The entries not completely written yet, in order. Guarded by lock_.
+  std::deque<Entry*> entries_;
+
+  // The number of bytes of the chunks in entries_. Guarded by lock_.
+  int64_t buffered_bytes_;
+
+  // True if WriteEntriesCallback is submitted or running. Guarded by lock_.
+  bool write_scheduled_;
+
+  // True if reading or writing failed, or the archive was closed with an
+  // error. Guarded by lock_.
+  bool error_;
+
+  // The written entries, kept for the central directory. Used by the writer.
+  std::vector<Entry*> written_entries_;
+
+  // The buffer of compressor_stream_ the data waiting to be written onto the
+  // archive is copied into. It is kept mapped at output_data_ until it is
+  // written, or NULL if there is no data to write. Used by the writer.
+  pp::VarArrayBuffer output_buffer_;
+  char* output_data_;
+
+  // The number of bytes of output_buffer_ filled so far. Used by the writer.
+  int64_t output_length_;
+
+  // The number of bytes passed to WriteOutput so far. Used by the writer.
+  int64_t output_offset_;
+};
+
+#endif  // COMPRESSOR_ARCHIVE_ZIP_H_
@@ -4,12 +4,17 @@
 
 #include "compressor_io_javascript_stream.h"
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
 #include <thread>
 
 #include "archive.h"
 #include "ppapi/cpp/logging.h"
 
+#include "compressor_archive.h"
+#include "worker_pool.h"
+
 CompressorIOJavaScriptStream::CompressorIOJavaScriptStream(
     JavaScriptCompressorRequestorInterface* requestor)
     : requestor_(requestor) {
@@ -18,7 +23,14 @@ CompressorIOJavaScriptStream::CompressorIOJavaScriptStream(
   pthread_cond_init(&data_written_cond_, NULL);
 
   pthread_mutex_lock(&shared_state_lock_);
-  available_data_ = false;
+  write_error_ = false;
+  entry_id_ = 0;
+  unrequested_bytes_ = 0;
+  pending_chunks_ = 0;
+  discarded_chunks_ = 0;
+  read_chunk_offset_ = 0;
+  read_error_ = false;
+  aborted_ = false;
   pthread_mutex_unlock(&shared_state_lock_);
 }
 
@@ -28,39 +40,163 @@ CompressorIOJavaScriptStream::~CompressorIOJavaScriptStream() {
   pthread_mutex_destroy(&shared_state_lock_);
 };
 
+pp::VarArrayBuffer CompressorIOJavaScriptStream::GetWriteBuffer() {
+  pthread_mutex_lock(&shared_state_lock_);
+  if (free_write_buffers_.empty()) {
+    pthread_mutex_unlock(&shared_state_lock_);
+    return pp::VarArrayBuffer(
+        compressor_archive_constants::kMaximumDataChunkSize);
+  }
+  pp::VarArrayBuffer buffer = free_write_buffers_.back();
+  free_write_buffers_.pop_back();
+  pthread_mutex_unlock(&shared_state_lock_);
+  return buffer;
+}
+
 int64_t CompressorIOJavaScriptStream::Write(int64_t byte_to_write,
     const pp::VarArrayBuffer& buffer) {
   pthread_mutex_lock(&shared_state_lock_);
-  requestor_->WriteChunkRequest(byte_to_write, buffer);
 
-  pthread_cond_wait(&data_written_cond_, &shared_state_lock_);
+  // Wait for JavaScript to write the previous chunks. The writer is waited for
+  // by other jobs of the compressor, so it just blocks on the condition and no
+  // job is ever run on its thread meanwhile.
+  while (!write_error_ && !aborted_ &&
+         pending_write_buffers_.size() >=
+             compressor_stream_constants::kMaximumPendingWrites) {
+    pthread_cond_wait(&data_written_cond_, &shared_state_lock_);
+  }
+
+  // JavaScript writes the chunks in order, so nothing is written after a
+  // chunk that failed.
+  if (write_error_ || aborted_) {
+    pthread_mutex_unlock(&shared_state_lock_);
+    return -1;
+  }
 
-  int64_t written_bytes = written_bytes_;
+  pending_write_buffers_.push_back(buffer);
+  requestor_->WriteChunkRequest(byte_to_write, buffer);
   pthread_mutex_unlock(&shared_state_lock_);
 
-  return written_bytes;
+  return byte_to_write;
 }
 
 void CompressorIOJavaScriptStream::WriteChunkDone(int64_t written_bytes) {
   pthread_mutex_lock(&shared_state_lock_);
-  written_bytes_ = written_bytes;
+  PP_DCHECK(!pending_write_buffers_.empty());
+  // JavaScript sets a negative value in written_bytes if an error occurred
+  // while writing a chunk.
+  if (written_bytes < 0) {
+    write_error_ = true;
+  } else if (pending_write_buffers_.front().ByteLength() ==
+             compressor_archive_constants::kMaximumDataChunkSize) {
+    // JavaScript received a copy of the buffer, so it can be filled again.
+    free_write_buffers_.push_back(pending_write_buffers_.front());
+  }
+  pending_write_buffers_.pop_front();
   pthread_cond_signal(&data_written_cond_);
   pthread_mutex_unlock(&shared_state_lock_);
 }
 
-int64_t CompressorIOJavaScriptStream::Read(int64_t bytes_to_read,
-                                           char* destination_buffer) {
+bool CompressorIOJavaScriptStream::Flush() {
+  pthread_mutex_lock(&shared_state_lock_);
+  // JavaScript may not respond to the chunks after a failure. Blocks like
+  // Write().
+  while (!write_error_ && !aborted_ && !pending_write_buffers_.empty())
+    pthread_cond_wait(&data_written_cond_, &shared_state_lock_);
+  bool write_error = write_error_ || aborted_;
+  pthread_mutex_unlock(&shared_state_lock_);
+  return !write_error;
+}
+
+void CompressorIOJavaScriptStream::DiscardEntry() {
+  discarded_chunks_ += pending_chunks_;
+  pending_chunks_ = 0;
+  read_chunks_.clear();
+  read_chunk_offset_ = 0;
+  read_error_ = false;
+}
+
+void CompressorIOJavaScriptStream::StartEntry(int entry_id,
+                                              int64_t file_size) {
   pthread_mutex_lock(&shared_state_lock_);
+  DiscardEntry();
+  entry_id_ = entry_id;
+  unrequested_bytes_ = file_size;
+  RequestChunksAhead();
+  pthread_mutex_unlock(&shared_state_lock_);
+}
+
+void CompressorIOJavaScriptStream::StartEntryWithContents(
+    int entry_id,
+    const pp::VarArrayBuffer& contents) {
+  pthread_mutex_lock(&shared_state_lock_);
+  DiscardEntry();
+  entry_id_ = entry_id;
+  unrequested_bytes_ = 0;
+  if (contents.ByteLength() > 0)
+    read_chunks_.push_back(contents);
+  pthread_mutex_unlock(&shared_state_lock_);
+}
 
-  destination_buffer_ = destination_buffer;
-  requestor_->ReadFileChunkRequest(bytes_to_read);
+int64_t CompressorIOJavaScriptStream::Read(int64_t bytes_to_read,
+                                           pp::VarArrayBuffer* buffer) {
+  pthread_mutex_lock(&shared_state_lock_);
 
-  while (!available_data_) {
-    pthread_cond_wait(&available_data_cond_, &shared_state_lock_);
+  int64_t read_bytes = 0;
+  // The chunks are copied into buffer only if they don't match the read.
+  char* destination_buffer = NULL;
+  while (read_bytes < bytes_to_read) {
+    if (read_error_ || aborted_) {
+      read_bytes = -1;
+      break;
+    }
+
+    if (read_chunks_.empty()) {
+      // Request the data if it was not requested ahead, e.g. if the entry is
+      // bigger than told to StartEntry().
+      if (pending_chunks_ == 0) {
+        if (unrequested_bytes_ > 0)
+          RequestChunksAhead();
+        else
+          RequestChunk(bytes_to_read - read_bytes);
+      }
+      // Let the pool run jobs of other compressors and volumes while
+      // JavaScript responds.
+      WorkerPool::WaitForSignal(&available_data_cond_, &shared_state_lock_);
+      continue;
+    }
+
+    pp::VarArrayBuffer& chunk = read_chunks_.front();
+    size_t chunk_size = chunk.ByteLength();
+    if (!destination_buffer && read_chunk_offset_ == 0 &&
+        static_cast<int64_t>(chunk_size) == bytes_to_read) {
+      *buffer = chunk;
+      read_chunks_.pop_front();
+      read_bytes = bytes_to_read;
+      break;
+    }
+
+    if (!destination_buffer) {
+      *buffer = pp::VarArrayBuffer(bytes_to_read);
+      destination_buffer = static_cast<char*>(buffer->Map());
+    }
+    size_t length = std::min(static_cast<size_t>(bytes_to_read - read_bytes),
+                             chunk_size - read_chunk_offset_);
+    memcpy(destination_buffer + read_bytes,
+           static_cast<char*>(chunk.Map()) + read_chunk_offset_, length);
+    chunk.Unmap();
+    read_bytes += length;
+    read_chunk_offset_ += length;
+    if (read_chunk_offset_ == chunk_size) {
+      read_chunks_.pop_front();
+      read_chunk_offset_ = 0;
+    }
   }
+  if (destination_buffer)
+    buffer->Unmap();
 
-  int64_t read_bytes = read_bytes_;
-  available_data_ = false;
+  // Request the next chunks, so they are read while this one is compressed.
+  RequestChunksAhead();
   pthread_mutex_unlock(&shared_state_lock_);
   return read_bytes;
 }
@@ -69,16 +205,49 @@ void CompressorIOJavaScriptStream::ReadFileChunkDone(int64_t read_bytes,
       pp::VarArrayBuffer* array_buffer) {
   pthread_mutex_lock(&shared_state_lock_);
 
+  // The data of a previous entry is not read anymore.
+  if (discarded_chunks_ > 0) {
+    --discarded_chunks_;
+    pthread_mutex_unlock(&shared_state_lock_);
+    return;
+  }
+
+  PP_DCHECK(pending_chunks_ > 0);
+  --pending_chunks_;
   // JavaScript sets a negative value in read_bytes if an error occurred while
-  // reading a chunk.
-  if (read_bytes >= 0) {
-    char* array_buffer_data = static_cast<char*>(array_buffer->Map());
-    memcpy(destination_buffer_, array_buffer_data, read_bytes);
-    array_buffer->Unmap();
+  // reading a chunk. The buffer is kept as it is, Read() passes it on.
+  if (read_bytes < 0 ||
+      static_cast<int64_t>(array_buffer->ByteLength()) != read_bytes) {
+    read_error_ = true;
+  } else if (read_bytes > 0) {
+    read_chunks_.push_back(*array_buffer);
   }
 
-  read_bytes_ = read_bytes;
-  available_data_ = true;
   pthread_cond_signal(&available_data_cond_);
   pthread_mutex_unlock(&shared_state_lock_);
 }
+
+void CompressorIOJavaScriptStream::Abort() {
+  pthread_mutex_lock(&shared_state_lock_);
+  aborted_ = true;
+  pthread_cond_broadcast(&available_data_cond_);
+  pthread_cond_broadcast(&data_written_cond_);
+  pthread_mutex_unlock(&shared_state_lock_);
+}
+
+void CompressorIOJavaScriptStream::RequestChunk(int64_t length) {
+  ++pending_chunks_;
+  requestor_->ReadFileChunkRequest(entry_id_, length);
+}
+
+void CompressorIOJavaScriptStream::RequestChunksAhead() {
+  while (!aborted_ && unrequested_bytes_ > 0 &&
+         pending_chunks_ + read_chunks_.size() <
+             compressor_stream_constants::kMaximumReadAheadChunks) {
+    int64_t length =
+        std::min(unrequested_bytes_,
+                 compressor_archive_constants::kMaximumDataChunkSize);
+    unrequested_bytes_ -= length;
+    RequestChunk(length);
+  }
+}
@@ -6,7 +6,10 @@
 #define COMPRESSOR_IO_JAVSCRIPT_STREAM_H_
 
 #include <pthread.h>
+
+#include <deque>
 #include <string>
+#include <vector>
 
 #include "archive.h"
 #include "ppapi/cpp/instance_handle.h"
@@ -18,6 +21,17 @@
 #include "compressor_stream.h"
 #include "javascript_compressor_requestor_interface.h"
 
+// A namespace with constants used by CompressorIOJavaScriptStream.
+namespace compressor_stream_constants {
+// The maximum number of chunks of an entry requested from JavaScript and not
+// read yet. The next chunks are read by JavaScript while the current one is
+// compressed, up to this many chunks of kMaximumDataChunkSize bytes.
+const size_t kMaximumReadAheadChunks = 2;
+// The maximum number of chunks sent to JavaScript by Write() and not written
+// yet. Write() waits for JavaScript beyond it.
+const size_t kMaximumPendingWrites = 4;
+}  // namespace compressor_stream_constants
+
 class CompressorIOJavaScriptStream : public CompressorStream {
  public:
   CompressorIOJavaScriptStream(
@@ -25,17 +39,41 @@ class CompressorIOJavaScriptStream : public CompressorStream {
 
   virtual ~CompressorIOJavaScriptStream();
 
+  virtual pp::VarArrayBuffer GetWriteBuffer();
+
   virtual int64_t Write(int64_t bytes_to_read,
                         const pp::VarArrayBuffer& buffer);
 
   virtual void WriteChunkDone(int64_t write_bytes);
 
-  virtual int64_t Read(int64_t bytes_to_read, char* destination_buffer);
+  virtual bool Flush();
+
+  virtual void StartEntry(int entry_id, int64_t file_size);
+
+  virtual void StartEntryWithContents(int entry_id,
+                                      const pp::VarArrayBuffer& contents);
+
+  virtual int64_t Read(int64_t bytes_to_read, pp::VarArrayBuffer* buffer);
 
   virtual void ReadFileChunkDone(int64_t read_bytes,
                                  pp::VarArrayBuffer* buffer);
 
+  virtual void Abort();
+
 private:
+  // Discards the data of the previous entry. Must be called with
+  // shared_state_lock_ acquired.
+  void DiscardEntry();
+
+  // Sends a read file chunk request for length bytes. Must be called with
+  // shared_state_lock_ acquired.
+  void RequestChunk(int64_t length);
+
+  // Requests the next chunks of the entry, as long as there are less than
+  // kMaximumReadAheadChunks chunks requested and not read. Must be called
+  // with shared_state_lock_ acquired.
+  void RequestChunksAhead();
+
   // A requestor that makes calls to JavaScript to read and write chunks.
   JavaScriptCompressorRequestorInterface* requestor_;
 
@@ -43,21 +81,43 @@ private:
   pthread_cond_t available_data_cond_;
   pthread_cond_t data_written_cond_;
 
-  // The bytelength of the data written onto the archive for the last write
-  // chunk request. If this value is negative, some error occurred when writing
-  // a chunk in JavaScript.
-  int64_t written_bytes_;
+  // The buffers of the write chunk requests that JavaScript didn't respond to
+  // yet, in order.
+  std::deque<pp::VarArrayBuffer> pending_write_buffers_;
+
+  // The buffers written by JavaScript, returned by GetWriteBuffer().
+  std::vector<pp::VarArrayBuffer> free_write_buffers_;
+
+  // True if some error occurred when writing a chunk in JavaScript.
+  bool write_error_;
+
+  // The id of the entry being read, sent with the read file chunk requests.
+  // JavaScript may have sent the next entries already.
+  int entry_id_;
+
+  // The number of bytes of the entry not requested from JavaScript yet.
+  int64_t unrequested_bytes_;
+
+  // The number of read file chunk requests of the entry that JavaScript didn't
+  // respond to yet.
+  size_t pending_chunks_;
+
+  // The number of read file chunk requests of the previous entries that
+  // JavaScript didn't respond to yet. Their data is discarded.
+  size_t discarded_chunks_;
+
+  // The chunks read from JavaScript and not read by Read() yet, in order.
+  std::deque<pp::VarArrayBuffer> read_chunks_;
 
-  // The bytelength of the data read from the entry for the last read file chunk
-  // request. If this value is negative, some error occurred when reading a
-  // chunk in JavaScript.
-  int64_t read_bytes_;
+  // The number of bytes of the first of read_chunks_ already read by Read().
+  size_t read_chunk_offset_;
 
-  // True if destination_buffer_ is available.
-  bool available_data_;
+  // True if some error occurred when reading a chunk of the entry in
+  // JavaScript.
+  bool read_error_;
 
-  // Stores the data read from JavaScript.
-  char* destination_buffer_;
+  // True once Abort() was called.
+  bool aborted_;
 };
 
 #endif  // COMPRESSOR_IO_JAVSCRIPT_STREAM_H_
@@ -7,36 +7,69 @@
 
 #include <string>
 
+#include "ppapi/cpp/var_array_buffer.h"
+
 // A IO class that reads and writes data from and to files through JavaScript.
-// Currently, Read() and Write() methods are not called at the same time.
-// To improve the performance, these should be called in parallel by preparing
-// two buffers and calling them with these buffers alternatively.
+// Read() and Write() can be called at the same time from two threads, e.g.
+// CompressorArchiveZip reads the next entries while a job writes the previous
+// ones, but neither of them can be called by two threads at the same time.
 class CompressorStream {
  public:
   virtual ~CompressorStream() {}
 
-  // Writes the given buffer onto the archive. After sending a write chunk
-  // request to JavaScript, it waits until WriteChunkDone() is called in the
-  // main thread. Thus, This method must not be called in the main thread.
+  // Returns an array buffer of kMaximumDataChunkSize bytes to fill and to pass
+  // to Write(), so that the data is not copied again before it's sent. The
+  // buffers are reused once JavaScript wrote them.
+  virtual pp::VarArrayBuffer GetWriteBuffer() = 0;
+
+  // Writes the first bytes_to_write bytes of the given buffer onto the
+  // archive. The buffer is sent to JavaScript and written while the next data
+  // is compressed, so buffer must not be modified afterwards. If too many
+  // chunks are not written yet, it waits until WriteChunkDone() is called in
+  // the main thread. Thus, This method must not be called in the main thread.
+  // Returns a negative value if writing a previous chunk failed.
   virtual int64_t Write(int64_t bytes_to_write,
                         const pp::VarArrayBuffer& buffer) = 0;
 
   // Called when write chunk done response arrives from JavaScript. Sends a
-  // signal to invoke Write function in another thread again.
+  // signal to invoke Write or Flush function in another thread again.
   virtual void WriteChunkDone(int64_t write_bytes) = 0;
 
-  // Reads a file chunk from the entry that is currently being processed. After
-  // sending a read file chunk request to JavaScript, it waits until
+  // Waits until all the chunks passed to Write() are written onto the archive.
+  // Returns false if writing any of them failed. Must not be called in the
+  // main thread.
+  virtual bool Flush() = 0;
+
+  // Called before the data of the entry with entry_id, of file_size bytes, is
+  // read, so that the chunks of the entry can be requested from JavaScript
+  // ahead of Read(). The data of the previous entry that was not read is
+  // discarded.
+  virtual void StartEntry(int entry_id, int64_t file_size) = 0;
+
+  // Like StartEntry(), but for an entry whose data was sent by JavaScript
+  // along with the entry. Read() returns contents without requesting
+  // anything from JavaScript.
+  virtual void StartEntryWithContents(int entry_id,
+                                      const pp::VarArrayBuffer& contents) = 0;
+
+  // Reads a file chunk from the entry that is currently being processed into
+  // buffer. buffer is set to the array buffer received from JavaScript, so the
+  // data is not copied, unless bytes_to_read doesn't match the chunks read
+  // ahead. If the chunk was not read ahead, it waits until
   // ReadFileChunkDone() is called in the main thread. Thus, This method must
   // not be called in the main thread.
-  virtual int64_t Read(int64_t bytes_to_read, char* destination_buffer) = 0;
+  virtual int64_t Read(int64_t bytes_to_read, pp::VarArrayBuffer* buffer) = 0;
 
-  // Called when read file chunk done response arrives from JavaScript. Copies
-  // the binary data in the given buffer to destination_buffer_ and Sends a
-  // signal to invoke Read function in another thread again. buffer must not be
-  // const because buffer.Map() and buffer.Unmap() can not be called with const.
+  // Called when read file chunk done response arrives from JavaScript. Keeps
+  // the given buffer for Read() and Sends a signal to invoke Read function in
+  // another thread again.
   virtual void ReadFileChunkDone(int64_t read_bytes,
                                  pp::VarArrayBuffer* buffer) = 0;
+
+  // Makes Read(), Write() and Flush() fail from now on, including the calls
+  // waiting for JavaScript, and stops requesting chunks. Called once
+  // JavaScript doesn't respond anymore, e.g. after an error.
+  virtual void Abort() = 0;
 };
 
 #endif  // COMPRESSOR_STREAM_H_
@@ -15,7 +15,7 @@ class JavaScriptCompressorRequestorInterface {
   virtual void WriteChunkRequest(int64_t length,
                                  const pp::VarArrayBuffer& buffer) = 0;
 
-  virtual void ReadFileChunkRequest(int64_t length) = 0;
+  virtual void ReadFileChunkRequest(int entry_id, int64_t length) = 0;
 };
 
 #endif  // JAVASCRIPT_COMPRESSOR_REQUESTOR_INTERFACE_H_
@@ -29,11 +29,30 @@ class JavaScriptMessageSenderInterface {
 
   virtual void SendReadMetadataDone(const std::string& file_system_id,
                                     const std::string& request_id,
-                                    const pp::VarDictionary& metadata) = 0;
+                                    const pp::Var& metadata,
+                                    const pp::Var& metadata_cache) = 0;
+
+  virtual void SendReadMetadataProgress(
+      const std::string& file_system_id,
+      const std::string& request_id,
+      const pp::VarArrayBuffer& metadata) = 0;
+
+  virtual void SendReadDirectoryDone(const std::string& file_system_id,
+                                     const std::string& request_id,
+                                     const pp::VarArray& entries) = 0;
+
+  virtual void SendGetMetadataDone(const std::string& file_system_id,
+                                   const std::string& request_id,
+                                   const pp::VarDictionary& metadata) = 0;
 
   virtual void SendOpenFileDone(const std::string& file_system_id,
                                 const std::string& request_id) = 0;
 
+  virtual void SendOpenFileByPathDone(const std::string& file_system_id,
+                                      const std::string& request_id,
+                                      int64_t index,
+                                      int64_t size) = 0;
+
   virtual void SendCloseFileDone(const std::string& file_system_id,
                                  const std::string& request_id,
                                  const std::string& open_request_id) = 0;
@@ -43,6 +62,21 @@ class JavaScriptMessageSenderInterface {
                                 const pp::VarArrayBuffer& array_buffer,
                                 bool has_more_data) = 0;
 
+  virtual void SendExtractEntry(const std::string& file_system_id,
+                                const std::string& request_id,
+                                int64_t index,
+                                const std::string& path,
+                                int64_t size) = 0;
+
+  virtual void SendExtractData(const std::string& file_system_id,
+                               const std::string& request_id,
+                               int64_t index,
+                               const pp::VarArrayBuffer& array_buffer,
+                               bool has_more_data) = 0;
+
+  virtual void SendExtractDone(const std::string& file_system_id,
+                               const std::string& request_id) = 0;
+
   virtual void SendConsoleLog(const std::string& file_system_id,
                               const std::string& request_id,
                               const std::string& src_file,
@@ -53,13 +87,14 @@ class JavaScriptMessageSenderInterface {
   virtual void SendCreateArchiveDone(int compressor_id) = 0;
 
   virtual void SendReadFileChunk(int compressor_id_,
+                                 int entry_id,
                                  int64_t file_size) = 0;
 
   virtual void SendWriteChunk(int compressor_id,
                               const pp::VarArrayBuffer& array_buffer,
                               int64_t length) = 0;
 
-  virtual void SendAddToArchiveDone(int compressor_id) = 0;
+  virtual void SendAddToArchiveDone(int compressor_id, int entry_id) = 0;
 
   virtual void SendCloseArchiveDone(int compressor_id) = 0;
 };
@@ -0,0 +1,439 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "metadata_tree.h"
+
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+#include "ppapi/cpp/logging.h"
+
+namespace {
+
+const char kPathDelimiter = '/';
+
+// size is int64_t and modification_time is time_t because this is how
+// libarchive is going to pass them to us.
+pp::VarDictionary CreateEntry(int64_t index,
+                              const std::string& name,
+                              bool is_directory,
+                              int64_t size,
+                              time_t modification_time) {
+  pp::VarDictionary entry_metadata;
+  // index is int64_t, unsupported by pp::Var
+  std::stringstream ss_index;
+  ss_index << index;
+  entry_metadata.Set("index", ss_index.str());
+  entry_metadata.Set("isDirectory", is_directory);
+  entry_metadata.Set("name", name);
+  // size is int64_t, unsupported by pp::Var
+  std::stringstream ss_size;
+  ss_size << size;
+  entry_metadata.Set("size", ss_size.str());
+  // mtime is time_t, unsupported by pp::Var
+  std::stringstream ss_modification_time;
+  ss_modification_time << modification_time;
+  entry_metadata.Set("modificationTime", ss_modification_time.str());
+
+  return entry_metadata;
+}
+
+// Normalize a path by:
+// - remove all leading / and ./ and ../
+// - turn all // into /
+// - turn all /./ into /
+// - TODO canonicalize /../
+std::string normpath(const std::string& path) {
+  std::string ret = path;
+  size_t i;
+
+  // Removing all leading "/" and "./" and "../".
+  do {
+    i = ret.length();
+
+    if (ret[0] == '/')
+      ret.erase(0, 1);
+
+    if (ret.compare(0, 2, "./") == 0)
+      ret.erase(0, 2);
+
+    if (ret.compare(0, 3, "../") == 0)
+      ret.erase(0, 3);
+  } while (i != ret.length());
+
+  // Turn runs of "//" and "/./" into a single "/".
+  i = 0;
+  while (i < ret.length()) {
+    if (ret.compare(i, 2, "//") == 0) {
+      ret.erase(i, 1);
+      continue;
+    }
+
+    if (ret.compare(i, 3, "/./") == 0) {
+      ret.erase(i, 2);
+      continue;
+    }
+
+    ++i;
+  }
+
+  return ret;
+}
+
+// Writes value at destination in little endian order.
+void WriteUint32(uint32_t value, uint8_t* destination) {
+  for (int i = 0; i < 4; ++i)
+    destination[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+// Writes value at destination as a little endian IEEE 754 double.
+void WriteFloat64(double value, uint8_t* destination) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0; i < 8; ++i)
+    destination[i] = static_cast<uint8_t>(bits >> (8 * i));
+}
+
+// Reads a little endian value written by WriteUint32.
+uint32_t ReadUint32(const uint8_t* source) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i)
+    value |= static_cast<uint32_t>(source[i]) << (8 * i);
+  return value;
+}
+
+// Reads a little endian value written by WriteFloat64.
+double ReadFloat64(const uint8_t* source) {
+  uint64_t bits = 0;
+  for (int i = 0; i < 8; ++i)
+    bits |= static_cast<uint64_t>(source[i]) << (8 * i);
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+const MetadataTree::NodeId MetadataTree::kNoNode;
+const MetadataTree::NodeId MetadataTree::kRootNode;
+
+MetadataTree::Node::Node(NameId name,
+                         int64_t index,
+                         int64_t size,
+                         bool is_directory,
+                         int64_t modification_time)
+    : name(name),
+      index(index),
+      size(size),
+      modification_time(modification_time),
+      is_directory(is_directory),
+      parent(kNoNode),
+      first_child(kNoNode),
+      last_child(kNoNode),
+      next_sibling(kNoNode) {}
+
+MetadataTree::MetadataTree() {
+  nodes_.push_back(Node(InternName(""), -1, 0, true, 0));
+}
+
+MetadataTree::~MetadataTree() {}
+
+void MetadataTree::AddEntry(int64_t index,
+                            const std::string& path,
+                            int64_t size,
+                            bool is_directory,
+                            time_t modification_time) {
+  // Normalize the path.  The FSP layers can't handle anything weird.
+  std::string entry_path = normpath(path);
+
+  // If, after all the stripping, the path is empty, skip it.
+  if (entry_path.empty())
+    return;
+
+  NodeId parent = kRootNode;
+  size_t start = 0;
+  for (;;) {
+    size_t position = entry_path.find(kPathDelimiter, start);
+
+    if (position == std::string::npos) {  // The entry itself.
+      NameId name = InternName(entry_path.substr(start));
+      Node entry(name, index, size, is_directory, modification_time);
+
+      // Update directory information. Required as sometimes the directory
+      // itself is returned after the files inside it.
+      NodeId node_id = FindChild(parent, name);
+      if (node_id == kNoNode) {
+        AddChild(parent, entry);
+      } else {
+        Node& node = nodes_[node_id];
+        PP_DCHECK(node.is_directory);
+        node.index = entry.index;
+        node.size = entry.size;
+        node.modification_time = entry.modification_time;
+        node.is_directory = entry.is_directory;
+      }
+      return;
+    }
+
+    // Get next parent on the way to the entry. If none, create a new
+    // directory entry for it. Some archives don't have directory information
+    // inside and for some the information is returned later than the files
+    // inside it.
+    NameId name = InternName(entry_path.substr(start, position - start));
+    NodeId node_id = FindChild(parent, name);
+    if (node_id == kNoNode) {
+      node_id = AddChild(parent,
+                         Node(name, -1, 0, true /* is_directory */,
+                              modification_time));
+    }
+
+    parent = node_id;
+    start = position + 1;
+    // A trailing delimiter, so the path was a directory already created above.
+    if (start == entry_path.length())
+      return;
+  }
+}
+
+pp::VarDictionary MetadataTree::ToVarDictionary() const {
+  return NodeToVarDictionary(kRootNode);
+}
+
+pp::VarArrayBuffer MetadataTree::ToVarArrayBuffer() const {
+  return ToVarArrayBuffer(kRootNode);
+}
+
+pp::VarArrayBuffer MetadataTree::ToVarArrayBuffer(size_t first_node) const {
+  using namespace metadata_tree_constants;
+  PP_DCHECK(first_node <= nodes_.size());
+
+  // Lay out the string table, where every name used by the nodes is stored
+  // once.
+  std::unordered_map<NameId, uint32_t> name_offsets;
+  std::vector<NameId> table_names;
+  uint32_t string_table_size = 0;
+  for (size_t i = first_node; i < nodes_.size(); ++i) {
+    NameId name = nodes_[i].name;
+    if (name_offsets.insert(std::make_pair(name, string_table_size)).second) {
+      table_names.push_back(name);
+      string_table_size += names_[name].length();
+    }
+  }
+
+  uint32_t count = nodes_.size() - first_node;
+  uint32_t string_table_offset = kBinaryHeaderSize + count * kBinaryRecordSize;
+  pp::VarArrayBuffer array_buffer(string_table_offset + string_table_size);
+  uint8_t* data = static_cast<uint8_t*>(array_buffer.Map());
+
+  WriteUint32(kBinaryFormatVersion, data);
+  WriteUint32(count, data + 4);
+  WriteUint32(string_table_offset, data + 8);
+  WriteUint32(string_table_size, data + 12);
+  WriteUint32(first_node, data + 16);
+
+  // Node ids are used as record numbers. A child is always added after its
+  // parent, so parents come first as required by the format.
+  uint8_t* record = data + kBinaryHeaderSize;
+  for (size_t i = first_node; i < nodes_.size(); ++i) {
+    const Node& node = nodes_[i];
+    WriteUint32(node.parent == kNoNode ? kBinaryNoParent : node.parent,
+                record);
+    WriteUint32(name_offsets[node.name], record + 4);
+    WriteUint32(names_[node.name].length(), record + 8);
+    WriteUint32(node.is_directory ? kBinaryDirectoryFlag : 0, record + 12);
+    WriteFloat64(node.index, record + 16);
+    WriteFloat64(node.size, record + 24);
+    WriteFloat64(node.modification_time, record + 32);
+    record += kBinaryRecordSize;
+  }
+
+  uint8_t* string_table = data + string_table_offset;
+  for (size_t i = 0; i < table_names.size(); ++i) {
+    const std::string& name = names_[table_names[i]];
+    memcpy(string_table, name.data(), name.length());
+    string_table += name.length();
+  }
+
+  array_buffer.Unmap();
+  return array_buffer;
+}
+
+MetadataTree* MetadataTree::FromBinary(const uint8_t* data, size_t size) {
+  using namespace metadata_tree_constants;
+  if (size < kBinaryHeaderSize || ReadUint32(data) != kBinaryFormatVersion)
+    return NULL;
+
+  uint32_t count = ReadUint32(data + 4);
+  uint64_t string_table_offset = ReadUint32(data + 8);
+  uint64_t string_table_size = ReadUint32(data + 12);
+  // Only a whole tree has the root as its first record.
+  if (count == 0 || ReadUint32(data + 16) != 0 ||
+      string_table_offset !=
+          kBinaryHeaderSize + static_cast<uint64_t>(count) * kBinaryRecordSize ||
+      string_table_offset + string_table_size > size) {
+    return NULL;
+  }
+
+  const char* string_table =
+      reinterpret_cast<const char*>(data + string_table_offset);
+  MetadataTree* metadata_tree = new MetadataTree();
+  const uint8_t* record = data + kBinaryHeaderSize;
+  for (uint32_t i = 0; i < count; ++i, record += kBinaryRecordSize) {
+    uint32_t parent = ReadUint32(record);
+    uint64_t name_offset = ReadUint32(record + 4);
+    uint32_t name_length = ReadUint32(record + 8);
+    // Parents come before their children, so the record numbers are the node
+    // ids the records had when written.
+    if (name_offset + name_length > string_table_size ||
+        (i == 0) != (parent == kBinaryNoParent) ||
+        (i > 0 && parent >= i)) {
+      delete metadata_tree;
+      return NULL;
+    }
+
+    Node node(metadata_tree->InternName(
+                  std::string(string_table + name_offset, name_length)),
+              ReadFloat64(record + 16), ReadFloat64(record + 24),
+              (ReadUint32(record + 12) & kBinaryDirectoryFlag) != 0,
+              ReadFloat64(record + 32));
+    if (i == 0)
+      metadata_tree->nodes_[kRootNode] = node;
+    else
+      metadata_tree->AddChild(parent, node);
+  }
+  return metadata_tree;
+}
+
+MetadataTree::Result MetadataTree::GetEntryMetadata(
+    const std::string& path,
+    pp::VarDictionary* entry_metadata) const {
+  NodeId node_id = FindNode(path);
+  if (node_id == kNoNode)
+    return RESULT_NOT_FOUND;
+
+  *entry_metadata = NodeToEntryMetadata(node_id);
+  return RESULT_SUCCESS;
+}
+
+MetadataTree::Result MetadataTree::ReadDirectory(const std::string& path,
+                                                 pp::VarArray* entries) const {
+  NodeId node_id = FindNode(path);
+  if (node_id == kNoNode)
+    return RESULT_NOT_FOUND;
+  if (!nodes_[node_id].is_directory && nodes_[node_id].first_child == kNoNode)
+    return RESULT_NOT_A_DIRECTORY;
+
+  uint32_t length = 0;
+  for (NodeId child = nodes_[node_id].first_child; child != kNoNode;
+       child = nodes_[child].next_sibling) {
+    entries->Set(length++, NodeToEntryMetadata(child));
+  }
+  entries->SetLength(length);
+  return RESULT_SUCCESS;
+}
+
+MetadataTree::Result MetadataTree::FindEntry(const std::string& path,
+                                             int64_t* index,
+                                             int64_t* size,
+                                             bool* is_directory) const {
+  NodeId node_id = FindNode(path);
+  if (node_id == kNoNode)
+    return RESULT_NOT_FOUND;
+
+  const Node& node = nodes_[node_id];
+  *index = node.index;
+  *size = node.size;
+  *is_directory = node.is_directory;
+  return RESULT_SUCCESS;
+}
+
+std::string MetadataTree::NormalizePath(const std::string& path) {
+  std::string normalized_path = normpath(path);
+  while (!normalized_path.empty() &&
+         normalized_path[normalized_path.length() - 1] == kPathDelimiter) {
+    normalized_path.erase(normalized_path.length() - 1);
+  }
+  return normalized_path;
+}
+
+MetadataTree::NameId MetadataTree::InternName(const std::string& name) {
+  std::unordered_map<std::string, NameId>::const_iterator it =
+      name_ids_.find(name);
+  if (it != name_ids_.end())
+    return it->second;
+
+  NameId name_id = names_.size();
+  names_.push_back(name);
+  name_ids_[name] = name_id;
+  return name_id;
+}
+
+MetadataTree::NodeId MetadataTree::FindChild(NodeId parent,
+                                             NameId name) const {
+  std::unordered_map<uint64_t, NodeId>::const_iterator it =
+      children_.find(static_cast<uint64_t>(parent) << 32 | name);
+  return it != children_.end() ? it->second : kNoNode;
+}
+
+MetadataTree::NodeId MetadataTree::AddChild(NodeId parent, const Node& node) {
+  NodeId node_id = nodes_.size();
+  nodes_.push_back(node);
+  nodes_.back().parent = parent;
+
+  Node& parent_node = nodes_[parent];
+  if (parent_node.last_child == kNoNode)
+    parent_node.first_child = node_id;
+  else
+    nodes_[parent_node.last_child].next_sibling = node_id;
+  parent_node.last_child = node_id;
+
+  children_[static_cast<uint64_t>(parent) << 32 | node.name] = node_id;
+  return node_id;
+}
+
+MetadataTree::NodeId MetadataTree::FindNode(const std::string& path) const {
+  NodeId node_id = kRootNode;
+  size_t start = 0;
+  while (start < path.length()) {
+    size_t position = path.find(kPathDelimiter, start);
+    if (position == std::string::npos)
+      position = path.length();
+
+    // Skip the leading and trailing delimiters.
+    if (position > start) {
+      std::unordered_map<std::string, NameId>::const_iterator it =
+          name_ids_.find(path.substr(start, position - start));
+      if (it == name_ids_.end())
+        return kNoNode;
+      node_id = FindChild(node_id, it->second);
+      if (node_id == kNoNode)
+        return kNoNode;
+    }
+    start = position + 1;
+  }
+  return node_id;
+}
+
+pp::VarDictionary MetadataTree::NodeToEntryMetadata(NodeId node_id) const {
+  const Node& node = nodes_[node_id];
+  return CreateEntry(node.index, names_[node.name], node.is_directory,
+                     node.size, node.modification_time);
+}
+
+pp::VarDictionary MetadataTree::NodeToVarDictionary(NodeId node_id) const {
+  const Node& node = nodes_[node_id];
+  pp::VarDictionary entry_metadata = NodeToEntryMetadata(node_id);
+
+  if (node.is_directory || node.first_child != kNoNode) {
+    pp::VarDictionary entries;
+    for (NodeId child = node.first_child; child != kNoNode;
+         child = nodes_[child].next_sibling) {
+      entries.Set(names_[nodes_[child].name], NodeToVarDictionary(child));
+    }
+    entry_metadata.Set("entries", entries);
+  }
+
+  return entry_metadata;
+}
@@ -0,0 +1,191 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef METADATA_TREE_H_
+#define METADATA_TREE_H_
+
+#include <stdint.h>
+
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ppapi/cpp/var_array.h"
+#include "ppapi/cpp/var_array_buffer.h"
+#include "ppapi/cpp/var_dictionary.h"
+
+// A namespace with constants used by MetadataTree.
+namespace metadata_tree_constants {
+
+// The binary format of MetadataTree::ToVarArrayBuffer. All the integers are
+// little endian. The format starts with a header of 5 uint32 values: the
+// format version, the number of entries, the offset of the string table, its
+// size in bytes and the number of the first record. The header is followed by
+// the entry records and then by the string table, which contains the UTF-8
+// names of the entries with no separators.
+//
+// Records are numbered consecutively starting with the first record number,
+// which is 0 for a whole tree and greater for the records added to a tree
+// after a previous conversion. Every entry record contains, in order:
+// - uint32 parent: the number of the parent record, kBinaryNoParent for root.
+//   Parents are always before their children, possibly in a previous buffer.
+// - uint32 name offset and uint32 name length in the string table.
+// - uint32 flags: kBinaryDirectoryFlag for directories.
+// - float64 index, float64 size and float64 modification time.
+//
+// Should be the same as the format decoded by js/volume.js.
+const uint32_t kBinaryFormatVersion = 1;
+const uint32_t kBinaryHeaderSize = 20;
+const uint32_t kBinaryRecordSize = 40;
+const uint32_t kBinaryNoParent = 0xffffffff;
+const uint32_t kBinaryDirectoryFlag = 1;
+
+}  // namespace metadata_tree_constants
+
+// The metadata of the entries of an archive, organized as a directory tree.
+// The tree is built natively while reading the headers and converted to
+// pp::Var(s) only once, as updating nested pp::VarDictionary(s) for every
+// entry is expensive for archives with many entries.
+//
+// Path components are interned, every node keeps its children in a linked
+// list of node ids and children are looked up by (parent, name) in a hash map,
+// so adding an entry costs O(path length) without any pp::Var operations.
+class MetadataTree {
+ public:
+  // The result of looking up an entry by path.
+  enum Result {
+    RESULT_SUCCESS,
+    RESULT_NOT_FOUND,
+    RESULT_NOT_A_DIRECTORY
+  };
+
+  MetadataTree();
+
+  virtual ~MetadataTree();
+
+  // Adds the entry with the given path to the tree. The path is normalized
+  // first and entries with an empty path are ignored. Directories on the path
+  // that weren't added yet are created with index -1, a size of 0 and
+  // modification_time. In case the entry already exists, as some archives
+  // list directories after the files inside them, its metadata is replaced
+  // and its children are kept.
+  void AddEntry(int64_t index,
+                const std::string& path,
+                int64_t size,
+                bool is_directory,
+                time_t modification_time);
+
+  // Converts the tree to the format expected by JavaScript: a dictionary for
+  // the root directory where every directory has its children in "entries",
+  // keyed by name.
+  pp::VarDictionary ToVarDictionary() const;
+
+  // Converts the tree to a single pp::VarArrayBuffer in the binary format
+  // described in metadata_tree_constants. Much cheaper to create and to send
+  // to JavaScript than the pp::VarDictionary(s) of ToVarDictionary.
+  pp::VarArrayBuffer ToVarArrayBuffer() const;
+
+  // Same as above, but only with the nodes starting with first_node, which
+  // are the nodes added after node_count() was first_node. Nodes changed by
+  // AddEntry before that are not included. Used to send a tree in parts while
+  // it is being built.
+  pp::VarArrayBuffer ToVarArrayBuffer(size_t first_node) const;
+
+  // Creates a tree from size bytes at data in the format of ToVarArrayBuffer,
+  // which must describe a whole tree. Returns NULL if the data is not valid.
+  // The caller owns the returned tree.
+  static MetadataTree* FromBinary(const uint8_t* data, size_t size);
+
+  // Sets *entry_metadata to the metadata of the entry at path, in the format
+  // of ToVarDictionary but without "entries". path is absolute, like the paths
+  // used by the File System Provider API, e.g. "/dir/file".
+  Result GetEntryMetadata(const std::string& path,
+                          pp::VarDictionary* entry_metadata) const;
+
+  // Sets *entries to the metadata of the children of the directory at path,
+  // each one in the format of GetEntryMetadata.
+  Result ReadDirectory(const std::string& path, pp::VarArray* entries) const;
+
+  // Sets *index, *size and *is_directory to the metadata of the entry at path,
+  // which is absolute like for GetEntryMetadata.
+  Result FindEntry(const std::string& path,
+                   int64_t* index,
+                   int64_t* size,
+                   bool* is_directory) const;
+
+  // Normalizes path the way AddEntry does and removes the trailing delimiter,
+  // so the path of a header can be compared with a path for GetEntryMetadata
+  // normalized the same way, e.g. "./dir/file" with "/dir/file".
+  static std::string NormalizePath(const std::string& path);
+
+  // The number of nodes in the tree, including the root and the directories
+  // created for the paths of entries.
+  size_t node_count() const { return nodes_.size(); }
+
+ private:
+  typedef uint32_t NodeId;
+  typedef uint32_t NameId;
+
+  // A file or directory of the tree.
+  struct Node {
+    Node(NameId name,
+         int64_t index,
+         int64_t size,
+         bool is_directory,
+         int64_t modification_time);
+
+    NameId name;
+    int64_t index;
+    int64_t size;
+    int64_t modification_time;
+    bool is_directory;
+
+    // The parent directory. kNoNode for the root.
+    NodeId parent;
+
+    // The children of the node as a linked list. kNoNode for no node.
+    NodeId first_child;
+    NodeId last_child;
+    NodeId next_sibling;
+  };
+
+  // Marks the end of a list of children.
+  static const NodeId kNoNode = 0xffffffff;
+
+  // The root directory. Always the first node.
+  static const NodeId kRootNode = 0;
+
+  // Returns the id of name, interning it if not seen before.
+  NameId InternName(const std::string& name);
+
+  // Returns the child of parent with the given name or kNoNode if none.
+  NodeId FindChild(NodeId parent, NameId name) const;
+
+  // Appends a new node to the children of parent and returns its id.
+  NodeId AddChild(NodeId parent, const Node& node);
+
+  // Returns the node at the absolute path or kNoNode if none.
+  NodeId FindNode(const std::string& path) const;
+
+  // Converts a node to a pp::VarDictionary, without its children.
+  pp::VarDictionary NodeToEntryMetadata(NodeId node_id) const;
+
+  // Converts a node and its children to pp::VarDictionary(s).
+  pp::VarDictionary NodeToVarDictionary(NodeId node_id) const;
+
+  // The nodes of the tree, indexed by NodeId.
+  std::vector<Node> nodes_;
+
+  // The interned names, indexed by NameId.
+  std::vector<std::string> names_;
+
+  // Maps a name to its NameId.
+  std::unordered_map<std::string, NameId> name_ids_;
+
+  // Maps (parent NodeId << 32 | child NameId) to the child NodeId.
+  std::unordered_map<uint64_t, NodeId> children_;
+};
+
+#endif  // METADATA_TREE_H_
@@ -3,7 +3,9 @@
 // found in the LICENSE file.
 
 #include <clocale>
+#include <set>
 #include <sstream>
+#include <vector>
 
 #include "ppapi/cpp/instance.h"
 #include "ppapi/cpp/instance_handle.h"
@@ -11,11 +13,12 @@
 #include "ppapi/cpp/module.h"
 #include "ppapi/cpp/var_dictionary.h"
 #include "ppapi/utility/threading/lock.h"
-#include "ppapi/utility/threading/simple_thread.h"
 
+#include "compressibility.h"
 #include "compressor.h"
 #include "request.h"
 #include "volume.h"
+#include "worker_pool.h"
 
 namespace {
 
@@ -63,8 +66,30 @@ class JavaScriptMessageSender : public JavaScriptMessageSenderInterface {
 
   virtual void SendReadMetadataDone(const std::string& file_system_id,
                                     const std::string& request_id,
-                                    const pp::VarDictionary& metadata) {
+                                    const pp::Var& metadata,
+                                    const pp::Var& metadata_cache) {
     JavaScriptPostMessage(request::CreateReadMetadataDoneResponse(
+        file_system_id, request_id, metadata, metadata_cache));
+  }
+
+  virtual void SendReadMetadataProgress(const std::string& file_system_id,
+                                        const std::string& request_id,
+                                        const pp::VarArrayBuffer& metadata) {
+    JavaScriptPostMessage(request::CreateReadMetadataProgressResponse(
+        file_system_id, request_id, metadata));
+  }
+
+  virtual void SendReadDirectoryDone(const std::string& file_system_id,
+                                     const std::string& request_id,
+                                     const pp::VarArray& entries) {
+    JavaScriptPostMessage(request::CreateReadDirectoryDoneResponse(
+        file_system_id, request_id, entries));
+  }
+
+  virtual void SendGetMetadataDone(const std::string& file_system_id,
+                                   const std::string& request_id,
+                                   const pp::VarDictionary& metadata) {
+    JavaScriptPostMessage(request::CreateGetMetadataDoneResponse(
         file_system_id, request_id, metadata));
   }
 
@@ -74,6 +99,14 @@ class JavaScriptMessageSender : public JavaScriptMessageSenderInterface {
         request::CreateOpenFileDoneResponse(file_system_id, request_id));
   }
 
+  virtual void SendOpenFileByPathDone(const std::string& file_system_id,
+                                      const std::string& request_id,
+                                      int64_t index,
+                                      int64_t size) {
+    JavaScriptPostMessage(request::CreateOpenFileByPathDoneResponse(
+        file_system_id, request_id, index, size));
+  }
+
   virtual void SendCloseFileDone(const std::string& file_system_id,
                                  const std::string& request_id,
                                  const std::string& open_request_id) {
@@ -89,6 +122,30 @@ class JavaScriptMessageSender : public JavaScriptMessageSenderInterface {
         file_system_id, request_id, array_buffer, has_more_data));
   }
 
+  virtual void SendExtractEntry(const std::string& file_system_id,
+                                const std::string& request_id,
+                                int64_t index,
+                                const std::string& path,
+                                int64_t size) {
+    JavaScriptPostMessage(request::CreateExtractEntryResponse(
+        file_system_id, request_id, index, path, size));
+  }
+
+  virtual void SendExtractData(const std::string& file_system_id,
+                               const std::string& request_id,
+                               int64_t index,
+                               const pp::VarArrayBuffer& array_buffer,
+                               bool has_more_data) {
+    JavaScriptPostMessage(request::CreateExtractDataResponse(
+        file_system_id, request_id, index, array_buffer, has_more_data));
+  }
+
+  virtual void SendExtractDone(const std::string& file_system_id,
+                               const std::string& request_id) {
+    JavaScriptPostMessage(
+        request::CreateExtractDoneResponse(file_system_id, request_id));
+  }
+
   virtual void SendConsoleLog(const std::string& file_system_id,
                               const std::string& request_id,
                               const std::string& src_file,
@@ -104,9 +161,11 @@ class JavaScriptMessageSender : public JavaScriptMessageSenderInterface {
         compressor_id));
   }
 
-  virtual void SendReadFileChunk(int compressor_id, int64_t length) {
+  virtual void SendReadFileChunk(int compressor_id,
+                                 int entry_id,
+                                 int64_t length) {
     JavaScriptPostMessage(request::CreateReadFileChunkRequest(
-        compressor_id, length));
+        compressor_id, entry_id, length));
   }
 
   virtual void SendWriteChunk(int compressor_id,
@@ -116,9 +175,9 @@ class JavaScriptMessageSender : public JavaScriptMessageSenderInterface {
         compressor_id, array_buffer, length));
   }
 
-  virtual void SendAddToArchiveDone(int compressor_id) {
+  virtual void SendAddToArchiveDone(int compressor_id, int entry_id) {
     JavaScriptPostMessage(request::CreateAddToArchiveDoneResponse(
-        compressor_id));
+        compressor_id, entry_id));
   }
 
   virtual void SendCloseArchiveDone(int compressor_id) {
@@ -144,8 +203,9 @@ class NaclArchiveInstance : public pp::Instance {
  public:
   explicit NaclArchiveInstance(PP_Instance instance)
       : pp::Instance(instance),
-        instance_handle_(instance),
-        message_sender_(this) {}
+        message_sender_(this),
+        worker_pool_(pp::InstanceHandle(instance),
+                     WorkerPool::DefaultMaximumThreads()) {}
 
   virtual ~NaclArchiveInstance() {
     for (volume_iterator iterator = volumes_.begin();
@@ -205,10 +265,30 @@ class NaclArchiveInstance : public pp::Instance {
         ReadPassphraseError(file_system_id, request_id);
         break;
 
+      case request::READ_DIRECTORY:
+        ReadDirectory(var_dict, file_system_id, request_id);
+        break;
+
+      case request::GET_METADATA:
+        GetMetadata(var_dict, file_system_id, request_id);
+        break;
+
       case request::OPEN_FILE:
         OpenFile(var_dict, file_system_id, request_id);
         break;
 
+      case request::OPEN_FILES:
+        OpenFiles(var_dict, file_system_id, request_id);
+        break;
+
+      case request::OPEN_FILE_BY_PATH:
+        OpenFileByPath(var_dict, file_system_id, request_id);
+        break;
+
+      case request::EXTRACT:
+        Extract(var_dict, file_system_id, request_id);
+        break;
+
       case request::CLOSE_FILE:
         CloseFile(var_dict, file_system_id, request_id);
         break;
@@ -239,7 +319,7 @@ class NaclArchiveInstance : public pp::Instance {
 
     switch (operation) {
       case request::CREATE_ARCHIVE: {
-        CreateArchive(compressor_id);
+        CreateArchive(var_dict, compressor_id);
         break;
       }
 
@@ -248,6 +328,11 @@ class NaclArchiveInstance : public pp::Instance {
         break;
       }
 
+      case request::ADD_TO_ARCHIVE_BATCH: {
+        AddToArchiveBatch(var_dict, compressor_id);
+        break;
+      }
+
       case request::READ_FILE_CHUNK_DONE: {
         ReadFileChunkDone(var_dict, compressor_id);
         break;
@@ -268,39 +353,80 @@ class NaclArchiveInstance : public pp::Instance {
     }
   }
 
-  // Reads the metadata for the corresponding volume for file_system_id. This
-  // should be called only once and before any other operation like OpenFile,
-  // ReadFile, etc.
-  // Reading metadata or opening a file could work even if the Volume exists
-  // or not, but as the JavaScript code doesn't use this feature there is no
-  // reason to allow it. If the logic on JavaScript changes then this can be
-  // updated. But in current design if we read metadata for an existing Volume,
-  // then there is a programmer error on JavaScript side.
-  void ReadMetadata(const pp::VarDictionary& var_dict,
-                    const std::string& file_system_id,
-                    const std::string& request_id) {
-    // Should not call ReadMetadata for a Volume already present in NaCl.
-    PP_DCHECK(volumes_.find(file_system_id) == volumes_.end());
+  // Returns the volume of file_system_id, creating it if not present yet. The
+  // volume is already present if files were opened with OPEN_FILE_BY_PATH
+  // before READ_METADATA. Returns NULL and sends an error to JavaScript if the
+  // volume could not be created.
+  Volume* GetOrCreateVolume(const std::string& file_system_id,
+                            const std::string& request_id) {
+    volume_iterator iterator = volumes_.find(file_system_id);
+    if (iterator != volumes_.end())
+      return iterator->second;
 
     Volume* volume =
-        new Volume(instance_handle_, file_system_id, &message_sender_);
+        new Volume(&worker_pool_, file_system_id, &message_sender_);
     if (!volume->Init()) {
       message_sender_.SendFileSystemError(
           file_system_id,
           request_id,
           "Could not create a volume for: " + file_system_id + ".");
       delete volume;
-      return;
+      return NULL;
     }
     volumes_[file_system_id] = volume;
+    return volume;
+  }
+
+  // Reads the metadata for the corresponding volume for file_system_id. This
+  // should be called only once per volume, and before any other operation
+  // except OPEN_FILE_BY_PATH, which doesn't need the metadata.
+  void ReadMetadata(const pp::VarDictionary& var_dict,
+                    const std::string& file_system_id,
+                    const std::string& request_id) {
+    Volume* volume = GetOrCreateVolume(file_system_id, request_id);
+    if (!volume)
+      return;
 
     PP_DCHECK(var_dict.Get(request::key::kEncoding).is_string());
     PP_DCHECK(var_dict.Get(request::key::kArchiveSize).is_string());
 
+    // The metadata format is optional. Older callers get dictionaries.
+    request::MetadataFormat metadata_format =
+        request::METADATA_FORMAT_DICTIONARY;
+    pp::Var metadata_format_var =
+        var_dict.Get(request::key::kMetadataFormat);
+    if (!metadata_format_var.is_undefined()) {
+      PP_DCHECK(metadata_format_var.is_int());
+      metadata_format =
+          static_cast<request::MetadataFormat>(metadata_format_var.AsInt());
+    }
+
+    // Progress messages are optional too and need the binary format.
+    pp::Var metadata_progress_var =
+        var_dict.Get(request::key::kMetadataProgress);
+    bool metadata_progress =
+        metadata_progress_var.is_bool() && metadata_progress_var.AsBool();
+    PP_DCHECK(!metadata_progress ||
+              metadata_format == request::METADATA_FORMAT_BINARY);
+
+    // A cache record returned for a previous mount of the archive, if any,
+    // and whether to return a new one.
+    pp::Var metadata_cache = var_dict.Get(request::key::kMetadataCache);
+    PP_DCHECK(metadata_cache.is_undefined() ||
+              metadata_cache.is_array_buffer());
+    pp::Var create_metadata_cache_var =
+        var_dict.Get(request::key::kCreateMetadataCache);
+    bool create_metadata_cache = create_metadata_cache_var.is_bool() &&
+                                 create_metadata_cache_var.AsBool();
+
     volume->ReadMetadata(
         request_id,
         var_dict.Get(request::key::kEncoding).AsString(),
-        request::GetInt64FromString(var_dict, request::key::kArchiveSize));
+        request::GetInt64FromString(var_dict, request::key::kArchiveSize),
+        metadata_format,
+        metadata_progress,
+        metadata_cache,
+        create_metadata_cache);
   }
 
   void ReadChunkDone(const pp::VarDictionary& var_dict,
@@ -353,6 +479,30 @@ class NaclArchiveInstance : public pp::Instance {
     iterator->second->ReadPassphraseError(request_id);
   }
 
+  void ReadDirectory(const pp::VarDictionary& var_dict,
+                     const std::string& file_system_id,
+                     const std::string& request_id) {
+    PP_DCHECK(var_dict.Get(request::key::kPath).is_string());
+    std::string path(var_dict.Get(request::key::kPath).AsString());
+
+    volume_iterator iterator = volumes_.find(file_system_id);
+    PP_DCHECK(iterator != volumes_.end());  // Should call ReadDirectory after
+                                            // ReadMetadata.
+    iterator->second->ReadDirectory(request_id, path);
+  }
+
+  void GetMetadata(const pp::VarDictionary& var_dict,
+                   const std::string& file_system_id,
+                   const std::string& request_id) {
+    PP_DCHECK(var_dict.Get(request::key::kPath).is_string());
+    std::string path(var_dict.Get(request::key::kPath).AsString());
+
+    volume_iterator iterator = volumes_.find(file_system_id);
+    PP_DCHECK(iterator != volumes_.end());  // Should call GetMetadata after
+                                            // ReadMetadata.
+    iterator->second->GetMetadata(request_id, path);
+  }
+
   void OpenFile(const pp::VarDictionary& var_dict,
                 const std::string& file_system_id,
                 const std::string& request_id) {
@@ -373,6 +523,90 @@ class NaclArchiveInstance : public pp::Instance {
     iterator->second->OpenFile(request_id, index, encoding, archive_size);
   }
 
+  void OpenFiles(const pp::VarDictionary& var_dict,
+                 const std::string& file_system_id,
+                 const std::string& request_id) {
+    PP_DCHECK(var_dict.Get(request::key::kRequestIds).is_array());
+    pp::VarArray request_ids(var_dict.Get(request::key::kRequestIds));
+    PP_DCHECK(var_dict.Get(request::key::kIndices).is_array());
+    pp::VarArray indices(var_dict.Get(request::key::kIndices));
+    PP_DCHECK(request_ids.GetLength() == indices.GetLength());
+
+    std::vector<std::pair<int64_t, std::string> > files;
+    for (uint32_t i = 0; i < indices.GetLength(); ++i) {
+      PP_DCHECK(indices.Get(i).is_string());
+      std::stringstream ss_index(indices.Get(i).AsString());
+      int64_t index;
+      ss_index >> index;
+      PP_DCHECK(request_ids.Get(i).is_string());
+      files.push_back(std::make_pair(index, request_ids.Get(i).AsString()));
+    }
+
+    PP_DCHECK(var_dict.Get(request::key::kEncoding).is_string());
+    std::string encoding(var_dict.Get(request::key::kEncoding).AsString());
+
+    PP_DCHECK(var_dict.Get(request::key::kArchiveSize).is_string());
+    int64_t archive_size =
+        request::GetInt64FromString(var_dict, request::key::kArchiveSize);
+
+    volume_iterator iterator = volumes_.find(file_system_id);
+    PP_DCHECK(iterator != volumes_.end());  // Should call OpenFiles after
+                                            // ReadMetadata.
+    iterator->second->OpenFiles(files, encoding, archive_size);
+  }
+
+  void OpenFileByPath(const pp::VarDictionary& var_dict,
+                      const std::string& file_system_id,
+                      const std::string& request_id) {
+    PP_DCHECK(var_dict.Get(request::key::kPath).is_string());
+    std::string path(var_dict.Get(request::key::kPath).AsString());
+
+    PP_DCHECK(var_dict.Get(request::key::kEncoding).is_string());
+    std::string encoding(var_dict.Get(request::key::kEncoding).AsString());
+
+    PP_DCHECK(var_dict.Get(request::key::kArchiveSize).is_string());
+    int64_t archive_size =
+        request::GetInt64FromString(var_dict, request::key::kArchiveSize);
+
+    // Can be called before ReadMetadata, so the volume may not exist yet.
+    Volume* volume = GetOrCreateVolume(file_system_id, request_id);
+    if (!volume)
+      return;
+    volume->OpenFileByPath(request_id, path, encoding, archive_size);
+  }
+
+  void Extract(const pp::VarDictionary& var_dict,
+               const std::string& file_system_id,
+               const std::string& request_id) {
+    // The indices are optional. All of the entries are extracted without them.
+    std::set<int64_t> indices;
+    pp::Var indices_var = var_dict.Get(request::key::kIndices);
+    if (!indices_var.is_undefined()) {
+      PP_DCHECK(indices_var.is_array());
+      pp::VarArray indices_array(indices_var);
+      for (uint32_t i = 0; i < indices_array.GetLength(); ++i) {
+        PP_DCHECK(indices_array.Get(i).is_string());
+        std::stringstream ss_index(indices_array.Get(i).AsString());
+        int64_t index;
+        ss_index >> index;
+        indices.insert(index);
+      }
+    }
+
+    PP_DCHECK(var_dict.Get(request::key::kEncoding).is_string());
+    std::string encoding(var_dict.Get(request::key::kEncoding).AsString());
+
+    PP_DCHECK(var_dict.Get(request::key::kArchiveSize).is_string());
+    int64_t archive_size =
+        request::GetInt64FromString(var_dict, request::key::kArchiveSize);
+
+    // Doesn't need the metadata, like OpenFileByPath.
+    Volume* volume = GetOrCreateVolume(file_system_id, request_id);
+    if (!volume)
+      return;
+    volume->Extract(request_id, indices, encoding, archive_size);
+  }
+
   void CloseFile(const pp::VarDictionary& var_dict,
                  const std::string& file_system_id,
                  const std::string& request_id) {
@@ -405,9 +639,43 @@ class NaclArchiveInstance : public pp::Instance {
   }
 
   // Requests libarchive to create an archive object for the given compressor_id.
-  void CreateArchive(int compressor_id) {
+  void CreateArchive(const pp::VarDictionary& var_dict, int compressor_id) {
+    // The format, the filter, the level, the options and the store ratio are
+    // optional. Older callers get ZIP archives deflated with the default
+    // level.
+    request::PackFormat pack_format = request::PACK_FORMAT_ZIP;
+    pp::Var pack_format_var = var_dict.Get(request::key::kPackFormat);
+    if (!pack_format_var.is_undefined()) {
+      PP_DCHECK(pack_format_var.is_int());
+      pack_format = static_cast<request::PackFormat>(pack_format_var.AsInt());
+    }
+    request::PackFilter pack_filter = request::PACK_FILTER_DEFAULT;
+    pp::Var pack_filter_var = var_dict.Get(request::key::kPackFilter);
+    if (!pack_filter_var.is_undefined()) {
+      PP_DCHECK(pack_filter_var.is_int());
+      pack_filter = static_cast<request::PackFilter>(pack_filter_var.AsInt());
+    }
+    int pack_level = compressor_archive_constants::kDefaultCompressionLevel;
+    pp::Var pack_level_var = var_dict.Get(request::key::kPackLevel);
+    if (!pack_level_var.is_undefined()) {
+      PP_DCHECK(pack_level_var.is_int());
+      pack_level = pack_level_var.AsInt();
+    }
+    std::string pack_options;
+    pp::Var pack_options_var = var_dict.Get(request::key::kPackOptions);
+    if (!pack_options_var.is_undefined()) {
+      PP_DCHECK(pack_options_var.is_string());
+      pack_options = pack_options_var.AsString();
+    }
+    double pack_store_ratio = compressibility_constants::kDefaultStoreRatio;
+    pp::Var pack_store_ratio_var = var_dict.Get(request::key::kPackStoreRatio);
+    if (!pack_store_ratio_var.is_undefined()) {
+      PP_DCHECK(pack_store_ratio_var.is_number());
+      pack_store_ratio = pack_store_ratio_var.AsDouble();
+    }
+
     Compressor* compressor =
-        new Compressor(instance_handle_, compressor_id, &message_sender_);
+        new Compressor(&worker_pool_, compressor_id, &message_sender_);
     if (!compressor->Init()) {
       std::stringstream ss;
       ss << compressor_id;
@@ -419,7 +687,8 @@ class NaclArchiveInstance : public pp::Instance {
     }
     compressors_[compressor_id] = compressor;
 
-    compressor->CreateArchive();
+    compressor->CreateArchive(
+        pack_format, pack_filter, pack_level, pack_options, pack_store_ratio);
   }
 
   void AddToArchive(const pp::VarDictionary& var_dict,
@@ -430,6 +699,14 @@ class NaclArchiveInstance : public pp::Instance {
     iterator->second->AddToArchive(var_dict);
   }
 
+  void AddToArchiveBatch(const pp::VarDictionary& var_dict,
+                         int compressor_id) {
+    compressor_iterator iterator = compressors_.find(compressor_id);
+    PP_DCHECK(iterator != compressors_.end());
+
+    iterator->second->AddToArchiveBatch(var_dict);
+  }
+
   void ReadFileChunkDone(const pp::VarDictionary& var_dict,
                          const int compressor_id) {
     compressor_iterator iterator = compressors_.find(compressor_id);
@@ -461,11 +738,12 @@ class NaclArchiveInstance : public pp::Instance {
   // A map from compressor ids to compressors.
   std::map<int, Compressor*> compressors_;
 
-  // An pp::InstanceHandle used to create pp::SimpleThread in Volume.
-  pp::InstanceHandle instance_handle_;
-
   // An object used to send messages to JavaScript.
   JavaScriptMessageSender message_sender_;
+
+  // The threads that run the jobs of all the volumes and compressors. Declared
+  // last so the jobs still running on destruction can use the other members.
+  WorkerPool worker_pool_;
 };
 
 // The Module class. The browser calls the CreateInstance() method to create
@@ -30,13 +30,55 @@ bool request::IsPackRequest(int operation) {
 pp::VarDictionary request::CreateReadMetadataDoneResponse(
     const std::string& file_system_id,
     const std::string& request_id,
-    const pp::VarDictionary& metadata) {
+    const pp::Var& metadata) {
   pp::VarDictionary response =
       CreateBasicRequest(READ_METADATA_DONE, file_system_id, request_id);
   response.Set(request::key::kMetadata, metadata);
   return response;
 }
 
+pp::VarDictionary request::CreateReadMetadataDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    const pp::Var& metadata,
+    const pp::Var& metadata_cache) {
+  pp::VarDictionary response =
+      CreateReadMetadataDoneResponse(file_system_id, request_id, metadata);
+  if (!metadata_cache.is_undefined())
+    response.Set(request::key::kMetadataCache, metadata_cache);
+  return response;
+}
+
+pp::VarDictionary request::CreateReadMetadataProgressResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    const pp::VarArrayBuffer& metadata) {
+  pp::VarDictionary response = CreateBasicRequest(
+      READ_METADATA_PROGRESS, file_system_id, request_id);
+  response.Set(request::key::kMetadata, metadata);
+  return response;
+}
+
+pp::VarDictionary request::CreateReadDirectoryDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    const pp::VarArray& entries) {
+  pp::VarDictionary response =
+      CreateBasicRequest(READ_DIRECTORY_DONE, file_system_id, request_id);
+  response.Set(request::key::kEntries, entries);
+  return response;
+}
+
+pp::VarDictionary request::CreateGetMetadataDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    const pp::VarDictionary& metadata) {
+  pp::VarDictionary response =
+      CreateBasicRequest(GET_METADATA_DONE, file_system_id, request_id);
+  response.Set(request::key::kMetadata, metadata);
+  return response;
+}
+
 pp::VarDictionary request::CreateReadChunkRequest(
     const std::string& file_system_id,
     const std::string& request_id,
@@ -69,6 +111,24 @@ pp::VarDictionary request::CreateOpenFileDoneResponse(
   return CreateBasicRequest(OPEN_FILE_DONE, file_system_id, request_id);
 }
 
+pp::VarDictionary request::CreateOpenFileByPathDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    int64_t index,
+    int64_t size) {
+  pp::VarDictionary response =
+      CreateBasicRequest(OPEN_FILE_BY_PATH_DONE, file_system_id, request_id);
+
+  std::stringstream ss_index;
+  ss_index << index;
+  response.Set(request::key::kIndex, ss_index.str());
+
+  std::stringstream ss_size;
+  ss_size << size;
+  response.Set(request::key::kSize, ss_size.str());
+  return response;
+}
+
 pp::VarDictionary request::CreateCloseFileDoneResponse(
     const std::string& file_system_id,
     const std::string& request_id,
@@ -91,6 +151,51 @@ pp::VarDictionary request::CreateReadFileDoneResponse(
   return response;
 }
 
+pp::VarDictionary request::CreateExtractEntryResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    int64_t index,
+    const std::string& path,
+    int64_t size) {
+  pp::VarDictionary response =
+      CreateBasicRequest(EXTRACT_ENTRY, file_system_id, request_id);
+
+  std::stringstream ss_index;
+  ss_index << index;
+  response.Set(request::key::kIndex, ss_index.str());
+
+  response.Set(request::key::kPath, path);
+
+  std::stringstream ss_size;
+  ss_size << size;
+  response.Set(request::key::kSize, ss_size.str());
+  return response;
+}
+
+pp::VarDictionary request::CreateExtractDataResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    int64_t index,
+    const pp::VarArrayBuffer& array_buffer,
+    bool has_more_data) {
+  pp::VarDictionary response =
+      CreateBasicRequest(EXTRACT_DATA, file_system_id, request_id);
+
+  std::stringstream ss_index;
+  ss_index << index;
+  response.Set(request::key::kIndex, ss_index.str());
+
+  response.Set(request::key::kReadFileData, array_buffer);
+  response.Set(request::key::kHasMoreData, has_more_data);
+  return response;
+}
+
+pp::VarDictionary request::CreateExtractDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id) {
+  return CreateBasicRequest(EXTRACT_DONE, file_system_id, request_id);
+}
+
 pp::VarDictionary request::CreateCreateArchiveDoneResponse(
     const int compressor_id) {
   pp::VarDictionary request;
@@ -101,10 +206,12 @@ pp::VarDictionary request::CreateCreateArchiveDoneResponse(
 
 pp::VarDictionary request::CreateReadFileChunkRequest(
     const int compressor_id,
+    const int entry_id,
     const int64_t length) {
   pp::VarDictionary request;
   request.Set(request::key::kOperation, READ_FILE_CHUNK);
   request.Set(request::key::kCompressorId, compressor_id);
+  request.Set(request::key::kEntryId, entry_id);
 
   std::stringstream ss_length;
   ss_length << length;
@@ -127,10 +234,12 @@ pp::VarDictionary request::CreateWriteChunkRequest(
   return request;
 }
 
-pp::VarDictionary request::CreateAddToArchiveDoneResponse(int compressor_id) {
+pp::VarDictionary request::CreateAddToArchiveDoneResponse(int compressor_id,
+                                                          int entry_id) {
   pp::VarDictionary request;
   request.Set(request::key::kOperation, ADD_TO_ARCHIVE_DONE);
   request.Set(request::key::kCompressorId, compressor_id);
+  request.Set(request::key::kEntryId, entry_id);
   return request;
 }
 
@@ -5,6 +5,7 @@
 #ifndef REQUEST_H_
 #define REQUEST_H_
 
+#include "ppapi/cpp/var_array.h"
 #include "ppapi/cpp/var_array_buffer.h"
 #include "ppapi/cpp/var_dictionary.h"
 
@@ -22,7 +23,16 @@ const char kFileSystemId[] = "file_system_id";  // Should be a string.
 const char kRequestId[] = "request_id";         // Should be a string.
 
 // Optional keys unique to unpacking operations.
-const char kMetadata[] = "metadata";  // Should be a pp:VarDictionary.
+const char kMetadata[] = "metadata";  // Should be a pp:VarDictionary or a
+                                      // pp::VarArrayBuffer, depending on
+                                      // kMetadataFormat.
+const char kMetadataFormat[] = "metadata_format";  // Should be an int, a
+                                                   // request::MetadataFormat.
+const char kMetadataProgress[] = "metadata_progress";  // Should be a bool.
+const char kMetadataCache[] = "metadata_cache";  // Should be a
+                                                 // pp::VarArrayBuffer.
+const char kCreateMetadataCache[] =
+    "create_metadata_cache";  // Should be a bool.
 const char kArchiveSize[] =
     "archive_size";  // Should be a string as int64_t is not support by pp::Var.
 const char kIndex[] = "index";         // Should be a string as int64_t is not
@@ -34,6 +44,14 @@ const char kReadFileData[] = "read_file_data";    // Should be a
                                                   // pp::VarArrayBuffer.
 const char kHasMoreData[] = "has_more_data";      // Should be a bool.
 const char kPassphrase[] = "passphrase";          // Should be a string.
+const char kPath[] = "path";                      // Should be a string.
+const char kEntries[] = "entries";                // Should be a pp::VarArray.
+const char kSize[] = "size";  // Should be a string as int64_t is not
+                              // supported by pp::Var.
+const char kIndices[] = "indices";  // Should be a pp::VarArray of strings, like
+                                    // kIndex.
+const char kRequestIds[] = "request_ids";  // Should be a pp::VarArray of
+                                           // strings, like kRequestId.
 
 // Mandatory keys for all packing requests.
 const char kCompressorId[] = "compressor_id";         // Should be an int.
@@ -46,6 +64,16 @@ const char kIsDirectory[] = "is_directory";           // Should be a bool.
 const char kModificationTime[] = "modification_time"; // Should be a string
                                                       // (mm/dd/yy h:m:s).
 const char kHasError[] = "has_error";                 // Should be a bool.
+const char kPackFormat[] = "pack_format";  // Should be an int, a
+                                           // request::PackFormat.
+const char kPackFilter[] = "pack_filter";  // Should be an int, a
+                                           // request::PackFilter.
+const char kPackLevel[] = "pack_level";    // Should be an int.
+const char kPackOptions[] = "pack_options";  // Should be a string.
+const char kPackStoreRatio[] = "pack_store_ratio";  // Should be a number.
+const char kFileContents[] = "file_contents";  // Should be a
+                                               // pp::VarArrayBuffer with all
+                                               // the data of the file.
 
 // Optional keys used for both packing and unpacking operations.
 const char kError[] = "error";        // Should be a string.
@@ -80,28 +108,113 @@ enum Operation {
   READ_FILE_DONE = 14,
   CONSOLE_LOG = 15,
   CONSOLE_DEBUG = 16,
-  CREATE_ARCHIVE = 17,
-  CREATE_ARCHIVE_DONE = 18,
-  ADD_TO_ARCHIVE = 19,
-  ADD_TO_ARCHIVE_DONE = 20,
-  READ_FILE_CHUNK = 21,
-  READ_FILE_CHUNK_DONE = 22,
-  WRITE_CHUNK = 23,
-  WRITE_CHUNK_DONE = 24,
-  CLOSE_ARCHIVE = 25,
-  CLOSE_ARCHIVE_DONE = 26,
+  READ_METADATA_PROGRESS = 17,
+  READ_DIRECTORY = 18,
+  READ_DIRECTORY_DONE = 19,
+  GET_METADATA = 20,
+  GET_METADATA_DONE = 21,
+  OPEN_FILE_BY_PATH = 22,
+  OPEN_FILE_BY_PATH_DONE = 23,
+  EXTRACT = 24,
+  EXTRACT_ENTRY = 25,
+  EXTRACT_DATA = 26,
+  EXTRACT_DONE = 27,
+  OPEN_FILES = 28,  // Opens the files with kIndices for the open requests
+                    // with kRequestIds. Answered with OPEN_FILE_DONE for every
+                    // open request. kRequestId is the first open request id.
+  CREATE_ARCHIVE = 50,
+  CREATE_ARCHIVE_DONE = 51,
+  ADD_TO_ARCHIVE = 52,  // May be sent before the previous entries are added.
+                        // The entries are added in order.
+  ADD_TO_ARCHIVE_DONE = 53,  // With the kEntryId of the entry added.
+  READ_FILE_CHUNK = 54,      // With the kEntryId of the entry to read.
+  READ_FILE_CHUNK_DONE = 55,
+  WRITE_CHUNK = 56,
+  WRITE_CHUNK_DONE = 57,
+  CLOSE_ARCHIVE = 58,
+  CLOSE_ARCHIVE_DONE = 59,
+  ADD_TO_ARCHIVE_BATCH = 60,  // Adds the entries in kEntries, dictionaries
+                              // with the keys of ADD_TO_ARCHIVE, in order.
+                              // Answered with a single ADD_TO_ARCHIVE_DONE,
+                              // with the kEntryId of the last entry.
   FILE_SYSTEM_ERROR = -1,  // Errors specific to a file system.
   COMPRESSOR_ERROR = -2    // Errors specific to a compressor.
 };
 
-// Operations greater than or equal to this value are for packing.
-const int MINIMUM_PACK_REQUEST_VALUE = 17;
+// Defines the formats of the metadata sent with READ_METADATA_DONE. These
+// formats should be the same as the formats on the JavaScript side.
+enum MetadataFormat {
+  METADATA_FORMAT_DICTIONARY = 0,  // Nested pp::VarDictionary(s). Default.
+  METADATA_FORMAT_BINARY = 1,      // A pp::VarArrayBuffer, see
+                                   // metadata_tree_constants.
+  METADATA_FORMAT_LAZY = 2         // Only the root directory, without
+                                   // "entries". The entries are kept in NaCl
+                                   // and queried with READ_DIRECTORY and
+                                   // GET_METADATA.
+};
+
+// Defines the formats of the archives created with CREATE_ARCHIVE. These
+// formats should be the same as the formats on the JavaScript side.
+enum PackFormat {
+  PACK_FORMAT_ZIP = 0,  // Default.
+  PACK_FORMAT_TAR = 1
+};
+
+// Defines how the archives created with CREATE_ARCHIVE are compressed. ZIP
+// archives compress every file on its own and support only PACK_FILTER_NONE
+// and PACK_FILTER_DEFLATE, while TAR archives are compressed as a whole. These
+// filters should be the same as the filters on the JavaScript side.
+enum PackFilter {
+  PACK_FILTER_DEFAULT = 0,  // Deflate for ZIP, none for TAR. Default.
+  PACK_FILTER_NONE = 1,     // Stored, without compression.
+  PACK_FILTER_DEFLATE = 2,  // Gzip for TAR.
+  PACK_FILTER_ZSTD = 3,
+  PACK_FILTER_XZ = 4,
+  PACK_FILTER_LZ4 = 5
+};
+
+// Operations greater than or equal to this value are for packing. Unpacking
+// operations use the values below it.
+const int MINIMUM_PACK_REQUEST_VALUE = 50;
 
 // Return true if the given operation is related to packing.
 bool IsPackRequest(int operation);
 
-// Creates a response to READ_METADATA request.
+// Creates a response to READ_METADATA request. metadata is a
+// pp::VarDictionary or a pp::VarArrayBuffer depending on the requested
+// request::MetadataFormat.
 pp::VarDictionary CreateReadMetadataDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    const pp::Var& metadata);
+
+// Same as above, but also with a cache record of the metadata that JavaScript
+// can pass with kMetadataCache to the next READ_METADATA request for the same
+// archive. metadata_cache is a pp::VarArrayBuffer or undefined if none.
+pp::VarDictionary CreateReadMetadataDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    const pp::Var& metadata,
+    const pp::Var& metadata_cache);
+
+// Creates a message with the entries read by a READ_METADATA request so far.
+// metadata is a pp::VarArrayBuffer in request::METADATA_FORMAT_BINARY format
+// with the records added since the previous message.
+pp::VarDictionary CreateReadMetadataProgressResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    const pp::VarArrayBuffer& metadata);
+
+// Creates a response to READ_DIRECTORY request. entries contains the metadata
+// of the children of the directory, without their own children.
+pp::VarDictionary CreateReadDirectoryDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    const pp::VarArray& entries);
+
+// Creates a response to GET_METADATA request. metadata doesn't contain the
+// children of the entry.
+pp::VarDictionary CreateGetMetadataDoneResponse(
     const std::string& file_system_id,
     const std::string& request_id,
     const pp::VarDictionary& metadata);
@@ -120,6 +233,14 @@ pp::VarDictionary CreateReadPassphraseRequest(const std::string& file_system_id,
 pp::VarDictionary CreateOpenFileDoneResponse(const std::string& file_system_id,
                                              const std::string& request_id);
 
+// Creates a response to OPEN_FILE_BY_PATH request with the index and the size
+// of the opened entry.
+pp::VarDictionary CreateOpenFileByPathDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    int64_t index,
+    int64_t size);
+
 // Creates a response to CLOSE_FILE request.
 pp::VarDictionary CreateCloseFileDoneResponse(
     const std::string& file_system_id,
@@ -133,16 +254,42 @@ pp::VarDictionary CreateReadFileDoneResponse(
     const pp::VarArrayBuffer& array_buffer,
     bool has_more_data);
 
+// Creates a message for EXTRACT that starts the data of an entry. It is
+// followed by EXTRACT_DATA messages for the entry, the last one without more
+// data.
+pp::VarDictionary CreateExtractEntryResponse(const std::string& file_system_id,
+                                             const std::string& request_id,
+                                             int64_t index,
+                                             const std::string& path,
+                                             int64_t size);
+
+// Creates a message for EXTRACT with a chunk of the data of the entry at
+// index. has_more_data is false for the last chunk of the entry.
+pp::VarDictionary CreateExtractDataResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    int64_t index,
+    const pp::VarArrayBuffer& array_buffer,
+    bool has_more_data);
+
+// Creates a response to EXTRACT request, sent after all of the entries.
+pp::VarDictionary CreateExtractDoneResponse(const std::string& file_system_id,
+                                            const std::string& request_id);
+
 pp::VarDictionary CreateCreateArchiveDoneResponse(int compressor_id);
 
 pp::VarDictionary CreateReadFileChunkRequest(int compressor_id,
+                                             int entry_id,
                                              int64_t length);
 
 pp::VarDictionary CreateWriteChunkRequest(int compressor_id,
                                           const pp::VarArrayBuffer& array_buffer,
                                           int64_t length);
 
-pp::VarDictionary CreateAddToArchiveDoneResponse(int compressor_id);
+// Creates a response to ADD_TO_ARCHIVE or ADD_TO_ARCHIVE_BATCH. entry_id is
+// the id of the last entry added.
+pp::VarDictionary CreateAddToArchiveDoneResponse(int compressor_id,
+                                                 int entry_id);
 
 pp::VarDictionary CreateCloseArchiveDoneResponse(int compressor_id);
 
@@ -0,0 +1,62 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "small_file_cache.h"
+
+#include <cstring>
+
+#include "ppapi/cpp/logging.h"
+
+SmallFileCache::SmallFileCache(int64_t maximum_file_size, int64_t capacity)
+    : maximum_file_size_(maximum_file_size), capacity_(capacity), size_(0) {
+  PP_DCHECK(maximum_file_size_ <= capacity_);
+}
+
+SmallFileCache::~SmallFileCache() {
+}
+
+bool SmallFileCache::Get(int64_t index, pp::VarArrayBuffer* contents) {
+  std::map<int64_t, Entry>::iterator it = entries_.find(index);
+  if (it == entries_.end())
+    return false;
+
+  lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+  *contents = it->second.contents;
+  return true;
+}
+
+bool SmallFileCache::Contains(int64_t index) const {
+  return entries_.find(index) != entries_.end();
+}
+
+bool SmallFileCache::Put(int64_t index, const char* data, int64_t size) {
+  if (!CanCache(size))
+    return false;
+
+  std::map<int64_t, Entry>::iterator it = entries_.find(index);
+  if (it != entries_.end()) {
+    size_ -= it->second.contents.ByteLength();
+    lru_.erase(it->second.lru_position);
+    entries_.erase(it);
+  }
+
+  while (size_ + size > capacity_) {
+    std::map<int64_t, Entry>::iterator oldest = entries_.find(lru_.back());
+    size_ -= oldest->second.contents.ByteLength();
+    entries_.erase(oldest);
+    lru_.pop_back();
+  }
+
+  Entry entry;
+  entry.contents = pp::VarArrayBuffer(size);
+  if (size > 0) {
+    memcpy(entry.contents.Map(), data, size);
+    entry.contents.Unmap();
+  }
+  lru_.push_front(index);
+  entry.lru_position = lru_.begin();
+  entries_[index] = entry;
+  size_ += size;
+  return true;
+}
@@ -0,0 +1,74 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef SMALL_FILE_CACHE_H_
+#define SMALL_FILE_CACHE_H_
+
+#include <stdint.h>
+
+#include <list>
+#include <map>
+
+#include "ppapi/cpp/var_array_buffer.h"
+
+// The whole decompressed contents of small files of an archive, keyed by the
+// index of their entries. The contents are kept in pp::VarArrayBuffer(s), so a
+// cached file can be sent to JavaScript without decompressing or copying it
+// again. Only the most recently used files are kept.
+class SmallFileCache {
+ public:
+  // Files bigger than maximum_file_size are not cached and the cached files
+  // use at most capacity bytes together.
+  SmallFileCache(int64_t maximum_file_size, int64_t capacity);
+
+  virtual ~SmallFileCache();
+
+  // Sets *contents to the contents of the file at index and marks it as the
+  // most recently used one. Returns false if the file is not cached.
+  bool Get(int64_t index, pp::VarArrayBuffer* contents);
+
+  // Returns true if the file at index is cached, without changing the order
+  // of the files.
+  bool Contains(int64_t index) const;
+
+  // Caches the size bytes at data as the contents of the file at index,
+  // releasing the least recently used files until it fits. Returns false if
+  // the file is too big to be cached.
+  bool Put(int64_t index, const char* data, int64_t size);
+
+  // Returns true if a file of the given size can be cached.
+  bool CanCache(int64_t size) const {
+    return size >= 0 && size <= maximum_file_size_;
+  }
+
+  // The number of bytes used by the cached files.
+  int64_t size() const { return size_; }
+
+ private:
+  // A cached file.
+  struct Entry {
+    pp::VarArrayBuffer contents;
+
+    // The position of the file in lru_.
+    std::list<int64_t>::iterator lru_position;
+  };
+
+  // The maximum size of a cached file.
+  int64_t maximum_file_size_;
+
+  // The maximum number of bytes used by the cached files together.
+  int64_t capacity_;
+
+  // The number of bytes used by the cached files.
+  int64_t size_;
+
+  // The cached files, keyed by index.
+  std::map<int64_t, Entry> entries_;
+
+  // The indices of the cached files, from the most recently used to the least
+  // recently used one.
+  std::list<int64_t> lru_;
+};
+
+#endif  // SMALL_FILE_CACHE_H_
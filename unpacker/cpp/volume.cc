@@ -4,9 +4,13 @@
 
 #include "volume.h"
 
+#include <sys/time.h>
+
+#include <algorithm>
 #include <cstring>
 #include <sstream>
 
+#include "metadata_tree.h"
 #include "request.h"
 #include "volume_archive_libarchive.h"
 #include "volume_reader_javascript_stream.h"
@@ -20,145 +24,77 @@ namespace {
     message_sender_->CONSOLE_LOG(file_system_id_, request_id, fmt.str()); \
   } while (0)
 
-typedef std::map<std::string, VolumeArchive*>::const_iterator
-    volume_archive_iterator;
-
-const char kPathDelimiter[] = "/";
-
-// size is int64_t and modification_time is time_t because this is how
-// libarchive is going to pass them to us.
-pp::VarDictionary CreateEntry(int64_t index,
-                              const std::string& name,
-                              bool is_directory,
-                              int64_t size,
-                              time_t modification_time) {
-  pp::VarDictionary entry_metadata;
-  // index is int64_t, unsupported by pp::Var
-  std::stringstream ss_index;
-  ss_index << index;
-  entry_metadata.Set("index", ss_index.str());
-  entry_metadata.Set("isDirectory", is_directory);
-  entry_metadata.Set("name", name);
-  // size is int64_t, unsupported by pp::Var
-  std::stringstream ss_size;
-  ss_size << size;
-  entry_metadata.Set("size", ss_size.str());
-  // mtime is time_t, unsupported by pp::Var
-  std::stringstream ss_modification_time;
-  ss_modification_time << modification_time;
-  entry_metadata.Set("modificationTime", ss_modification_time.str());
-
-  if (is_directory)
-    entry_metadata.Set("entries", pp::VarDictionary());
-
-  return entry_metadata;
-}
-
-// Normalize a path by:
-// - remove all leading / and ./ and ../
-// - turn all // into /
-// - turn all /./ into /
-// - TODO canonicalize /../
-std::string normpath(const std::string& path) {
-  std::string ret = path;
-  size_t i;
-
-  // Removing all leading "/" and "./" and "../".
-  do {
-    i = ret.length();
-
-    if (ret[0] == '/')
-      ret.erase(0, 1);
-
-    if (ret.compare(0, 2, "./") == 0)
-      ret.erase(0, 2);
-
-    if (ret.compare(0, 3, "../") == 0)
-      ret.erase(0, 3);
-  } while (i != ret.length());
-
-  // Turn runs of "//" and "/./" into a single "/".
-  i = 0;
-  while (i < ret.length()) {
-    if (ret.compare(i, 2, "//") == 0) {
-      ret.erase(i, 1);
-      continue;
-    }
-
-    if (ret.compare(i, 3, "/./") == 0) {
-      ret.erase(i, 2);
-      continue;
-    }
+typedef std::list<VolumeArchive*>::iterator volume_archive_iterator;
 
-    ++i;
-  }
+typedef std::map<std::string, VolumeArchive*>::iterator opened_file_iterator;
 
-  return ret;
+double NowInMilliseconds() {
+  timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec * 1000.0 + now.tv_usec / 1000.0;
 }
 
-void ConstructMetadata(int64_t index,
-                       const std::string& entry_complete_path,
-                       int64_t size,
-                       bool is_directory,
-                       time_t modification_time,
-                       pp::VarDictionary* parent_metadata) {
-  // Normalize the path.  The FSP layers can't handle anything weird.
-  std::string entry_path = normpath(entry_complete_path);
-
-  // If, after all the stripping, the path is empty, skip it.
-  if (entry_path.empty())
-    return;
-
-  pp::VarDictionary parent_entries =
-      pp::VarDictionary(parent_metadata->Get("entries"));
-
-  unsigned int position = entry_path.find(kPathDelimiter);
-  pp::VarDictionary entry_metadata;
-  std::string entry_name;
-
-  if (position == std::string::npos) {  // The entry itself.
-    entry_name = entry_path;
-    entry_metadata =
-        CreateEntry(index, entry_name, is_directory, size, modification_time);
-
-    // Update directory information. Required as sometimes the directory itself
-    // is returned after the files inside it.
-    pp::Var old_entry_metadata_var = parent_entries.Get(entry_name);
-    if (!old_entry_metadata_var.is_undefined()) {
-      pp::VarDictionary old_entry_metadata =
-          pp::VarDictionary(old_entry_metadata_var);
-      PP_DCHECK(old_entry_metadata.Get("isDirectory").AsBool());
-      entry_metadata.Set("entries", old_entry_metadata.Get("entries"));
-    }
-  } else {  // Get next parent on the way to the entry.
-    entry_name = entry_path.substr(0, position);
+// Writes value at destination in little endian order.
+void WriteUint32(uint32_t value, uint8_t* destination) {
+  for (int i = 0; i < 4; ++i)
+    destination[i] = static_cast<uint8_t>(value >> (8 * i));
+}
 
-    // Get next parent metadata. If none, create a new directory entry for it.
-    // Some archives don't have directory information inside and for some the
-    // information is returned later than the files inside it.
-    pp::Var entry_metadata_var = parent_entries.Get(entry_name);
-    if (entry_metadata_var.is_undefined())
-      entry_metadata = CreateEntry(-1, entry_name, true, 0, modification_time);
-    else
-      entry_metadata = pp::VarDictionary(parent_entries.Get(entry_name));
+// Reads a little endian value written by WriteUint32.
+uint32_t ReadUint32(const uint8_t* source) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i)
+    value |= static_cast<uint32_t>(source[i]) << (8 * i);
+  return value;
+}
 
-    // Continue to construct metadata for all directories on the path to the
-    // to the entry and for the entry itself.
-    std::string entry_path_without_next_parent = entry_path.substr(
-        position + sizeof(kPathDelimiter) - 1 /* Last char is '\0'. */);
+// Creates a metadata cache record, see volume_constants::kMetadataCacheVersion.
+pp::VarArrayBuffer CreateMetadataCache(const MetadataTree& metadata_tree,
+                                       bool raw) {
+  using namespace volume_constants;
+  pp::VarArrayBuffer tree_buffer = metadata_tree.ToVarArrayBuffer();
+  pp::VarArrayBuffer metadata_cache(kMetadataCacheHeaderSize +
+                                    tree_buffer.ByteLength());
+  uint8_t* data = static_cast<uint8_t*>(metadata_cache.Map());
+  WriteUint32(kMetadataCacheVersion, data);
+  WriteUint32(raw ? kMetadataCacheRawFlag : 0, data + 4);
+  memcpy(data + kMetadataCacheHeaderSize, tree_buffer.Map(),
+         tree_buffer.ByteLength());
+  tree_buffer.Unmap();
+  metadata_cache.Unmap();
+  return metadata_cache;
+}
 
-    ConstructMetadata(index,
-                      entry_path_without_next_parent,
-                      size,
-                      is_directory,
-                      modification_time,
-                      &entry_metadata);
+// Restores the metadata from a cache record created by CreateMetadataCache.
+// Returns NULL if the record is not valid, e.g. it was created by another
+// version. The caller owns the returned tree.
+MetadataTree* RestoreMetadataCache(pp::VarArrayBuffer metadata_cache,
+                                   bool* raw) {
+  using namespace volume_constants;
+  const uint8_t* data = static_cast<const uint8_t*>(metadata_cache.Map());
+  uint32_t size = metadata_cache.ByteLength();
+  MetadataTree* metadata_tree = NULL;
+  if (size >= kMetadataCacheHeaderSize &&
+      ReadUint32(data) == kMetadataCacheVersion) {
+    *raw = (ReadUint32(data + 4) & kMetadataCacheRawFlag) != 0;
+    metadata_tree = MetadataTree::FromBinary(data + kMetadataCacheHeaderSize,
+                                             size - kMetadataCacheHeaderSize);
   }
+  metadata_cache.Unmap();
+  return metadata_tree;
+}
 
-  // Recreate parent_metadata. This is necessary because pp::VarDictionary::Get
-  // returns a Var, not a Var& or Var* to directly modify the result.
-  parent_entries.Set(entry_name, entry_metadata);
-  parent_metadata->Set("entries", parent_entries);
+// Returns the name of the single entry of a raw archive, which has no names:
+// the name of the archive without the extension, e.g. "file" for "file.gz".
+std::string RawEntryName(const std::string& file_system_id) {
+  std::string name = file_system_id;
+  size_t pos = name.rfind("/");
+  if (pos != std::string::npos)
+    name.erase(0, pos + 1);
+  pos = name.rfind(".");
+  if (pos != std::string::npos)
+    name.erase(pos);
+  return name;
 }
 
 // An internal implementation of JavaScriptRequestorInterface.
@@ -225,13 +161,80 @@ struct Volume::OpenFileArgs {
   const int64_t archive_size;
 };
 
-Volume::Volume(const pp::InstanceHandle& instance_handle,
+struct Volume::OpenFileByPathArgs {
+  OpenFileByPathArgs(const std::string& request_id,
+                     const std::string& path,
+                     const std::string& encoding,
+                     int64_t archive_size) : request_id(request_id),
+                                             path(path),
+                                             encoding(encoding),
+                                             archive_size(archive_size) {}
+  const std::string request_id;
+  const std::string path;
+  const std::string encoding;
+  const int64_t archive_size;
+};
+
+struct Volume::ExtractArgs {
+  ExtractArgs(const std::string& request_id,
+              const std::set<int64_t>& indices,
+              const std::string& encoding,
+              int64_t archive_size) : request_id(request_id),
+                                      indices(indices),
+                                      encoding(encoding),
+                                      archive_size(archive_size) {}
+  const std::string request_id;
+  const std::set<int64_t> indices;
+  const std::string encoding;
+  const int64_t archive_size;
+};
+
+struct Volume::OpenFilesArgs {
+  OpenFilesArgs(const std::vector<std::pair<int64_t, std::string> >& files,
+                const std::string& encoding,
+                int64_t archive_size) : files(files),
+                                        encoding(encoding),
+                                        archive_size(archive_size) {}
+  const std::vector<std::pair<int64_t, std::string> > files;
+  const std::string encoding;
+  const int64_t archive_size;
+};
+
+struct Volume::ReadMetadataArgs {
+  ReadMetadataArgs(const std::string& request_id,
+                   const std::string& encoding,
+                   int64_t archive_size,
+                   request::MetadataFormat metadata_format,
+                   bool metadata_progress,
+                   const pp::Var& metadata_cache,
+                   bool create_metadata_cache)
+      : request_id(request_id),
+        encoding(encoding),
+        archive_size(archive_size),
+        metadata_format(metadata_format),
+        metadata_progress(metadata_progress),
+        metadata_cache(metadata_cache),
+        create_metadata_cache(create_metadata_cache) {}
+  const std::string request_id;
+  const std::string encoding;
+  const int64_t archive_size;
+  const request::MetadataFormat metadata_format;
+  const bool metadata_progress;
+  const pp::Var metadata_cache;
+  const bool create_metadata_cache;
+};
+
+Volume::Volume(WorkerPool* worker_pool,
                const std::string& file_system_id,
                JavaScriptMessageSenderInterface* message_sender)
-    : volume_archive_(NULL),
+    : small_file_cache_(volume_constants::kSmallFileCacheMaximumFileSize,
+                        volume_constants::kSmallFileCacheCapacity),
+      raw_(false),
+      metadata_tree_(NULL),
       file_system_id_(file_system_id),
       message_sender_(message_sender),
-      worker_(instance_handle),
+      worker_pool_(worker_pool),
+      job_queue_(worker_pool),
       callback_factory_(this) {
   requestor_ = new JavaScriptRequestor(this);
   volume_archive_factory_ = new VolumeArchiveFactory();
@@ -239,15 +242,19 @@ Volume::Volume(const pp::InstanceHandle& instance_handle,
   // Delegating constructors only from c++11.
 }
 
-Volume::Volume(const pp::InstanceHandle& instance_handle,
+Volume::Volume(WorkerPool* worker_pool,
                const std::string& file_system_id,
                JavaScriptMessageSenderInterface* message_sender,
                VolumeArchiveFactoryInterface* volume_archive_factory,
                VolumeReaderFactoryInterface* volume_reader_factory)
-    : volume_archive_(NULL),
+    : small_file_cache_(volume_constants::kSmallFileCacheMaximumFileSize,
+                        volume_constants::kSmallFileCacheCapacity),
+      raw_(false),
+      metadata_tree_(NULL),
       file_system_id_(file_system_id),
       message_sender_(message_sender),
-      worker_(instance_handle),
+      worker_pool_(worker_pool),
+      job_queue_(worker_pool),
       callback_factory_(this),
       volume_archive_factory_(volume_archive_factory),
       volume_reader_factory_(volume_reader_factory) {
@@ -255,132 +262,257 @@ Volume::Volume(const pp::InstanceHandle& instance_handle,
 }
 
 Volume::~Volume() {
-  worker_.Join();
+  job_queue_.Join();
 
-  if (volume_archive_) {
-    volume_archive_->Cleanup();
-    delete volume_archive_;
+  for (volume_archive_iterator it = volume_archives_.begin();
+       it != volume_archives_.end(); ++it) {
+    (*it)->Cleanup();
+    delete *it;
   }
 
+  delete metadata_tree_;
   delete requestor_;
   delete volume_archive_factory_;
   delete volume_reader_factory_;
 }
 
 bool Volume::Init() {
-  return worker_.Start();
+  return worker_pool_->Start();
 }
 
 void Volume::ReadMetadata(const std::string& request_id,
                           const std::string& encoding,
-                          int64_t archive_size) {
-  worker_.message_loop().PostWork(callback_factory_.NewCallback(
-      &Volume::ReadMetadataCallback, request_id, encoding, archive_size));
+                          int64_t archive_size,
+                          request::MetadataFormat metadata_format,
+                          bool metadata_progress,
+                          const pp::Var& metadata_cache,
+                          bool create_metadata_cache) {
+  PP_DCHECK(!metadata_progress ||
+            metadata_format == request::METADATA_FORMAT_BINARY);
+  job_queue_.PostWork(callback_factory_.NewCallback(
+      &Volume::ReadMetadataCallback,
+      ReadMetadataArgs(request_id, encoding, archive_size, metadata_format,
+                       metadata_progress, metadata_cache,
+                       create_metadata_cache)));
+}
+
+void Volume::ReadDirectory(const std::string& request_id,
+                           const std::string& path) {
+  if (GetMetadataTree()) {
+    ReadDirectoryCallback(PP_OK, request_id, path);
+    return;
+  }
+  job_queue_.PostWork(callback_factory_.NewCallback(
+      &Volume::ReadDirectoryCallback, request_id, path));
+}
+
+void Volume::GetMetadata(const std::string& request_id,
+                         const std::string& path) {
+  if (GetMetadataTree()) {
+    GetMetadataCallback(PP_OK, request_id, path);
+    return;
+  }
+  job_queue_.PostWork(callback_factory_.NewCallback(
+      &Volume::GetMetadataCallback, request_id, path));
 }
 
 void Volume::OpenFile(const std::string& request_id,
                       int64_t index,
                       const std::string& encoding,
                       int64_t archive_size) {
-  worker_.message_loop().PostWork(callback_factory_.NewCallback(
+  job_queue_.PostWork(callback_factory_.NewCallback(
       &Volume::OpenFileCallback, OpenFileArgs(request_id, index, encoding,
       archive_size)));
 }
 
+void Volume::OpenFiles(
+    const std::vector<std::pair<int64_t, std::string> >& files,
+    const std::string& encoding,
+    int64_t archive_size) {
+  job_queue_.PostWork(callback_factory_.NewCallback(
+      &Volume::OpenFilesCallback,
+      OpenFilesArgs(files, encoding, archive_size)));
+}
+
+void Volume::OpenFileByPath(const std::string& request_id,
+                            const std::string& path,
+                            const std::string& encoding,
+                            int64_t archive_size) {
+  job_queue_.PostWork(callback_factory_.NewCallback(
+      &Volume::OpenFileByPathCallback,
+      OpenFileByPathArgs(request_id, path, encoding, archive_size)));
+}
+
+void Volume::Extract(const std::string& request_id,
+                     const std::set<int64_t>& indices,
+                     const std::string& encoding,
+                     int64_t archive_size) {
+  job_queue_.PostWork(callback_factory_.NewCallback(
+      &Volume::ExtractCallback,
+      ExtractArgs(request_id, indices, encoding, archive_size)));
+}
+
 void Volume::CloseFile(const std::string& request_id,
                        const std::string& open_request_id) {
-  // Though close file could be executed on main thread, we send it to worker_
-  // in order to ensure thread safety.
-  worker_.message_loop().PostWork(callback_factory_.NewCallback(
+  // Though close file could be executed on main thread, we send it to
+  // job_queue_ in order to ensure thread safety.
+  job_queue_.PostWork(callback_factory_.NewCallback(
       &Volume::CloseFileCallback, request_id, open_request_id));
 }
 
 void Volume::ReadFile(const std::string& request_id,
                       const pp::VarDictionary& dictionary) {
-  worker_.message_loop().PostWork(callback_factory_.NewCallback(
+  job_queue_.PostWork(callback_factory_.NewCallback(
       &Volume::ReadFileCallback, request_id, dictionary));
 }
 
 void Volume::ReadChunkDone(const std::string& request_id,
                            const pp::VarArrayBuffer& array_buffer,
                            int64_t read_offset) {
-  PP_DCHECK(volume_archive_);
-
-  static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
-      SetBufferAndSignal(array_buffer, read_offset);
+  // Every reader requests its own chunks, so the chunk goes only to the
+  // archive which requested it. A chunk for an archive acquired for another
+  // request since is dropped, as the reader requests it again.
+  job_lock_.Acquire();
+  VolumeArchive* volume_archive = FindVolumeArchive(request_id);
+  if (volume_archive) {
+    static_cast<VolumeReaderJavaScriptStream*>(volume_archive->reader())->
+        SetBufferAndSignal(array_buffer, read_offset);
+  }
+  job_lock_.Release();
 }
 
 void Volume::ReadChunkError(const std::string& request_id) {
-  PP_DCHECK(volume_archive_);
-
-  static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
-      ReadErrorSignal();
+  // JavaScript fails reading chunks only if the archive file is not readable
+  // anymore, which affects all of the archives.
+  job_lock_.Acquire();
+  for (volume_archive_iterator it = volume_archives_.begin();
+       it != volume_archives_.end(); ++it) {
+    static_cast<VolumeReaderJavaScriptStream*>((*it)->reader())->
+        ReadErrorSignal();
+  }
+  job_lock_.Release();
 }
 
 void Volume::ReadPassphraseDone(const std::string& request_id,
                                 const std::string& passphrase) {
-  PP_DCHECK(volume_archive_);
-
   job_lock_.Acquire();
-  if (request_id == reader_request_id_) {
-    static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
+  VolumeArchive* volume_archive = FindVolumeArchive(request_id);
+  if (volume_archive) {
+    static_cast<VolumeReaderJavaScriptStream*>(volume_archive->reader())->
         SetPassphraseAndSignal(passphrase);
   }
   job_lock_.Release();
 }
 
 void Volume::ReadPassphraseError(const std::string& request_id) {
-  PP_DCHECK(volume_archive_);
-
   job_lock_.Acquire();
-  if (request_id == reader_request_id_) {
-    static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
+  VolumeArchive* volume_archive = FindVolumeArchive(request_id);
+  if (volume_archive) {
+    static_cast<VolumeReaderJavaScriptStream*>(volume_archive->reader())->
         PassphraseErrorSignal();
   }
   job_lock_.Release();
 }
 
 void Volume::ReadMetadataCallback(int32_t /*result*/,
-                                  const std::string& request_id,
-                                  const std::string& encoding,
-                                  int64_t archive_size) {
-  if (volume_archive_) {
+                                  const ReadMetadataArgs& args) {
+  const std::string& request_id = args.request_id;
+  const std::string& encoding = args.encoding;
+  int64_t archive_size = args.archive_size;
+
+  // Archives may be already created by OpenFileByPath, which doesn't read
+  // the metadata.
+  if (GetMetadataTree()) {
      message_sender_->SendFileSystemError(
          file_system_id_, request_id, "ALREADY_OPENED");
+     return;
   }
 
-  job_lock_.Acquire();
-  volume_archive_ = volume_archive_factory_->Create(
-      volume_reader_factory_->Create(archive_size));
-  static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
-      SetRequestId(request_id);
-  reader_request_id_ = request_id;
-  job_lock_.Release();
-
-  // First we try the non-raw format.
-  if (!volume_archive_->Init(encoding, false)) {
-    volume_archive_->Cleanup();
-    delete volume_archive_;
-    volume_archive_ = volume_archive_factory_->Create(
-        volume_reader_factory_->Create(archive_size));
-    static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
-        SetRequestId(reader_request_id_);
-
-    // If that failed, retry with the raw format.
-    if (!volume_archive_->Init(encoding, true)) {
+  // Restore the metadata of an archive mounted before. The archive is opened
+  // with the cached format, so no headers are read but the first ones.
+  std::string error_message;
+  VolumeArchive* volume_archive = NULL;
+  MetadataTree* metadata_tree = NULL;
+  if (args.metadata_cache.is_array_buffer()) {
+    bool raw = false;
+    metadata_tree =
+        RestoreMetadataCache(pp::VarArrayBuffer(args.metadata_cache), &raw);
+    if (metadata_tree) {
+      raw_ = raw;
+      volume_archive = CreateVolumeArchive(
+          request_id, encoding, archive_size, raw_, &error_message);
+    }
+    if (!volume_archive) {
+      delete metadata_tree;
+      metadata_tree = NULL;
+    }
+  }
 
+  // First we try the non-raw format. If that failed, retry with the raw format.
+  if (!volume_archive) {
+    raw_ = false;
+    volume_archive = CreateVolumeArchive(
+        request_id, encoding, archive_size, raw_, &error_message);
+  }
+  if (!volume_archive) {
+    raw_ = true;
+    volume_archive = CreateVolumeArchive(
+        request_id, encoding, archive_size, raw_, &error_message);
+  }
+  if (!volume_archive) {
     message_sender_->SendFileSystemError(
-        file_system_id_, request_id, volume_archive_->error_message());
-    ClearJob();
-    delete volume_archive_;
-    volume_archive_ = NULL;
+        file_system_id_, request_id, error_message);
     return;
+  }
+
+  pp::Var metadata_cache;
+  if (!metadata_tree) {
+    metadata_tree = ReadMetadataTree(volume_archive, args);
+    if (!metadata_tree) {
+      message_sender_->SendFileSystemError(
+          file_system_id_, request_id, volume_archive->error_message());
+      DestroyVolumeArchive(volume_archive);
+      return;
+    }
+    if (args.create_metadata_cache)
+      metadata_cache = CreateMetadataCache(*metadata_tree, raw_);
+  }
+
+  // The whole tree is sent below, including the changes to nodes already sent
+  // with READ_METADATA_PROGRESS, e.g. for directories listed after their files.
+
+  // Keep the metadata for READ_DIRECTORY and GET_METADATA.
+  job_lock_.Acquire();
+  metadata_tree_ = metadata_tree;
+  job_lock_.Release();
 
+  // Send metadata back to JavaScript.
+  switch (args.metadata_format) {
+    case request::METADATA_FORMAT_DICTIONARY:
+    default:
+      message_sender_->SendReadMetadataDone(
+          file_system_id_, request_id, metadata_tree->ToVarDictionary(),
+          metadata_cache);
+      break;
+    case request::METADATA_FORMAT_BINARY:
+      message_sender_->SendReadMetadataDone(
+          file_system_id_, request_id, metadata_tree->ToVarArrayBuffer(),
+          metadata_cache);
+      break;
+    case request::METADATA_FORMAT_LAZY: {
+      pp::VarDictionary root_metadata;
+      metadata_tree->GetEntryMetadata("/", &root_metadata);
+      message_sender_->SendReadMetadataDone(
+          file_system_id_, request_id, root_metadata, metadata_cache);
+      break;
     }
   }
+}
 
-  // Read and construct metadata.
-  pp::VarDictionary root_metadata = CreateEntry(-1, "" /* name */, true, 0, 0);
+MetadataTree* Volume::ReadMetadataTree(VolumeArchive* volume_archive,
+                                       const ReadMetadataArgs& args) {
+  const std::string& request_id = args.request_id;
+  MetadataTree* metadata_tree = new MetadataTree();
 
   const char* path_name = NULL;
   int64_t size = 0;
@@ -388,107 +520,451 @@ void Volume::ReadMetadataCallback(int32_t /*result*/,
   time_t modification_time = 0;
   int64_t index = 0;
 
+  // The nodes of metadata_tree not sent with READ_METADATA_PROGRESS yet.
+  size_t first_unsent_node = 0;
+  double last_progress_time = NowInMilliseconds();
+
   for (;;) {
-    VolumeArchive::Result ret = volume_archive_->GetNextHeader(
+    VolumeArchive::Result ret = volume_archive->GetNextHeader(
         &path_name, &size, &is_directory, &modification_time);
     if (ret == VolumeArchive::RESULT_FAIL) {
-      message_sender_->SendFileSystemError(
-          file_system_id_, request_id, volume_archive_->error_message());
-      ClearJob();
-      delete volume_archive_;
-      volume_archive_ = NULL;
-      return;
+      delete metadata_tree;
+      return NULL;
     } else if (ret == VolumeArchive::RESULT_EOF)
       break;
 
     // If the file name didn't exist, construct one.
     std::string new_path_name;
-    size_t pos;
     if (path_name == NULL) {
-      new_path_name = file_system_id_;
-      pos = new_path_name.rfind("/");
-      if (pos != std::string::npos)
-        new_path_name.erase(0, pos + 1);
-      pos = new_path_name.rfind(".");
-      if (pos != std::string::npos)
-        new_path_name.erase(pos);
+      new_path_name = RawEntryName(file_system_id_);
       path_name = new_path_name.c_str();
     }
 
-    ConstructMetadata(index, path_name, size, is_directory, modification_time,
-        &root_metadata);
+    metadata_tree->AddEntry(
+        index, path_name, size, is_directory, modification_time);
 
     ++index;
+
+    if (args.metadata_progress) {
+      size_t unsent_nodes = metadata_tree->node_count() - first_unsent_node;
+      double now = NowInMilliseconds();
+      if (unsent_nodes >= volume_constants::kMetadataProgressEntries ||
+          (unsent_nodes > 0 &&
+           now - last_progress_time >=
+               volume_constants::kMetadataProgressIntervalMs)) {
+        message_sender_->SendReadMetadataProgress(
+            file_system_id_, request_id,
+            metadata_tree->ToVarArrayBuffer(first_unsent_node));
+        first_unsent_node = metadata_tree->node_count();
+        last_progress_time = now;
+      }
+    }
   }
 
-  ClearJob();
+  return metadata_tree;
+}
 
-  // Send metadata back to JavaScript.
-  message_sender_->SendReadMetadataDone(
-      file_system_id_, request_id, root_metadata);
+void Volume::ReadDirectoryCallback(int32_t /*result*/,
+                                   const std::string& request_id,
+                                   const std::string& path) {
+  const MetadataTree* metadata_tree = GetMetadataTree();
+  if (!metadata_tree) {
+    message_sender_->SendFileSystemError(
+        file_system_id_, request_id, "NOT_READ");
+    return;
+  }
+
+  pp::VarArray entries;
+  switch (metadata_tree->ReadDirectory(path, &entries)) {
+    case MetadataTree::RESULT_SUCCESS:
+      message_sender_->SendReadDirectoryDone(
+          file_system_id_, request_id, entries);
+      break;
+    case MetadataTree::RESULT_NOT_FOUND:
+      message_sender_->SendFileSystemError(
+          file_system_id_, request_id, "NOT_FOUND");
+      break;
+    case MetadataTree::RESULT_NOT_A_DIRECTORY:
+      message_sender_->SendFileSystemError(
+          file_system_id_, request_id, "NOT_A_DIRECTORY");
+      break;
+  }
+}
+
+void Volume::GetMetadataCallback(int32_t /*result*/,
+                                 const std::string& request_id,
+                                 const std::string& path) {
+  const MetadataTree* metadata_tree = GetMetadataTree();
+  if (!metadata_tree) {
+    message_sender_->SendFileSystemError(
+        file_system_id_, request_id, "NOT_READ");
+    return;
+  }
+
+  pp::VarDictionary entry_metadata;
+  if (metadata_tree->GetEntryMetadata(path, &entry_metadata) !=
+      MetadataTree::RESULT_SUCCESS) {
+    message_sender_->SendFileSystemError(
+        file_system_id_, request_id, "NOT_FOUND");
+    return;
+  }
+  message_sender_->SendGetMetadataDone(
+      file_system_id_, request_id, entry_metadata);
+}
+
+bool Volume::IsFileOpened(const std::string& open_request_id) {
+  job_lock_.Acquire();
+  bool opened = opened_files_.find(open_request_id) != opened_files_.end();
+  job_lock_.Release();
+  return opened || cached_opened_files_.find(open_request_id) !=
+                       cached_opened_files_.end();
+}
+
+bool Volume::OpenCachedFile(const std::string& open_request_id,
+                            int64_t index) {
+  pp::VarArrayBuffer contents;
+  if (!small_file_cache_.Get(index, &contents))
+    return false;
+  cached_opened_files_[open_request_id] = contents;
+  return true;
+}
+
+void Volume::ReadCachedFile(const std::string& request_id,
+                            const pp::VarArrayBuffer& contents,
+                            int64_t offset,
+                            int64_t length) {
+  // The whole contents are sent without copying them if requested, which is
+  // the common case for small files.
+  int64_t size = contents.ByteLength();
+  if (offset == 0 && length >= size) {
+    message_sender_->SendReadFileDone(
+        file_system_id_, request_id, contents, false /* has_more_data */);
+    return;
+  }
+
+  int64_t read_bytes = std::max(std::min(length, size - offset),
+                                static_cast<int64_t>(0));
+  pp::VarArrayBuffer array_buffer(read_bytes);
+  if (read_bytes > 0) {
+    pp::VarArrayBuffer source(contents);
+    memcpy(array_buffer.Map(), static_cast<char*>(source.Map()) + offset,
+           read_bytes);
+    source.Unmap();
+    array_buffer.Unmap();
+  }
+  message_sender_->SendReadFileDone(
+      file_system_id_, request_id, array_buffer, false /* has_more_data */);
+}
+
+const MetadataTree* Volume::GetMetadataTree() {
+  job_lock_.Acquire();
+  const MetadataTree* metadata_tree = metadata_tree_;
+  job_lock_.Release();
+  return metadata_tree;
 }
 
 void Volume::OpenFileCallback(int32_t /*result*/,
                               const OpenFileArgs& args) {
-  if (!volume_archive_) {
+  if (volume_archives_.empty()) {
      message_sender_->SendFileSystemError(
          file_system_id_, args.request_id, "NOT_OPENED");
      return;
   }
 
+  if (IsFileOpened(args.request_id)) {
+    message_sender_->SendFileSystemError(
+        file_system_id_, args.request_id, "ILLEGAL");
+    return;
+  }
+
+  if (OpenCachedFile(args.request_id, args.index)) {
+    message_sender_->SendOpenFileDone(file_system_id_, args.request_id);
+    return;
+  }
+
+  std::string error_message;
+  VolumeArchive* volume_archive = AcquireVolumeArchive(
+      args.request_id, args.index, args.encoding, args.archive_size,
+      &error_message);
+  if (!volume_archive) {
+    message_sender_->SendFileSystemError(
+        file_system_id_, args.request_id, error_message);
+    return;
+  }
+
   job_lock_.Acquire();
-  if (!reader_request_id_.empty()) {
-    // It is illegal to open a file while another operation is in progress or
-    // another file is opened.
+  opened_files_[args.request_id] = volume_archive;
+  job_lock_.Release();
+
+  // Send successful opened file response to NaCl.
+  message_sender_->SendOpenFileDone(file_system_id_, args.request_id);
+}
+
+void Volume::OpenFilesCallback(int32_t /*result*/,
+                               const OpenFilesArgs& args) {
+  // Pairs are ordered by index first.
+  std::vector<std::pair<int64_t, std::string> > files(args.files);
+  std::sort(files.begin(), files.end());
+  for (size_t i = 0; i < files.size(); ++i) {
+    OpenFileCallback(PP_OK, OpenFileArgs(files[i].second, files[i].first,
+                                         args.encoding, args.archive_size));
+  }
+}
+
+void Volume::OpenFileByPathCallback(int32_t /*result*/,
+                                    const OpenFileByPathArgs& args) {
+  if (IsFileOpened(args.request_id)) {
     message_sender_->SendFileSystemError(
         file_system_id_, args.request_id, "ILLEGAL");
-    job_lock_.Release();
     return;
   }
-  static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
-      SetRequestId(args.request_id);
-  reader_request_id_ = args.request_id;
+
+  std::string error_message;
+  VolumeArchive* volume_archive = NULL;
+  int64_t index = 0;
+  int64_t size = 0;
+  bool is_directory = false;
+  const MetadataTree* metadata_tree = GetMetadataTree();
+  if (metadata_tree) {
+    // The index is known once the metadata is read, so the entry is opened
+    // just like with OpenFile.
+    if (metadata_tree->FindEntry(args.path, &index, &size, &is_directory) !=
+        MetadataTree::RESULT_SUCCESS) {
+      error_message = "NOT_FOUND";
+    } else if (is_directory) {
+      error_message = "NOT_A_FILE";
+    } else if (OpenCachedFile(args.request_id, index)) {
+      message_sender_->SendOpenFileByPathDone(
+          file_system_id_, args.request_id, index, size);
+      return;
+    } else {
+      volume_archive = AcquireVolumeArchive(
+          args.request_id, index, args.encoding, args.archive_size,
+          &error_message);
+    }
+  } else {
+    volume_archive = FindVolumeArchiveEntry(
+        args, &index, &size, &is_directory, &error_message);
+    // Keep the archive parked at the directory for the next opened files.
+    if (volume_archive && is_directory) {
+      error_message = "NOT_A_FILE";
+      volume_archive = NULL;
+    }
+  }
+
+  if (!volume_archive) {
+    message_sender_->SendFileSystemError(
+        file_system_id_, args.request_id, error_message);
+    return;
+  }
+
+  job_lock_.Acquire();
+  opened_files_[args.request_id] = volume_archive;
   job_lock_.Release();
 
-  if (!volume_archive_->SeekHeader(args.index)) {
-    // Maybe we're dealing with a streaming archive format (e.g. tar).
-    // We need to re-read this thing everytime.
-    bool raw = volume_archive_->raw_;
-    if (volume_archive_->curr_index > args.index || raw) {
-      volume_archive_->Cleanup();
-      delete volume_archive_;
-      volume_archive_ = volume_archive_factory_->Create(
-          volume_reader_factory_->Create(args.archive_size));
-      static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
-          SetRequestId(reader_request_id_);
-      if (!volume_archive_->Init(args.encoding, raw)) {
+  message_sender_->SendOpenFileByPathDone(
+      file_system_id_, args.request_id, index, size);
+}
+
+VolumeArchive* Volume::FindVolumeArchiveEntry(const OpenFileByPathArgs& args,
+                                              int64_t* index,
+                                              int64_t* size,
+                                              bool* is_directory,
+                                              std::string* error_message) {
+  // The parked archives can't be used, as the entry may be before them.
+  ReleaseIdleVolumeArchives();
+  VolumeArchive* volume_archive = CreateVolumeArchiveDetectingFormat(
+      args.request_id, args.encoding, args.archive_size, error_message);
+  if (!volume_archive)
+    return NULL;
+
+  // Stop at the first entry with the path. Unlike in the metadata, where the
+  // last one wins, later entries with the same path are not looked at, as
+  // that would need reading all the headers.
+  const std::string path = MetadataTree::NormalizePath(args.path);
+  const char* path_name = NULL;
+  time_t modification_time = 0;
+  for (*index = 0;; ++*index) {
+    VolumeArchive::Result ret = volume_archive->GetNextHeader(
+        &path_name, size, is_directory, &modification_time);
+    if (ret != VolumeArchive::RESULT_SUCCESS) {
+      *error_message = ret == VolumeArchive::RESULT_EOF ?
+          "NOT_FOUND" : volume_archive->error_message();
+      DestroyVolumeArchive(volume_archive);
+      return NULL;
+    }
+    if (MetadataTree::NormalizePath(
+            path_name ? path_name : RawEntryName(file_system_id_)) == path) {
+      break;
+    }
+  }
+
+  // The size of a raw entry is computed by decompressing all of its data, so
+  // read the entry again from the beginning.
+  if (raw_) {
+    DestroyVolumeArchive(volume_archive);
+    volume_archive = AcquireVolumeArchive(
+        args.request_id, *index, args.encoding, args.archive_size,
+        error_message);
+  }
+  return volume_archive;
+}
+
+void Volume::ExtractCallback(int32_t /*result*/, const ExtractArgs& args) {
+  const std::string& request_id = args.request_id;
+
+  // Parked archives are not used, as some of the entries may be before them.
+  std::string error_message;
+  ReleaseIdleVolumeArchives();
+  VolumeArchive* volume_archive = CreateVolumeArchiveDetectingFormat(
+      request_id, args.encoding, args.archive_size, &error_message);
+  if (!volume_archive) {
+    message_sender_->SendFileSystemError(
+        file_system_id_, request_id, error_message);
+    return;
+  }
+
+  const char* path_name = NULL;
+  int64_t size = 0;
+  bool is_directory = false;
+  time_t modification_time = 0;
+  size_t selected_entries = 0;
+  bool more_entries = true;
+  for (int64_t index = 0;
+       args.indices.empty() || selected_entries < args.indices.size();
+       ++index) {
+    VolumeArchive::Result ret = volume_archive->GetNextHeader(
+        &path_name, &size, &is_directory, &modification_time);
+    if (ret == VolumeArchive::RESULT_FAIL) {
+      message_sender_->SendFileSystemError(
+          file_system_id_, request_id, volume_archive->error_message());
+      DestroyVolumeArchive(volume_archive);
+      return;
+    } else if (ret == VolumeArchive::RESULT_EOF) {
+      more_entries = false;
+      break;
+    }
+
+    if (!args.indices.empty()) {
+      if (args.indices.find(index) == args.indices.end())
+        continue;
+      ++selected_entries;
+    }
+    if (is_directory)
+      continue;
+
+    std::string path = path_name ? path_name : RawEntryName(file_system_id_);
+
+    // The size of a raw entry is computed by decompressing all of its data,
+    // so read the entry again from the beginning.
+    if (raw_) {
+      DestroyVolumeArchive(volume_archive);
+      volume_archive = AcquireVolumeArchive(
+          request_id, index, args.encoding, args.archive_size,
+          &error_message);
+      if (!volume_archive) {
         message_sender_->SendFileSystemError(
-            file_system_id_, args.request_id, volume_archive_->error_message());
-        ClearJob();
+            file_system_id_, request_id, error_message);
         return;
       }
     }
+
+    message_sender_->SendExtractEntry(
+        file_system_id_, request_id, index, path, size);
+    if (!ExtractEntryData(volume_archive, request_id, index, size)) {
+      message_sender_->SendFileSystemError(
+          file_system_id_, request_id, volume_archive->error_message());
+      DestroyVolumeArchive(volume_archive);
+      return;
+    }
   }
 
-  do {
-  if (volume_archive_->GetNextHeader() == VolumeArchive::RESULT_FAIL) {
-    message_sender_->SendFileSystemError(
-        file_system_id_, args.request_id, volume_archive_->error_message());
-    ClearJob();
-    return;
+  // Keep the archive parked for opening the next entries, unless it was read
+  // till the end.
+  if (!more_entries)
+    DestroyVolumeArchive(volume_archive);
+
+  message_sender_->SendExtractDone(file_system_id_, request_id);
+}
+
+bool Volume::ExtractEntryData(VolumeArchive* volume_archive,
+                              const std::string& request_id,
+                              int64_t index,
+                              int64_t size) {
+  // Every entry ends with a chunk without more data. Some formats don't store
+  // the size in the header, in which case it is 0 and the entry ends with an
+  // empty chunk once no more data can be read.
+  bool cache_contents =
+      small_file_cache_.CanCache(size) && !small_file_cache_.Contains(index);
+  std::string contents;
+  int64_t offset = 0;
+  for (;;) {
+    const char* destination_buffer = NULL;
+    int64_t read_bytes = volume_archive->ReadData(
+        offset, volume_constants::kExtractChunkSize, &destination_buffer);
+    if (read_bytes < 0)
+      return false;
+
+    pp::VarArrayBuffer array_buffer(read_bytes);
+    if (read_bytes > 0) {
+      char* array_buffer_data = static_cast<char*>(array_buffer.Map());
+      memcpy(array_buffer_data, destination_buffer, read_bytes);
+      array_buffer.Unmap();
+    }
+
+    offset += read_bytes;
+    cache_contents = cache_contents && small_file_cache_.CanCache(offset);
+    if (cache_contents)
+      contents.append(destination_buffer, read_bytes);
+
+    bool has_more_data = read_bytes > 0 && (offset < size || size == 0);
+    message_sender_->SendExtractData(
+        file_system_id_, request_id, index, array_buffer, has_more_data);
+    if (!has_more_data)
+      break;
   }
-  } while (volume_archive_->curr_index <= args.index);
 
-  // Send successful opened file response to NaCl.
-  message_sender_->SendOpenFileDone(file_system_id_, args.request_id);
+  if (cache_contents)
+    small_file_cache_.Put(index, contents.data(), contents.size());
+  return true;
+}
+
+bool Volume::CacheEntryData(VolumeArchive* volume_archive,
+                            int64_t index,
+                            int64_t size) {
+  if (!small_file_cache_.CanCache(size) || small_file_cache_.Contains(index))
+    return true;
+
+  // Stop once the entry turns out to be too big, e.g. if its size is not
+  // stored in the header. The rest of its data is skipped with the header.
+  std::string contents;
+  int64_t offset = 0;
+  while (small_file_cache_.CanCache(offset)) {
+    const char* destination_buffer = NULL;
+    int64_t read_bytes = volume_archive->ReadData(
+        offset, volume_constants::kSmallFileCacheMaximumFileSize,
+        &destination_buffer);
+    if (read_bytes < 0)
+      return false;
+    if (read_bytes == 0) {
+      small_file_cache_.Put(index, contents.data(), contents.size());
+      return true;
+    }
+    contents.append(destination_buffer, read_bytes);
+    offset += read_bytes;
+  }
+  return true;
 }
 
 void Volume::CloseFileCallback(int32_t /*result*/,
                                const std::string& request_id,
                                const std::string& open_request_id) {
+  // The archive stays parked at the header of the closed file, so opening a
+  // file after it doesn't have to start from the beginning.
   job_lock_.Acquire();
-  reader_request_id_ = "";
+  opened_files_.erase(open_request_id);
   job_lock_.Release();
+  cached_opened_files_.erase(open_request_id);
 
   message_sender_->SendCloseFileDone(
       file_system_id_, request_id, open_request_id);
@@ -497,12 +973,6 @@ void Volume::CloseFileCallback(int32_t /*result*/,
 void Volume::ReadFileCallback(int32_t /*result*/,
                               const std::string& request_id,
                               const pp::VarDictionary& dictionary) {
-  if (!volume_archive_) {
-     message_sender_->SendFileSystemError(
-         file_system_id_, request_id, "NOT_OPENED");
-     return;
-  }
-
   std::string open_request_id(
       dictionary.Get(request::key::kOpenRequestId).AsString());
   int64_t offset =
@@ -511,14 +981,23 @@ void Volume::ReadFileCallback(int32_t /*result*/,
       request::GetInt64FromString(dictionary, request::key::kLength);
   PP_DCHECK(length > 0);  // JavaScript must not make requests with length <= 0.
 
+  std::map<std::string, pp::VarArrayBuffer>::const_iterator cached_it =
+      cached_opened_files_.find(open_request_id);
+  if (cached_it != cached_opened_files_.end()) {
+    ReadCachedFile(request_id, cached_it->second, offset, length);
+    return;
+  }
+
   job_lock_.Acquire();
-  if (open_request_id != reader_request_id_) {
+  opened_file_iterator it = opened_files_.find(open_request_id);
+  if (it == opened_files_.end()) {
     // The file is not opened.
     message_sender_->SendFileSystemError(
         file_system_id_, request_id, "FILE_NOT_OPENED");
     job_lock_.Release();
     return;
   }
+  VolumeArchive* volume_archive = it->second;
   job_lock_.Release();
 
   // Decompress data and send it to JavaScript. Sending data is done in chunks
@@ -526,7 +1005,7 @@ void Volume::ReadFileCallback(int32_t /*result*/,
   int64_t left_length = length;
   while (left_length > 0) {
     const char* destination_buffer = NULL;
-    int64_t read_bytes = volume_archive_->ReadData(
+    int64_t read_bytes = volume_archive->ReadData(
         offset, left_length, &destination_buffer);
 
     if (read_bytes < 0) {
@@ -534,7 +1013,7 @@ void Volume::ReadFileCallback(int32_t /*result*/,
       // open request (open_request_id), as the last one has finished and this
       // is a read file.
       message_sender_->SendFileSystemError(
-          file_system_id_, request_id, volume_archive_->error_message());
+          file_system_id_, request_id, volume_archive->error_message());
 
       // Should not cleanup VolumeArchive as Volume::CloseFile will be called in
       // case of failure.
@@ -559,12 +1038,187 @@ void Volume::ReadFileCallback(int32_t /*result*/,
     left_length -= read_bytes;
     offset += read_bytes;
   }
-  volume_archive_->MaybeDecompressAhead();
+  volume_archive->MaybeDecompressAhead();
+}
+
+
+VolumeArchive* Volume::CreateVolumeArchive(const std::string& request_id,
+                                           const std::string& encoding,
+                                           int64_t archive_size,
+                                           bool raw,
+                                           std::string* error_message) {
+  VolumeArchive* volume_archive = volume_archive_factory_->Create(
+      volume_reader_factory_->Create(archive_size));
+
+  // Must be visible to the main thread before Init, which already reads data
+  // and may ask for a passphrase.
+  job_lock_.Acquire();
+  static_cast<VolumeReaderJavaScriptStream*>(volume_archive->reader())->
+      SetRequestId(request_id);
+  volume_archives_.push_front(volume_archive);
+  job_lock_.Release();
+
+  if (!volume_archive->Init(encoding, raw)) {
+    *error_message = volume_archive->error_message();
+    DestroyVolumeArchive(volume_archive);
+    return NULL;
+  }
+
+  return volume_archive;
 }
 
+VolumeArchive* Volume::CreateVolumeArchiveDetectingFormat(
+    const std::string& request_id,
+    const std::string& encoding,
+    int64_t archive_size,
+    std::string* error_message) {
+  if (!volume_archives_.empty()) {
+    return CreateVolumeArchive(
+        request_id, encoding, archive_size, raw_, error_message);
+  }
 
-void Volume::ClearJob() {
+  // First we try the non-raw format. If that failed, retry with the raw format.
+  raw_ = false;
+  VolumeArchive* volume_archive = CreateVolumeArchive(
+      request_id, encoding, archive_size, raw_, error_message);
+  if (!volume_archive) {
+    raw_ = true;
+    volume_archive = CreateVolumeArchive(
+        request_id, encoding, archive_size, raw_, error_message);
+  }
+  return volume_archive;
+}
+
+void Volume::DestroyVolumeArchive(VolumeArchive* volume_archive) {
   job_lock_.Acquire();
-  reader_request_id_ = "";
+  volume_archives_.remove(volume_archive);
   job_lock_.Release();
+
+  // Not reachable from the main thread anymore, so no lock is needed.
+  volume_archive->Cleanup();
+  delete volume_archive;
+}
+
+void Volume::ReleaseIdleVolumeArchives() {
+  volume_archive_iterator it = volume_archives_.end();
+  while (it != volume_archives_.begin() &&
+         static_cast<int64_t>(volume_archives_.size() + 1) *
+                 volume_constants::kVolumeArchiveMemoryUsage >
+             volume_constants::kMaximumVolumeArchivesMemoryUsage) {
+    VolumeArchive* candidate = *(--it);
+    if (IsVolumeArchiveInUse(candidate))
+      continue;
+    // Removing invalidates only the iterator of the removed element.
+    ++it;
+    DestroyVolumeArchive(candidate);
+  }
+}
+
+VolumeArchive* Volume::AcquireVolumeArchive(const std::string& request_id,
+                                            int64_t index,
+                                            const std::string& encoding,
+                                            int64_t archive_size,
+                                            std::string* error_message) {
+  // Streaming formats can be read only forward, so prefer the archive parked
+  // nearest before the entry. Formats that can seek to a header can use any
+  // archive, so fall back to the most recently used one. Archives of opened
+  // files are never taken over. An archive still at the entry, e.g. of a file
+  // opened again right after it was closed, is used as is if the data read so
+  // far can be read again, so nothing has to be read from the archive.
+  VolumeArchive* volume_archive = NULL;
+  VolumeArchive* most_recently_used = NULL;
+  VolumeArchive* at_entry = NULL;
+  size_t idle_count = 0;
+  for (volume_archive_iterator it = volume_archives_.begin();
+       it != volume_archives_.end(); ++it) {
+    if (IsVolumeArchiveInUse(*it))
+      continue;
+    ++idle_count;
+    if (!most_recently_used)
+      most_recently_used = *it;
+    if (!at_entry && (*it)->curr_index == index + 1 &&
+        (*it)->CanReadDataAgain()) {
+      at_entry = *it;
+    }
+    if ((*it)->curr_index <= index &&
+        (!volume_archive || (*it)->curr_index > volume_archive->curr_index)) {
+      volume_archive = *it;
+    }
+  }
+  if (!volume_archive)
+    volume_archive = most_recently_used;
+  if (at_entry)
+    volume_archive = at_entry;
+
+  if (volume_archive) {
+    job_lock_.Acquire();
+    static_cast<VolumeReaderJavaScriptStream*>(volume_archive->reader())->
+        SetRequestId(request_id);
+    volume_archives_.remove(volume_archive);
+    volume_archives_.push_front(volume_archive);
+    job_lock_.Release();
+  }
+
+  if (at_entry)
+    return volume_archive;
+
+  if (!volume_archive ||
+      (!volume_archive->SeekHeader(index) &&
+       (volume_archive->curr_index > index || volume_archive->raw_))) {
+    // Maybe we're dealing with a streaming archive format (e.g. tar) and no
+    // archive is parked before the entry. Read it again from the beginning
+    // with a new archive, releasing the least recently used idle ones first.
+    ReleaseIdleVolumeArchives();
+    volume_archive = CreateVolumeArchive(
+        request_id, encoding, archive_size, raw_, error_message);
+    if (!volume_archive)
+      return NULL;
+  }
+
+  // Streaming formats decompress the data of the entries before the one at
+  // index to skip it anyway, so keep the small files on the way. The raw
+  // format has a single entry.
+  while (volume_archive->curr_index <= index) {
+    int64_t entry_index = volume_archive->curr_index;
+    const char* path_name = NULL;
+    int64_t size = 0;
+    bool is_directory = false;
+    time_t modification_time = 0;
+    VolumeArchive::Result ret = raw_ ?
+        volume_archive->GetNextHeader() :
+        volume_archive->GetNextHeader(
+            &path_name, &size, &is_directory, &modification_time);
+    if (ret == VolumeArchive::RESULT_FAIL ||
+        (ret == VolumeArchive::RESULT_SUCCESS && entry_index < index &&
+         !is_directory &&
+         !CacheEntryData(volume_archive, entry_index, size))) {
+      *error_message = volume_archive->error_message();
+      DestroyVolumeArchive(volume_archive);
+      return NULL;
+    }
+  }
+
+  return volume_archive;
+}
+
+bool Volume::IsVolumeArchiveInUse(VolumeArchive* volume_archive) {
+  bool in_use = false;
+  job_lock_.Acquire();
+  for (opened_file_iterator it = opened_files_.begin();
+       it != opened_files_.end() && !in_use; ++it) {
+    in_use = it->second == volume_archive;
+  }
+  job_lock_.Release();
+  return in_use;
+}
+
+VolumeArchive* Volume::FindVolumeArchive(const std::string& request_id) {
+  for (volume_archive_iterator it = volume_archives_.begin();
+       it != volume_archives_.end(); ++it) {
+    if (static_cast<VolumeReaderJavaScriptStream*>((*it)->reader())->
+            request_id() == request_id) {
+      return *it;
+    }
+  }
+  return NULL;
 }
@@ -7,17 +7,69 @@
 
 #include <pthread.h>
 
+#include <list>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
 #include "archive.h"
-#include "ppapi/cpp/instance_handle.h"
 #include "ppapi/cpp/var_array_buffer.h"
 #include "ppapi/cpp/var_dictionary.h"
 #include "ppapi/utility/completion_callback_factory.h"
 #include "ppapi/utility/threading/lock.h"
-#include "ppapi/utility/threading/simple_thread.h"
 
 #include "javascript_requestor_interface.h"
 #include "javascript_message_sender_interface.h"
+#include "metadata_tree.h"
+#include "request.h"
+#include "small_file_cache.h"
 #include "volume_archive.h"
+#include "worker_pool.h"
+
+// A namespace with constants used by Volume.
+namespace volume_constants {
+
+// An estimate of the memory used by a single VolumeArchive: the skip,
+// decompress and entry head buffers of VolumeArchiveLibarchive and the two read
+// ahead buffers of VolumeReaderJavaScriptStream.
+const int64_t kVolumeArchiveMemoryUsage = 2 * 1024 * 1024;  // 2 MB.
+
+// The memory the VolumeArchive(s) of a volume may use together. Least recently
+// used archives are released when opening a file would exceed it. Should be at
+// least kVolumeArchiveMemoryUsage.
+const int64_t kMaximumVolumeArchivesMemoryUsage = 8 * 1024 * 1024;  // 8 MB.
+
+// When progress is requested for reading metadata, the entries read so far are
+// sent once there are kMetadataProgressEntries new entries or
+// kMetadataProgressIntervalMs passed since the previous message, whichever
+// comes first.
+const size_t kMetadataProgressEntries = 10000;
+const int kMetadataProgressIntervalMs = 250;
+
+// The format of the metadata cache records passed with
+// request::key::kMetadataCache. JavaScript stores the records by a fingerprint
+// of the archive and passes them back when the same archive is mounted again,
+// so its headers don't have to be read again. All the integers are little
+// endian. A record starts with a header of 2 uint32 values: the format version
+// and the flags, with kMetadataCacheRawFlag if the archive is read with the
+// raw format. The header is followed by the whole metadata in the format of
+// MetadataTree::ToVarArrayBuffer.
+const uint32_t kMetadataCacheVersion = 1;
+const uint32_t kMetadataCacheHeaderSize = 8;
+const uint32_t kMetadataCacheRawFlag = 1;
+
+// The maximum size of the chunks of data sent to JavaScript by Extract.
+const int64_t kExtractChunkSize = 512 * 1024;  // 512 KB.
+
+// The files of an archive up to kSmallFileCacheMaximumFileSize decompressed by
+// Extract or while reading the archive to reach a file are kept in a
+// SmallFileCache of kSmallFileCacheCapacity, so opening them again doesn't
+// need an archive. Should be at most kSmallFileCacheCapacity.
+const int64_t kSmallFileCacheMaximumFileSize = 64 * 1024;  // 64 KB.
+const int64_t kSmallFileCacheCapacity = 4 * 1024 * 1024;  // 4 MB.
+
+}  // namespace volume_constants
 
 // A factory that creates VolumeArchive(s). Useful for testing.
 class VolumeArchiveFactoryInterface {
@@ -43,14 +95,14 @@ class VolumeReaderFactoryInterface {
 // Volume.
 class Volume {
  public:
-  Volume(const pp::InstanceHandle& instance_handle /* Used for workers. */,
+  Volume(WorkerPool* worker_pool /* Used for jobs. */,
          const std::string& file_system_id,
          JavaScriptMessageSenderInterface* message_sender);
 
   // Used by tests to create custom VolumeArchive and VolumeReader objects.
   // VolumeArchiveFactory and VolumeReaderFactory should be allocated with new
   // and the ownership will be passed to Volume on constructing it.
-  Volume(const pp::InstanceHandle& instance_handle /* Used for workers. */,
+  Volume(WorkerPool* worker_pool /* Used for jobs. */,
          const std::string& file_system_id,
          JavaScriptMessageSenderInterface* message_sender,
          VolumeArchiveFactoryInterface* volume_archive_factory,
@@ -61,10 +113,22 @@ class Volume {
   // Initializes the volume.
   bool Init();
 
-  // Reads archive metadata using libarchive.
+  // Reads archive metadata using libarchive. The metadata is sent to
+  // JavaScript in metadata_format. If metadata_progress is true, the entries
+  // are also sent in batches with READ_METADATA_PROGRESS while the headers are
+  // read, which requires request::METADATA_FORMAT_BINARY.
+  //
+  // If metadata_cache is a valid cache record, see
+  // volume_constants::kMetadataCacheVersion, the metadata is restored from it
+  // instead of reading the headers. Otherwise, if create_metadata_cache is
+  // true, a new cache record is sent along with the metadata.
   void ReadMetadata(const std::string& request_id,
                     const std::string& encoding,
-                    int64_t archive_size);
+                    int64_t archive_size,
+                    request::MetadataFormat metadata_format,
+                    bool metadata_progress,
+                    const pp::Var& metadata_cache,
+                    bool create_metadata_cache);
 
   // Processes a successful archive chunk read from JavaScript. Read offset
   // represents the offset from where the data contained in array_buffer starts.
@@ -82,12 +146,52 @@ class Volume {
   // Processes an error when requesting a passphrase from JavaScript.
   void ReadPassphraseError(const std::string& nacl_request_id);
 
+  // Sends the metadata of the children of the directory at path to
+  // JavaScript. Once the metadata is read, it is answered right away instead
+  // of waiting for the jobs of the volume, e.g. reading a file.
+  void ReadDirectory(const std::string& request_id, const std::string& path);
+
+  // Sends the metadata of the entry at path to JavaScript. Answered like
+  // ReadDirectory.
+  void GetMetadata(const std::string& request_id, const std::string& path);
+
   // Opens a file.
   void OpenFile(const std::string& request_id,
                 int64_t index,
                 const std::string& encoding,
                 int64_t archive_size);
 
+  // Opens many files at once. files contains the index of every file with the
+  // id of its open request. The files are opened in the order of their
+  // indices, which is the order of the headers in the archive, so archives
+  // parked by the previous files can be used for the next files instead of
+  // reading streaming formats again from the beginning. Every file is
+  // answered like for OpenFile, with its own open request id.
+  void OpenFiles(const std::vector<std::pair<int64_t, std::string> >& files,
+                 const std::string& encoding,
+                 int64_t archive_size);
+
+  // Opens the file at path, which is absolute like for GetMetadata, and sends
+  // its index and size to JavaScript. Can be called before ReadMetadata, in
+  // which case the headers are read only until the entry is found, so opening
+  // a file near the beginning of a big archive doesn't need its whole
+  // metadata. The file is then read and closed like any file opened with
+  // OpenFile.
+  void OpenFileByPath(const std::string& request_id,
+                      const std::string& path,
+                      const std::string& encoding,
+                      int64_t archive_size);
+
+  // Extracts the entries with the given indices, or all of the entries if
+  // indices is empty, sending their data to JavaScript. Directories are
+  // skipped. A single new archive reads the entries in the order they are
+  // stored, so solid and streaming archives are decompressed only once
+  // instead of being read again from the beginning for many of the files.
+  void Extract(const std::string& request_id,
+               const std::set<int64_t>& indices,
+               const std::string& encoding,
+               int64_t archive_size);
+
   // Closes a file.
   void CloseFile(const std::string& request_id,
                  const std::string& open_request_id);
@@ -110,16 +214,99 @@ class Volume {
   // up to three arguments, while here we have four.
   struct OpenFileArgs;
 
+  // Encapsulates arguments to ReadMetadataCallback, for the same reason as
+  // OpenFileArgs.
+  struct ReadMetadataArgs;
+
+  // Encapsulates arguments to OpenFileByPathCallback, for the same reason as
+  // OpenFileArgs.
+  struct OpenFileByPathArgs;
+
+  // Encapsulates arguments to ExtractCallback, for the same reason as
+  // OpenFileArgs.
+  struct ExtractArgs;
+
+  // Encapsulates arguments to OpenFilesCallback, for the same reason as
+  // OpenFileArgs.
+  struct OpenFilesArgs;
+
   // A callback helper for ReadMetadata.
-  void ReadMetadataCallback(int32_t result,
-                            const std::string& request_id,
-                            const std::string& encoding,
-                            int64_t archive_size);
+  void ReadMetadataCallback(int32_t result, const ReadMetadataArgs& args);
+
+  // Reads the headers of volume_archive into a new tree, sending progress
+  // messages if requested by args. Returns NULL if the headers couldn't be
+  // read, in which case the error message is set in volume_archive.
+  MetadataTree* ReadMetadataTree(VolumeArchive* volume_archive,
+                                 const ReadMetadataArgs& args);
+
+  // A callback helper for ReadDirectory.
+  void ReadDirectoryCallback(int32_t result,
+                             const std::string& request_id,
+                             const std::string& path);
+
+  // A callback helper for GetMetadata.
+  void GetMetadataCallback(int32_t result,
+                           const std::string& request_id,
+                           const std::string& path);
+
+  // Returns the metadata of the archive, or NULL if it wasn't read yet.
+  const MetadataTree* GetMetadataTree();
+
+  // Returns true if a file is opened with open_request_id.
+  bool IsFileOpened(const std::string& open_request_id);
+
+  // Opens the file at index with open_request_id if its contents are in
+  // small_file_cache_. Returns false if they are not.
+  bool OpenCachedFile(const std::string& open_request_id, int64_t index);
+
+  // Sends the contents of a cached file from offset to offset + length in a
+  // single READ_FILE_DONE message.
+  void ReadCachedFile(const std::string& request_id,
+                      const pp::VarArrayBuffer& contents,
+                      int64_t offset,
+                      int64_t length);
+
+  // Reads the data of the entry at index, whose header is the last one read
+  // by volume_archive, into small_file_cache_ if it is small enough. Returns
+  // false in case of failure, in which case the error message is set in
+  // volume_archive.
+  bool CacheEntryData(VolumeArchive* volume_archive,
+                      int64_t index,
+                      int64_t size);
 
   // A calback helper for OpenFile.
   void OpenFileCallback(int32_t result,
                         const OpenFileArgs& args);
 
+  // A callback helper for OpenFiles.
+  void OpenFilesCallback(int32_t result, const OpenFilesArgs& args);
+
+  // A callback helper for OpenFileByPath.
+  void OpenFileByPathCallback(int32_t result, const OpenFileByPathArgs& args);
+
+  // Reads the headers with a new archive until the one of the entry at
+  // args.path. Returns the archive with the header of the entry as its last
+  // read header and sets *index, *size and *is_directory, or returns NULL and
+  // sets *error_message. The error message is "NOT_FOUND" if there is no such
+  // entry.
+  VolumeArchive* FindVolumeArchiveEntry(const OpenFileByPathArgs& args,
+                                        int64_t* index,
+                                        int64_t* size,
+                                        bool* is_directory,
+                                        std::string* error_message);
+
+  // A callback helper for Extract.
+  void ExtractCallback(int32_t result, const ExtractArgs& args);
+
+  // Sends the data of the entry at index, whose header is the last one read
+  // by volume_archive, in EXTRACT_DATA messages, and keeps it in
+  // small_file_cache_ if it is small enough. Returns false in case of
+  // failure, in which case the error message is set in volume_archive.
+  bool ExtractEntryData(VolumeArchive* volume_archive,
+                        const std::string& request_id,
+                        int64_t index,
+                        int64_t size);
+
   // A callback helper for CloseFile.
   void CloseFileCallback(int32_t result,
                          const std::string& request_id,
@@ -130,16 +317,76 @@ class Volume {
                         const std::string& request_id,
                         const pp::VarDictionary& dictionary);
 
-  // Creates a new archive object for this volume.
+  // Creates a new archive object for this volume and adds it to
+  // volume_archives_ as the most recently used one. Returns NULL if the archive
+  // couldn't be initialized and sets *error_message.
   VolumeArchive* CreateVolumeArchive(const std::string& request_id,
                                      const std::string& encoding,
-                                     int64_t archive_size);
-
-  // Clears job.
-  void ClearJob();
-
-  // Libarchive wrapper instance per volume, shared across all operations.
-  VolumeArchive* volume_archive_;
+                                     int64_t archive_size,
+                                     bool raw,
+                                     std::string* error_message);
+
+  // Same as CreateVolumeArchive, but with the format of the existing archives.
+  // If there are none, the format is detected like in ReadMetadataCallback
+  // and kept in raw_.
+  VolumeArchive* CreateVolumeArchiveDetectingFormat(
+      const std::string& request_id,
+      const std::string& encoding,
+      int64_t archive_size,
+      std::string* error_message);
+
+  // Removes volume_archive from volume_archives_ and releases it.
+  void DestroyVolumeArchive(VolumeArchive* volume_archive);
+
+  // Releases the least recently used idle archives until a new one fits in
+  // volume_constants::kMaximumVolumeArchivesMemoryUsage. Archives of opened
+  // files are kept even if they exceed the limit.
+  void ReleaseIdleVolumeArchives();
+
+  // Returns an archive whose last read header is the one of the index-th
+  // entry. Picks the archive parked nearest before the entry, so streaming
+  // formats don't have to be read again from the beginning, and creates a new
+  // one if there is no such archive. Small files read on the way are kept in
+  // small_file_cache_. Returns NULL in case of failure and sets
+  // *error_message.
+  VolumeArchive* AcquireVolumeArchive(const std::string& request_id,
+                                      int64_t index,
+                                      const std::string& encoding,
+                                      int64_t archive_size,
+                                      std::string* error_message);
+
+  // Returns true if volume_archive is used by an opened file.
+  bool IsVolumeArchiveInUse(VolumeArchive* volume_archive);
+
+  // Returns the archive whose reader makes requests with request_id, or NULL if
+  // there is none. Must be called with job_lock_ acquired.
+  VolumeArchive* FindVolumeArchive(const std::string& request_id);
+
+  // Libarchive wrapper instances of this volume, each one parked at the header
+  // it last read. Ordered from the most recently used to the least recently
+  // used one. Guarded by job_lock_ as chunks from JavaScript are dispatched to
+  // them from the main thread.
+  std::list<VolumeArchive*> volume_archives_;
+
+  // The archives of the opened files, keyed by the open request id. Each
+  // opened file has its own archive, so files can be read at the same time.
+  // Guarded by job_lock_.
+  std::map<std::string, VolumeArchive*> opened_files_;
+
+  // The contents of the opened files that were in small_file_cache_, keyed by
+  // the open request id. Kept here, as the files may be released from the
+  // cache while opened. Used only by the jobs.
+  std::map<std::string, pp::VarArrayBuffer> cached_opened_files_;
+
+  // The contents of small files decompressed before. Used only by the jobs.
+  SmallFileCache small_file_cache_;
+
+  // True if the archive could be read only with the raw format.
+  bool raw_;
+
+  // The metadata of the archive. Set by ReadMetadataCallback under job_lock_
+  // and never changed after, so it can be used without the lock once set.
+  MetadataTree* metadata_tree_;
 
   // The file system id for this volume.
   std::string file_system_id_;
@@ -147,33 +394,31 @@ class Volume {
   // An object that sends messages to JavaScript.
   JavaScriptMessageSenderInterface* message_sender_;
 
-  // A worker for jobs that require blocking operations or a lot of processing
-  // time. Those shouldn't be done on the main thread. The jobs submitted to
-  // this thread are executed in order, so a new job must wait for the last job
-  // to finish.
-  // TODO(cmihail): Consider using multiple workers in case of many jobs to
-  // improve execution speedup. In case multiple workers are added
-  // synchronization between workers might be needed.
-  pp::SimpleThread worker_;
+  // The pool that runs jobs that require blocking operations or a lot of
+  // processing time. Those shouldn't be done on the main thread.
+  WorkerPool* worker_pool_;
+
+  // The queue the jobs of this volume are submitted to. The jobs are executed
+  // in order, so a new job must wait for the last job to finish. This keeps
+  // the jobs of a volume from racing on its VolumeArchive(s), while jobs of
+  // different volumes run in parallel on the threads of worker_pool_.
+  WorkerPool::JobQueue job_queue_;
 
-  // Callback factory used to submit jobs to worker_.
+  // Callback factory used to submit jobs to job_queue_.
   // See "Detailed Description" Note at:
   // https://developer.chrome.com/native-client/
   //     pepper_dev/cpp/classpp_1_1_completion_callback_factory
   //
   // As a minus this would require ugly synchronization between the main thread
-  // and the function that is executed on worker_ construction. Current
+  // and the function that is executed on the worker construction. Current
   // implementation is simimlar to examples in $NACL_SDK_ROOT and according to
   // https://chromiumcodereview.appspot.com/lint_patch/issue10790078_24001_25013
-  // it should be safe (see TODO(dmichael)). That's because both worker_ and
-  // callback_factory_ will be alive during the life of Volume and deleting a
+  // it should be safe (see TODO(dmichael)). That's because both job_queue_
+  // and callback_factory_ will be alive during the life of Volume and deleting a
   // Volume is permitted only if there are no requests in progress on
   // JavaScript side (this means no Callbacks in progress).
   pp::CompletionCallbackFactory<Volume> callback_factory_;
 
-  // Request ID of the current reader instance.
-  std::string reader_request_id_;
-
   pp::Lock job_lock_;  // A lock for guarding members related to jobs.
 
   // A requestor for making calls to JavaScript.
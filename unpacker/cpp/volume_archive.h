@@ -73,6 +73,13 @@ class VolumeArchive {
   // buffer.
   virtual void MaybeDecompressAhead() = 0;
 
+  // Returns true if the data of the file reached with
+  // VolumeArchive::GetNextHeader can be read again from offset 0 without
+  // reading the archive again, as all of the data read so far is kept. Used to
+  // reopen a file right after it was closed, e.g. when Files app reads the
+  // beginning of a file to detect its type and then opens it again.
+  virtual bool CanReadDataAgain() const = 0;
+
   // Cleans all resources. Should be called only once. Returns true if
   // successful. In case of failure the error message can be obtained with
   // VolumeArchive::error_message().
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <cstring>
 #include <limits>
 
 #include "archive_entry.h"
@@ -87,7 +88,8 @@ VolumeArchiveLibarchive::VolumeArchiveLibarchive(VolumeReader* reader)
       last_read_data_length_(0),
       decompressed_data_(NULL),
       decompressed_data_size_(0),
-      decompressed_error_(false) {
+      decompressed_error_(false),
+      entry_head_size_(0) {
 }
 
 VolumeArchiveLibarchive::~VolumeArchiveLibarchive() {
@@ -161,6 +163,7 @@ VolumeArchive::Result VolumeArchiveLibarchive::GetNextHeader() {
   // Reset to 0 for new VolumeArchive::ReadData operation.
   last_read_data_offset_ = 0;
   decompressed_data_size_ = 0;
+  entry_head_size_ = 0;
 
   ++curr_index;
 
@@ -202,6 +205,8 @@ VolumeArchive::Result VolumeArchiveLibarchive::GetNextHeader(
       int64_t offset;
       while (archive_read_data_block(archive_, &buf, &block_size, &offset) != ARCHIVE_EOF)
         *size += block_size;
+      // The data was consumed, so it can't be read anymore.
+      last_read_data_offset_ = *size;
     }
 
     *modification_time = archive_entry_mtime(current_archive_entry_);
@@ -215,6 +220,7 @@ bool VolumeArchiveLibarchive::SeekHeader(int64_t index) {
   // Reset to 0 for new VolumeArchive::ReadData operation.
   last_read_data_offset_ = 0;
   decompressed_data_size_ = 0;
+  entry_head_size_ = 0;
 
   if (archive_read_seek_header(archive_, index) != ARCHIVE_OK) {
     set_error_message(ArchiveError(
@@ -242,6 +248,17 @@ void VolumeArchiveLibarchive::DecompressData(int64_t offset, int64_t length) {
     return;
   }
 
+  // The bytes decompressed ahead were already read from the archive, so skip
+  // them first. If the requested offset is among them, there is nothing to
+  // decompress.
+  int64_t skipped_bytes =
+      std::min(decompressed_data_size_, offset - last_read_data_offset_);
+  decompressed_data_ += skipped_bytes;
+  decompressed_data_size_ -= skipped_bytes;
+  last_read_data_offset_ += skipped_bytes;
+  if (decompressed_data_size_ > 0)
+    return;
+
   // Request with offset greater than last read offset. Skip not needed bytes.
   // Because files are compressed, seeking is not possible, so all of the bytes
   // until the requested position must be unpacked.
@@ -346,6 +363,13 @@ int64_t VolumeArchiveLibarchive::ReadData(int64_t offset,
       archive_entry_size(current_archive_entry_) <= offset)
     return 0;
 
+  // The data at the beginning of the file was already read, e.g. because the
+  // file was closed and opened again.
+  if (offset < entry_head_size_) {
+    *buffer = entry_head_buffer_ + offset;
+    return std::min(length, entry_head_size_ - offset);
+  }
+
   // In case of first read or no more available data in the internal buffer or
   // offset is different from the last_read_data_offset_, then force
   // VolumeArchiveLibarchive::DecompressData as the decompressed data is
@@ -365,6 +389,18 @@ int64_t VolumeArchiveLibarchive::ReadData(int64_t offset,
 
   // Advance internal buffer for next ReadData call.
   int64_t read_bytes = std::min(decompressed_data_size_, length);
+
+  // Keep the data at the beginning of the file, so it can be read again.
+  if (last_read_data_offset_ == entry_head_size_ &&
+      entry_head_size_ < volume_archive_constants::kEntryHeadBufferSize) {
+    int64_t head_bytes = std::min(
+        read_bytes,
+        volume_archive_constants::kEntryHeadBufferSize - entry_head_size_);
+    memcpy(entry_head_buffer_ + entry_head_size_, decompressed_data_,
+           head_bytes);
+    entry_head_size_ += head_bytes;
+  }
+
   decompressed_data_ = decompressed_data_ + read_bytes;
   decompressed_data_size_ -= read_bytes;
   last_read_data_offset_ += read_bytes;
@@ -376,6 +412,10 @@ int64_t VolumeArchiveLibarchive::ReadData(int64_t offset,
   return read_bytes;
 }
 
+bool VolumeArchiveLibarchive::CanReadDataAgain() const {
+  return current_archive_entry_ && last_read_data_offset_ == entry_head_size_;
+}
+
 void VolumeArchiveLibarchive::MaybeDecompressAhead() {
   if (decompressed_data_size_ == 0)
     DecompressData(last_read_data_offset_, last_read_data_length_);
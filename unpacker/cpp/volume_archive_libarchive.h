@@ -40,6 +40,10 @@ const int64_t kMaximumDataChunkSize = 512 * 1024;  // 512 KB.
 // Should be positive.
 const int64_t kMinimumDataChunkSize = 32 * 1024;  // 16 KB.
 
+// The size of the buffer that keeps the data at the beginning of the current
+// file, so it can be read again. Should be positive.
+const int64_t kEntryHeadBufferSize = 64 * 1024;  // 64 KB.
+
 }  // namespace volume_archive_constants
 
 // Defines an implementation of VolumeArchive that wraps all libarchive
@@ -71,6 +75,9 @@ class VolumeArchiveLibarchive : public VolumeArchive {
   // See volume_archive_interface.h.
   virtual void MaybeDecompressAhead();
 
+  // See volume_archive_interface.h.
+  virtual bool CanReadDataAgain() const;
+
   // See volume_archive_interface.h.
   virtual bool Cleanup();
 
@@ -132,6 +139,16 @@ class VolumeArchiveLibarchive : public VolumeArchive {
 
   // True if VolumeArchiveLibarchive::DecompressData failed.
   bool decompressed_error_;
+
+  // The first bytes of the current file returned by
+  // VolumeArchiveLibarchive::ReadData, so they can be returned again without
+  // decompressing the file again from its beginning, which is not possible
+  // without reading the archive again. Only data contiguous from offset 0 is
+  // kept.
+  char entry_head_buffer_[volume_archive_constants::kEntryHeadBufferSize];
+
+  // The size of valid data in entry_head_buffer_.
+  int64_t entry_head_size_;
 };
 
 #endif  // VOLUME_ARCHIVE_LIBARCHIVE_H_
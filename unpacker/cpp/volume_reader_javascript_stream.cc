@@ -10,6 +10,8 @@
 #include "archive.h"
 #include "ppapi/cpp/logging.h"
 
+#include "worker_pool.h"
+
 VolumeReaderJavaScriptStream::VolumeReaderJavaScriptStream(
     int64_t archive_size,
     JavaScriptRequestorInterface* requestor)
@@ -131,7 +133,8 @@ int64_t VolumeReaderJavaScriptStream::Read(int64_t bytes_to_read,
         pthread_mutex_unlock(&shared_state_lock_);
         return ARCHIVE_FATAL;
       }
-      pthread_cond_wait(&available_data_cond_, &shared_state_lock_);
+      // Let the pool run jobs of other volumes while JavaScript responds.
+      WorkerPool::WaitForSignal(&available_data_cond_, &shared_state_lock_);
     }
   }
 
@@ -232,8 +235,15 @@ int64_t VolumeReaderJavaScriptStream::Skip(int64_t bytes_to_skip) {
 }
 
 void VolumeReaderJavaScriptStream::SetRequestId(const std::string& request_id) {
-  // No lock necessary, as request_id is used by one thread only.
+  // The owner of the reader synchronizes access to the request id, but the
+  // read ahead state is shared with SetBufferAndSignal.
+  pthread_mutex_lock(&shared_state_lock_);
+  // A chunk still requested with the previous request id won't be delivered
+  // anymore, so request it again on the next Read.
+  if (request_id != request_id_ && !available_data_)
+    last_read_chunk_offset_ = -1;
   request_id_ = request_id;
+  pthread_mutex_unlock(&shared_state_lock_);
 }
 
 const char* VolumeReaderJavaScriptStream::Passphrase() {
@@ -251,8 +261,9 @@ const char* VolumeReaderJavaScriptStream::Passphrase() {
   requestor_->RequestPassphrase(request_id_);
 
   pthread_mutex_lock(&shared_state_lock_);
-  // Wait for the passphrase from JavaScript.
-  pthread_cond_wait(&available_passphrase_cond_, &shared_state_lock_);
+  // Wait for the passphrase from JavaScript. The user may take long to answer,
+  // so let the pool run jobs of other volumes meanwhile.
+  WorkerPool::WaitForSignal(&available_passphrase_cond_, &shared_state_lock_);
   const char* result = NULL;
   if (!passphrase_error_)
     result = strdup(available_passphrase_.c_str());
@@ -54,9 +54,10 @@ class VolumeReaderJavaScriptStream : public VolumeReader {
   // in order to synchronize with VolumeReaderJavaScriptStream::Passphrase.
   void PassphraseErrorSignal();
 
-  // See volume_reader.h for description. This method blocks on
-  // available_data_cond_. SetBufferAndSignal should unblock it from another
-  // thread.
+  // See volume_reader.h for description. This method waits on
+  // available_data_cond_ with WorkerPool::WaitForSignal, so when called from a
+  // WorkerPool job other threads of the pool run other jobs meanwhile.
+  // SetBufferAndSignal should unblock it from another thread.
   virtual int64_t Read(int64_t bytes_to_read, const void** destination_buffer);
 
   // See volume_reader.h for description.
@@ -65,12 +66,17 @@ class VolumeReaderJavaScriptStream : public VolumeReader {
   // See volume_reader.h for description.
   virtual int64_t Seek(int64_t offset, int whence);
 
-  // Sets the request Id to be used by the reader.
+  // Sets the request Id to be used by the reader. A chunk requested with the
+  // previous request Id and not received yet is requested again by the next
+  // Read.
   void SetRequestId(const std::string& request_id);
 
-  // See volume_reader.h for description. The method blocks on
-  // available_passphrase_cond_. SetPassphraseAndSignal should unblock it from
-  // another thread.
+  // The request Id used by the reader.
+  const std::string& request_id() const { return request_id_; }
+
+  // See volume_reader.h for description. The method waits on
+  // available_passphrase_cond_ with WorkerPool::WaitForSignal.
+  // SetPassphraseAndSignal should unblock it from another thread.
   virtual const char* Passphrase();
 
   int64_t offset() const { return offset_; }
@@ -0,0 +1,235 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "worker_pool.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "ppapi/cpp/logging.h"
+
+namespace {
+
+// The key for WorkerPool::ThreadState of the current thread.
+pthread_key_t thread_state_key;
+pthread_once_t thread_state_key_once = PTHREAD_ONCE_INIT;
+
+}  // namespace
+
+WorkerPool::JobQueue::JobQueue(WorkerPool* worker_pool)
+    : worker_pool_(worker_pool), scheduled_(false) {
+  PP_DCHECK(worker_pool_);
+}
+
+WorkerPool::JobQueue::~JobQueue() {
+  Join();
+}
+
+void WorkerPool::JobQueue::PostWork(const pp::CompletionCallback& callback) {
+  pthread_mutex_lock(&worker_pool_->lock_);
+  jobs_.push_back(callback);
+  if (!scheduled_)
+    worker_pool_->ScheduleQueue(this);
+  pthread_mutex_unlock(&worker_pool_->lock_);
+}
+
+void WorkerPool::JobQueue::Join() {
+  pthread_mutex_lock(&worker_pool_->lock_);
+  while (scheduled_)
+    pthread_cond_wait(&worker_pool_->queue_idle_cond_, &worker_pool_->lock_);
+  pthread_mutex_unlock(&worker_pool_->lock_);
+}
+
+WorkerPool::WorkerPool(const pp::InstanceHandle& instance_handle,
+                       int max_threads)
+    : instance_handle_(instance_handle),
+      max_threads_(std::max(max_threads, 1)),
+      exited_thread_(NULL),
+      idle_threads_(0),
+      waiting_threads_(0),
+      quit_(false) {
+  pthread_mutex_init(&lock_, NULL);
+  pthread_cond_init(&work_available_cond_, NULL);
+  pthread_cond_init(&queue_idle_cond_, NULL);
+}
+
+WorkerPool::~WorkerPool() {
+  pthread_mutex_lock(&lock_);
+  quit_ = true;
+  pthread_cond_broadcast(&work_available_cond_);
+  pp::SimpleThread* exited_thread = exited_thread_;
+  exited_thread_ = NULL;
+  pthread_mutex_unlock(&lock_);
+
+  // The thread that exited last joins the one before it.
+  if (exited_thread) {
+    exited_thread->Join();
+    delete exited_thread;
+  }
+
+  // No thread is started or exits early after quit_ is set, so threads_ can
+  // be accessed without the lock.
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    threads_[i]->Join();
+    delete threads_[i];
+  }
+
+  pthread_mutex_destroy(&lock_);
+  pthread_cond_destroy(&work_available_cond_);
+  pthread_cond_destroy(&queue_idle_cond_);
+}
+
+bool WorkerPool::Start() {
+  pthread_mutex_lock(&lock_);
+  bool result = !threads_.empty() || StartThread();
+  pthread_mutex_unlock(&lock_);
+  return result;
+}
+
+int WorkerPool::DefaultMaximumThreads() {
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  if (processors < worker_pool_constants::kMinimumThreads)
+    return worker_pool_constants::kMinimumThreads;
+  if (processors > worker_pool_constants::kMaximumThreads)
+    return worker_pool_constants::kMaximumThreads;
+  return static_cast<int>(processors);
+}
+
+// static
+void WorkerPool::WaitForSignal(pthread_cond_t* cond, pthread_mutex_t* mutex) {
+  pthread_once(&thread_state_key_once, &WorkerPool::CreateThreadStateKey);
+  ThreadState* state =
+      static_cast<ThreadState*>(pthread_getspecific(thread_state_key));
+  if (!state) {
+    pthread_cond_wait(cond, mutex);
+    return;
+  }
+
+  // The waiting job may wait for jobs which are ready, so they must be run on
+  // another thread.
+  WorkerPool* worker_pool = state->worker_pool;
+  pthread_mutex_lock(&worker_pool->lock_);
+  ++worker_pool->waiting_threads_;
+  worker_pool->MaybeStartThread();
+  pthread_mutex_unlock(&worker_pool->lock_);
+
+  pthread_cond_wait(cond, mutex);
+
+  // The idle threads started for the waiting job are not needed anymore.
+  pthread_mutex_lock(&worker_pool->lock_);
+  --worker_pool->waiting_threads_;
+  if (worker_pool->HasExtraThreads())
+    pthread_cond_broadcast(&worker_pool->work_available_cond_);
+  pthread_mutex_unlock(&worker_pool->lock_);
+}
+
+// static
+void WorkerPool::CreateThreadStateKey() {
+  pthread_key_create(&thread_state_key, NULL);
+}
+
+void WorkerPool::ScheduleQueue(JobQueue* queue) {
+  queue->scheduled_ = true;
+  ready_queues_.push_back(queue);
+  MaybeStartThread();
+  pthread_cond_signal(&work_available_cond_);
+}
+
+bool WorkerPool::StartThread() {
+  pp::SimpleThread* thread = new pp::SimpleThread(instance_handle_);
+  ThreadState* state = new ThreadState(this, thread);
+  if (!thread->StartWithFunction(&WorkerPool::WorkerThreadFunction, state)) {
+    delete state;
+    delete thread;
+    return false;
+  }
+  threads_.push_back(thread);
+  return true;
+}
+
+void WorkerPool::MaybeStartThread() {
+  // Idle threads that were already signaled but didn't wake up yet are still
+  // counted in idle_threads_, so compare against all the ready queues.
+  if (ready_queues_.size() > idle_threads_ &&
+      threads_.size() - waiting_threads_ < max_threads_ && !quit_) {
+    // If the thread couldn't be started the queues will be run by one of the
+    // existing threads.
+    StartThread();
+  }
+}
+
+bool WorkerPool::HasExtraThreads() const {
+  return threads_.size() - waiting_threads_ > max_threads_ && !quit_;
+}
+
+// static
+void WorkerPool::WorkerThreadFunction(pp::MessageLoop& /* message_loop */,
+                                      void* thread_state) {
+  ThreadState* state = static_cast<ThreadState*>(thread_state);
+  state->worker_pool->RunJobs(state);
+  delete state;
+}
+
+void WorkerPool::RunJobs(ThreadState* state) {
+  pthread_once(&thread_state_key_once, &WorkerPool::CreateThreadStateKey);
+  pthread_setspecific(thread_state_key, state);
+
+  pp::SimpleThread* exited_thread = NULL;
+  pthread_mutex_lock(&lock_);
+  for (;;) {
+    while (ready_queues_.empty() && !quit_ && !HasExtraThreads()) {
+      ++idle_threads_;
+      pthread_cond_wait(&work_available_cond_, &lock_);
+      --idle_threads_;
+    }
+
+    // A thread started while jobs were waiting exits once they stopped
+    // waiting. The thread can't join itself, so it's joined by the next
+    // thread that exits or by the destructor.
+    if (HasExtraThreads()) {
+      threads_.erase(
+          std::find(threads_.begin(), threads_.end(), state->thread));
+      exited_thread = exited_thread_;
+      exited_thread_ = state->thread;
+      // The ready queues may have been left to this thread.
+      if (!ready_queues_.empty())
+        pthread_cond_signal(&work_available_cond_);
+      break;
+    }
+
+    // Jobs submitted before destroying the pool are still run.
+    if (ready_queues_.empty())
+      break;
+    RunReadyJob();
+  }
+  pthread_mutex_unlock(&lock_);
+
+  // The previous thread that exited doesn't use lock_ anymore.
+  if (exited_thread) {
+    exited_thread->Join();
+    delete exited_thread;
+  }
+  pthread_setspecific(thread_state_key, NULL);
+}
+
+void WorkerPool::RunReadyJob() {
+  JobQueue* queue = ready_queues_.front();
+  ready_queues_.pop_front();
+  pp::CompletionCallback job = queue->jobs_.front();
+  queue->jobs_.pop_front();
+
+  pthread_mutex_unlock(&lock_);
+  job.Run(PP_OK);
+  pthread_mutex_lock(&lock_);
+
+  // The queue mustn't be accessed after it is marked as idle, as its owner
+  // may destroy it right away.
+  if (queue->jobs_.empty()) {
+    queue->scheduled_ = false;
+    pthread_cond_broadcast(&queue_idle_cond_);
+  } else {
+    ready_queues_.push_back(queue);
+  }
+}
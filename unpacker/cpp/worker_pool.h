@@ -0,0 +1,186 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include <pthread.h>
+
+#include <deque>
+#include <vector>
+
+#include "ppapi/cpp/completion_callback.h"
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/utility/threading/simple_thread.h"
+
+// A namespace with constants used by WorkerPool.
+namespace worker_pool_constants {
+
+// The bounds for the number of threads of a WorkerPool when the number of
+// processors is used to size it.
+const int kMinimumThreads = 2;
+const int kMaximumThreads = 8;
+
+}  // namespace worker_pool_constants
+
+// A bounded pool of threads shared by all the volumes and compressors of the
+// module. Jobs are submitted through a WorkerPool::JobQueue. Jobs of the same
+// JobQueue are executed in order and never in parallel, while jobs of
+// different JobQueue(s) are picked up by whichever thread is idle. Threads are
+// started lazily, so a pool without work doesn't cost any thread beside the
+// first one.
+//
+// Jobs waiting for JavaScript or for other jobs should wait with
+// WorkerPool::WaitForSignal. A waiting job keeps its thread blocked, as jobs
+// wait inside synchronous code such as libarchive callbacks and can't be
+// suspended without their thread. Jobs are never run nested inside a waiting
+// job either, as that job couldn't continue until the nested one returned,
+// even if the nested one waited for it. So a waiting thread doesn't count
+// against the maximum number of threads, and another thread is started to
+// run the jobs of the other queues in the meantime. The number of threads
+// grows with the number of waiting jobs, e.g. volumes waiting for
+// JavaScript, but the extra threads exit once the jobs stop waiting, so the
+// pool shrinks back to the maximum number of threads.
+//
+// The pool must outlive all of its JobQueue(s). All the methods must be called
+// from the main thread, except for JobQueue::PostWork which can be called from
+// any thread.
+class WorkerPool {
+ public:
+  // A serial queue of jobs executed on the threads of a WorkerPool.
+  class JobQueue {
+   public:
+    explicit JobQueue(WorkerPool* worker_pool);
+
+    // Waits for the submitted jobs to finish.
+    ~JobQueue();
+
+    // Submits a job. The callback will be run with PP_OK on one of the threads
+    // of the pool after all the jobs submitted before it to this JobQueue
+    // finished.
+    void PostWork(const pp::CompletionCallback& callback);
+
+    // Blocks until all the submitted jobs finished. Must not be called from
+    // one of this JobQueue's jobs.
+    void Join();
+
+   private:
+    friend class WorkerPool;
+
+    WorkerPool* worker_pool_;
+
+    // The jobs waiting to be run. Guarded by WorkerPool::lock_.
+    std::deque<pp::CompletionCallback> jobs_;
+
+    // True if the queue is waiting in WorkerPool::ready_queues_ or one of its
+    // jobs is running. Guarded by WorkerPool::lock_.
+    bool scheduled_;
+  };
+
+  // max_threads is the maximum number of threads running jobs at the same
+  // time. Should be positive. Threads waiting in WaitForSignal are not
+  // counted, so there can be one more thread for every waiting job until the
+  // jobs stop waiting.
+  WorkerPool(const pp::InstanceHandle& instance_handle, int max_threads);
+
+  // Waits for all the submitted jobs to finish and stops the threads.
+  virtual ~WorkerPool();
+
+  // Starts the first thread of the pool if not already started. Returns true
+  // if the pool has at least one thread to run jobs on.
+  bool Start();
+
+  // Returns the number of threads suitable for the current machine.
+  static int DefaultMaximumThreads();
+
+  // Waits for cond to be signaled, with the same contract as
+  // pthread_cond_wait: mutex must be locked, it is locked on return and the
+  // caller must check its condition again as the call can return before cond
+  // is signaled.
+  //
+  // If called from a job of a WorkerPool, the thread still blocks but is not
+  // counted as running a job while it waits, so another thread is started if
+  // needed to run the ready jobs of the other queues. The caller must not
+  // hold other locks those jobs may need.
+  static void WaitForSignal(pthread_cond_t* cond, pthread_mutex_t* mutex);
+
+ private:
+  // The state of a thread of a pool, stored in thread specific data.
+  struct ThreadState {
+    ThreadState(WorkerPool* worker_pool, pp::SimpleThread* thread)
+        : worker_pool(worker_pool), thread(thread) {}
+    WorkerPool* const worker_pool;
+    pp::SimpleThread* const thread;
+  };
+
+  // Creates the key used for ThreadState.
+  static void CreateThreadStateKey();
+
+  // Schedules queue to be run. Must be called with lock_ acquired.
+  void ScheduleQueue(JobQueue* queue);
+
+  // Starts a new thread. Must be called with lock_ acquired.
+  bool StartThread();
+
+  // Starts a new thread if there are more ready queues than idle threads and
+  // fewer than max_threads_ threads that are not waiting. Must be called with
+  // lock_ acquired.
+  void MaybeStartThread();
+
+  // Returns true if more than max_threads_ threads are not waiting, once jobs
+  // stopped waiting, so that a thread should exit. Must be called with lock_
+  // acquired.
+  bool HasExtraThreads() const;
+
+  // The function run by the threads of the pool, with their ThreadState.
+  static void WorkerThreadFunction(pp::MessageLoop& message_loop,
+                                   void* thread_state);
+
+  // Runs jobs until the pool is destroyed or the thread is not needed
+  // anymore.
+  void RunJobs(ThreadState* state);
+
+  // Runs the first job of the queue at the front of ready_queues_. Must be
+  // called with lock_ acquired and ready_queues_ not empty. lock_ is released
+  // while the job runs.
+  void RunReadyJob();
+
+  // Used to create the pp::SimpleThread(s).
+  pp::InstanceHandle instance_handle_;
+
+  // The maximum number of threads.
+  const size_t max_threads_;
+
+  // A lock guarding the queues and the threads of the pool.
+  pthread_mutex_t lock_;
+
+  // Signaled when there are queues in ready_queues_ or the pool is destroyed.
+  pthread_cond_t work_available_cond_;
+
+  // Broadcasted when a queue runs out of jobs.
+  pthread_cond_t queue_idle_cond_;
+
+  // Queues with jobs that are not running. A thread runs one job of the queue
+  // at the front and appends it back if it has more, so busy queues share the
+  // threads fairly.
+  std::deque<JobQueue*> ready_queues_;
+
+  // The started threads, except for the ones that exited.
+  std::vector<pp::SimpleThread*> threads_;
+
+  // The last thread that exited because it was not needed anymore, joined by
+  // the next one or by the destructor.
+  pp::SimpleThread* exited_thread_;
+
+  // The number of threads waiting for work.
+  size_t idle_threads_;
+
+  // The number of threads whose job waits in WaitForSignal.
+  size_t waiting_threads_;
+
+  // True if the pool is destroyed and the threads should exit.
+  bool quit_;
+};
+
+#endif  // WORKER_POOL_H_
@@ -15,6 +15,13 @@ unpacker.app = {
    */
   STORAGE_KEY: 'state',
 
+  /**
+   * The number of files the Files app may keep opened at the same time in a
+   * single volume. Each of them is read by its own archive in NaCl.
+   * @const {number}
+   */
+  OPENED_FILES_LIMIT: 8,
+
   /**
    * The default id for the NaCl module.
    * @const {string}
@@ -53,6 +60,13 @@ unpacker.app = {
    */
   compressors: {},
 
+  /**
+   * The cache of the metadata of the archives mounted before, shared by all
+   * the volumes. Created on first use.
+   * @type {?unpacker.MetadataCache}
+   */
+  metadataCache: null,
+
   /**
    * A map with promises of loading a volume's metadata from NaCl.
    * Any call from fileSystemProvider API should work only on valid metadata.
@@ -236,6 +250,8 @@ unpacker.app = {
    *     openedFiles Previously opened files before a suspend.
    * @param {string} passphrase Previously used passphrase before a suspend.
    * @return {!Promise} Promise fulfilled on success and rejected on failure.
+   *     Fulfilled once the volume can be used, which may be before all of its
+   *     metadata is read.
    * @private
    */
   loadVolume_: function(fileSystemId, entry, openedFiles, passphrase) {
@@ -249,7 +265,10 @@ unpacker.app = {
         var decompressor = new unpacker.Decompressor(
             /** @type {!Object} */ (unpacker.app.naclModule),
             fileSystemId, file, passphraseManager);
-        var volume = new unpacker.Volume(decompressor, entry);
+        if (!unpacker.app.metadataCache)
+          unpacker.app.metadataCache = new unpacker.MetadataCache();
+        var volume = new unpacker.Volume(decompressor, entry,
+                                         unpacker.app.metadataCache);
 
         var onLoadVolumeSuccess = function() {
           if (Object.keys(openedFiles).length == 0) {
@@ -274,8 +293,17 @@ unpacker.app = {
           Promise.all(openFilePromises).then(fulfill, reject);
         };
 
+        // Without opened files to restore, the volume can be used as soon as
+        // the first entries are read, so the root directory of a big archive
+        // is shown early. Further entries are sent to Files app as they are
+        // read.
+        var onLoadVolumeProgress = function() {
+          if (Object.keys(openedFiles).length == 0)
+            fulfill();
+        };
+
         unpacker.app.volumes[fileSystemId] = volume;
-        volume.initialize(onLoadVolumeSuccess, reject);
+        volume.initialize(onLoadVolumeSuccess, reject, onLoadVolumeProgress);
       }, function(error) {
         reject('FAILED');
       });
@@ -304,7 +332,11 @@ unpacker.app = {
                 reject('FAILED');
                 return;
               }
-              if (!fileSystem || fileSystem.openedFilesLimit != 1) {
+              // Volumes mounted by older versions allow fewer opened files,
+              // which is still fine.
+              if (!fileSystem || fileSystem.openedFilesLimit < 1 ||
+                  fileSystem.openedFilesLimit >
+                      unpacker.app.OPENED_FILES_LIMIT) {
                 console.error('No compatible mounted file system found.');
                 reject('FAILED');
                 return;
@@ -784,7 +816,7 @@ unpacker.app = {
                 const mountOptions = {
                   fileSystemId: fileSystemId,
                   displayName: entry.name,
-                  openedFilesLimit: 1
+                  openedFilesLimit: unpacker.app.OPENED_FILES_LIMIT
                 };
                 if (unpacker.app.getChromeMajorVersion_() >= 64)
                   mountOptions.persistent = false;
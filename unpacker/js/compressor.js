@@ -13,8 +13,11 @@
  * @constructor
  * @param {!Object} naclModule The nacl module.
  * @param {!Array} items The items to be packed.
+ * @param {!unpacker.types.PackOptions=} opt_packOptions The format and the
+ *     compression of the archive, e.g. TAR with ZSTD or LZ4 for speed. A ZIP
+ *     archive deflated with the default level if not set.
  */
-unpacker.Compressor = function(naclModule, items) {
+unpacker.Compressor = function(naclModule, items, opt_packOptions) {
   /**
    * @private {!Object}
    * @const
@@ -33,6 +36,26 @@ unpacker.Compressor = function(naclModule, items) {
    */
   this.compressorId_ = unpacker.Compressor.compressorIdCounter++;
 
+  /**
+   * @private {!unpacker.types.PackOptions}
+   * @const
+   */
+  this.packOptions_ = opt_packOptions || {};
+
+  /**
+   * @private {!unpacker.request.PackFormat}
+   * @const
+   */
+  this.packFormat_ = this.packOptions_.format !== undefined ?
+      this.packOptions_.format : unpacker.request.PackFormat.ZIP;
+
+  /**
+   * @private {!unpacker.request.PackFilter}
+   * @const
+   */
+  this.packFilter_ = this.packOptions_.filter !== undefined ?
+      this.packOptions_.filter : unpacker.request.PackFilter.DEFAULT;
+
   /**
    * @private {string}
    * @const
@@ -61,12 +84,28 @@ unpacker.Compressor = function(naclModule, items) {
   this.pendingAddToArchiveRequests_ = [];
 
   /**
-   * The id of the entry that is being compressed and written into archive.
-   * Note that packing of each entry should be done one by one unlike
-   * unpacking. Thus, at most one entry is processed at once.
+   * The ids of the entries sent to NaCl and not added to the archive yet, in
+   * order, or of the last entries of the batches. NaCl adds the entries one
+   * by one, but the next ones are sent while an entry is compressed, so that
+   * NaCl doesn't wait for them. At most MAX_PENDING_ADD_TO_ARCHIVE_REQUESTS
+   * requests are in progress.
+   * @type {!Array<!unpacker.types.EntryId>}
+   */
+  this.addToArchiveRequestsInProgress_ = [];
+
+  /**
+   * True while the files of a batch are read. The next requests wait for the
+   * batch to be sent, as NaCl adds the entries in the order they are sent.
+   * @type {boolean}
+   */
+  this.preparingBatch_ = false;
+
+  /**
+   * The id of the entry read by the read file chunk requests, whose file is
+   * file_.
    * @type {!unpacker.types.EntryId}
    */
-  this.entryIdInProgress_ = 0;
+  this.readEntryId_ = 0;
 
   /**
    * Map from entry ids to entries.
@@ -81,10 +120,26 @@ unpacker.Compressor = function(naclModule, items) {
   this.metadata_ = {};
 
   /**
-   * The offset from which the entry in progress should be read.
+   * The offset from which readEntryId_ should be read.
    * @type {number}
    */
   this.offset_ = 0;
+
+  /**
+   * The read file chunk requests not responded yet, in order. NaCl requests
+   * the next chunks of an entry while it compresses the current one, but they
+   * are read one by one, so they are responded in order.
+   * @type {!Array<{entryId: !unpacker.types.EntryId, length: number}>}
+   */
+  this.pendingReadFileChunks_ = [];
+
+  /**
+   * The write chunk requests not responded yet, in order. NaCl sends the next
+   * chunks while the previous ones are written, but they are written one by
+   * one, so they are appended to the archive in order.
+   * @type {!Array<{length: number, buffer: !ArrayBuffer}>}
+   */
+  this.pendingWriteChunks_ = [];
 };
 
 /**
@@ -103,10 +158,55 @@ unpacker.Compressor.compressorIdCounter = 1;
 unpacker.Compressor.CompressorIdQueue = [];
 
 /**
- * The default archive name.
+ * The default archive name, without the extension.
  * @type {string}
  */
-unpacker.Compressor.DEFAULT_ARCHIVE_NAME = 'Archive.zip';
+unpacker.Compressor.DEFAULT_ARCHIVE_NAME = 'Archive';
+
+/**
+ * The extensions of TAR archives by filter.
+ * @const {!Object<!unpacker.request.PackFilter, string>}
+ */
+unpacker.Compressor.TAR_EXTENSIONS = {};
+unpacker.Compressor.TAR_EXTENSIONS[unpacker.request.PackFilter.DEFAULT] =
+    '.tar';
+unpacker.Compressor.TAR_EXTENSIONS[unpacker.request.PackFilter.NONE] =
+    '.tar';
+unpacker.Compressor.TAR_EXTENSIONS[unpacker.request.PackFilter.DEFLATE] =
+    '.tar.gz';
+unpacker.Compressor.TAR_EXTENSIONS[unpacker.request.PackFilter.ZSTD] =
+    '.tar.zst';
+unpacker.Compressor.TAR_EXTENSIONS[unpacker.request.PackFilter.XZ] =
+    '.tar.xz';
+unpacker.Compressor.TAR_EXTENSIONS[unpacker.request.PackFilter.LZ4] =
+    '.tar.lz4';
+
+/**
+ * The maximum number of add to archive requests sent to NaCl and not done.
+ * @const {number}
+ */
+unpacker.Compressor.MAX_PENDING_ADD_TO_ARCHIVE_REQUESTS = 4;
+
+/**
+ * Files up to this size are read before they are added to the archive and sent
+ * along with their entry, in a batch with the next directories and small
+ * files. NaCl doesn't request their data with READ_FILE_CHUNK then, which
+ * saves round trips for archives of many small files.
+ * @const {number}
+ */
+unpacker.Compressor.INLINE_FILE_SIZE = 64 * 1024;  // 64 KB.
+
+/**
+ * The maximum number of entries in a batch.
+ * @const {number}
+ */
+unpacker.Compressor.MAX_BATCH_ENTRIES = 256;
+
+/**
+ * The maximum number of bytes of the files sent in a batch.
+ * @const {number}
+ */
+unpacker.Compressor.MAX_BATCH_SIZE = 2 * 1024 * 1024;  // 2 MB.
 
 /**
  * The getter function for compressor id.
@@ -122,18 +222,21 @@ unpacker.Compressor.prototype.getCompressorId = function() {
  * @return {string}
  */
 unpacker.Compressor.prototype.getArchiveName_ = function() {
+  var extension = this.packFormat_ === unpacker.request.PackFormat.TAR ?
+      unpacker.Compressor.TAR_EXTENSIONS[this.packFilter_] : '.zip';
+
   // When multiple entries are selected.
   if (this.items_.length !== 1)
-    return unpacker.Compressor.DEFAULT_ARCHIVE_NAME;
+    return unpacker.Compressor.DEFAULT_ARCHIVE_NAME + extension;
 
   var name = this.items_[0].entry.name
   var idx = name.lastIndexOf('.');
   // When the name does not have extension.
   // TODO(takise): This converts file.tar.gz to file.tar.zip.
   if (idx === -1)
-    return name + '.zip';
+    return name + extension;
   // When the name has extension.
-  return name.substring(0, idx) + '.zip';
+  return name.substring(0, idx) + extension;
 };
 
 /**
@@ -180,7 +283,9 @@ unpacker.Compressor.prototype.getArchiveFile_ = function() {
  */
 unpacker.Compressor.prototype.sendCreateArchiveRequest_ = function() {
   var request = unpacker.request.createCreateArchiveRequest(
-      this.compressorId_);
+      this.compressorId_, this.packFormat_, this.packFilter_,
+      this.packOptions_.level, this.packOptions_.options,
+      this.packOptions_.storeRatio);
   this.naclModule_.postMessage(request);
 }
 
@@ -262,27 +367,132 @@ unpacker.Compressor.prototype.getDirectoryEntryMetadata_ = function(dir) {
 }
 
 /**
- * Pops an entry from the queue and adds it to the archive.
- * If another entry is in progress, this function does nothing. If there is no
- * entry in the queue, it shifts to close archive process. Otherwise, this sends
- * an add to archive request for a popped entry with its metadata to libarchive.
+ * Pops entries from the queue and adds them to the archive.
+ * If MAX_PENDING_ADD_TO_ARCHIVE_REQUESTS requests are in progress, this
+ * function does nothing. If there is no entry in the queue and no request in
+ * progress, it shifts to close archive process. Otherwise, this sends add to
+ * archive requests for popped entries with their metadata to libarchive.
+ * Directories and small files at the front of the queue are popped and sent
+ * together instead, see sendAddToArchiveBatchRequest_.
  * @private
  */
 unpacker.Compressor.prototype.sendAddToArchiveRequest_ = function() {
-  // Another process is in progress.
-  if (this.entryIdInProgress_ != 0)
-    return;
+  while (!this.preparingBatch_ &&
+         this.addToArchiveRequestsInProgress_.length <
+             unpacker.Compressor.MAX_PENDING_ADD_TO_ARCHIVE_REQUESTS &&
+         this.pendingAddToArchiveRequests_.length > 0) {
+    this.sendNextAddToArchiveRequest_();
+  }
 
   // All entries have already been archived.
-  if (this.pendingAddToArchiveRequests_.length === 0) {
-    if (this.metadataRequestsInProgress_.size === 0)
-      this.sendCloseArchiveRequest(false /* hasError */);
+  if (!this.preparingBatch_ &&
+      this.addToArchiveRequestsInProgress_.length === 0 &&
+      this.pendingAddToArchiveRequests_.length === 0 &&
+      this.metadataRequestsInProgress_.size === 0) {
+    this.sendCloseArchiveRequest(false /* hasError */);
+  }
+}
+
+/**
+ * Pops an entry, or a batch of directories and small files, from the queue
+ * and sends it to NaCl.
+ * @private
+ */
+unpacker.Compressor.prototype.sendNextAddToArchiveRequest_ = function() {
+  var batch = [];
+  var batchSize = 0;
+  while (this.pendingAddToArchiveRequests_.length > 0 &&
+         batch.length < unpacker.Compressor.MAX_BATCH_ENTRIES) {
+    var nextEntryId = this.pendingAddToArchiveRequests_[0];
+    var size = this.entries_[nextEntryId].isDirectory ?
+        0 : this.metadata_[nextEntryId].size;
+    if (size > unpacker.Compressor.INLINE_FILE_SIZE ||
+        batchSize + size > unpacker.Compressor.MAX_BATCH_SIZE) {
+      break;
+    }
+    batch.push(this.pendingAddToArchiveRequests_.shift());
+    batchSize += size;
+  }
+
+  if (batch.length > 0) {
+    this.addToArchiveRequestsInProgress_.push(batch[batch.length - 1]);
+    this.sendAddToArchiveBatchRequest_(batch);
     return;
   }
 
   var entryId = this.pendingAddToArchiveRequests_.shift();
-  this.entryIdInProgress_ = entryId;
+  this.addToArchiveRequestsInProgress_.push(entryId);
+  this.naclModule_.postMessage(this.createAddToArchiveRequest_(entryId));
+}
+
+/**
+ * Reads the files among the given entries, then sends an add to archive batch
+ * request for the entries with the contents of the files.
+ * @param {!Array<!unpacker.types.EntryId>} entryIds The entries of the batch,
+ *     directories or files up to INLINE_FILE_SIZE.
+ * @private
+ */
+unpacker.Compressor.prototype.sendAddToArchiveBatchRequest_ =
+    function(entryIds) {
+  var contents = {};
+  var remaining = entryIds.length;
+  var failed = false;
+  this.preparingBatch_ = true;
+
+  var onRead = function() {
+    if (--remaining > 0)
+      return;
+    var entries = entryIds.map(function(entryId) {
+      return this.createAddToArchiveRequest_(entryId, contents[entryId]);
+    }, this);
+    this.naclModule_.postMessage(
+        unpacker.request.createAddToArchiveBatchRequest(this.compressorId_,
+                                                        entries));
+    this.preparingBatch_ = false;
+    this.sendAddToArchiveRequest_();
+  }.bind(this);
+
+  var onError = function(name) {
+    if (failed)
+      return;
+    failed = true;
+    console.error('Failed to read file ' + name + '.');
+    this.onError_(this.compressorId_);
+  }.bind(this);
+
+  entryIds.forEach(function(entryId) {
+    var entry = this.entries_[entryId];
+    if (entry.isDirectory) {
+      onRead();
+      return;
+    }
+
+    entry.file(function(file) {
+      var reader = new FileReader();
+      reader.onload = function(event) {
+        contents[entryId] = event.target.result;
+        onRead();
+      };
+      reader.onerror = function(event) {
+        onError(entry.fullPath);
+      };
+      reader.readAsArrayBuffer(file);
+    }, function(error) {
+      onError(entry.fullPath);
+    });
+  }, this);
+}
 
+/**
+ * Creates an add to archive request for an entry with its metadata.
+ * @param {!unpacker.types.EntryId} entryId
+ * @param {!ArrayBuffer=} opt_fileContents The data of the file, sent along
+ *     with the entry. The size of the entry is its length.
+ * @return {!Object} An add to archive request.
+ * @private
+ */
+unpacker.Compressor.prototype.createAddToArchiveRequest_ =
+    function(entryId, opt_fileContents) {
   // Convert the absolute path on the virtual filesystem to a relative path from
   // the archive root by removing the leading '/' if exists.
   var fullPath = this.entries_[entryId].fullPath;
@@ -295,11 +505,16 @@ unpacker.Compressor.prototype.sendAddToArchiveRequest_ = function() {
                       mt.getFullYear() + ' ' + mt.getHours() + ':' +
                       mt.getMinutes() + ':' + mt.getSeconds();
 
-  var request = unpacker.request.createAddToArchiveRequest(
-      this.compressorId_, entryId, fullPath,
-      this.metadata_[entryId].size, formattedTime,
-      this.entries_[entryId].isDirectory);
-  this.naclModule_.postMessage(request);
+  var level = this.packOptions_.getEntryLevel ?
+      this.packOptions_.getEntryLevel(this.entries_[entryId],
+                                      this.metadata_[entryId]) :
+      undefined;
+  // The file may have changed since its metadata was read.
+  var size = opt_fileContents ?
+      opt_fileContents.byteLength : this.metadata_[entryId].size;
+  return unpacker.request.createAddToArchiveRequest(
+      this.compressorId_, entryId, fullPath, size, formattedTime,
+      this.entries_[entryId].isDirectory, level, opt_fileContents);
 }
 
 /**
@@ -328,14 +543,55 @@ unpacker.Compressor.prototype.sendReadFileChunkDone_ =
 
 /**
  * A handler of read file chunk messages.
- * Reads 'length' bytes from the entry currently in process.
+ * Queues the request, it is processed once the previous ones are responded.
  * @param {!Object} data
  * @private
  */
 unpacker.Compressor.prototype.onReadFileChunk_ = function(data) {
-  var entryId = this.entryIdInProgress_;
+  this.pendingReadFileChunks_.push({
+    entryId: data[unpacker.request.Key.ENTRY_ID],
+    length: Number(data[unpacker.request.Key.LENGTH])
+  });
+  if (this.pendingReadFileChunks_.length === 1)
+    this.readFileChunk_();
+}
+
+/**
+ * Reads the bytes of the first pending read file chunk request from the entry
+ * of the request, then processes the next request.
+ * @private
+ */
+unpacker.Compressor.prototype.readFileChunk_ = function() {
+  var entryId = this.pendingReadFileChunks_[0].entryId;
   var entry = this.entries_[entryId];
-  var length = Number(data[unpacker.request.Key.LENGTH]);
+  var length = this.pendingReadFileChunks_[0].length;
+
+  // A function to respond to the request and to process the next one.
+  var readFileChunkDone = function(length, buffer) {
+    this.sendReadFileChunkDone_(length, buffer);
+    this.pendingReadFileChunks_.shift();
+    if (this.pendingReadFileChunks_.length > 0)
+      this.readFileChunk_();
+  }.bind(this);
+
+  // A function to report an error. The next requests are dropped, NaCl doesn't
+  // read the entry anymore.
+  var readFileChunkError = function() {
+    this.pendingReadFileChunks_ = [];
+
+    // If the first argument(length) is negative, it means that an error
+    // occurred in reading a chunk.
+    this.sendReadFileChunkDone_(-1, new ArrayBuffer(0));
+    this.onError_(this.compressorId_);
+  }.bind(this);
+
+  // NaCl reads the entries one by one, so the requests for an entry come after
+  // the requests for the previous ones.
+  if (entryId !== this.readEntryId_) {
+    this.readEntryId_ = entryId;
+    this.file_ = null;
+    this.offset_ = 0;
+  }
 
   // A function to create a reader and read bytes.
   var readFileChunk = function() {
@@ -350,27 +606,19 @@ unpacker.Compressor.prototype.onReadFileChunk_ = function(data) {
       if (buffer.byteLength !== length) {
         console.error('Tried to read chunk with length ' + length +
             ', but byte with length ' + buffer.byteLength + ' was returned.');
-
-        // If the first argument(length) is negative, it means that an error
-        // occurred in reading a chunk.
-        this.sendReadFileChunkDone_(-1, buffer);
-        this.onError_(this.compressorId_);
+        readFileChunkError();
         return;
       }
 
       this.offset_ += length;
-      this.sendReadFileChunkDone_(length, buffer);
+      readFileChunkDone(length, buffer);
     }.bind(this);
 
     reader.onerror = function(event) {
       console.error('Failed to read file chunk. Name: ' + file.name +
           ', offset: ' + this.offset_ + ', length: ' + length + '.');
-
-      // If the first argument(length) is negative, it means that an error
-      // occurred in reading a chunk.
-      this.sendReadFileChunkDone_(-1, new ArrayBuffer(0));
-      this.onError_(this.compressorId_);
-    }
+      readFileChunkError();
+    }.bind(this);
 
     reader.readAsArrayBuffer(file);
   }.bind(this);
@@ -390,14 +638,38 @@ unpacker.Compressor.prototype.onReadFileChunk_ = function(data) {
 
 /**
  * A handler of write chunk requests.
- * Writes the data in the given buffer onto the archive file.
+ * Queues the data in the given buffer, it is written onto the archive file
+ * once the previous chunks are written.
  * @param {!Object} data
  * @private
  */
 unpacker.Compressor.prototype.onWriteChunk_ = function(data) {
-  var length = Number(data[unpacker.request.Key.LENGTH]);
-  var buffer = data[unpacker.request.Key.CHUNK_BUFFER];
-  this.writeChunk_(length, buffer, this.sendWriteChunkDone_.bind(this));
+  this.pendingWriteChunks_.push({
+    length: Number(data[unpacker.request.Key.LENGTH]),
+    buffer: data[unpacker.request.Key.CHUNK_BUFFER]
+  });
+  if (this.pendingWriteChunks_.length === 1)
+    this.writeNextChunk_();
+}
+
+/**
+ * Writes the first pending chunk onto the archive file, then writes the next
+ * one. The next chunks are dropped if writing fails, NaCl doesn't wait for
+ * them.
+ * @private
+ */
+unpacker.Compressor.prototype.writeNextChunk_ = function() {
+  var chunk = this.pendingWriteChunks_[0];
+  this.writeChunk_(chunk.length, chunk.buffer, function(length) {
+    this.sendWriteChunkDone_(length);
+    if (length < 0) {
+      this.pendingWriteChunks_ = [];
+      return;
+    }
+    this.pendingWriteChunks_.shift();
+    if (this.pendingWriteChunks_.length > 0)
+      this.writeNextChunk_();
+  }.bind(this));
 }
 
 /**
@@ -415,28 +687,36 @@ unpacker.Compressor.prototype.writeChunk_ = function(length, buffer,
   // TODO(takise): Use the same instance of FileWriter over multiple calls of
   // this function instead of creating new ones.
   this.archiveFileEntry_.createWriter(function(fileWriter) {
+    // onwriteend is called after onerror too.
+    var failed = false;
     fileWriter.onwriteend = function(event) {
-      callback(length);
+      if (!failed)
+        callback(length);
     };
 
     fileWriter.onerror = function(event) {
+      failed = true;
       console.error('Failed to write chunk to ' + this.archiveFileEntry_ + '.');
 
       // If the first argument(length) is negative, it means that an error
       // occurred in writing a chunk.
       callback(-1 /* length */);
       this.onError_(this.compressorId_);
-    };
+    }.bind(this);
 
-    // Create a new Blob and append it to the archive file.
-    var blob = new Blob([buffer], {});
+    // Create a new Blob and append it to the archive file. NaCl reuses its
+    // buffers, so only the first 'length' bytes of buffer are data.
+    var data = length < buffer.byteLength ?
+        new Uint8Array(buffer, 0, length) : buffer;
+    var blob = new Blob([data], {});
     fileWriter.seek(fileWriter.length);
     fileWriter.write(blob);
-  }, function(event) {
+  }.bind(this), function(event) {
     console.error('Failed to create writer for ' + this.archiveFileEntry_ +
         '.');
+    callback(-1 /* length */);
     this.onError_(this.compressorId_);
-  });
+  }.bind(this));
 };
 
 /**
@@ -452,16 +732,16 @@ unpacker.Compressor.prototype.sendWriteChunkDone_ = function(length) {
 
 /**
  * A handler of add to archive done responses.
- * Resets information on the current entry and starts processing another entry.
+ * Forgets the requests of the entries added and sends the next entries.
+ * @param {!Object} data
  * @private
  */
-unpacker.Compressor.prototype.onAddToArchiveDone_ = function() {
-  // Reset information on the current entry.
-  this.entryIdInProgress_ = 0;
-  this.file_ = null;
-  this.offset_ = 0;
+unpacker.Compressor.prototype.onAddToArchiveDone_ = function(data) {
+  var entryId = data[unpacker.request.Key.ENTRY_ID];
+  var index = this.addToArchiveRequestsInProgress_.indexOf(entryId);
+  this.addToArchiveRequestsInProgress_.splice(0, index + 1);
 
-  // Start processing another entry.
+  // Start processing other entries.
   this.sendAddToArchiveRequest_();
 }
 
@@ -495,7 +775,7 @@ unpacker.Compressor.prototype.processMessage = function(data, operation) {
       break;
 
     case unpacker.request.Operation.ADD_TO_ARCHIVE_DONE:
-      this.onAddToArchiveDone_();
+      this.onAddToArchiveDone_(data);
       break;
 
     case unpacker.request.Operation.CLOSE_ARCHIVE_DONE:
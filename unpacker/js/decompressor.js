@@ -66,16 +66,19 @@ unpacker.Decompressor.prototype.hasRequestsInProgress = function() {
  * @param {function(!ProviderError)} onError Callback to execute on error.
  * @param {!Object} naclRequest A request that must be sent to NaCl using
  *     postMessage.
+ * @param {function(...)=} opt_onProgress Callback to execute on progress
+ *     messages received before the answer.
  * @private
  */
-unpacker.Decompressor.prototype.addRequest_ = function(requestId, onSuccess,
-                                                       onError, naclRequest) {
+unpacker.Decompressor.prototype.addRequest_ = function(
+    requestId, onSuccess, onError, naclRequest, opt_onProgress) {
   console.assert(!this.requestsInProgress[requestId],
                  'There is already a request with the id ' + requestId + '.');
 
   this.requestsInProgress[requestId] = {
     onSuccess: onSuccess,
-    onError: onError
+    onError: onError,
+    onProgress: opt_onProgress || null
   };
 
   this.naclModule_.postMessage(naclRequest);
@@ -85,18 +88,80 @@ unpacker.Decompressor.prototype.addRequest_ = function(requestId, onSuccess,
  * Creates a request for reading metadata.
  * @param {!unpacker.types.RequestId} requestId
  * @param {string} encoding Default encoding for the archive's headers.
- * @param {function(!Object<string, !Object>)} onSuccess Callback to execute
- *     once the metadata is obtained from NaCl. It has one parameter, which is
- *     the metadata itself. The metadata has as key the full path to an entry
- *     and as value information about the entry.
+ * @param {function(!Object<string, !Object>|!ArrayBuffer, ArrayBuffer=)}
+ *     onSuccess Callback to execute once the metadata is obtained from NaCl.
+ *     Its first parameter is the metadata itself. The metadata has as key the
+ *     full path to an entry and as value information about the entry, or is
+ *     an ArrayBuffer if opt_metadataFormat is BINARY. The second parameter is
+ *     a new cache record if opt_metadataCache is set and the metadata wasn't
+ *     restored from it.
  * @param {function(!ProviderError)} onError Callback to execute on error.
+ * @param {!unpacker.request.MetadataFormat=} opt_metadataFormat The format of
+ *     the metadata passed to onSuccess. DICTIONARY by default.
+ * @param {function(!ArrayBuffer)=} opt_onProgress Callback to execute for
+ *     every batch of entries NaCl sends while reading the metadata, before
+ *     onSuccess. The batches are in the BINARY format, which must be used.
+ * @param {?ArrayBuffer=} opt_metadataCache The cache record of a previous
+ *     mount of the archive or null if none. If not set, no cache record is
+ *     used or created.
  */
-unpacker.Decompressor.prototype.readMetadata = function(requestId, encoding,
-                                                        onSuccess, onError) {
+unpacker.Decompressor.prototype.readMetadata = function(
+    requestId, encoding, onSuccess, onError, opt_metadataFormat,
+    opt_onProgress, opt_metadataCache) {
   this.addRequest_(
       requestId, onSuccess, onError,
-      unpacker.request.createReadMetadataRequest(this.fileSystemId_, requestId,
-                                                 encoding, this.blob_.size));
+      unpacker.request.createReadMetadataRequest(
+          this.fileSystemId_, requestId, encoding, this.blob_.size,
+          opt_metadataFormat, !!opt_onProgress, opt_metadataCache),
+      opt_onProgress);
+};
+
+/**
+ * Sends a read directory request to NaCl. Used if the metadata was read in
+ * the LAZY format.
+ * @param {!unpacker.types.RequestId} requestId
+ * @param {string} path The full path to the directory.
+ * @param {function(!Array<!Object>)} onSuccess Callback to execute with the
+ *     metadata of the entries of the directory, without their own entries.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ */
+unpacker.Decompressor.prototype.readDirectory = function(requestId, path,
+                                                         onSuccess, onError) {
+  this.addRequest_(
+      requestId, onSuccess, onError,
+      unpacker.request.createReadDirectoryRequest(this.fileSystemId_,
+                                                  requestId, path));
+};
+
+/**
+ * Sends a get metadata request to NaCl. Used if the metadata was read in the
+ * LAZY format.
+ * @param {!unpacker.types.RequestId} requestId
+ * @param {string} path The full path to the entry.
+ * @param {function(!Object)} onSuccess Callback to execute with the metadata
+ *     of the entry, without its entries.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ */
+unpacker.Decompressor.prototype.getMetadata = function(requestId, path,
+                                                       onSuccess, onError) {
+  this.addRequest_(
+      requestId, onSuccess, onError,
+      unpacker.request.createGetMetadataRequest(this.fileSystemId_, requestId,
+                                                path));
+};
+
+/**
+ * @return {number} The size of the archive.
+ */
+unpacker.Decompressor.prototype.getArchiveSize = function() {
+  return this.blob_.size;
+};
+
+/**
+ * @return {!Blob} The archive.
+ */
+unpacker.Decompressor.prototype.getArchive = function() {
+  return this.blob_;
 };
 
 /**
@@ -115,6 +180,78 @@ unpacker.Decompressor.prototype.openFile = function(requestId, index, encoding,
                                              index, encoding, this.blob_.size));
 };
 
+/**
+ * Sends a request to open many files at once to NaCl, which opens them in the
+ * order they are stored in the archive. Every file is answered separately, as
+ * if opened with openFile.
+ * @param {!Array<{requestId: !unpacker.types.RequestId, index: number,
+ *     onSuccess: function(), onError: function(!ProviderError)}>} files
+ * @param {string} encoding Default encoding for the archive's headers.
+ */
+unpacker.Decompressor.prototype.openFiles = function(files, encoding) {
+  files.forEach(function(file) {
+    console.assert(!this.requestsInProgress[file.requestId],
+                   'There is already a request with the id ' +
+                       file.requestId + '.');
+    this.requestsInProgress[file.requestId] = {
+      onSuccess: file.onSuccess,
+      onError: file.onError,
+      onProgress: null
+    };
+  }.bind(this));
+
+  this.naclModule_.postMessage(unpacker.request.createOpenFilesRequest(
+      this.fileSystemId_,
+      files.map(function(file) {
+        return file.requestId;
+      }),
+      files.map(function(file) {
+        return file.index;
+      }),
+      encoding, this.blob_.size));
+};
+
+/**
+ * Sends an open file by path request to NaCl. Unlike openFile, doesn't need
+ * the metadata, as NaCl reads the headers only until the file is found.
+ * @param {!unpacker.types.RequestId} requestId
+ * @param {string} path The absolute path of the file, e.g. '/dir/file'.
+ * @param {string} encoding Default encoding for the archive's headers.
+ * @param {function({index: number, size: number})} onSuccess Callback to
+ *     execute on successful open with the index and the size of the file.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ */
+unpacker.Decompressor.prototype.openFileByPath = function(
+    requestId, path, encoding, onSuccess, onError) {
+  this.addRequest_(
+      requestId, onSuccess, onError,
+      unpacker.request.createOpenFileByPathRequest(
+          this.fileSystemId_, requestId, path, encoding, this.blob_.size));
+};
+
+/**
+ * Sends an extract request to NaCl. The entries are extracted in a single
+ * pass over the archive, in the order they are stored.
+ * @param {!unpacker.types.RequestId} requestId
+ * @param {?Array<number>} indices The indices of the entries to extract or
+ *     null for all of the entries. Directories are skipped.
+ * @param {string} encoding Default encoding for the archive's headers.
+ * @param {function({index: number, path: string, size: number}, !ArrayBuffer,
+ *     boolean)} onData Callback to execute for every chunk of data with the
+ *     entry it belongs to. The last chunk of every entry has no more data.
+ * @param {function()} onSuccess Callback to execute once all of the entries
+ *     are extracted.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ */
+unpacker.Decompressor.prototype.extract = function(
+    requestId, indices, encoding, onData, onSuccess, onError) {
+  this.addRequest_(
+      requestId, onSuccess, onError,
+      unpacker.request.createExtractRequest(
+          this.fileSystemId_, requestId, indices, encoding, this.blob_.size),
+      onData);
+};
+
 /**
  * Sends a close file request to NaCl.
  * @param {!unpacker.types.RequestId} requestId
@@ -169,9 +306,34 @@ unpacker.Decompressor.prototype.processMessage = function(data, operation,
     case unpacker.request.Operation.READ_METADATA_DONE:
       var metadata = data[unpacker.request.Key.METADATA];
       console.assert(metadata, 'No metadata.');
-      requestInProgress.onSuccess(metadata);
+      requestInProgress.onSuccess(
+          metadata, data[unpacker.request.Key.METADATA_CACHE]);
+      break;
+
+    case unpacker.request.Operation.READ_METADATA_PROGRESS:
+      var metadata = data[unpacker.request.Key.METADATA];
+      console.assert(metadata, 'No metadata.');
+      console.assert(requestInProgress.onProgress, 'No progress callback.');
+      requestInProgress.onProgress(metadata);
+      // this.requestsInProgress_[requestId] should be valid until
+      // READ_METADATA_DONE.
+      return;
+
+    case unpacker.request.Operation.READ_DIRECTORY_DONE:
+      var entries = data[unpacker.request.Key.ENTRIES];
+      console.assert(entries, 'No entries.');
+      requestInProgress.onSuccess(entries);
       break;
 
+    case unpacker.request.Operation.GET_METADATA_DONE:
+      var metadata = data[unpacker.request.Key.METADATA];
+      console.assert(metadata, 'No metadata.');
+      // Deleted first as opening a file reuses the request id of the get
+      // metadata request issued before it.
+      delete this.requestsInProgress[requestId];
+      requestInProgress.onSuccess(metadata);
+      return;
+
     case unpacker.request.Operation.READ_CHUNK:
       this.readChunk_(data, requestId);
       // this.requestsInProgress_[requestId] should be valid as long as NaCL
@@ -190,6 +352,38 @@ unpacker.Decompressor.prototype.processMessage = function(data, operation,
       // file so NaCL can make READ_CHUNK requests.
       return;
 
+    case unpacker.request.Operation.OPEN_FILE_BY_PATH_DONE:
+      var index = data[unpacker.request.Key.INDEX];
+      var size = data[unpacker.request.Key.SIZE];
+      console.assert(index && size, 'No index or size of the opened file.');
+      // Received as strings.
+      requestInProgress.onSuccess({index: Number(index), size: Number(size)});
+      // Valid until closing the file, like for OPEN_FILE_DONE.
+      return;
+
+    case unpacker.request.Operation.EXTRACT_ENTRY:
+      // Received as strings.
+      requestInProgress.entry = {
+        index: Number(data[unpacker.request.Key.INDEX]),
+        path: data[unpacker.request.Key.PATH],
+        size: Number(data[unpacker.request.Key.SIZE])
+      };
+      // this.requestsInProgress_[requestId] should be valid until
+      // EXTRACT_DONE.
+      return;
+
+    case unpacker.request.Operation.EXTRACT_DATA:
+      var buffer = data[unpacker.request.Key.READ_FILE_DATA];
+      console.assert(buffer, 'No buffer for extract operation.');
+      console.assert(requestInProgress.entry, 'No extracted entry.');
+      requestInProgress.onProgress(requestInProgress.entry, buffer,
+                                   data[unpacker.request.Key.HAS_MORE_DATA]);
+      return;
+
+    case unpacker.request.Operation.EXTRACT_DONE:
+      requestInProgress.onSuccess();
+      break;
+
     case unpacker.request.Operation.CLOSE_FILE_DONE:
       var openRequestId = data[unpacker.request.Key.OPEN_REQUEST_ID];
       console.assert(openRequestId, 'No open request id.');
@@ -212,9 +406,15 @@ unpacker.Decompressor.prototype.processMessage = function(data, operation,
       break;
 
     case unpacker.request.Operation.FILE_SYSTEM_ERROR:
+      var error = data[unpacker.request.Key.ERROR];
+      // Lookups of entries fail with the error to report to Files app.
+      if (error === 'NOT_FOUND' || error === 'NOT_A_DIRECTORY' ||
+          error === 'NOT_A_FILE') {
+        requestInProgress.onError(error);
+        break;
+      }
       console.error('File system error for <' + this.fileSystemId_ + '>: ' +
-                    data[unpacker.request.Key.ERROR]);  // The error contains
-                                                        // the '.' at the end.
+                    error);  // The error contains the '.' at the end.
       requestInProgress.onError('FAILED');
       break;
 
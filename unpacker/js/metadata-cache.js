@@ -0,0 +1,210 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+'use strict';
+
+/**
+ * Stores the metadata cache records created by NaCl, keyed by a fingerprint of
+ * the archive, so the headers of an archive mounted again don't have to be
+ * read again. The records can be big ArrayBuffers, so they are kept in
+ * IndexedDB rather than chrome.storage.local. Only the most recently used
+ * records are kept.
+ *
+ * The cache is best effort: failures are logged and treated as missing
+ * records.
+ * @constructor
+ */
+unpacker.MetadataCache = function() {
+  /**
+   * The opened database, or null if not opened yet.
+   * @private {?Promise<!IDBDatabase>}
+   */
+  this.database_ = null;
+};
+
+/**
+ * @const {string}
+ */
+unpacker.MetadataCache.DATABASE_NAME = 'metadata-cache';
+
+/**
+ * @const {number}
+ */
+unpacker.MetadataCache.DATABASE_VERSION = 1;
+
+/**
+ * The object store with the records. The key is the fingerprint.
+ * @const {string}
+ */
+unpacker.MetadataCache.STORE_NAME = 'records';
+
+/**
+ * The index of the store by the time the records were last used.
+ * @const {string}
+ */
+unpacker.MetadataCache.LAST_USED_INDEX = 'lastUsed';
+
+/**
+ * The maximum number of records kept. The least recently used records are
+ * removed first.
+ * @const {number}
+ */
+unpacker.MetadataCache.MAXIMUM_RECORDS = 16;
+
+/**
+ * The size of the blocks at the beginning and at the end of an archive that
+ * are hashed for its fingerprint.
+ * @const {number}
+ */
+unpacker.MetadataCache.FINGERPRINT_BLOCK_SIZE = 64 * 1024;
+
+/**
+ * Computes the fingerprint of an archive from its size, its modification time
+ * and the hashes of the blocks at its beginning and at its end. Cheap even for
+ * big archives, as only the two blocks are read.
+ * @param {!Blob} blob The archive.
+ * @return {!Promise<string>}
+ */
+unpacker.MetadataCache.getFingerprint = function(blob) {
+  var blockSize = unpacker.MetadataCache.FINGERPRINT_BLOCK_SIZE;
+  var head = blob.slice(0, Math.min(blockSize, blob.size));
+  var tail = blob.slice(Math.max(0, blob.size - blockSize), blob.size);
+  return Promise.all([
+    unpacker.MetadataCache.hashBlob_(head),
+    unpacker.MetadataCache.hashBlob_(tail)
+  ]).then(function(hashes) {
+    var lastModified = /** @type {!File} */ (blob).lastModified || 0;
+    return [blob.size, lastModified, hashes[0], hashes[1]].join(':');
+  });
+};
+
+/**
+ * Reads a blob and returns its SHA-256 hash as a hex string.
+ * @param {!Blob} blob
+ * @return {!Promise<string>}
+ * @private
+ */
+unpacker.MetadataCache.hashBlob_ = function(blob) {
+  return new Promise(function(fulfill, reject) {
+    var reader = new FileReader();
+    reader.onload = function(event) {
+      fulfill(event.target.result);
+    };
+    reader.onerror = reject;
+    reader.readAsArrayBuffer(blob);
+  }).then(function(buffer) {
+    return crypto.subtle.digest('SHA-256', buffer);
+  }).then(function(digest) {
+    var bytes = new Uint8Array(digest);
+    var hex = '';
+    for (var i = 0; i < bytes.length; i++)
+      hex += (bytes[i] < 16 ? '0' : '') + bytes[i].toString(16);
+    return hex;
+  });
+};
+
+/**
+ * Gets the record stored for an archive and marks it as recently used.
+ * @param {string} fingerprint The fingerprint of the archive.
+ * @return {!Promise<?ArrayBuffer>} The record or null if none.
+ */
+unpacker.MetadataCache.prototype.get = function(fingerprint) {
+  return this.openDatabase_().then(function(database) {
+    return new Promise(function(fulfill, reject) {
+      var transaction = database.transaction(
+          [unpacker.MetadataCache.STORE_NAME], 'readwrite');
+      var store = transaction.objectStore(unpacker.MetadataCache.STORE_NAME);
+      var record = null;
+      store.get(fingerprint).onsuccess = function(event) {
+        var value = event.target.result;
+        if (!value)
+          return;
+        record = value.record;
+        value.lastUsed = Date.now();
+        store.put(value);
+      };
+      transaction.oncomplete = function() {
+        fulfill(record);
+      };
+      transaction.onerror = function() {
+        reject(transaction.error);
+      };
+    });
+  }).catch(function(error) {
+    console.warn('Failed to get a metadata cache record: ' + error + '.');
+    return null;
+  });
+};
+
+/**
+ * Stores the record of an archive, removing the least recently used records
+ * above MAXIMUM_RECORDS.
+ * @param {string} fingerprint The fingerprint of the archive.
+ * @param {!ArrayBuffer} record The record created by NaCl.
+ * @return {!Promise}
+ */
+unpacker.MetadataCache.prototype.put = function(fingerprint, record) {
+  return this.openDatabase_().then(function(database) {
+    return new Promise(function(fulfill, reject) {
+      var transaction = database.transaction(
+          [unpacker.MetadataCache.STORE_NAME], 'readwrite');
+      var store = transaction.objectStore(unpacker.MetadataCache.STORE_NAME);
+      store.put({fingerprint: fingerprint, record: record,
+                 lastUsed: Date.now()});
+      store.count().onsuccess = function(event) {
+        var excess = event.target.result -
+                     unpacker.MetadataCache.MAXIMUM_RECORDS;
+        if (excess <= 0)
+          return;
+        // Oldest first.
+        store.index(unpacker.MetadataCache.LAST_USED_INDEX).openCursor()
+            .onsuccess = function(event) {
+          var cursor = event.target.result;
+          if (!cursor || excess-- <= 0)
+            return;
+          cursor.delete();
+          cursor.continue();
+        };
+      };
+      transaction.oncomplete = function() {
+        fulfill();
+      };
+      transaction.onerror = function() {
+        reject(transaction.error);
+      };
+    });
+  }).catch(function(error) {
+    console.warn('Failed to store a metadata cache record: ' + error + '.');
+  });
+};
+
+/**
+ * Opens the database, creating it if needed.
+ * @return {!Promise<!IDBDatabase>}
+ * @private
+ */
+unpacker.MetadataCache.prototype.openDatabase_ = function() {
+  if (!this.database_) {
+    this.database_ = new Promise(function(fulfill, reject) {
+      var request = indexedDB.open(unpacker.MetadataCache.DATABASE_NAME,
+                                   unpacker.MetadataCache.DATABASE_VERSION);
+      request.onupgradeneeded = function(event) {
+        var store = event.target.result.createObjectStore(
+            unpacker.MetadataCache.STORE_NAME, {keyPath: 'fingerprint'});
+        store.createIndex(unpacker.MetadataCache.LAST_USED_INDEX, 'lastUsed');
+      };
+      request.onsuccess = function(event) {
+        fulfill(event.target.result);
+      };
+      request.onerror = function() {
+        reject(request.error);
+      };
+    });
+    // Try again next time.
+    this.database_.catch(function() {
+      this.database_ = null;
+    }.bind(this));
+  }
+  return this.database_;
+};
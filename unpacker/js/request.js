@@ -22,7 +22,13 @@ unpacker.request = {
     REQUEST_ID: 'request_id',          // Should be a string.
 
     // Optional keys unique to unpacking operations.
-    METADATA: 'metadata',          // Should be a dictionary.
+    METADATA: 'metadata',          // Should be a dictionary or an
+                                   // ArrayBuffer, see MetadataFormat.
+    METADATA_FORMAT: 'metadata_format',  // Should be a
+                                         // unpacker.request.MetadataFormat.
+    METADATA_PROGRESS: 'metadata_progress',  // Should be a boolean.
+    METADATA_CACHE: 'metadata_cache',  // Should be an ArrayBuffer.
+    CREATE_METADATA_CACHE: 'create_metadata_cache',  // Should be a boolean.
     ARCHIVE_SIZE: 'archive_size',  // Should be a string as only int is
                                    // supported by pp::Var on C++.
     INDEX: 'index',        // Should be a string. Same reason as ARCHIVE_SIZE.
@@ -32,6 +38,12 @@ unpacker.request = {
     READ_FILE_DATA: 'read_file_data',       // Should be an ArrayBuffer.
     HAS_MORE_DATA: 'has_more_data',         // Should be a boolean.
     PASSPHRASE: 'passphrase',               // Should be a string.
+    PATH: 'path',                           // Should be a string.
+    ENTRIES: 'entries',                     // Should be an array.
+    SIZE: 'size',          // Should be a string. Same reason as ARCHIVE_SIZE.
+    INDICES: 'indices',    // Should be an array of strings, like INDEX.
+    REQUEST_IDS: 'request_ids',  // Should be an array of strings, like
+                                 // REQUEST_ID.
 
     // Mandatory keys for all packing operations.
     COMPRESSOR_ID: 'compressor_id',         // Should be an int.
@@ -46,6 +58,13 @@ unpacker.request = {
                                             // (mm/dd/yy h:m:s)
     HAS_ERROR: 'has_error',                 // Should be a boolean Sent from JS
                                             // to NaCL.
+    PACK_FORMAT: 'pack_format',  // Should be an unpacker.request.PackFormat.
+    PACK_FILTER: 'pack_filter',  // Should be an unpacker.request.PackFilter.
+    PACK_LEVEL: 'pack_level',      // Should be an int.
+    PACK_OPTIONS: 'pack_options',  // Should be a string.
+    PACK_STORE_RATIO: 'pack_store_ratio',  // Should be a number.
+    FILE_CONTENTS: 'file_contents',  // Should be an ArrayBuffer with all the
+                                     // data of the file.
 
     // Optional keys used for both packing and unpacking operations.
     ERROR: 'error',                // Should be a string.
@@ -84,25 +103,79 @@ unpacker.request = {
     READ_FILE_DONE: 14,
     CONSOLE_LOG: 15,
     CONSOLE_DEBUG: 16,
-    CREATE_ARCHIVE: 17,
-    CREATE_ARCHIVE_DONE: 18,
-    ADD_TO_ARCHIVE: 19,
-    ADD_TO_ARCHIVE_DONE: 20,
-    READ_FILE_CHUNK: 21,
-    READ_FILE_CHUNK_DONE: 22,
-    WRITE_CHUNK: 23,
-    WRITE_CHUNK_DONE: 24,
-    CLOSE_ARCHIVE: 25,
-    CLOSE_ARCHIVE_DONE: 26,
+    READ_METADATA_PROGRESS: 17,
+    READ_DIRECTORY: 18,
+    READ_DIRECTORY_DONE: 19,
+    GET_METADATA: 20,
+    GET_METADATA_DONE: 21,
+    OPEN_FILE_BY_PATH: 22,
+    OPEN_FILE_BY_PATH_DONE: 23,
+    EXTRACT: 24,
+    EXTRACT_ENTRY: 25,
+    EXTRACT_DATA: 26,
+    EXTRACT_DONE: 27,
+    OPEN_FILES: 28,
+    CREATE_ARCHIVE: 50,
+    CREATE_ARCHIVE_DONE: 51,
+    ADD_TO_ARCHIVE: 52,
+    ADD_TO_ARCHIVE_DONE: 53,
+    READ_FILE_CHUNK: 54,
+    READ_FILE_CHUNK_DONE: 55,
+    WRITE_CHUNK: 56,
+    WRITE_CHUNK_DONE: 57,
+    CLOSE_ARCHIVE: 58,
+    CLOSE_ARCHIVE_DONE: 59,
+    ADD_TO_ARCHIVE_BATCH: 60,
     FILE_SYSTEM_ERROR: -1,
     COMPRESSOR_ERROR: -2
   },
 
   /**
-  * Operations greater than or equal to this value are for packing.
+   * Defines the formats of the metadata sent with READ_METADATA_DONE. Should
+   * be the same as the formats on the NaCL side. DICTIONARY is a tree of
+   * nested dictionaries, while BINARY is a single ArrayBuffer decoded by
+   * unpacker.Volume. LAZY is only the root directory without its entries,
+   * which are kept by NaCl and obtained with READ_DIRECTORY and GET_METADATA.
+   * @enum {number}
+   */
+  MetadataFormat: {
+    DICTIONARY: 0,
+    BINARY: 1,
+    LAZY: 2
+  },
+
+  /**
+   * Defines the formats of the archives created with CREATE_ARCHIVE. Should be
+   * the same as the formats on the NaCL side.
+   * @enum {number}
+   */
+  PackFormat: {
+    ZIP: 0,
+    TAR: 1
+  },
+
+  /**
+   * Defines how the archives created with CREATE_ARCHIVE are compressed.
+   * Should be the same as the filters on the NaCL side. DEFAULT is DEFLATE for
+   * ZIP and NONE for TAR. ZIP supports only NONE and DEFLATE, while DEFLATE is
+   * gzip for TAR.
+   * @enum {number}
+   */
+  PackFilter: {
+    DEFAULT: 0,
+    NONE: 1,
+    DEFLATE: 2,
+    ZSTD: 3,
+    XZ: 4,
+    LZ4: 5
+  },
+
+  /**
+  * Operations greater than or equal to this value are for packing. Unpacking
+  * operations use the values below it.
   * @const {number}
   */
-  MINIMUM_PACK_REQUEST_VALUE: 17,
+  MINIMUM_PACK_REQUEST_VALUE: 50,
 
   /**
   * Return true if the given operation is related to packing.
@@ -137,15 +210,43 @@ unpacker.request = {
    * @param {!unpacker.types.RequestId} requestId
    * @param {string} encoding Default encoding for the archive.
    * @param {number} archiveSize The size of the archive for fileSystemId.
+   * @param {!unpacker.request.MetadataFormat=} opt_metadataFormat The format
+   *     of the metadata in the response. NaCl uses DICTIONARY if not set.
+   * @param {boolean=} opt_metadataProgress True if NaCl should also send the
+   *     entries in batches with READ_METADATA_PROGRESS while reading them.
+   *     Requires the BINARY format.
+   * @param {?ArrayBuffer=} opt_metadataCache A cache record returned by NaCl
+   *     for a previous mount of the archive, or null if none. If set, NaCl
+   *     restores the metadata from the record if valid and otherwise returns
+   *     a new record with READ_METADATA_DONE.
    * @return {!Object} A read metadata request.
    */
   createReadMetadataRequest: function(fileSystemId, requestId, encoding,
-                                      archiveSize) {
+                                      archiveSize, opt_metadataFormat,
+                                      opt_metadataProgress,
+                                      opt_metadataCache) {
     var readMetadataRequest = unpacker.request.createBasic_(
         unpacker.request.Operation.READ_METADATA, fileSystemId, requestId);
     readMetadataRequest[unpacker.request.Key.ENCODING] = encoding;
     readMetadataRequest[unpacker.request.Key.ARCHIVE_SIZE] =
         archiveSize.toString();
+    if (opt_metadataFormat !== undefined) {
+      readMetadataRequest[unpacker.request.Key.METADATA_FORMAT] =
+          opt_metadataFormat;
+    }
+    if (opt_metadataProgress) {
+      console.assert(
+          opt_metadataFormat === unpacker.request.MetadataFormat.BINARY,
+          'Metadata progress requires the binary format.');
+      readMetadataRequest[unpacker.request.Key.METADATA_PROGRESS] = true;
+    }
+    if (opt_metadataCache !== undefined) {
+      readMetadataRequest[unpacker.request.Key.CREATE_METADATA_CACHE] = true;
+      if (opt_metadataCache) {
+        readMetadataRequest[unpacker.request.Key.METADATA_CACHE] =
+            opt_metadataCache;
+      }
+    }
     return readMetadataRequest;
   },
 
@@ -224,6 +325,34 @@ unpacker.request = {
         unpacker.request.Operation.CLOSE_VOLUME, fileSystemId, -1);
   },
 
+  /**
+   * Creates a read directory request.
+   * @param {!unpacker.types.FileSystemId} fileSystemId
+   * @param {!unpacker.types.RequestId} requestId
+   * @param {string} path The full path to the directory.
+   * @return {!Object} A read directory request.
+   */
+  createReadDirectoryRequest: function(fileSystemId, requestId, path) {
+    var readDirectoryRequest = unpacker.request.createBasic_(
+        unpacker.request.Operation.READ_DIRECTORY, fileSystemId, requestId);
+    readDirectoryRequest[unpacker.request.Key.PATH] = path;
+    return readDirectoryRequest;
+  },
+
+  /**
+   * Creates a get metadata request.
+   * @param {!unpacker.types.FileSystemId} fileSystemId
+   * @param {!unpacker.types.RequestId} requestId
+   * @param {string} path The full path to the entry.
+   * @return {!Object} A get metadata request.
+   */
+  createGetMetadataRequest: function(fileSystemId, requestId, path) {
+    var getMetadataRequest = unpacker.request.createBasic_(
+        unpacker.request.Operation.GET_METADATA, fileSystemId, requestId);
+    getMetadataRequest[unpacker.request.Key.PATH] = path;
+    return getMetadataRequest;
+  },
+
   /**
    * Creates an open file request.
    * @param {!unpacker.types.FileSystemId} fileSystemId
@@ -242,6 +371,85 @@ unpacker.request = {
     return openFileRequest;
   },
 
+  /**
+   * Creates a request to open many files at once. NaCl opens them in the
+   * order of their indices and answers every open request with OPEN_FILE_DONE
+   * or FILE_SYSTEM_ERROR. The request id of the request itself is the first
+   * open request id.
+   * @param {!unpacker.types.FileSystemId} fileSystemId
+   * @param {!Array<!unpacker.types.RequestId>} requestIds The open request ids.
+   * @param {!Array<number>} indices The indices of the files, in the order of
+   *     requestIds.
+   * @param {string} encoding Default encoding for the archive.
+   * @param {number} archiveSize The size of the volume's archive.
+   * @return {!Object} An open files request.
+   */
+  createOpenFilesRequest: function(fileSystemId, requestIds, indices, encoding,
+                                   archiveSize) {
+    var openFilesRequest = unpacker.request.createBasic_(
+        unpacker.request.Operation.OPEN_FILES, fileSystemId, requestIds[0]);
+    openFilesRequest[unpacker.request.Key.REQUEST_IDS] =
+        requestIds.map(function(requestId) {
+          return requestId.toString();
+        });
+    openFilesRequest[unpacker.request.Key.INDICES] =
+        indices.map(function(index) {
+          return index.toString();
+        });
+    openFilesRequest[unpacker.request.Key.ENCODING] = encoding;
+    openFilesRequest[unpacker.request.Key.ARCHIVE_SIZE] =
+        archiveSize.toString();
+    return openFilesRequest;
+  },
+
+  /**
+   * Creates an open file by path request, which can be sent before the
+   * metadata is read.
+   * @param {!unpacker.types.FileSystemId} fileSystemId
+   * @param {!unpacker.types.RequestId} requestId
+   * @param {string} path The absolute path of the file, e.g. '/dir/file'.
+   * @param {string} encoding Default encoding for the archive.
+   * @param {number} archiveSize The size of the volume's archive.
+   * @return {!Object} An open file by path request.
+   */
+  createOpenFileByPathRequest: function(fileSystemId, requestId, path, encoding,
+                                        archiveSize) {
+    var openFileByPathRequest = unpacker.request.createBasic_(
+        unpacker.request.Operation.OPEN_FILE_BY_PATH, fileSystemId, requestId);
+    openFileByPathRequest[unpacker.request.Key.PATH] = path;
+    openFileByPathRequest[unpacker.request.Key.ENCODING] = encoding;
+    openFileByPathRequest[unpacker.request.Key.ARCHIVE_SIZE] =
+        archiveSize.toString();
+    return openFileByPathRequest;
+  },
+
+  /**
+   * Creates an extract request. NaCl answers with an EXTRACT_ENTRY message for
+   * every extracted file, followed by EXTRACT_DATA messages with its data, the
+   * last one without more data, and finally with EXTRACT_DONE.
+   * @param {!unpacker.types.FileSystemId} fileSystemId
+   * @param {!unpacker.types.RequestId} requestId
+   * @param {?Array<number>} indices The indices of the entries to extract or
+   *     null for all of the entries.
+   * @param {string} encoding Default encoding for the archive.
+   * @param {number} archiveSize The size of the volume's archive.
+   * @return {!Object} An extract request.
+   */
+  createExtractRequest: function(fileSystemId, requestId, indices, encoding,
+                                 archiveSize) {
+    var extractRequest = unpacker.request.createBasic_(
+        unpacker.request.Operation.EXTRACT, fileSystemId, requestId);
+    if (indices) {
+      extractRequest[unpacker.request.Key.INDICES] =
+          indices.map(function(index) {
+            return index.toString();
+          });
+    }
+    extractRequest[unpacker.request.Key.ENCODING] = encoding;
+    extractRequest[unpacker.request.Key.ARCHIVE_SIZE] = archiveSize.toString();
+    return extractRequest;
+  },
+
   /**
    * Creates a close file request.
    * @param {!unpacker.types.FileSystemId} fileSystemId
@@ -280,13 +488,37 @@ unpacker.request = {
   /**
    * Creates a create archive request for compressor.
    * @param {!unpacker.types.CompressorId} compressorId
+   * @param {!unpacker.request.PackFormat=} opt_packFormat The format of the
+   *     archive. NaCl uses ZIP if not set.
+   * @param {!unpacker.request.PackFilter=} opt_packFilter How the archive is
+   *     compressed. NaCl uses DEFAULT if not set.
+   * @param {number=} opt_packLevel The compression level, e.g. 1-9 for
+   *     deflate and xz or 1-22 for zstd. NaCl uses the default level of the
+   *     filter if not set.
+   * @param {string=} opt_packOptions Options passed to libarchive as they
+   *     are, e.g. 'gzip:!timestamp'.
+   * @param {number=} opt_packStoreRatio ZIP entries whose start doesn't
+   *     deflate below this ratio of its size, or that look already compressed,
+   *     are stored. 0 deflates all of them. NaCl uses 0.95 if not set.
    * @return {!Object} A create archive request.
    */
-  createCreateArchiveRequest: function(compressorId) {
+  createCreateArchiveRequest: function(compressorId, opt_packFormat,
+                                       opt_packFilter, opt_packLevel,
+                                       opt_packOptions, opt_packStoreRatio) {
     var request = {};
     request[unpacker.request.Key.OPERATION] =
         unpacker.request.Operation.CREATE_ARCHIVE;
     request[unpacker.request.Key.COMPRESSOR_ID] = compressorId;
+    if (opt_packFormat !== undefined)
+      request[unpacker.request.Key.PACK_FORMAT] = opt_packFormat;
+    if (opt_packFilter !== undefined)
+      request[unpacker.request.Key.PACK_FILTER] = opt_packFilter;
+    if (opt_packLevel !== undefined)
+      request[unpacker.request.Key.PACK_LEVEL] = opt_packLevel;
+    if (opt_packOptions !== undefined)
+      request[unpacker.request.Key.PACK_OPTIONS] = opt_packOptions;
+    if (opt_packStoreRatio !== undefined)
+      request[unpacker.request.Key.PACK_STORE_RATIO] = opt_packStoreRatio;
     return request;
   },
 
@@ -298,10 +530,16 @@ unpacker.request = {
    * @param {number} fileSize The size of the entry.
    * @param {string} modificationTime The modification time of the entry.
    * @param {boolean} isDirectory Whether the entry is a directory or not.
+   * @param {number=} opt_packLevel The compression level of the entry, which
+   *     overrides the level of the archive. Used only by ZIP, where 0 stores
+   *     the entry, e.g. if it is compressed already.
+   * @param {!ArrayBuffer=} opt_fileContents The data of the file, so that NaCl
+   *     doesn't request it with READ_FILE_CHUNK. fileSize must be its length.
    * @return {!Object} An add to archive request.
    */
   createAddToArchiveRequest: function(compressorId, entryId, pathname,
-                                      fileSize, modificationTime, isDirectory) {
+                                      fileSize, modificationTime, isDirectory,
+                                      opt_packLevel, opt_fileContents) {
     var request = {};
     request[unpacker.request.Key.OPERATION] =
         unpacker.request.Operation.ADD_TO_ARCHIVE;
@@ -312,6 +550,27 @@ unpacker.request = {
     request[unpacker.request.Key.MODIFICATION_TIME] =
         modificationTime.toString();
     request[unpacker.request.Key.IS_DIRECTORY] = isDirectory;
+    if (opt_packLevel !== undefined)
+      request[unpacker.request.Key.PACK_LEVEL] = opt_packLevel;
+    if (opt_fileContents !== undefined)
+      request[unpacker.request.Key.FILE_CONTENTS] = opt_fileContents;
+    return request;
+  },
+
+  /**
+   * Creates a request that adds several entries to the archive, in order.
+   * NaCl answers it with a single ADD_TO_ARCHIVE_DONE.
+   * @param {!unpacker.types.CompressorId} compressorId
+   * @param {!Array<!Object>} entries The add to archive requests of the
+   *     entries, see createAddToArchiveRequest.
+   * @return {!Object} An add to archive batch request.
+   */
+  createAddToArchiveBatchRequest: function(compressorId, entries) {
+    var request = {};
+    request[unpacker.request.Key.OPERATION] =
+        unpacker.request.Operation.ADD_TO_ARCHIVE_BATCH;
+    request[unpacker.request.Key.COMPRESSOR_ID] = compressorId;
+    request[unpacker.request.Key.ENTRIES] = entries;
     return request;
   },
 
@@ -78,3 +78,18 @@ unpacker.types.CloseFileRequestedOptions;
  *                    length: number}>}
  */
 unpacker.types.ReadFileRequestedOptions;
+
+/**
+ * The options of an archive created by unpacker.Compressor. All of them are
+ * optional, see unpacker.request.createCreateArchiveRequest. getEntryLevel
+ * returns the compression level of an entry, which overrides level for ZIP
+ * archives, or undefined for the level of the archive.
+ * @typedef {{format: (!unpacker.request.PackFormat|undefined),
+ *            filter: (!unpacker.request.PackFilter|undefined),
+ *            level: (number|undefined),
+ *            options: (string|undefined),
+ *            storeRatio: (number|undefined),
+ *            getEntryLevel: ((function(!Entry, !Metadata):
+ *                (number|undefined))|undefined)}}
+ */
+unpacker.types.PackOptions;
@@ -14,16 +14,26 @@ function DateFromTimeT(timestamp) {
 }
 
 /**
- * Corrects metadata entries fields in order for them to be sent to Files.app.
- * This function runs recursively for every entry in a directory.
+ * Corrects the fields of a single metadata entry in order for it to be sent to
+ * Files.app. The entries of a directory are not corrected.
  * @param {!Object<string, !EntryMetadata>} entryMetadata The metadata to
  *     correct.
  */
-function correctMetadata(entryMetadata) {
+function correctEntryMetadata(entryMetadata) {
   entryMetadata.index = parseInt(entryMetadata.index, 10);
   entryMetadata.size = parseInt(entryMetadata.size, 10);
   entryMetadata.modificationTime =
       DateFromTimeT(entryMetadata.modificationTime);
+}
+
+/**
+ * Corrects metadata entries fields in order for them to be sent to Files.app.
+ * This function runs recursively for every entry in a directory.
+ * @param {!Object<string, !EntryMetadata>} entryMetadata The metadata to
+ *     correct.
+ */
+function correctMetadata(entryMetadata) {
+  correctEntryMetadata(entryMetadata);
   if (entryMetadata.isDirectory) {
     console.assert(entryMetadata.entries,
         'The field "entries" is mandatory for dictionaries.');
@@ -33,6 +43,76 @@ function correctMetadata(entryMetadata) {
   }
 }
 
+/**
+ * Decodes the metadata sent by NaCl in unpacker.request.MetadataFormat.BINARY
+ * format into the same objects correctMetadata produces. Should be the same
+ * format as the one described in cpp/metadata_tree.h.
+ * @param {!ArrayBuffer} buffer The metadata sent by NaCl.
+ * @param {!Array<!Object>} records The records decoded so far, indexed by
+ *     record number. The records of buffer are added to it and linked to
+ *     their parents, which may come from previous buffers.
+ * @return {!Object<string, !EntryMetadata>} The metadata of the root
+ *     directory.
+ */
+function decodeBinaryMetadata(buffer, records) {
+  var view = new DataView(buffer);
+  console.assert(
+      view.getUint32(0, true) == unpacker.Volume.BINARY_METADATA_VERSION,
+      'Unsupported metadata format version.');
+  var count = view.getUint32(4, true);
+  var stringTableOffset = view.getUint32(8, true);
+  var stringTableSize = view.getUint32(12, true);
+  var firstRecord = view.getUint32(16, true);
+  console.assert(firstRecord == records.length, 'Missing records.');
+
+  // Names are stored only once in the string table, so decode every name once.
+  var decoder = new TextDecoder('utf-8');
+  var names = {};
+  var recordOffset = unpacker.Volume.BINARY_METADATA_HEADER_SIZE;
+  for (var i = 0; i < count; i++) {
+    var parent = view.getUint32(recordOffset, true);
+    var nameOffset = view.getUint32(recordOffset + 4, true);
+    var nameLength = view.getUint32(recordOffset + 8, true);
+    var flags = view.getUint32(recordOffset + 12, true);
+    console.assert(nameOffset + nameLength <= stringTableSize,
+        'Name out of the string table.');
+
+    var nameKey = nameOffset + ':' + nameLength;
+    var name = names[nameKey];
+    if (name === undefined) {
+      name = decoder.decode(new Uint8Array(
+          buffer, stringTableOffset + nameOffset, nameLength));
+      names[nameKey] = name;
+    }
+
+    var isDirectory =
+        !!(flags & unpacker.Volume.BINARY_METADATA_DIRECTORY_FLAG);
+    var entry = {
+      index: view.getFloat64(recordOffset + 16, true),
+      isDirectory: isDirectory,
+      name: name,
+      size: view.getFloat64(recordOffset + 24, true),
+      modificationTime: DateFromTimeT(view.getFloat64(recordOffset + 32, true))
+    };
+    if (isDirectory)
+      entry.entries = {};
+    records.push(entry);
+
+    // Parents are always before their children.
+    if (parent != unpacker.Volume.BINARY_METADATA_NO_PARENT) {
+      console.assert(parent < firstRecord + i, 'Child before its parent.');
+      var parentEntry = records[parent];
+      if (!parentEntry.entries)
+        parentEntry.entries = {};
+      parentEntry.entries[name] = entry;
+    }
+    recordOffset += unpacker.Volume.BINARY_METADATA_RECORD_SIZE;
+  }
+
+  console.assert(records.length > 0, 'No root entry.');
+  return /** @type {!Object<string, !EntryMetadata>} */ (records[0]);
+}
+
 /**
  * Defines a volume object that contains information about archives' contents
  * and performs operations on these contents.
@@ -40,8 +120,10 @@ function correctMetadata(entryMetadata) {
  * @param {!unpacker.Decompressor} decompressor The decompressor used to obtain
  *     data from archives.
  * @param {!Entry} entry The entry corresponding to the volume's archive.
+ * @param {!unpacker.MetadataCache=} opt_metadataCache The cache of the
+ *     metadata of archives mounted before. Not used if not set.
  */
-unpacker.Volume = function(decompressor, entry) {
+unpacker.Volume = function(decompressor, entry, opt_metadataCache) {
   /**
    * Used for restoring the opened file entry after resuming the event page.
    * @type {!Entry}
@@ -53,6 +135,11 @@ unpacker.Volume = function(decompressor, entry) {
    */
   this.decompressor = decompressor;
 
+  /**
+   * @private {?unpacker.MetadataCache}
+   */
+  this.metadataCache_ = opt_metadataCache || null;
+
   /**
    * The volume's metadata. The key is the full path to the file on this volume.
    * For more details see
@@ -61,6 +148,58 @@ unpacker.Volume = function(decompressor, entry) {
    */
   this.metadata = null;
 
+  /**
+   * True while the metadata is being read. this.metadata may contain only
+   * some of the entries in the meantime.
+   * @private {boolean}
+   */
+  this.loadingMetadata_ = false;
+
+  /**
+   * The records decoded from the batches of entries received while loading
+   * the metadata. See decodeBinaryMetadata.
+   * @private {!Array<!Object>}
+   */
+  this.metadataRecords_ = [];
+
+  /**
+   * Requests that can't be answered until more entries are loaded. Retried
+   * for every batch of entries.
+   * @private {!Array<{retry: function(), onError: function(!ProviderError)}>}
+   */
+  this.pendingRequests_ = [];
+
+  /**
+   * True if the metadata of the entries is kept by NaCl and obtained for
+   * every request, in which case this.metadata is only the root directory.
+   * Used for big archives, where sending the metadata of all the entries to
+   * JavaScript is expensive.
+   * @private {boolean}
+   */
+  this.lazyMetadata_ = false;
+
+  /**
+   * A map with currently opened files. The key is a requestId value from the
+   * openFileRequested event and the value is the size of the file.
+   * @private {!Object<!unpacker.types.RequestId, number>}
+   */
+  this.openedFileSizes_ = {};
+
+  /**
+   * Files to open that wait for the files already sent to NaCl to be opened.
+   * They are then sent together, so NaCl can open them in the order they are
+   * stored in the archive instead of the order they were requested in.
+   * @private {!Array<{requestId: !unpacker.types.RequestId, index: number,
+   *     onSuccess: function(), onError: function(!ProviderError)}>}
+   */
+  this.pendingOpens_ = [];
+
+  /**
+   * The number of files sent to NaCl to be opened and not answered yet.
+   * @private {number}
+   */
+  this.openingFiles_ = 0;
+
   /**
    * A map with currently opened files. The key is a requestId value from the
    * openFileRequested event and the value is the open file options.
@@ -91,6 +230,42 @@ unpacker.Volume = function(decompressor, entry) {
  */
 unpacker.Volume.DEFAULT_READ_METADATA_REQUEST_ID = -1;
 
+/**
+ * The layout of the metadata in unpacker.request.MetadataFormat.BINARY format.
+ * Should be the same as the constants in cpp/metadata_tree.h.
+ * @const {number}
+ */
+unpacker.Volume.BINARY_METADATA_VERSION = 1;
+
+/**
+ * @const {number}
+ */
+unpacker.Volume.BINARY_METADATA_HEADER_SIZE = 20;
+
+/**
+ * @const {number}
+ */
+unpacker.Volume.BINARY_METADATA_RECORD_SIZE = 40;
+
+/**
+ * The parent of the root record.
+ * @const {number}
+ */
+unpacker.Volume.BINARY_METADATA_NO_PARENT = 0xffffffff;
+
+/**
+ * The flag set for directory records.
+ * @const {number}
+ */
+unpacker.Volume.BINARY_METADATA_DIRECTORY_FLAG = 1;
+
+/**
+ * The minimum size of an archive, in bytes, for its metadata to be kept by
+ * NaCl and obtained per request instead of being sent to JavaScript at once.
+ * @const {number}
+ */
+unpacker.Volume.LAZY_METADATA_MINIMUM_ARCHIVE_SIZE = 512 * 1024 * 1024;
+
 /**
  * Map from language codes to default charset encodings.
  * @const {!Object<string, string>}
@@ -158,20 +333,114 @@ unpacker.Volume.prototype.inUse = function() {
 };
 
 /**
- * Initializes the volume by reading its metadata.
+ * Initializes the volume by reading its metadata. Entries are received in
+ * batches while NaCl reads them, so the volume may be used before the whole
+ * metadata is read. Requests for entries that are not read yet are answered
+ * once they are read. For big archives only the root directory is received
+ * and the other entries are obtained from NaCl per request.
+ *
+ * If the volume has a metadata cache and the archive was mounted before, NaCl
+ * restores the metadata from the cache instead of reading the headers again.
  * @param {function()} onSuccess Callback to execute on success.
  * @param {function(!ProviderError)} onError Callback to execute on error.
+ * @param {function()=} opt_onProgress Callback to execute every time a batch
+ *     of entries is read. The volume is ready to be used after the first call.
  */
-unpacker.Volume.prototype.initialize = function(onSuccess, onError) {
+unpacker.Volume.prototype.initialize = function(onSuccess, onError,
+                                                opt_onProgress) {
+  if (!this.metadataCache_) {
+    this.readMetadata_(null, undefined, onSuccess, onError, opt_onProgress);
+    return;
+  }
+
+  var metadataCache = this.metadataCache_;
+  var fingerprint = null;
+  unpacker.MetadataCache.getFingerprint(this.decompressor.getArchive())
+      .then(function(archiveFingerprint) {
+        fingerprint = archiveFingerprint;
+        return metadataCache.get(fingerprint);
+      })
+      .then(function(record) {
+        this.readMetadata_(fingerprint, record, onSuccess, onError,
+                           opt_onProgress);
+      }.bind(this), function(error) {
+        console.warn('Failed to fingerprint the archive: ' + error + '.');
+        this.readMetadata_(null, undefined, onSuccess, onError,
+                           opt_onProgress);
+      }.bind(this));
+};
+
+/**
+ * Reads the metadata of the volume from NaCl.
+ * @param {?string} fingerprint The fingerprint of the archive, or null if no
+ *     cache record should be stored.
+ * @param {?ArrayBuffer|undefined} metadataCache The cache record of the
+ *     archive, null if none and undefined if the cache is not used.
+ * @param {function()} onSuccess Callback to execute on success.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ * @param {function()=} opt_onProgress Callback to execute every time a batch
+ *     of entries is read.
+ * @private
+ */
+unpacker.Volume.prototype.readMetadata_ = function(
+    fingerprint, metadataCache, onSuccess, onError, opt_onProgress) {
   var requestId = unpacker.Volume.DEFAULT_READ_METADATA_REQUEST_ID;
-  this.decompressor.readMetadata(requestId, this.encoding, function(metadata) {
-    // Make a deep copy of metadata.
-    this.metadata = /** @type {!Object<string, !EntryMetadata>} */ (JSON.parse(
-            JSON.stringify(metadata)));
-    correctMetadata(this.metadata);
+  var storeMetadataCache = function(record) {
+    if (fingerprint && record)
+      this.metadataCache_.put(fingerprint, record);
+  }.bind(this);
+
+  if (this.decompressor.getArchiveSize() >=
+      unpacker.Volume.LAZY_METADATA_MINIMUM_ARCHIVE_SIZE) {
+    this.decompressor.readMetadata(requestId, this.encoding,
+                                   function(metadata, opt_record) {
+      this.lazyMetadata_ = true;
+      // Make a copy of metadata, which has no entries.
+      this.metadata = /** @type {!Object<string, !EntryMetadata>} */ (
+          JSON.parse(JSON.stringify(metadata)));
+      correctEntryMetadata(this.metadata);
+      storeMetadataCache(opt_record);
+      onSuccess();
+    }.bind(this), onError, unpacker.request.MetadataFormat.LAZY, undefined,
+    metadataCache);
+    return;
+  }
+
+  this.loadingMetadata_ = true;
+  this.decompressor.readMetadata(requestId, this.encoding,
+                                 function(metadata, opt_record) {
+    this.loadingMetadata_ = false;
+    this.metadataRecords_ = [];
+    if (metadata instanceof ArrayBuffer) {
+      // Also contains the changes to entries already received in batches.
+      this.metadata = decodeBinaryMetadata(metadata, []);
+    } else {
+      // Make a deep copy of metadata.
+      this.metadata = /** @type {!Object<string, !EntryMetadata>} */ (
+          JSON.parse(JSON.stringify(metadata)));
+      correctMetadata(this.metadata);
+    }
+    this.retryPendingRequests_();
+    storeMetadataCache(opt_record);
 
     onSuccess();
-  }.bind(this), onError);
+  }.bind(this), function(error) {
+    this.loadingMetadata_ = false;
+    this.metadataRecords_ = [];
+    var pendingRequests = this.pendingRequests_;
+    this.pendingRequests_ = [];
+    pendingRequests.forEach(function(request) {
+      request.onError('FAILED');
+    });
+
+    onError(error);
+  }.bind(this), unpacker.request.MetadataFormat.BINARY, function(buffer) {
+    this.metadata = decodeBinaryMetadata(buffer, this.metadataRecords_);
+    this.retryPendingRequests_();
+
+    if (opt_onProgress)
+      opt_onProgress();
+  }.bind(this), metadataCache);
 };
 
 /**
@@ -185,7 +454,23 @@ unpacker.Volume.prototype.initialize = function(onSuccess, onError) {
 unpacker.Volume.prototype.onGetMetadataRequested = function(options, onSuccess,
                                                             onError) {
   console.assert(this.isReady(), 'Metadata must be loaded.');
+  if (this.lazyMetadata_) {
+    this.decompressor.getMetadata(
+        options.requestId, options.entryPath, function(entryMetadata) {
+          correctEntryMetadata(entryMetadata);
+          onSuccess(entryMetadata);
+        }, onError);
+    return;
+  }
+
   var entryMetadata = this.getEntryMetadata_(options.entryPath);
+  if (!entryMetadata && this.loadingMetadata_) {
+    this.addPendingRequest_(
+        this.onGetMetadataRequested.bind(this, options, onSuccess, onError),
+        onError);
+    return;
+  }
+
   if (!entryMetadata)
     onError('NOT_FOUND');
   else
@@ -193,7 +478,8 @@ unpacker.Volume.prototype.onGetMetadataRequested = function(options, onSuccess,
 };
 
 /**
- * Reads a directory contents from metadata. Assumes metadata is loaded.
+ * Reads a directory contents from metadata. Assumes metadata is loaded. While
+ * the metadata is being read, the entries are sent as they are read.
  * @param {!unpacker.types.ReadDirectoryRequestedOptions} options Options
  *     for reading the contents of a directory.
  * @param {function(!Array<!EntryMetadata>, boolean)} onSuccess Callback to
@@ -203,9 +489,39 @@ unpacker.Volume.prototype.onGetMetadataRequested = function(options, onSuccess,
 unpacker.Volume.prototype.onReadDirectoryRequested = function(
     options, onSuccess, onError) {
   console.assert(this.isReady(), 'Metadata must be loaded.');
+  if (this.lazyMetadata_) {
+    this.decompressor.readDirectory(
+        options.requestId, options.directoryPath, function(entries) {
+          entries.forEach(correctEntryMetadata);
+          onSuccess(entries, false /* Last call. */);
+        }, onError);
+    return;
+  }
+
+  this.readDirectory_(options, {}, onSuccess, onError);
+};
+
+/**
+ * Sends the entries of a directory that were not sent yet.
+ * @param {!unpacker.types.ReadDirectoryRequestedOptions} options Options
+ *     for reading the contents of a directory.
+ * @param {!Object<string, boolean>} sentNames The names of the entries
+ *     already sent. Updated with the sent entries.
+ * @param {function(!Array<!EntryMetadata>, boolean)} onSuccess Callback to
+ *     execute on success.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ * @private
+ */
+unpacker.Volume.prototype.readDirectory_ = function(
+    options, sentNames, onSuccess, onError) {
+  var retry =
+      this.readDirectory_.bind(this, options, sentNames, onSuccess, onError);
   var directoryMetadata = this.getEntryMetadata_(options.directoryPath);
   if (!directoryMetadata) {
-    onError('NOT_FOUND');
+    if (this.loadingMetadata_)
+      this.addPendingRequest_(retry, onError);
+    else
+      onError('NOT_FOUND');
     return;
   }
   if (!directoryMetadata.isDirectory) {
@@ -216,9 +532,19 @@ unpacker.Volume.prototype.onReadDirectoryRequested = function(
   // Convert dictionary entries to an array.
   var entries = [];
   for (var entry in directoryMetadata.entries) {
+    if (sentNames[entry])
+      continue;
+    sentNames[entry] = true;
     entries.push(directoryMetadata.entries[entry]);
   }
 
+  if (this.loadingMetadata_) {
+    if (entries.length > 0)
+      onSuccess(entries, true /* More entries may be read. */);
+    this.addPendingRequest_(retry, onError);
+    return;
+  }
+
   onSuccess(entries, false /* Last call. */);
 };
 
@@ -237,23 +563,145 @@ unpacker.Volume.prototype.onOpenFileRequested = function(options, onSuccess,
     return;
   }
 
+  if (this.lazyMetadata_) {
+    this.decompressor.getMetadata(
+        options.requestId, options.filePath, function(metadata) {
+          correctEntryMetadata(metadata);
+          this.openFile_(options, metadata, onSuccess, onError);
+        }.bind(this), onError);
+    return;
+  }
+
   var metadata = this.getEntryMetadata_(options.filePath);
+  if (!metadata && this.loadingMetadata_) {
+    this.addPendingRequest_(
+        this.onOpenFileRequested.bind(this, options, onSuccess, onError),
+        onError);
+    return;
+  }
   if (!metadata) {
     onError('NOT_FOUND');
     return;
   }
 
+  this.openFile_(options, metadata, onSuccess, onError);
+};
+
+/**
+ * Opens the file with the given metadata in NaCl. Files requested while
+ * other files are being opened are batched, see pendingOpens_.
+ * @param {!unpacker.types.OpenFileRequestedOptions} options Options for
+ *     opening a file.
+ * @param {!Object} metadata The metadata of the file.
+ * @param {function()} onSuccess Callback to execute on success.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ * @private
+ */
+unpacker.Volume.prototype.openFile_ = function(options, metadata, onSuccess,
+                                               onError) {
   this.openedFiles[options.requestId] = options;
+  this.openedFileSizes_[options.requestId] = metadata.size;
+
+  this.pendingOpens_.push({
+    requestId: options.requestId,
+    index: metadata.index,
+    onSuccess: function() {
+      this.onFileOpened_();
+      onSuccess();
+    }.bind(this),
+    onError: function(error) {
+      delete this.openedFiles[options.requestId];
+      delete this.openedFileSizes_[options.requestId];
+      this.onFileOpened_();
+      onError('FAILED');
+    }.bind(this)
+  });
+  this.sendPendingOpens_();
+};
+
+/**
+ * Sends the files waiting to be opened to NaCl, unless files sent before are
+ * still being opened.
+ * @private
+ */
+unpacker.Volume.prototype.sendPendingOpens_ = function() {
+  if (this.openingFiles_ > 0 || this.pendingOpens_.length === 0)
+    return;
+
+  var files = this.pendingOpens_;
+  this.pendingOpens_ = [];
+  this.openingFiles_ = files.length;
+  if (files.length === 1) {
+    this.decompressor.openFile(files[0].requestId, files[0].index,
+                               this.encoding, files[0].onSuccess,
+                               files[0].onError);
+    return;
+  }
+  this.decompressor.openFiles(files, this.encoding);
+};
+
+/**
+ * Called once a file sent to NaCl is opened or failed to open.
+ * @private
+ */
+unpacker.Volume.prototype.onFileOpened_ = function() {
+  this.openingFiles_--;
+  this.sendPendingOpens_();
+};
+
+/**
+ * Opens a file by its path without the metadata, so it can be called before
+ * initialize. NaCl reads the headers only until the file is found, which is
+ * much faster than reading the metadata of a big archive if only one file near
+ * its beginning is needed. The file is read and closed like any file opened
+ * with onOpenFileRequested.
+ * @param {!unpacker.types.OpenFileRequestedOptions} options Options for
+ *     opening a file.
+ * @param {function()} onSuccess Callback to execute on success.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ */
+unpacker.Volume.prototype.openFileByPath = function(options, onSuccess,
+                                                    onError) {
+  if (options.mode != 'READ') {
+    onError('INVALID_OPERATION');
+    return;
+  }
 
-  this.decompressor.openFile(
-      options.requestId, metadata.index, this.encoding, function() {
+  this.openedFiles[options.requestId] = options;
+  this.decompressor.openFileByPath(
+      options.requestId, options.filePath, this.encoding, function(file) {
+        this.openedFileSizes_[options.requestId] = file.size;
         onSuccess();
       }.bind(this), function(error) {
         delete this.openedFiles[options.requestId];
-        onError('FAILED');
+        onError(error);
       }.bind(this));
 };
 
+/**
+ * Extracts files in a single pass over the archive, which is much faster than
+ * opening and reading them one by one for solid and streaming archives. Can be
+ * called before initialize.
+ * @param {!unpacker.types.RequestId} requestId
+ * @param {?Array<number>} indices The indices of the entries to extract or
+ *     null for all of the entries.
+ * @param {function({index: number, path: string, size: number}, !ArrayBuffer,
+ *     boolean)} onData Callback to execute for every chunk of data, see
+ *     unpacker.Decompressor.prototype.extract.
+ * @param {function()} onSuccess Callback to execute on success.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ */
+unpacker.Volume.prototype.extract = function(requestId, indices, onData,
+                                             onSuccess, onError) {
+  // NaCl extracts all of the entries without indices.
+  if (indices && indices.length === 0) {
+    onSuccess();
+    return;
+  }
+  this.decompressor.extract(requestId, indices, this.encoding, onData,
+                            onSuccess, onError);
+};
+
 /**
  * Closes a file identified by options.openRequestId.
  * @param {!unpacker.types.CloseFileRequestedOptions} options Options for
@@ -263,7 +711,8 @@ unpacker.Volume.prototype.onOpenFileRequested = function(options, onSuccess,
  */
 unpacker.Volume.prototype.onCloseFileRequested = function(options, onSuccess,
                                                           onError) {
-  console.assert(this.isReady(), 'Metadata must be loaded.');
+  // Files opened with openFileByPath can be closed before the metadata is
+  // loaded.
   var openRequestId = options.openRequestId;
   var openOptions = this.openedFiles[openRequestId];
   if (!openOptions) {
@@ -273,6 +722,7 @@ unpacker.Volume.prototype.onCloseFileRequested = function(options, onSuccess,
 
   this.decompressor.closeFile(options.requestId, openRequestId, function() {
     delete this.openedFiles[openRequestId];
+    delete this.openedFileSizes_[openRequestId];
     onSuccess();
   }.bind(this), onError);
 };
@@ -287,7 +737,8 @@ unpacker.Volume.prototype.onCloseFileRequested = function(options, onSuccess,
  */
 unpacker.Volume.prototype.onReadFileRequested = function(options, onSuccess,
                                                          onError) {
-  console.assert(this.isReady(), 'Metadata must be loaded.');
+  // Files opened with openFileByPath can be read before the metadata is
+  // loaded.
   var openOptions = this.openedFiles[options.openRequestId];
   if (!openOptions) {
     onError('INVALID_OPERATION');
@@ -300,7 +751,7 @@ unpacker.Volume.prototype.onReadFileRequested = function(options, onSuccess,
   console.assert(offset >= 0, 'Offset should be >= 0.');
   console.assert(length >= 0, 'Length should be >= 0.');
 
-  var fileSize = this.getEntryMetadata_(openOptions.filePath).size;
+  var fileSize = this.openedFileSizes_[options.openRequestId];
   if (offset >= fileSize || length == 0) {  // No more data.
     onSuccess(new ArrayBuffer(0), false /* Last call. */);
     return;
@@ -311,6 +762,31 @@ unpacker.Volume.prototype.onReadFileRequested = function(options, onSuccess,
                              offset, length, onSuccess, onError);
 };
 
+/**
+ * Adds a request to be retried once more entries are read.
+ * @param {function()} retry Retries the request.
+ * @param {function(!ProviderError)} onError Callback to execute if reading
+ *     the metadata fails.
+ * @private
+ */
+unpacker.Volume.prototype.addPendingRequest_ = function(retry, onError) {
+  console.assert(this.loadingMetadata_, 'Metadata must be loading.');
+  this.pendingRequests_.push({retry: retry, onError: onError});
+};
+
+/**
+ * Retries the pending requests after new entries were read. Requests that
+ * still can't be answered are added back.
+ * @private
+ */
+unpacker.Volume.prototype.retryPendingRequests_ = function() {
+  var pendingRequests = this.pendingRequests_;
+  this.pendingRequests_ = [];
+  pendingRequests.forEach(function(request) {
+    request.retry();
+  });
+};
+
 /**
  * Gets the metadata for an entry based on its path.
  * @param {string} entryPath The full path to the entry.